@@ -27,6 +27,7 @@ int main(int argc, char **argv) {
     cmdParser.add<string>("model", 'm', "specify mllm model path", false, default_model_path);
     cmdParser.add<int>("limits", 'l', "max KV cache size", false, 500);
     cmdParser.add<int>("thread", 't', "num of threads", false, 4);
+    cmdParser.add<int>("experts", 'x', "MoE experts kept in memory, 0 keeps all", false, 0);
     cmdParser.add<int>("gen", 'g', "max new tokens", false, -1);
     cmdParser.parse_check(argc, argv);
 
@@ -41,6 +42,7 @@ int main(int argc, char **argv) {
 
     auto tokenizer = BaiLingTokenizer(vocab_path, merge_path);
     BailingMoeConfig config(tokens_limit);
+    config.expert_cache_size = cmdParser.get<int>("experts");
 #ifdef USE_OPENCL
     if (device == MLLM_OPENCL) {
         config.dtype = MLLM_TYPE_F16;
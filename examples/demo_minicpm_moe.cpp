@@ -12,6 +12,7 @@ int main(int argc, char **argv) {
     cmdParser.add<string>("model", 'm', "specify mllm model path", false, "../models/minicpm-moe-8x2b-q4_k.mllm");
     cmdParser.add<int>("limits", 'l', "max KV cache size", false, 400);
     cmdParser.add<int>("thread", 't', "num of threads", false, 4);
+    cmdParser.add<int>("experts", 'x', "MoE experts kept in memory, 0 keeps all", false, 0);
     cmdParser.parse_check(argc, argv);
 
     string vocab_path = cmdParser.get<string>("vocab");
@@ -21,6 +22,7 @@ int main(int argc, char **argv) {
 
     auto tokenizer = MiniCPMTokenizer(vocab_path, "../vocab/minicpm_merges.txt");
     MiniCPMConfig config(tokens_limit, "2B");
+    config.expert_cache_size = cmdParser.get<int>("experts");
     auto model = MiniCPMForCausalLM(config);
     model.load(model_path);
 
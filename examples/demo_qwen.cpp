@@ -12,6 +12,10 @@
 #include "models/qwen/configuration_qwen.hpp"
 #include "models/qwen/modeling_qwen.hpp"
 #include "models/qwen/tokenization_qwen.hpp"
+#include "tokenizers/StreamDetokenizer.hpp"
+#include "backends/cpu/CPUPrefixCache.hpp"
+#include <algorithm>
+#include <memory>
 
 using namespace mllm;
 
@@ -32,6 +36,8 @@ int main(int argc, char **argv) {
     cmdParser.add<string>("billion", 'b', "[0.5B | 1.8B | 1.5B | 3B |]", false, default_model_billion);
     cmdParser.add<int>("limits", 'l', "max KV cache size", false, 550);
     cmdParser.add<int>("thread", 't', "num of threads", false, 4);
+    cmdParser.add<int>("cores", 'c', "cores of the worker threads [0:`all` | 1:`big` | 2:`little`]", false, 0);
+    cmdParser.add("prefix_cache", 'p', "prefill the prompt prefix shared by the questions once (cpu only)");
     cmdParser.parse_check(argc, argv);
 
     string vocab_path = cmdParser.get<string>("vocab");
@@ -39,7 +45,7 @@ int main(int argc, char **argv) {
     string model_path = cmdParser.get<string>("model");
     string model_billion = cmdParser.get<string>("billion");
     int tokens_limit = cmdParser.get<int>("limits");
-    CPUBackend::cpu_threads = cmdParser.get<int>("thread");
+    CPUBackend::configureThreads(cmdParser.get<int>("thread"), cmdParser.get<int>("cores"));
     BackendType device = (BackendType)cmdParser.get<int>("device");
     assert((device == MLLM_CPU || device == MLLM_OPENCL) && "device not supports!");
 
@@ -57,6 +63,10 @@ int main(int argc, char **argv) {
     model = model.to(device);
 #endif
     model.load(model_path);
+    std::unique_ptr<CPUPrefixCache> prefix_cache;
+    if (cmdParser.exist("prefix_cache") && device == MLLM_CPU) {
+        prefix_cache = std::make_unique<CPUPrefixCache>(model);
+    }
 
     vector<string> in_strs = {
         "Give me a short introduction to large language model.",
@@ -64,9 +74,24 @@ int main(int argc, char **argv) {
         "清晨的阳光透过薄纱窗帘，懒洋洋地洒在木地板上，空气中飘散着咖啡豆研磨后特有的醇厚香气。窗外传来几声清脆的鸟鸣，伴随着远处隐约的车流声，构成这座都市尚未完全苏醒的独特交响。书桌上摊开着昨夜未读完的书，书页边缘已微微卷起。厨房里，水壶正发出细密的声响，预示着一天的热饮即将就绪。昨日的计划表贴在冰箱门上，几个重要的待办事项用红笔醒目地圈出。公园里晨练的人们身影绰绰，有节奏的脚步声和太极音乐交织。一只橘猫敏捷地跃上围墙，在晨光中伸展着腰肢，神态悠闲得仿佛它是这片领地的主人。街角的面包店刚拉开铁门，新鲜出炉的面包香气迫不及待地涌向街头。公交站台上，等待的乘客低头刷着手机屏幕，神情各异。云朵缓慢地在湛蓝的天空中移动，时间似乎被拉长了片刻。生活就在这些微小的、平凡的细节里徐徐展开，既不惊天动地，却也充满细碎的温暖和实在的步履。新的一天开始了。\n​​请在以上文本中找出描述“气味”的句子（复制出来），然后判断叙述者对“橘猫”的态度是正面还是负面，最后请用三个成语概括文中描绘的早晨氛围。",
         "项羽已杀卿子冠军，威震楚国，名闻诸侯。乃遣当阳君、蒲将军将卒二万渡河，救巨鹿。战少利，陈馀复请兵。项羽乃悉引兵渡河，皆沉船，破釜甑，烧庐舍，持三日粮，以示士卒必死，无一还心。于是至则围王离，与秦军遇，九战，绝其甬道，大破之，杀苏角，虏王离。涉间不降楚，自烧杀。当是时，楚兵冠诸侯。诸侯军救巨鹿下者十余壁，莫敢纵兵。及楚击秦，诸将皆从壁上观。楚战士无不一以当十，楚兵呼声动天，诸侯军无不人人惴恐。于是已破秦军，项羽召见诸侯将，入辕门，无不膝行而前，莫敢仰视。项羽由是始为诸侯上将军，诸侯皆属焉。 问题：结合项羽在巨鹿之战中的战术决策与心理威慑手段，分析其如何实现『楚战士无不一以当十』的战斗效应，并论述这种军事心理学实践对诸侯将领『膝行而前，莫敢仰视』行为模式的生成机制。",
     };
+    // the chat template puts the same system prompt in front of every question
+    vector<vector<token_id_t>> prompts;
+    for (auto &str : in_strs) {
+        auto ids = tokenizer.tokenize(tokenizer.apply_chat_template(str));
+        vector<token_id_t> prompt(ids.sequence());
+        for (int s = 0; s < ids.sequence(); ++s) {
+            prompt[s] = ids.dataAt<float>(0, 0, s, 0);
+        }
+        prompts.push_back(std::move(prompt));
+    }
+    size_t shared = prompts[0].size();
+    for (auto &prompt : prompts) {
+        shared = std::mismatch(prompts[0].begin(), prompts[0].begin() + std::min(shared, prompt.size()), prompt.begin()).first - prompts[0].begin();
+    }
     for (int i = 0; i < in_strs.size(); ++i) {
-        auto input_str = tokenizer.apply_chat_template(in_strs[i]);
-        auto input_tensor = tokenizer.tokenize(input_str);
+        auto &prompt = prompts[i];
+        int hit = prefix_cache ? prefix_cache->restore(prompt) : 0;
+        auto input_tensor = Tokenizer::tokens2Input(vector<token_id_t>(prompt.begin() + hit, prompt.end()));
         std::cout << "[Q] " << in_strs[i] << std::endl;
         std::cout << "[A] " << std::flush;
 
@@ -77,14 +102,18 @@ int main(int argc, char **argv) {
             .top_k = 50,
             .top_p = 0.F,
         };
+        StreamDetokenizer stream(tokenizer);
         model.generate(input_tensor, opt, [&](unsigned int out_token) -> bool {
-            auto out_string = tokenizer.detokenize({out_token});
-            auto [not_end, output_string] = tokenizer.postprocess(out_string);
-            if (!not_end) { return false; }
-            std::cout << output_string << std::flush;
+            // <|im_end|> / <|endoftext|> end the answer
+            if (out_token == tokenizer.eos_id_ || out_token == tokenizer.bos_id_) { return false; }
+            std::cout << stream.push(out_token) << std::flush;
             return true;
         });
-        std::cout << "\n";
+        std::cout << stream.flush() << "\n";
+        if (prefix_cache && hit == 0 && shared > 0) {
+            // the cache starts with this prompt, keep its shared part for the next questions
+            prefix_cache->insert(vector<unsigned>(prompt.begin(), prompt.begin() + shared));
+        }
         model.clear_kvcache();
         model.profiling();
     }
@@ -0,0 +1,65 @@
+/**
+ * @file demo_qwen_continuous_batch.cpp
+ * @brief Continuous batching: requests join free batch slots while others are still decoding.
+ */
+#include "cmdline.h"
+#include "BatchScheduler.hpp"
+#include "models/qwen/configuration_qwen.hpp"
+#include "models/qwen/modeling_qwen.hpp"
+#include "models/qwen/tokenization_qwen.hpp"
+#include <string>
+#include <vector>
+
+using namespace mllm;
+
+int main(int argc, char **argv) {
+    std::iostream::sync_with_stdio(false);
+
+    cmdline::parser cmdParser;
+    cmdParser.add<string>("vocab", 'v', "specify mllm tokenizer model path", false, "../vocab/qwen2.5_vocab.mllm");
+    cmdParser.add<string>("merge", 'e', "specify mllm merge file path", false, "../vocab/qwen2.5_merges.txt");
+    cmdParser.add<string>("model", 'm', "specify mllm model path", false, "../models/qwen-2.5-1.5b-instruct-q4_0_4_4.mllm");
+    cmdParser.add<string>("billion", 'b', "[0.5B | 1.8B | 1.5B | 3B |]", false, "1.5b-lm");
+    cmdParser.add<int>("limits", 'l', "max KV cache size", false, 1024);
+    cmdParser.add<int>("slots", 's', "batch slots", false, 2);
+    cmdParser.add<int>("thread", 't', "num of threads", false, 4);
+    cmdParser.parse_check(argc, argv);
+
+    CPUBackend::cpu_threads = cmdParser.get<int>("thread");
+    auto tokenizer = QWenTokenizer(cmdParser.get<string>("vocab"), cmdParser.get<string>("merge"));
+    QWenConfig config(cmdParser.get<int>("limits"), cmdParser.get<string>("billion"), RoPEType::HFHUBROPE);
+    config.attn_implementation = "eager"; // the scheduler masks per row in Softmax
+    auto model = QWenForCausalLM(config);
+    model.load(cmdParser.get<string>("model"));
+
+    vector<string> in_strs = {
+        "Give me a short introduction to large language model.",
+        "介绍一下你自己。",
+        "什么是北京市的旧称？",
+    };
+    LlmTextGeneratorOpts opt{
+        .max_new_tokens = 100,
+        .do_sample = false,
+    };
+    BatchScheduler scheduler(model, cmdParser.get<int>("slots"), opt, tokenizer.eos_id_);
+    vector<int> ids;
+    for (auto &str : in_strs) {
+        auto input = tokenizer.tokenize(tokenizer.apply_chat_template(str));
+        vector<unsigned> prompt;
+        for (int i = 0; i < input.sequence(); ++i) {
+            prompt.push_back(input.dataAt<float>(0, 0, i, 0));
+        }
+        ids.push_back(scheduler.submit(prompt));
+    }
+    scheduler.run();
+    for (int i = 0; i < ids.size(); ++i) {
+        std::cout << "[Q" << i << "] " << in_strs[i] << std::endl;
+        BatchScheduler::FinishReason reason;
+        auto answer = scheduler.takeResult(ids[i], &reason);
+        std::cout << "[A" << i << "] " << tokenizer.detokenize(answer) << std::endl;
+        if (reason == BatchScheduler::FinishReason::KVCacheFull) {
+            std::cout << "[A" << i << " truncated: KV cache full, raise --limits]" << std::endl;
+        }
+    }
+    model.profiling();
+}
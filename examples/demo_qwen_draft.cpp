@@ -0,0 +1,68 @@
+/**
+ * @file demo_qwen_draft.cpp
+ * @brief Speculative decoding with a small Qwen2.5 drafting for a larger one (same tokenizer).
+ */
+#include "cmdline.h"
+#include "DraftDecoder.hpp"
+#include "models/qwen/configuration_qwen.hpp"
+#include "models/qwen/modeling_qwen.hpp"
+#include "models/qwen/tokenization_qwen.hpp"
+#include "tokenizers/StreamDetokenizer.hpp"
+#include <string>
+#include <vector>
+
+using namespace mllm;
+
+int main(int argc, char **argv) {
+    std::iostream::sync_with_stdio(false);
+
+    cmdline::parser cmdParser;
+    cmdParser.add<string>("vocab", 'v', "specify mllm tokenizer model path", false, "../vocab/qwen2.5_vocab.mllm");
+    cmdParser.add<string>("merge", 'e', "specify mllm merge file path", false, "../vocab/qwen2.5_merges.txt");
+    cmdParser.add<string>("model", 'm', "specify mllm target model path", false, "../models/qwen-2.5-1.5b-instruct-q4_0_4_4.mllm");
+    cmdParser.add<string>("billion", 'b', "target [0.5B | 1.8B | 1.5B | 3B |]", false, "1.5b");
+    cmdParser.add<string>("draft", 'r', "specify mllm draft model path", false, "../models/qwen-2.5-0.5b-instruct-q4_0_4_4.mllm");
+    cmdParser.add<string>("draft_billion", 'c', "draft [0.5B | 1.8B | 1.5B | 3B |]", false, "0.5b");
+    cmdParser.add<int>("max_draft", 'k', "max draft tokens per step", false, 8);
+    cmdParser.add<int>("limits", 'l', "max KV cache size", false, 600);
+    cmdParser.add<int>("thread", 't', "num of threads", false, 4);
+    cmdParser.parse_check(argc, argv);
+
+    int tokens_limit = cmdParser.get<int>("limits");
+    CPUBackend::cpu_threads = cmdParser.get<int>("thread");
+    auto tokenizer = QWenTokenizer(cmdParser.get<string>("vocab"), cmdParser.get<string>("merge"));
+    QWenConfig config(tokens_limit, cmdParser.get<string>("billion"));
+    QWenConfig draft_config(tokens_limit, cmdParser.get<string>("draft_billion"));
+    auto model = QWenForCausalLM(config);
+    auto draft = QWenForCausalLM(draft_config);
+    DraftModelDecoder decoder(model, draft, cmdParser.get<int>("max_draft"));
+    decoder.load(cmdParser.get<string>("model"), cmdParser.get<string>("draft"));
+
+    vector<string> in_strs = {
+        "Give me a short introduction to large language model.",
+        "介绍一下你自己。",
+        "Write a C function that reverses a singly linked list.",
+    };
+    LlmTextGeneratorOpts opt{
+        .max_new_tokens = 200,
+        .do_sample = false,
+    };
+    for (auto &str : in_strs) {
+        auto input_tensor = tokenizer.tokenize(tokenizer.apply_chat_template(str));
+        std::cout << "[Q] " << str << std::endl;
+        std::cout << "[A] " << std::flush;
+        StreamDetokenizer stream(tokenizer);
+        decoder.generate(input_tensor, opt, [&](unsigned int out_token) -> bool {
+            // <|im_end|> / <|endoftext|> end the answer
+            if (out_token == tokenizer.eos_id_ || out_token == tokenizer.bos_id_) { return false; }
+            std::cout << stream.push(out_token) << std::flush;
+            return true;
+        });
+        std::cout << stream.flush() << "\n";
+        auto &stats = decoder.stats();
+        std::cout << "[SD] acceptance " << stats.acceptanceRate() << ", " << stats.tokensPerStep()
+                  << " tokens per target step, draft length now " << decoder.draftLength() << std::endl;
+    }
+    model.profiling("target");
+    draft.profiling("draft");
+}
@@ -27,6 +27,7 @@ int main(int argc, char **argv) {
     cmdParser.add<string>("model", 'm', "specify mllm model path", false, default_model_path);
     cmdParser.add<int>("limits", 'l', "max KV cache size", false, 500);
     cmdParser.add<int>("thread", 't', "num of threads", false, 4);
+    cmdParser.add<int>("experts", 'x', "MoE experts kept in memory, 0 keeps all", false, 0);
     cmdParser.parse_check(argc, argv);
     string vocab_path = cmdParser.get<string>("vocab");
     string merge_path = cmdParser.get<string>("merge");
@@ -41,6 +42,7 @@ int main(int argc, char **argv) {
     string chat_template_end = "<|im_end|>\n<|im_start|>assistant\n";
     tokenizer.set_chat_template(chat_template_pre, chat_template_end);
     SmallThinkerConfig config(tokens_limit, "4ba0.6b-lm");
+    config.expert_cache_size = cmdParser.get<int>("experts");
 #ifdef USE_OPENCL
     if (device == MLLM_OPENCL) {
         config.dtype = MLLM_TYPE_F16;
@@ -0,0 +1,349 @@
+// Kernel micro-benchmark: mat_mul for every weight dtype of type_traits on the projection shapes of
+// our models, plus the attention kernels (flash_attention_2, sage attention) and softmax, through the
+// same ops the models run. Reports ms, GFLOP/s and GB/s, writes JSON (one result per line) and
+// compares against a previous JSON run with --baseline.
+//
+//   ./kernel_benchmark -t 4 -j now.json
+//   ./kernel_benchmark -t 4 -b now.json -f Q4_0      # after a change: only the Q4_0 cases, vs. baseline
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <vector>
+#include "cmdline.h"
+#include "Module.hpp"
+#include "Tensor.hpp"
+#include "Timing.hpp"
+#include "Types.hpp"
+#include "backends/cpu/CPUBackend.hpp"
+#include "backends/cpu/compute/Matmul.hpp"
+#include "backends/cpu/compute/GemmKleidiai.hpp"
+#include "backends/cpu/third_party/ggml/GemmPack.hpp"
+#include "backends/cpu/third_party/ggml/VecDotType.hpp"
+
+using namespace mllm;
+
+struct BenchResult {
+    std::string name;
+    double ms = 0;
+    double flops = 0;
+    double bytes = 0;
+};
+
+struct LinearShape {
+    std::string model;
+    std::string proj;
+    int N;
+    int K;
+};
+
+struct AttnShape {
+    std::string model;
+    int q_head;
+    int kv_head;
+    int dim;
+};
+
+// (N, K) of the projections of the models we ship
+static const std::vector<LinearShape> linear_shapes = {
+    {"qwen2.5-0.5B", "qkv", 896, 896},
+    {"qwen2.5-0.5B", "kv", 128, 896},
+    {"qwen2.5-0.5B", "up", 4864, 896},
+    {"qwen2.5-0.5B", "down", 896, 4864},
+    {"qwen2.5-1.5B", "qo", 1536, 1536},
+    {"qwen2.5-1.5B", "up", 8960, 1536},
+    {"qwen2.5-1.5B", "down", 1536, 8960},
+    {"llama-7B", "qkvo", 4096, 4096},
+    {"llama-7B", "up", 11008, 4096},
+    {"llama-7B", "down", 4096, 11008},
+};
+
+static const std::vector<AttnShape> attn_shapes = {
+    {"qwen2.5-0.5B", 14, 2, 64},
+    {"qwen2.5-1.5B", 12, 2, 128},
+    {"llama-7B", 32, 32, 128},
+};
+
+static std::mt19937 rng(42);
+
+static void fill_random(float *data, size_t n) {
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    for (size_t i = 0; i < n; ++i) {
+        data[i] = dist(rng);
+    }
+}
+
+static shared_ptr<Tensor> make_tensor(int b, int h, int s, int d, DataType dtype = MLLM_TYPE_F32) {
+    auto t = std::make_shared<Tensor>(Backend::global_backends[MLLM_CPU].get());
+    t->reshape(b, h, s, d);
+    t->setDtype(dtype);
+    t->alloc();
+    return t;
+}
+
+static shared_ptr<Tensor> make_random(int b, int h, int s, int d, DataType dtype = MLLM_TYPE_F32) {
+    auto t = make_tensor(b, h, s, d, dtype);
+    if (dtype == MLLM_TYPE_F32) {
+        fill_random(t->hostPtr<float>(), t->count());
+    } else {
+        std::vector<float> src(t->count());
+        fill_random(src.data(), src.size());
+        type_traits[dtype].from_float(src.data(), t->rawHostPtr(), (int)src.size());
+    }
+    return t;
+}
+
+// [1, 1, N, K] weight in `dtype`, nullptr if the dtype cannot hold this shape
+static shared_ptr<Tensor> make_weight(DataType dtype, int N, int K) {
+    if (K % blck_size(dtype) != 0) {
+        return nullptr;
+    }
+    std::vector<float> src((size_t)N * K);
+    fill_random(src.data(), src.size());
+    auto w = make_tensor(1, 1, N, K, dtype);
+    if (dtype == MLLM_TYPE_Q4_0_4_4) {
+        if (N % 4 != 0) return nullptr;
+        quantize_row_q4_0_4x4(src.data(), w->rawHostPtr(), (int)src.size(), K);
+    } else if (type_traits[dtype].from_float != nullptr) {
+        for (int n = 0; n < N; ++n) {
+            type_traits[dtype].from_float(src.data() + (size_t)n * K, (char *)w->rawHostPtr() + row_size(dtype, K) * n, K);
+        }
+    } else if (dtype == MLLM_TYPE_F32) {
+        std::copy(src.begin(), src.end(), w->hostPtr<float>());
+    } else {
+        return nullptr;
+    }
+    return w;
+}
+
+template <typename F>
+static double time_ms(F &&fn, int warmup, int iters) {
+    for (int i = 0; i < warmup; ++i) fn();
+    std::vector<double> runs;
+    for (int i = 0; i < iters; ++i) {
+        auto t0 = mllm_time_ns();
+        fn();
+        runs.push_back((mllm_time_ns() - t0) / 1e6);
+    }
+    // median, robust to the odd preempted run
+    std::nth_element(runs.begin(), runs.begin() + runs.size() / 2, runs.end());
+    return runs[runs.size() / 2];
+}
+
+static bool selected(const std::string &name, const std::string &filter) {
+    return filter.empty() || name.find(filter) != std::string::npos;
+}
+
+static void bench_linear(const std::vector<int> &ms, int threads, int warmup, int iters, const std::string &filter,
+                         std::vector<BenchResult> &results) {
+    std::vector<DataType> dtypes = {MLLM_TYPE_F32, MLLM_TYPE_F16, MLLM_TYPE_Q8_0, MLLM_TYPE_Q4_0, MLLM_TYPE_Q4_K,
+                                    MLLM_TYPE_Q6_K, MLLM_TYPE_Q2_K, MLLM_TYPE_Q4_0_4_4};
+#if defined(__aarch64__) || defined(__arm__) || defined(__arm64__)
+    dtypes.push_back(MLLM_TYPE_KLEIDIAI_Q4_0);
+#endif
+    for (auto dtype : dtypes) {
+        for (const auto &shape : linear_shapes) {
+            for (int M : ms) {
+                std::string name = std::string(M == 1 ? "gemv/" : "gemm/") + DataTypeName(dtype) + "/" + shape.model + "." + shape.proj
+                                   + "/M" + std::to_string(M) + "N" + std::to_string(shape.N) + "K" + std::to_string(shape.K);
+                if (!selected(name, filter)) continue;
+                auto x = make_random(1, 1, M, shape.K);
+                auto out = make_tensor(1, 1, M, shape.N);
+                BenchResult r;
+                r.name = name;
+                r.flops = 2.0 * M * shape.N * shape.K;
+                if (dtype == MLLM_TYPE_KLEIDIAI_Q4_0) {
+#if defined(__aarch64__) || defined(__arm__) || defined(__arm64__)
+                    std::vector<float> w_kn((size_t)shape.K * shape.N);
+                    fill_random(w_kn.data(), w_kn.size());
+                    std::vector<uint8_t> packed(mllm_kleidai_get_packed_b_qsi4_size(shape.N, shape.K));
+                    mllm_kleidai_pack_b_and_bias_qsi4(packed.data(), w_kn.data(), nullptr, shape.N, shape.K);
+                    kai_thread_count = threads;
+                    r.ms = time_ms([&] { mllm_kleidai_gemm_qsi4(out->hostPtr<float>(), x->hostPtr<float>(), packed.data(), M, shape.N, shape.K); },
+                                   warmup, iters);
+                    r.bytes = packed.size() + x->cntSize() + out->cntSize();
+#endif
+                } else {
+                    auto w = make_weight(dtype, shape.N, shape.K);
+                    if (w == nullptr) continue;
+                    r.ms = time_ms([&] { mat_mul(x.get(), w.get(), out.get(), false, nullptr, false, true, threads); }, warmup, iters);
+                    r.bytes = (double)w->cntSize() + x->cntSize() + out->cntSize();
+                }
+                results.push_back(r);
+            }
+        }
+    }
+}
+
+// q [1, q_head, Sq, D] against k/v [1, kv_head, Skv, D], all BSHD like the models' flash_attention_2 path
+static void bench_attention(int threads, int warmup, int iters, int prefill, int context, const std::string &filter,
+                            std::vector<BenchResult> &results) {
+    auto *bn = Backend::global_backends[MLLM_CPU].get();
+    struct Variant {
+        std::string kernel;
+        OpType type;
+        DataType kv_dtype;
+    };
+    std::vector<Variant> variants = {
+        {"fa2", F_FA2, MLLM_TYPE_F32},
+        {"sage", F_SAGEATTN, MLLM_TYPE_F32},
+        {"sage", F_SAGEATTN, MLLM_TYPE_F16},
+    };
+    for (const auto &v : variants) {
+        for (const auto &shape : attn_shapes) {
+            // prefill: causal Sq == Skv, decode: one query against the whole context
+            for (bool is_prefill : {true, false}) {
+                const int sq = is_prefill ? prefill : 1;
+                const int skv = is_prefill ? prefill : context;
+                std::string name = "attn/" + v.kernel + "/" + DataTypeName(v.kv_dtype) + "/" + shape.model + "/" + (is_prefill ? "prefill" : "decode")
+                                   + "/Sq" + std::to_string(sq) + "Skv" + std::to_string(skv);
+                if (!selected(name, filter)) continue;
+                OpParam param;
+                param["type"] = v.type;
+                param["causal_mask"] = is_prefill;
+                std::unique_ptr<Op> op(bn->opCreate(param, name, threads));
+                auto q = make_random(1, shape.q_head, sq, shape.dim);
+                auto k = make_random(1, shape.kv_head, skv, shape.dim, v.kv_dtype);
+                auto val = make_random(1, shape.kv_head, skv, shape.dim, v.kv_dtype);
+                auto o = make_tensor(1, shape.q_head, sq, shape.dim);
+                vector<shared_ptr<Tensor>> inputs = {q, k, val};
+                vector<shared_ptr<Tensor>> outputs = {o};
+                op->reshape(inputs, outputs);
+                o->alloc();
+                BenchResult r;
+                r.name = name;
+                r.ms = time_ms([&] { op->execute(inputs, outputs); }, warmup, iters);
+                r.flops = 4.0 * shape.q_head * sq * skv * shape.dim * (is_prefill ? 0.5 : 1.0);
+                r.bytes = (double)q->cntSize() + k->cntSize() + val->cntSize() + o->cntSize();
+                results.push_back(r);
+            }
+        }
+    }
+}
+
+static void bench_softmax(int threads, int warmup, int iters, int prefill, const std::string &filter,
+                          std::vector<BenchResult> &results) {
+    auto *bn = Backend::global_backends[MLLM_CPU].get();
+    for (const auto &shape : attn_shapes) {
+        std::string name = "softmax/causal/" + shape.model + "/H" + std::to_string(shape.q_head) + "S" + std::to_string(prefill);
+        if (!selected(name, filter)) continue;
+        OpParam param;
+        param["type"] = SOFTMAX;
+        param["axis"] = DIMENSION;
+        param["do_causal_mask"] = true;
+        std::unique_ptr<Op> op(bn->opCreate(param, name, threads));
+        auto in = make_random(1, shape.q_head, prefill, prefill);
+        auto out = make_tensor(1, shape.q_head, prefill, prefill);
+        vector<shared_ptr<Tensor>> inputs = {in};
+        vector<shared_ptr<Tensor>> outputs = {out};
+        op->reshape(inputs, outputs);
+        out->alloc();
+        BenchResult r;
+        r.name = name;
+        r.ms = time_ms([&] { op->execute(inputs, outputs); }, warmup, iters);
+        r.flops = 5.0 * in->count(); // max, sub, exp, sum, scale
+        r.bytes = (double)in->cntSize() + out->cntSize();
+        results.push_back(r);
+    }
+}
+
+static std::vector<int> parse_ints(const std::string &s) {
+    std::vector<int> values;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) values.push_back(std::stoi(item));
+    }
+    return values;
+}
+
+// the JSON written by write_json: one {"name": ..., "ms": ...} object per line
+static std::map<std::string, double> read_baseline(const std::string &path) {
+    std::map<std::string, double> baseline;
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line)) {
+        auto name_pos = line.find("\"name\":\"");
+        auto ms_pos = line.find("\"ms\":");
+        if (name_pos == std::string::npos || ms_pos == std::string::npos) continue;
+        name_pos += 8;
+        auto name_end = line.find('"', name_pos);
+        baseline[line.substr(name_pos, name_end - name_pos)] = std::stod(line.substr(ms_pos + 5));
+    }
+    return baseline;
+}
+
+static void write_json(const std::string &path, const std::vector<BenchResult> &results, int threads) {
+    std::ofstream file(path);
+    file << std::fixed << std::setprecision(4);
+    file << "{\"threads\":" << threads << ",\"results\":[\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto &r = results[i];
+        file << "{\"name\":\"" << r.name << "\",\"ms\":" << r.ms << ",\"gflops\":" << r.flops / r.ms / 1e6
+             << ",\"gbps\":" << r.bytes / r.ms / 1e6 << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    file << "]}\n";
+}
+
+int main(int argc, char **argv) {
+    cmdline::parser cmdParser;
+    cmdParser.add<int>("thread", 't', "num of threads", false, 4);
+    cmdParser.add<int>("iters", 'i', "timed iterations per case (median is reported)", false, 20);
+    cmdParser.add<int>("warmup", 'w', "untimed iterations per case", false, 3);
+    cmdParser.add<std::string>("m", 'm', "comma separated M (rows of x) for the GEMMs, 1 = gemv", false, "1,16,128");
+    cmdParser.add<int>("prefill", 'p', "sequence length of the prefill attention / softmax cases", false, 512);
+    cmdParser.add<int>("context", 'c', "KV length of the decode attention cases", false, 1024);
+    cmdParser.add<std::string>("filter", 'f', "only run cases whose name contains this", false, "");
+    cmdParser.add<std::string>("json", 'j', "write the results to this JSON file", false, "");
+    cmdParser.add<std::string>("baseline", 'b', "JSON of an earlier run to compare against", false, "");
+    cmdParser.add<float>("tolerance", 'r', "slowdown vs. baseline (percent) reported as a regression", false, 5.0f);
+    cmdParser.parse_check(argc, argv);
+
+    const int threads = cmdParser.get<int>("thread");
+    const int iters = std::max(1, cmdParser.get<int>("iters"));
+    const int warmup = cmdParser.get<int>("warmup");
+    const int prefill = cmdParser.get<int>("prefill");
+    const int context = cmdParser.get<int>("context");
+    const auto filter = cmdParser.get<std::string>("filter");
+    CPUBackend::cpu_threads = threads;
+    Module::initBackend(MLLM_CPU);
+
+    std::vector<BenchResult> results;
+    bench_linear(parse_ints(cmdParser.get<std::string>("m")), threads, warmup, iters, filter, results);
+    bench_attention(threads, warmup, iters, prefill, context, filter, results);
+    bench_softmax(threads, warmup, iters, prefill, filter, results);
+
+    std::map<std::string, double> baseline;
+    if (!cmdParser.get<std::string>("baseline").empty()) {
+        baseline = read_baseline(cmdParser.get<std::string>("baseline"));
+    }
+    const double tolerance = cmdParser.get<float>("tolerance") / 100.0;
+    int regressions = 0;
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << std::left << std::setw(64) << "case" << std::right << std::setw(12) << "ms" << std::setw(12) << "GFLOP/s"
+              << std::setw(12) << "GB/s" << (baseline.empty() ? "" : "     vs. baseline") << std::endl;
+    for (const auto &r : results) {
+        std::cout << std::left << std::setw(64) << r.name << std::right << std::setw(12) << r.ms
+                  << std::setw(12) << r.flops / r.ms / 1e6 << std::setw(12) << r.bytes / r.ms / 1e6;
+        auto it = baseline.find(r.name);
+        if (it != baseline.end() && it->second > 0) {
+            const double change = r.ms / it->second - 1.0;
+            const bool regressed = change > tolerance;
+            regressions += regressed;
+            std::cout << std::showpos << std::setw(12) << change * 100 << "%" << std::noshowpos << (regressed ? "  REGRESSION" : "");
+        }
+        std::cout << std::endl;
+    }
+    if (!cmdParser.get<std::string>("json").empty()) {
+        write_json(cmdParser.get<std::string>("json"), results, threads);
+    }
+    if (!baseline.empty()) {
+        std::cout << regressions << " regression(s) above " << cmdParser.get<float>("tolerance") << "%" << std::endl;
+    }
+    return regressions > 0 ? 1 : 0;
+}
@@ -0,0 +1,253 @@
+#include "BatchScheduler.hpp"
+#include "Context.hpp"
+#include "backends/cpu/op/CPUKVCache.hpp"
+#include "backends/cpu/op/CPURoPE.hpp"
+#include "backends/cpu/third_party/ggml/VecDotType.hpp"
+#include "Log.h"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <stdexcept>
+
+namespace mllm {
+
+BatchScheduler::BatchScheduler(Module &model, int slots, const LlmTextGeneratorOpts &opt, int end_token, int prefill_chunk) :
+    model_(model), slots_num_(slots), end_token_(end_token), prefill_chunk_(std::max(1, prefill_chunk)),
+    default_max_new_tokens_(opt.max_new_tokens), slots_(slots) {
+    if (!opt.do_sample) {
+        text_generator_ = std::make_shared<LlmTextGenerator>(LLmTextGeneratorType::kGreedySearch, opt);
+    } else if (opt.do_sample && !opt.top_k && opt.top_p != 0.F) {
+        text_generator_ = std::make_shared<LlmTextGenerator>(LLmTextGeneratorType::kToppSampling, opt);
+    } else {
+        text_generator_ = std::make_shared<LlmTextGenerator>(LLmTextGeneratorType::kTopkSampling, opt);
+    }
+    auto caches = CPUKVCache::cachesOf(&model_);
+    if (caches.empty()) {
+        throw std::invalid_argument("BatchScheduler: the model has no CPU KV cache, load it on the CPU backend first");
+    }
+    max_kv_len_ = INT_MAX;
+    for (auto *cache : caches) {
+        // the per-row mask is applied by CPUSoftMax, the flash attention path never sees it
+        if (cache->fa2_) {
+            throw std::invalid_argument("BatchScheduler: " + cache->name() + " uses flash attention, set attn_implementation = \"eager\"");
+        }
+        // compactRow moves single elements of a BHDS cache, quantized blocks cannot be split
+        if (cache->cache_->ctype() == BHDS && blck_size(cache->cache_->dtype()) > 1) {
+            throw std::invalid_argument("BatchScheduler: " + cache->name() + " is a quantized BHDS cache, rows cannot be compacted");
+        }
+        max_kv_len_ = std::min(max_kv_len_, cache->cache_limit_);
+    }
+    Context::Instance().batching_state().reset();
+    Context::Instance().batching_state().kvValid().assign(slots_num_, {});
+    Context::Instance().batching_state().positionShift().assign(slots_num_, 0);
+    compact();
+}
+
+int BatchScheduler::submit(const std::vector<unsigned> &prompt, const std::function<bool(unsigned int)> &call_back, size_t max_new_tokens) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    int id = next_id_++;
+    waiting_.push_back({id, prompt, call_back, max_new_tokens ? max_new_tokens : default_max_new_tokens_});
+    return id;
+}
+
+std::vector<unsigned> BatchScheduler::takeResult(int id, FinishReason *reason) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = results_.find(id);
+    if (it == results_.end()) {
+        return {};
+    }
+    auto tokens = std::move(it->second.first);
+    if (reason) {
+        *reason = it->second.second;
+    }
+    results_.erase(it);
+    return tokens;
+}
+
+void BatchScheduler::admit() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    bool idle = std::none_of(slots_.begin(), slots_.end(), [](const Slot &s) { return s.busy; });
+    if (idle && !waiting_.empty() && kv_len_ > 0) {
+        compact(); // nothing running, start again from an empty cache
+    }
+    auto &kv_valid = Context::Instance().batching_state().kvValid();
+    for (int b = 0; b < slots_num_ && !waiting_.empty(); ++b) {
+        if (slots_[b].busy) {
+            continue;
+        }
+        auto &slot = slots_[b];
+        slot = Slot();
+        slot.busy = true;
+        slot.request = std::move(waiting_.front());
+        waiting_.pop_front();
+        // whatever the previous request left in this row is masked out
+        kv_valid[b].assign(kv_len_, 0);
+        if (slot.request.prompt.empty()) {
+            finish(b, FinishReason::MaxNewTokens);
+        }
+    }
+}
+
+void BatchScheduler::finish(int b, FinishReason reason) {
+    auto &slot = slots_[b];
+    results_[slot.request.id] = {std::move(slot.generated), reason};
+    slot = Slot();
+    Context::Instance().batching_state().kvValid()[b].assign(kv_len_, 0);
+}
+
+void BatchScheduler::compact() {
+    auto &kv_valid = Context::Instance().batching_state().kvValid();
+    int new_len = 0;
+    for (int b = 0; b < slots_num_; ++b) {
+        std::vector<int> keep;
+        for (int j = 0; j < (int)kv_valid[b].size() && j < kv_len_; ++j) {
+            if (kv_valid[b][j]) keep.push_back(j);
+        }
+        if (!keep.empty()) {
+            for (auto *cache : CPUKVCache::cachesOf(&model_)) {
+                if (cache->cache_seq_len_ >= 0 && b < cache->cache_->batch()) {
+                    cache->compactRow(b, keep);
+                }
+            }
+        }
+        kv_valid[b].assign(keep.size(), 1);
+        slots_[b].kv_end = keep.size();
+        new_len = std::max(new_len, (int)keep.size());
+    }
+    setKVLength(new_len);
+}
+
+void BatchScheduler::setKVLength(int len) {
+    for (auto &valid : Context::Instance().batching_state().kvValid()) {
+        valid.resize(len, 0);
+    }
+    for (auto *cache : CPUKVCache::cachesOf(&model_)) {
+        cache->setCacheSeqLen(len);
+    }
+    for (auto *rope : CPURoPE::ropesOf(&model_)) {
+        rope->h_cnt_ = len;
+    }
+    kv_len_ = len;
+}
+
+bool BatchScheduler::step() {
+    admit();
+    auto &state = Context::Instance().batching_state();
+    // tokens each row feeds this step: a prompt chunk while prefilling, else the last sampled token
+    std::vector<std::vector<unsigned>> feed(slots_num_);
+    int chunk = 0;
+    for (int b = 0; b < slots_num_; ++b) {
+        auto &slot = slots_[b];
+        if (!slot.busy) continue;
+        auto &prompt = slot.request.prompt;
+        if (slot.prefilled < prompt.size()) {
+            size_t n = std::min(prompt.size() - slot.prefilled, (size_t)prefill_chunk_);
+            feed[b].assign(prompt.begin() + slot.prefilled, prompt.begin() + slot.prefilled + n);
+        } else {
+            feed[b] = {slot.last_token};
+        }
+        chunk = std::max(chunk, (int)feed[b].size());
+    }
+    if (chunk == 0) {
+        return false;
+    }
+    if (kv_len_ + chunk > max_kv_len_) {
+        compact();
+        ++compactions_;
+    }
+    if (kv_len_ + chunk > max_kv_len_) {
+        // still full: end the longest sequence to make room
+        int longest = 0;
+        for (int b = 1; b < slots_num_; ++b) {
+            if (slots_[b].logical_len > slots_[longest].logical_len) longest = b;
+        }
+        MLLM_LOG_ERROR_STREAM << "BatchScheduler: KV cache full (" << max_kv_len_ << "), request "
+                              << slots_[longest].request.id << " stopped after " << slots_[longest].generated.size()
+                              << " tokens" << std::endl;
+        std::lock_guard<std::mutex> lock(mutex_);
+        finish(longest, FinishReason::KVCacheFull);
+        return true;
+    }
+
+    Tensor input(slots_num_, 1, chunk, 1, Backend::global_backends[MLLM_CPU].get(), true);
+    input.setName("input");
+    Tensor::tensor_status = TENSOR_STATIC_INIT;
+    input.setTtype(INPUT_TENSOR);
+    auto &kv_valid = state.kvValid();
+    auto &shift = state.positionShift();
+    auto &moves = state.kvMoves();
+    moves.clear();
+    for (int b = 0; b < slots_num_; ++b) {
+        auto &slot = slots_[b];
+        int pad = chunk - (int)feed[b].size();
+        bool decoding = slot.busy && slot.prefilled >= slot.request.prompt.size();
+        kv_valid[b].resize(kv_len_ + chunk, 0);
+        for (int s = 0; s < chunk; ++s) {
+            bool real = s >= pad && slot.busy;
+            input.setDataAt<float>(b, 0, s, 0, real ? feed[b][s - pad] : 0);
+            kv_valid[b][kv_len_ + s] = real && !decoding;
+        }
+        shift[b] = kv_len_ + pad - slot.logical_len;
+        if (decoding) {
+            // the token sits at the step end for its logits, its K/V goes to the row's next free position
+            const int last = kv_len_ + chunk - 1;
+            if (slot.kv_end != last) {
+                moves.push_back({b, last, slot.kv_end});
+            }
+            kv_valid[b][slot.kv_end] = 1;
+            slot.kv_end += 1;
+        } else if (slot.busy) {
+            slot.kv_end = kv_len_ + chunk;
+        }
+    }
+    state.setStepStart(kv_len_);
+    state.setActive(true);
+    auto out = model_({input});
+    state.setActive(false);
+    moves.clear();
+    kv_len_ += chunk;
+
+    auto &logits = out[0];
+    if (logits.backend()->type() != MLLM_CPU) {
+        logits.cpu();
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (int b = 0; b < slots_num_; ++b) {
+        auto &slot = slots_[b];
+        if (!slot.busy) continue;
+        slot.logical_len += feed[b].size();
+        bool decoding = slot.prefilled >= slot.request.prompt.size();
+        if (!decoding) {
+            slot.prefilled += feed[b].size();
+            if (slot.prefilled < slot.request.prompt.size()) continue; // more prompt chunks to go
+        }
+        Tensor row(1, 1, 1, logits.dimension(), MLLM_CPU, true);
+        memcpy(row.hostPtr<float>(), logits.ptrAt<float>(b, 0, logits.sequence() - 1, 0), row.cntSize());
+        auto token = text_generator_->generate(row);
+        bool end = end_token_ != -1 && token == (unsigned)end_token_;
+        if (!end) {
+            slot.generated.push_back(token);
+            slot.last_token = token;
+        }
+        if (end) {
+            finish(b, FinishReason::EndToken);
+        } else if (!slot.request.call_back(token)) {
+            finish(b, FinishReason::Stopped);
+        } else if (slot.generated.size() >= slot.request.max_new_tokens) {
+            finish(b, FinishReason::MaxNewTokens);
+        }
+    }
+    // positions past the last valid one of every row are free again
+    int used = 0;
+    for (int b = 0; b < slots_num_; ++b) {
+        if (slots_[b].busy) {
+            used = std::max(used, slots_[b].kv_end);
+        }
+    }
+    if (used < kv_len_) {
+        setKVLength(used);
+    }
+    return true;
+}
+
+} // namespace mllm
@@ -0,0 +1,117 @@
+#ifndef MLLM_BATCHSCHEDULER_H
+#define MLLM_BATCHSCHEDULER_H
+
+#include "Module.hpp"
+#include "Generate.hpp"
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace mllm {
+
+/**
+ * @brief Continuous batching on top of a CPU causal LM.
+ *
+ * The model runs with a fixed batch of `slots` rows. Between two steps finished requests
+ * leave their slot and waiting requests are admitted into free slots; a step mixes the
+ * chunked prefill of newcomers (at most prefill_chunk prompt tokens per row) with one decode
+ * token of every running row, all rows right-aligned so each row's last real token sits at the
+ * last position. Rows share the physical KV length; the BatchingStateManager tells CPUSoftMax
+ * which KV positions belong to each row and CPURoPE the logical position of each row, so
+ * padding and the KV left behind by a previous request are invisible. Only a prefilling row
+ * keeps its K/V where the step wrote it: a decoding row's K/V is moved to the row's next free
+ * position (kv_end), so decode rows do not leave a prefill chunk of padding behind, and the KV
+ * length shrinks back to the longest row after each step. When the KV cache is full the valid
+ * positions of every row are compacted to the front; if that still leaves no room the longest
+ * running request is ended early and its result is tagged FinishReason::KVCacheFull.
+ *
+ * Needs the eager attention path (attn_implementation = "eager": a Softmax built with
+ * kv_attention on Tensor::mm scores, as in MultiHeadAttention) and RoPE ops on the CPU backend;
+ * the constructor throws std::invalid_argument otherwise. Only the KV caches and RoPE ops of
+ * `model` are touched, other loaded models keep their state.
+ *
+ * usage:
+ *   BatchScheduler scheduler(model, 4, opt, tokenizer->eos_id_);
+ *   int id = scheduler.submit(prompt_ids, [&](unsigned token) { ...; return true; });
+ *   scheduler.run();                 // or call step() from the serving loop
+ *   auto tokens = scheduler.takeResult(id);
+ */
+class BatchScheduler {
+public:
+    enum class FinishReason {
+        EndToken,     // the model produced end_token
+        Stopped,      // the callback returned false
+        MaxNewTokens, // max_new_tokens reached
+        KVCacheFull,  // cut short: the KV cache had no room left for the batch
+    };
+
+    BatchScheduler(Module &model, int slots, const LlmTextGeneratorOpts &opt, int end_token = -1, int prefill_chunk = 64);
+
+    // thread-safe, the request is admitted at the next step; returns the request id
+    int submit(const std::vector<unsigned> &prompt,
+               const std::function<bool(unsigned int)> &call_back = [](unsigned int) -> bool { return true; },
+               size_t max_new_tokens = 0);
+    // run one batched forward; false when there is nothing left to do
+    bool step();
+    void run() {
+        while (step()) {}
+    }
+    // generated tokens of a finished request (empty while it is still running);
+    // `reason` receives why it finished
+    std::vector<unsigned> takeResult(int id, FinishReason *reason = nullptr);
+
+    int kvLength() const {
+        return kv_len_;
+    }
+    // times the valid KV positions were packed because the cache was full
+    int compactions() const {
+        return compactions_;
+    }
+
+private:
+    struct Request {
+        int id;
+        std::vector<unsigned> prompt;
+        std::function<bool(unsigned int)> call_back;
+        size_t max_new_tokens;
+    };
+    struct Slot {
+        bool busy = false;
+        Request request;
+        size_t prefilled = 0;  // prompt tokens already fed
+        int logical_len = 0;   // tokens of this sequence in the KV cache
+        int kv_end = 0;        // physical KV position after the row's last valid one
+        unsigned last_token = 0;
+        std::vector<unsigned> generated;
+    };
+
+    void admit();
+    void finish(int b, FinishReason reason);
+    // pack the valid KV positions of every row to the front of the cache
+    void compact();
+    // physical KV length of the caches, the ropes and kv_valid
+    void setKVLength(int len);
+
+    Module &model_;
+    int slots_num_;
+    int end_token_;
+    int prefill_chunk_;
+    int max_kv_len_;
+    int kv_len_ = 0;
+    int compactions_ = 0;
+    size_t default_max_new_tokens_;
+    std::shared_ptr<LlmTextGenerator> text_generator_;
+    std::vector<Slot> slots_;
+
+    std::mutex mutex_;
+    int next_id_ = 0;
+    std::deque<Request> waiting_;
+    std::unordered_map<int, std::pair<std::vector<unsigned>, FinishReason>> results_;
+};
+
+} // namespace mllm
+
+#endif // MLLM_BATCHSCHEDULER_H
@@ -33,6 +33,14 @@ public:
         return speculative_decoding_state_;
     }
 
+    BatchingStateManager &batching_state() {
+        return batching_state_;
+    }
+
+    LMHeadStateManager &lm_head_state() {
+        return lm_head_state_;
+    }
+
 private:
     Context();
     ~Context() = default;
@@ -42,6 +50,8 @@ private:
 
     InferenceStateManager inference_state_;
     SpeculativeDecodingManager speculative_decoding_state_;
+    BatchingStateManager batching_state_;
+    LMHeadStateManager lm_head_state_;
 };
 
 } // namespace mllm
\ No newline at end of file
@@ -0,0 +1,239 @@
+#include "DraftDecoder.hpp"
+#include "backends/cpu/op/CPUKVCache.hpp"
+#include "backends/cpu/op/CPURoPE.hpp"
+#include "backends/cpu/third_party/ggml/QuantizeFP16.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace mllm {
+
+// logits row s as F32, in place when the logits are F32
+static const float *logitsRow(Tensor &logits, int s, std::vector<float> &buf) {
+    if (logits.dtype() == MLLM_TYPE_F32) {
+        return logits.ptrAt<float>(0, 0, s, 0);
+    }
+    if (logits.dtype() != MLLM_TYPE_F16) {
+        throw std::runtime_error("Unsupported dtype for text generation.");
+    }
+    buf.resize(logits.dimension());
+    const auto *row = logits.ptrAt<mllm_fp16_t>(0, 0, s, 0);
+    for (int i = 0; i < logits.dimension(); ++i) {
+        buf[i] = MLLM_FP16_TO_FP32(row[i]);
+    }
+    return buf.data();
+}
+
+static unsigned sampleIndex(const std::vector<float> &probs, std::mt19937 &rng) {
+    double sum = 0;
+    for (float p : probs) {
+        sum += p;
+    }
+    double r = std::uniform_real_distribution<double>(0.0, sum)(rng);
+    for (size_t i = 0; i < probs.size(); ++i) {
+        r -= probs[i];
+        if (r < 0) {
+            return i;
+        }
+    }
+    return probs.size() - 1;
+}
+
+DraftModelDecoder::DraftModelDecoder(Module &target, Module &draft, int max_draft, int init_draft) :
+    max_draft_(std::max(1, max_draft)), k_(std::min(std::max(1, init_draft), max_draft_)) {
+    target_.module = &target;
+    draft_.module = &draft;
+}
+
+void DraftModelDecoder::load(const std::string &target_path, const std::string &draft_path) {
+    attach(target_, target_path);
+    attach(draft_, draft_path);
+}
+
+void DraftModelDecoder::attach(Model &model, const std::string &path) {
+    model.module->load(path);
+    model.caches = CPUKVCache::cachesOf(model.module);
+    model.ropes = CPURoPE::ropesOf(model.module);
+    if (model.caches.empty()) {
+        throw std::runtime_error("DraftModelDecoder: " + path + " created no CPU KV cache, it cannot be rolled back.");
+    }
+}
+
+Tensor DraftModelDecoder::forward(Model &model, const std::vector<unsigned> &tokens) {
+    Module::llm_model_ptr = model.module;
+    Tensor input(1, 1, tokens.size(), 1, Backend::global_backends[MLLM_CPU].get(), true);
+    input.setName("input");
+    Tensor::tensor_status = TENSOR_STATIC_INIT;
+    input.setTtype(INPUT_TENSOR);
+    for (int s = 0; s < (int)tokens.size(); ++s) {
+        input.setDataAt<float>(0, 0, s, 0, tokens[s]);
+    }
+    auto out = (*model.module)({input});
+    model.len += tokens.size();
+    auto &logits = out[0];
+    if (logits.backend()->type() != MLLM_CPU) {
+        logits.cpu();
+    }
+    return logits;
+}
+
+void DraftModelDecoder::rollback(Model &model, int len) {
+    for (auto *cache : model.caches) {
+        cache->setCacheSeqLen(len);
+    }
+    for (auto *rope : model.ropes) {
+        rope->h_cnt_ = len;
+    }
+    model.len = len;
+}
+
+void DraftModelDecoder::probabilities(Tensor &logits, int s, std::vector<float> &probs) const {
+    std::vector<float> buf;
+    const float *row = logitsRow(logits, s, buf);
+    const int n = logits.dimension();
+    probs.resize(n);
+    float max_logit = *std::max_element(row, row + n);
+    double sum = 0;
+    for (int i = 0; i < n; ++i) {
+        probs[i] = std::exp((row[i] - max_logit) / temperature_);
+        sum += probs[i];
+    }
+    for (int i = 0; i < n; ++i) {
+        probs[i] /= sum;
+    }
+}
+
+unsigned DraftModelDecoder::pick(Tensor &logits, int s, std::vector<float> &probs) {
+    if (!sample_) {
+        const float *row = logitsRow(logits, s, probs);
+        return _argmax(row, logits.dimension());
+    }
+    probabilities(logits, s, probs);
+    return sampleIndex(probs, rng_);
+}
+
+void DraftModelDecoder::adapt(int drafted, int accepted) {
+    // per-token acceptance: every accepted token, and the first rejected one if any
+    int tried = accepted + (accepted < drafted ? 1 : 0);
+    accept_ema_ = 0.8f * accept_ema_ + 0.2f * ((float)accepted / tried);
+    // expected run of accepted tokens for a per-token acceptance rate a is a / (1 - a)
+    float a = std::min(accept_ema_, 0.95f);
+    k_ = std::min(std::max(1, (int)std::ceil(a / (1.0f - a))), max_draft_);
+}
+
+std::vector<unsigned> DraftModelDecoder::generate(Tensor &input_ids, const LlmTextGeneratorOpts &opt,
+                                                  const std::function<bool(unsigned int)> &call_back, int end_token) {
+    std::vector<unsigned> prompt;
+    for (int s = 0; s < input_ids.sequence(); ++s) {
+        prompt.push_back(input_ids.dataAt<float>(0, 0, s, 0));
+    }
+    return generate(prompt, opt, call_back, end_token);
+}
+
+std::vector<unsigned> DraftModelDecoder::generate(const std::vector<unsigned> &prompt, const LlmTextGeneratorOpts &opt,
+                                                  const std::function<bool(unsigned int)> &call_back, int end_token) {
+    std::vector<unsigned> result;
+    if (prompt.empty() || opt.max_new_tokens == 0) {
+        return result;
+    }
+    sample_ = opt.do_sample && opt.temperature > 0;
+    temperature_ = sample_ ? opt.temperature : 1.0f;
+    rng_.seed(opt.seed >= 0 ? (std::mt19937::result_type)opt.seed : std::random_device()());
+    stats_ = Stats();
+    accept_ema_ = (float)k_ / (k_ + 1);
+    rollback(target_, 0);
+    rollback(draft_, 0);
+
+    // every token of the sequence; a model has fed history[0, len) and feeds the rest next
+    std::vector<unsigned> history = prompt;
+    auto pending = [&](const Model &model) {
+        return std::vector<unsigned>(history.begin() + model.len, history.end());
+    };
+    bool stopped = false;
+    auto emit = [&](unsigned token) {
+        if (end_token != -1 && token == (unsigned)end_token) {
+            stopped = true;
+            return;
+        }
+        result.push_back(token);
+        stats_.generated++;
+        if (!call_back(token) || result.size() >= opt.max_new_tokens) {
+            stopped = true;
+        }
+    };
+
+    std::vector<float> probs;
+    std::vector<float> target_probs;
+    {
+        auto logits = forward(target_, history);
+        unsigned token = pick(logits, logits.sequence() - 1, probs);
+        history.push_back(token);
+        emit(token);
+    }
+
+    std::vector<unsigned> drafts;
+    std::vector<std::vector<float>> draft_probs(max_draft_);
+    while (!stopped) {
+        // the target forward adds one token of its own after the accepted drafts
+        int k = std::min<int>(k_, opt.max_new_tokens - result.size() - 1);
+        drafts.clear();
+        for (int i = 0; i < k; ++i) {
+            auto feed = i == 0 ? pending(draft_) : std::vector<unsigned>{drafts.back()};
+            auto logits = forward(draft_, feed);
+            drafts.push_back(pick(logits, logits.sequence() - 1, draft_probs[i]));
+        }
+
+        int n = target_.len;
+        auto verify = pending(target_);
+        const int first_row = verify.size() - 1; // logits row scoring drafts[0]
+        verify.insert(verify.end(), drafts.begin(), drafts.end());
+        auto logits = forward(target_, verify);
+        stats_.steps++;
+        stats_.drafted += k;
+
+        int accepted = 0;
+        unsigned next = 0;
+        bool rejected = false;
+        for (; accepted < k; ++accepted) {
+            unsigned d = drafts[accepted];
+            if (!sample_) {
+                if (pick(logits, first_row + accepted, probs) != d) break;
+                continue;
+            }
+            probabilities(logits, first_row + accepted, target_probs);
+            const auto &q = draft_probs[accepted];
+            float ratio = q[d] > 0 ? target_probs[d] / q[d] : 1.0f;
+            if (std::uniform_real_distribution<float>(0.0f, 1.0f)(rng_) < ratio) continue;
+            // rejected: resample from the part of p the draft under-proposed
+            for (size_t t = 0; t < target_probs.size(); ++t) {
+                target_probs[t] = std::max(0.0f, target_probs[t] - q[t]);
+            }
+            next = sampleIndex(target_probs, rng_);
+            rejected = true;
+            break;
+        }
+        if (!rejected) {
+            next = pick(logits, first_row + accepted, probs);
+        }
+        stats_.accepted += accepted;
+        if (k > 0) {
+            adapt(k, accepted);
+        }
+
+        // positions n, n + 1 .. hold verify[first_row], drafts[0 ..]; keep the accepted ones
+        history.insert(history.end(), drafts.begin(), drafts.begin() + accepted);
+        history.push_back(next);
+        rollback(target_, n + first_row + 1 + accepted);
+        rollback(draft_, std::min<int>(draft_.len, target_.len));
+        for (int i = 0; i < accepted && !stopped; ++i) {
+            emit(drafts[i]);
+        }
+        if (!stopped) {
+            emit(next);
+        }
+    }
+    Module::llm_model_ptr = target_.module;
+    return result;
+}
+
+} // namespace mllm
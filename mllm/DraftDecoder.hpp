@@ -0,0 +1,105 @@
+#ifndef MLLM_DRAFTDECODER_H
+#define MLLM_DRAFTDECODER_H
+
+#include "Module.hpp"
+#include "Generate.hpp"
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace mllm {
+
+class CPUKVCache;
+class CPURoPE;
+
+/**
+ * @brief Speculative decoding with a small draft model, for any pair of CPU causal LMs that share
+ * a tokenizer and keep their positions in CPURoPE / CPUKVCache ops (no model file changes).
+ *
+ * Each step the draft model proposes k tokens one at a time, then the target model scores the
+ * last token and all k proposals in one forward; the causal mask and the rope positions of a
+ * normal multi-token step are exactly the tree mask / tree positions of a single chain. The
+ * longest agreeing prefix is kept (greedy: argmax match, sampling: the usual p/q rejection test)
+ * plus one token from the target, and both models drop the rejected positions by moving their
+ * KV length and rope position back. k follows the acceptance rate between 1 and max_draft.
+ * Sampling uses the temperature only (top_k / top_p / repetition penalty are not applied), so the
+ * output follows the target distribution at that temperature.
+ *
+ * The KV caches and ropes of each model are the ones its load pass created (CPUKVCache::cachesOf,
+ * CPURoPE::ropesOf), so a third model loaded in the same process is never rolled back.
+ *
+ * usage:
+ *   DraftModelDecoder decoder(target, draft);
+ *   decoder.load(target_path, draft_path);
+ *   decoder.generate(prompt_ids, opt, [&](unsigned token) { ...; return true; });
+ */
+class DraftModelDecoder {
+public:
+    struct Stats {
+        size_t steps = 0;    // target forwards after the prefill
+        size_t drafted = 0;  // tokens proposed by the draft model
+        size_t accepted = 0; // of which the target kept
+        size_t generated = 0;
+        double acceptanceRate() const {
+            return drafted ? (double)accepted / drafted : 0.0;
+        }
+        // generated tokens per target forward
+        double tokensPerStep() const {
+            return steps ? (double)generated / steps : 0.0;
+        }
+    };
+
+    DraftModelDecoder(Module &target, Module &draft, int max_draft = 8, int init_draft = 4);
+
+    void load(const std::string &target_path, const std::string &draft_path);
+
+    // the call back returns false to stop; end_token is not passed to it
+    std::vector<unsigned> generate(
+        const std::vector<unsigned> &prompt, const LlmTextGeneratorOpts &opt,
+        const std::function<bool(unsigned int)> &call_back = [](unsigned int) -> bool { return true; },
+        int end_token = -1);
+    std::vector<unsigned> generate(
+        Tensor &input_ids, const LlmTextGeneratorOpts &opt,
+        const std::function<bool(unsigned int)> &call_back = [](unsigned int) -> bool { return true; },
+        int end_token = -1);
+
+    int draftLength() const {
+        return k_;
+    }
+    const Stats &stats() const {
+        return stats_;
+    }
+
+private:
+    struct Model {
+        Module *module;
+        std::vector<CPUKVCache *> caches;
+        std::vector<CPURoPE *> ropes;
+        int len = 0; // tokens in the KV cache
+    };
+
+    static void attach(Model &model, const std::string &path);
+    // run tokens through the model, return the logits [1, 1, tokens.size(), vocab] on the CPU
+    static Tensor forward(Model &model, const std::vector<unsigned> &tokens);
+    // forget every cached position from len on
+    static void rollback(Model &model, int len);
+    // logits row s as probabilities at the sampling temperature
+    void probabilities(Tensor &logits, int s, std::vector<float> &probs) const;
+    unsigned pick(Tensor &logits, int s, std::vector<float> &probs);
+    void adapt(int drafted, int accepted);
+
+    Model target_;
+    Model draft_;
+    int max_draft_;
+    int k_;
+    float accept_ema_ = 0.5f;
+    bool sample_ = false;
+    float temperature_ = 1.0f;
+    std::mt19937 rng_;
+    Stats stats_;
+};
+
+} // namespace mllm
+
+#endif // MLLM_DRAFTDECODER_H
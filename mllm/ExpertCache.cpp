@@ -0,0 +1,215 @@
+#include "ExpertCache.hpp"
+#include "Layer.hpp"
+#include "Tensor.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <map>
+
+namespace mllm {
+
+// per-acquire decay of the SCORE policy
+static constexpr float kScoreDecay = 0.99F;
+
+ExpertCache::ExpertCache(int num_layers, int num_experts, int capacity, ExpertEvictPolicy policy, bool prefetch) :
+    num_layers_(num_layers), num_experts_(num_experts), capacity_(std::max(1, capacity)), policy_(policy),
+    experts_(num_layers * num_experts), pinned_(num_layers), transitions_(num_layers, std::vector<float>(num_experts * num_experts, 0)) {
+    if (prefetch) {
+        thread_ = std::thread(&ExpertCache::worker, this);
+    }
+}
+
+ExpertCache::~ExpertCache() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+ExpertEvictPolicy ExpertCache::policyFromString(const std::string &name) {
+    if (name == "lfu") return ExpertEvictPolicy::LFU;
+    if (name == "score") return ExpertEvictPolicy::SCORE;
+    return ExpertEvictPolicy::LRU;
+}
+
+void ExpertCache::registerExpert(int layer, int expert, std::vector<Layer *> projections) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    at(layer, expert).projections = std::move(projections);
+}
+
+void ExpertCache::setLoader(std::shared_ptr<AbstructLoader> loader) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    loader_ = std::move(loader);
+}
+
+std::vector<std::pair<int, float>> ExpertCache::routing(Tensor &topk_weight, Tensor &topk_idx) {
+    std::map<int, float> sum;
+    auto n = topk_idx.count();
+    assert(topk_weight.count() == n);
+    auto *idx = topk_idx.hostPtr<float>();
+    auto *weight = topk_weight.hostPtr<float>();
+    for (int i = 0; i < n; ++i) {
+        sum[(int)idx[i]] += weight[i];
+    }
+    return {sum.begin(), sum.end()};
+}
+
+float ExpertCache::evictKey(const Expert &e) const {
+    switch (policy_) {
+    case ExpertEvictPolicy::LFU:
+        return (float)e.uses;
+    case ExpertEvictPolicy::SCORE:
+        return e.score * std::pow(kScoreDecay, (float)(clock_ - e.last_use));
+    default:
+        return (float)e.last_use;
+    }
+}
+
+bool ExpertCache::evictOne() {
+    Expert *victim = nullptr;
+    for (auto &e : experts_) {
+        if (e.state == RESIDENT && e.pins == 0 && (!victim || evictKey(e) < evictKey(*victim))) {
+            victim = &e;
+        }
+    }
+    if (victim == nullptr) {
+        return false;
+    }
+    for (auto *projection : victim->projections) {
+        projection->op_->free({}, {});
+    }
+    victim->state = EMPTY;
+    victim->prefetched = false;
+    resident_--;
+    return true;
+}
+
+bool ExpertCache::created(const Expert &e) {
+    return std::all_of(e.projections.begin(), e.projections.end(), [](Layer *projection) { return projection->op_ != nullptr; });
+}
+
+void ExpertCache::load(std::unique_lock<std::mutex> &lock, Expert &e) {
+    e.state = LOADING;
+    resident_++;
+    lock.unlock();
+    for (auto *projection : e.projections) {
+        if (projection->op_ == nullptr) {
+            projection->load(loader_); // first load, on the acquiring thread: creates the op
+        } else {
+            projection->op_->load(*loader_);
+        }
+    }
+    lock.lock();
+    e.state = RESIDENT;
+    cv_.notify_all();
+}
+
+void ExpertCache::acquire(int layer, const std::vector<std::pair<int, float>> &routed) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    assert(loader_ != nullptr && "ExpertCache::setLoader was not called in the load pass");
+    ++clock_;
+    int prev = (layer + num_layers_ - 1) % num_layers_;
+    if (last_layer_ == prev) {
+        auto &transition = transitions_[prev];
+        for (int a : last_routed_) {
+            for (auto &[b, w] : routed) {
+                transition[a * num_experts_ + b] += 1;
+            }
+        }
+    }
+    last_layer_ = layer;
+    last_routed_.clear();
+    // pin first, so neither the loads below nor the worker evict one of them
+    for (auto &[id, w] : routed) {
+        auto &e = at(layer, id);
+        e.pins++;
+        e.score = e.score * std::pow(kScoreDecay, (float)(clock_ - e.last_use)) + w;
+        e.last_use = clock_;
+        e.uses++;
+        last_routed_.push_back(id);
+        pinned_[layer].push_back(id);
+    }
+    for (auto &[id, w] : routed) {
+        auto &e = at(layer, id);
+        cv_.wait(lock, [&] { return e.state != LOADING; });
+        if (e.state == RESIDENT) {
+            hits_++;
+            if (e.prefetched) {
+                prefetch_hits_++;
+                e.prefetched = false;
+            }
+            continue;
+        }
+        misses_++;
+        if (resident_ >= capacity_) {
+            evictOne(); // over budget for now if every resident expert is pinned
+        }
+        load(lock, e);
+    }
+    predict(layer, routed);
+}
+
+void ExpertCache::release(int layer) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (int id : pinned_[layer]) {
+        at(layer, id).pins--;
+    }
+    pinned_[layer].clear();
+}
+
+void ExpertCache::predict(int layer, const std::vector<std::pair<int, float>> &routed) {
+    if (!thread_.joinable()) {
+        return;
+    }
+    int next = (layer + 1) % num_layers_;
+    auto &transition = transitions_[layer];
+    std::vector<std::pair<float, int>> guess;
+    for (int b = 0; b < num_experts_; ++b) {
+        float s = 0;
+        for (auto &[a, w] : routed) {
+            s += w * transition[a * num_experts_ + b];
+        }
+        if (s == 0) {
+            s = 1e-6F * at(next, b).uses; // nothing learned yet: the most used experts of the next layer
+        }
+        if (s > 0) {
+            guess.emplace_back(s, b);
+        }
+    }
+    int k = std::min<int>({(int)routed.size(), (int)guess.size(), capacity_ / 2});
+    std::partial_sort(guess.begin(), guess.begin() + k, guess.end(), std::greater<>());
+    // only the newest guess matters
+    prefetch_queue_.clear();
+    for (int i = 0; i < k; ++i) {
+        prefetch_queue_.emplace_back(next, guess[i].second);
+    }
+    cv_.notify_all();
+}
+
+void ExpertCache::worker() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        cv_.wait(lock, [&] { return stop_ || !prefetch_queue_.empty(); });
+        if (stop_) {
+            break;
+        }
+        auto [layer, id] = prefetch_queue_.front();
+        prefetch_queue_.pop_front();
+        auto &e = at(layer, id);
+        if (e.state != EMPTY || e.projections.empty() || !created(e)) {
+            continue;
+        }
+        if (resident_ >= capacity_ && !evictOne()) {
+            continue;
+        }
+        e.prefetched = true;
+        e.last_use = clock_;
+        load(lock, e);
+    }
+}
+
+} // namespace mllm
@@ -0,0 +1,131 @@
+#ifndef MLLM_EXPERTCACHE_H
+#define MLLM_EXPERTCACHE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace mllm {
+
+class AbstructLoader;
+class Layer;
+class Tensor;
+
+enum class ExpertEvictPolicy {
+    LRU,   // least recently routed to
+    LFU,   // least often routed to
+    SCORE, // lowest decayed sum of routing weights
+};
+
+/**
+ * @brief Keeps at most `capacity` MoE experts (over all layers) resident and loads the others
+ * from the model's ParamLoader on demand.
+ *
+ * A MoE block registers the projections (Layer*) of each of its experts once, then calls
+ * acquire() with the experts the router picked before running them and release() after. Misses
+ * are read from the loader handed to setLoader() in the load pass of Module::load and kept for
+ * every reload, whichever model Module::llm_model_ptr points at by then; evicted experts only free their op weights (Op::free), so the Layer stays marked as
+ * loaded and Layer::run never reloads it on its own. The experts of a running layer are never
+ * evicted.
+ *
+ * With prefetch on, a worker thread loads the experts layer+1 will most likely route to while
+ * layer runs. The guess comes from routing transitions learned online (which experts of layer+1
+ * followed the experts of layer), falling back to the most frequently used experts of layer+1.
+ * The worker only calls Op::load / Op::free on ops created by a first load on the calling
+ * thread, never Layer::load, and acquire() waits for an expert it is loading, so it does not
+ * race with Layer::run.
+ *
+ * The load pass of Module::load must skip the experts (Module::llm_model_ptr->doLoad), they are
+ * only loaded through the cache.
+ */
+class ExpertCache {
+public:
+    ExpertCache(int num_layers, int num_experts, int capacity, ExpertEvictPolicy policy = ExpertEvictPolicy::LRU, bool prefetch = true);
+    ~ExpertCache();
+
+    static ExpertEvictPolicy policyFromString(const std::string &name);
+
+    void registerExpert(int layer, int expert, std::vector<Layer *> projections);
+    // the loader of the model owning the experts, set in its load pass
+    void setLoader(std::shared_ptr<AbstructLoader> loader);
+    // routed: (expert, routing weight summed over the tokens); loads the misses, pins the experts until release()
+    void acquire(int layer, const std::vector<std::pair<int, float>> &routed);
+    void release(int layer);
+
+    // (expert, summed weight) from the router's top-k weights and indices, same element order
+    static std::vector<std::pair<int, float>> routing(Tensor &topk_weight, Tensor &topk_idx);
+
+    int resident() const {
+        return resident_;
+    }
+    uint64_t hits() const {
+        return hits_;
+    }
+    uint64_t misses() const {
+        return misses_;
+    }
+    uint64_t prefetchHits() const {
+        return prefetch_hits_;
+    }
+
+private:
+    enum State { EMPTY,
+                 LOADING,
+                 RESIDENT };
+    struct Expert {
+        std::vector<Layer *> projections;
+        State state = EMPTY;
+        int pins = 0;
+        bool prefetched = false; // loaded by the worker, not used yet
+        uint64_t last_use = 0;
+        uint64_t uses = 0;
+        float score = 0;
+    };
+
+    Expert &at(int layer, int expert) {
+        return experts_[layer * num_experts_ + expert];
+    }
+    // make room for one more expert; false if everything resident is pinned. mutex_ held
+    bool evictOne();
+    float evictKey(const Expert &e) const;
+    // load outside the lock, state is LOADING meanwhile
+    void load(std::unique_lock<std::mutex> &lock, Expert &e);
+    // every projection has an op, i.e. was loaded once by acquire()
+    static bool created(const Expert &e);
+    void predict(int layer, const std::vector<std::pair<int, float>> &routed);
+    void worker();
+
+    std::shared_ptr<AbstructLoader> loader_;
+    int num_layers_;
+    int num_experts_;
+    int capacity_;
+    ExpertEvictPolicy policy_;
+    std::vector<Expert> experts_;
+    std::vector<std::vector<int>> pinned_; // per layer, by acquire() until release()
+    // transitions_[layer][a * num_experts_ + b]: times expert b of layer+1 followed expert a of layer
+    std::vector<std::vector<float>> transitions_;
+    int last_layer_ = -1;
+    std::vector<int> last_routed_;
+    uint64_t clock_ = 0;
+    int resident_ = 0;
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+    uint64_t prefetch_hits_ = 0;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<std::pair<int, int>> prefetch_queue_;
+    std::atomic<bool> stop_{false};
+    std::thread thread_;
+};
+
+} // namespace mllm
+
+#endif // MLLM_EXPERTCACHE_H
@@ -10,14 +10,89 @@
  */
 #include "Generate.hpp"
 #include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <numeric>
 
 namespace mllm {
 
+unsigned int _argmax(const float *values, int n) {
+    // lane-wise maxima vectorize without -ffast-math, the index is found in a second pass
+    constexpr int kLanes = 16;
+    float lanes[kLanes];
+    std::fill(lanes, lanes + kLanes, -INFINITY);
+    int i = 0;
+    for (; i + kLanes <= n; i += kLanes) {
+        for (int j = 0; j < kLanes; ++j) {
+            lanes[j] = std::max(lanes[j], values[i + j]);
+        }
+    }
+    float max_value = *std::max_element(lanes, lanes + kLanes);
+    for (; i < n; ++i) {
+        max_value = std::max(max_value, values[i]);
+    }
+    for (i = 0; i < n; ++i) {
+        if (values[i] == max_value) {
+            return i;
+        }
+    }
+    return 0;
+}
+
+const float *_LlmTextGenerateMethod::_scores_row(Tensor &t, int &n) {
+    assert(t.batch() == 1 && "Batch size of result is not 1. Which is not supported for now.");
+    assert(t.head() == 1 && "The 3rd dim of result should be one. e.g.:[1, 1, seq, hidden]");
+    n = t.dimension();
+    int _seq = t.sequence() - 1;
+    // padding prefill for QNN
+    if (is_padding) {
+        if (chunk_size > 0) {
+            _seq = (seq_before_padding - 1) % chunk_size;
+        } else {
+            _seq = seq_before_padding - 1;
+        }
+    }
+    const bool penalize = m_repetition_penalty != 1.f && m_history && !m_history->empty();
+    const float *row;
+    if (t.dtype() == MLLM_TYPE_F32 && t.ctype() == BSHD) {
+        row = t.ptrAt<float>(0, 0, _seq, 0);
+        if (penalize) {
+            // the penalty goes on a copy, the caller's logits stay as they are
+            m_row.assign(row, row + n);
+            row = m_row.data();
+        }
+    } else if (t.dtype() == MLLM_TYPE_F32 || t.dtype() == MLLM_TYPE_F16) {
+        m_row.resize(n);
+        for (int i = 0; i < n; ++i) {
+            m_row[i] = t.dtype() == MLLM_TYPE_F16 ? MLLM_FP16_TO_FP32(t.dataAt<mllm_fp16_t>(0, 0, _seq, i)) : t.dataAt<float>(0, 0, _seq, i);
+        }
+        row = m_row.data();
+    } else {
+        throw std::runtime_error("Unsupported dtype for text generation.");
+    }
+    if (penalize) {
+        // once per distinct token, however often it occurs in the window
+        m_seen.resize(n);
+        for (unsigned int token : *m_history) {
+            if ((int)token < n && !m_seen[token]) {
+                m_seen[token] = 1;
+                float &v = m_row[token];
+                v = v > 0 ? v / m_repetition_penalty : v * m_repetition_penalty;
+            }
+        }
+        for (unsigned int token : *m_history) {
+            if ((int)token < n) {
+                m_seen[token] = 0;
+            }
+        }
+    }
+    return row;
+}
+
 unsigned int _LlmTextGenerateGreedySearchMethod::generate(Tensor &t) {
-    std::vector<float> scores;
-    this->_tensor_to_vec(t, scores);
-    return std::max_element(scores.begin(), scores.end()) - scores.begin();
+    int n;
+    const float *scores = _scores_row(t, n);
+    return _argmax(scores, n);
 }
 
 unsigned int _LlmTextGenerateGreedySearchMethodForSD::generate_SD(Tensor &t, TracePool &tp) {
@@ -42,104 +117,97 @@ unsigned int _LlmTextGenerateGreedySearchMethodForSD::generate_SD(Tensor &t, Tra
     return best_next_token_id;
 }
 
-unsigned int _LlmTextGenerateTopkSamplingMethod::generate(Tensor &t) {
-    auto argmax = [](const std::vector<float> &vec) -> unsigned int {
-        return std::distance(vec.begin(), std::max_element(vec.begin(), vec.end()));
-    };
-
-    if (m_k == 0 || m_k == 1) {
-        std::vector<float> scores;
-        this->_tensor_to_vec(t, scores);
-        return argmax(scores);
+// softmax((x - max) / temperature) over the selected scores, then one draw
+static unsigned int sample_selected(const std::vector<std::pair<float, unsigned int>> &selected, float temperature, std::mt19937 &gen) {
+    float max_value = selected[0].first;
+    for (const auto &e : selected) {
+        max_value = std::max(max_value, e.first);
     }
-
-    std::vector<std::pair<float, unsigned int>> scores;
-    this->_tensor_to_vec_with_idx(t, scores);
-
-    // find top k
-    std::partial_sort(scores.begin(), scores.begin() + m_k, scores.end(),
-                      [](std::pair<float, unsigned int> a, std::pair<float, unsigned int> b) { return a.first > b.first; });
-    std::vector<float> top_k_elements(m_k, 0.f);
-    std::vector<unsigned int> top_k_elements_idx(m_k, 0);
-    for (int i = 0; i < m_k; ++i) {
-        top_k_elements[i] = scores[i].first;
-        top_k_elements_idx[i] = scores[i].second;
-    }
-
-    // softmax with temperature
-    std::vector<float> softmax(top_k_elements.size(), 0.f);
-    double max_logit = top_k_elements[argmax(top_k_elements)];
-    double sum_exp = 0.f;
-
-    for (size_t i = 0; i < top_k_elements.size(); ++i) {
-        softmax[i] = exp((top_k_elements[i] - max_logit) / m_temperature);
-        sum_exp += softmax[i];
+    std::vector<float> weights(selected.size());
+    std::vector<unsigned int> ids(selected.size());
+    for (size_t i = 0; i < selected.size(); ++i) {
+        weights[i] = std::exp((selected[i].first - max_value) / temperature);
+        ids[i] = selected[i].second;
     }
+    return _sample_element(ids, weights, gen);
+}
 
-    for (float &value : softmax) {
-        value /= sum_exp;
+unsigned int _LlmTextGenerateTopkSamplingMethod::generate(Tensor &t) {
+    int n;
+    const float *scores = _scores_row(t, n);
+    if (m_k == 0 || m_k == 1) {
+        return _argmax(scores, n);
     }
-
-    // sampling
-    float _sum = std::accumulate(softmax.begin(), softmax.end(), 0.0);
-    for (float &value : softmax) {
-        value /= _sum;
+    // the k largest in one pass through a min-heap, no (score, id) copy of the vocabulary
+    const size_t k = std::min<size_t>(m_k, n);
+    auto greater = [](const std::pair<float, unsigned int> &a, const std::pair<float, unsigned int> &b) { return a.first > b.first; };
+    auto &top = m_candidates;
+    top.clear();
+    for (int i = 0; i < n; ++i) {
+        if (top.size() < k) {
+            top.emplace_back(scores[i], i);
+            std::push_heap(top.begin(), top.end(), greater);
+        } else if (scores[i] > top.front().first) {
+            std::pop_heap(top.begin(), top.end(), greater);
+            top.back() = {scores[i], (unsigned int)i};
+            std::push_heap(top.begin(), top.end(), greater);
+        }
     }
+    std::sort_heap(top.begin(), top.end(), greater);
+    return sample_selected(top, m_temperature, rng());
+}
 
-    auto idx = _sample_element(top_k_elements_idx, softmax);
-    return idx;
+// bucket of a probability by its float exponent: bucket b holds [2^-(b+1), 2^-b)
+static constexpr int kProbBuckets = 64;
+static inline int prob_bucket(float p) {
+    uint32_t bits;
+    std::memcpy(&bits, &p, sizeof(bits));
+    int e = (bits >> 23) & 0xff;
+    return std::min(kProbBuckets - 1, std::max(0, 126 - e));
 }
 
 unsigned int _LlmTextGenerateToppSamplingMethod::generate(Tensor &t) {
-    auto argmax = [](const std::vector<float> &vec) -> unsigned int {
-        return std::distance(vec.begin(), std::max_element(vec.begin(), vec.end()));
-    };
-    std::vector<std::pair<float, unsigned int>> scores;
-    this->_tensor_to_vec_with_idx(t, scores);
-
-    std::sort(scores.begin(), scores.end(), [](std::pair<float, unsigned int> a, std::pair<float, unsigned int> b) { return a.first > b.first; });
-    std::vector<float> top_k_elements;
-    std::vector<unsigned int> top_k_elements_idx;
-
-    if (scores[0].first > 1.f) {
-        throw std::runtime_error("The input tensor t should go through softmax first.(0.f - 1.f is acceptable)");
+    int n;
+    const float *scores = _scores_row(t, n);
+
+    // bucket select: only the buckets holding the top-p mass are collected and sorted
+    double bucket_mass[kProbBuckets] = {0};
+    float max_p = 0.f;
+    for (int i = 0; i < n; ++i) {
+        bucket_mass[prob_bucket(scores[i])] += scores[i];
+        max_p = std::max(max_p, scores[i]);
     }
-
-    float p = 0.f;
-    size_t idx = 0;
-    while (p < m_p) {
-        top_k_elements.emplace_back(scores[idx].first);
-        top_k_elements_idx.emplace_back(scores[idx].second);
-        p += scores[idx].first;
-        idx++;
+    if (max_p > 1.f) {
+        throw std::runtime_error("The input tensor t should go through softmax first.(0.f - 1.f is acceptable)");
     }
-
-    if (top_k_elements.size() == 1) {
-        return top_k_elements_idx[0];
+    int last = 0;
+    double mass = 0;
+    for (; last < kProbBuckets - 1; ++last) {
+        mass += bucket_mass[last];
+        if (mass >= m_p) {
+            break;
+        }
     }
-
-    // softmax with temperature
-    std::vector<float> softmax(top_k_elements.size(), 0.f);
-    double max_logit = top_k_elements[argmax(top_k_elements)];
-    double sum_exp = 0.f;
-
-    for (size_t i = 0; i < top_k_elements.size(); ++i) {
-        softmax[i] = exp((top_k_elements[i] - max_logit) / m_temperature);
-        sum_exp += softmax[i];
+    auto &selected = m_candidates;
+    selected.clear();
+    for (int i = 0; i < n; ++i) {
+        if (prob_bucket(scores[i]) <= last) {
+            selected.emplace_back(scores[i], i);
+        }
     }
+    std::sort(selected.begin(), selected.end(), [](const std::pair<float, unsigned int> &a, const std::pair<float, unsigned int> &b) { return a.first > b.first; });
 
-    for (float &value : softmax) {
-        value /= sum_exp;
+    float p = 0.f;
+    size_t count = 0;
+    while (p < m_p && count < selected.size()) {
+        p += selected[count].first;
+        count++;
     }
-
-    // sampling
-    float _sum = std::accumulate(softmax.begin(), softmax.end(), 0.0);
-    for (float &value : softmax) {
-        value /= _sum;
+    selected.resize(std::max<size_t>(count, 1));
+    if (selected.size() == 1) {
+        return selected[0].second;
     }
-
-    auto ret = _sample_element(top_k_elements_idx, softmax);
-    return ret;
+    return sample_selected(selected, m_temperature, rng());
 }
 
 unsigned int _LlmTextGenerateNucleusSamplingMethodForSD::generate_SD(Tensor &t, TracePool &tp) {
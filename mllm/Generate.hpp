@@ -33,17 +33,31 @@ struct LlmTextGeneratorOpts {
     bool is_padding = false;
     int seq_before_padding = 0;
     int chunk_size = -1;
+    float repetition_penalty = 1.0f; // > 1: scores of the last repetition_window generated tokens are penalized (one sequence)
+    int repetition_window = 64;
+    int64_t seed = -1; // < 0: seeded once from std::random_device
 };
 
+// probabilities need not be normalized
 template <typename T>
-T _sample_element(const std::vector<T> &elements, const std::vector<float> &probabilities) {
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::discrete_distribution<> dist(probabilities.begin(), probabilities.end());
-    size_t index = dist(gen);
-    return elements[index];
+T _sample_element(const std::vector<T> &elements, const std::vector<float> &probabilities, std::mt19937 &gen) {
+    double sum = 0;
+    for (float p : probabilities) {
+        sum += p;
+    }
+    double r = std::uniform_real_distribution<double>(0.0, sum)(gen);
+    for (size_t i = 0; i < probabilities.size(); ++i) {
+        r -= probabilities[i];
+        if (r < 0) {
+            return elements[i];
+        }
+    }
+    return elements.back();
 }
 
+// index of the first maximum
+unsigned int _argmax(const float *values, int n);
+
 enum class LLmTextGeneratorType : int32_t {
     kNone = 0,
     kGreedySearch,
@@ -58,6 +72,13 @@ protected:
     bool is_padding = false;
     int seq_before_padding = 0;
     int chunk_size = -1;
+    std::mt19937 *m_rng = nullptr; // the generator's, persistent across tokens
+    std::mt19937 m_own_rng{std::random_device()()};
+    float m_repetition_penalty = 1.f;
+    const std::vector<unsigned int> *m_history = nullptr;
+    std::vector<float> m_row; // scores copied out of the logits (F16 / penalized)
+    std::vector<uint8_t> m_seen; // per vocab id, all clear between calls
+    std::vector<std::pair<float, unsigned int>> m_candidates; // reused between tokens
 
 public:
     virtual ~_LlmTextGenerateMethod() = default;
@@ -67,6 +88,17 @@ public:
         this->seq_before_padding = seq_before_padding;
         this->chunk_size = chunk_size;
     }
+    inline void setSampling(std::mt19937 *rng, float repetition_penalty, const std::vector<unsigned int> *history) {
+        m_rng = rng;
+        m_repetition_penalty = repetition_penalty;
+        m_history = history;
+    }
+    // the scores of the position to generate from, read in place from t when it is F32 and no
+    // repetition penalty applies, else a copy in m_row; t itself is never modified
+    const float *_scores_row(Tensor &t, int &n);
+    inline std::mt19937 &rng() {
+        return m_rng ? *m_rng : m_own_rng;
+    }
     inline void _tensor_to_vec(Tensor &t, std::vector<float> &scores) {
         assert(t.batch() == 1 && "Batch size of result is not 1. Which is not supported for now.");
         assert(t.head() == 1 && "The 3rd dim of result should be one. e.g.:[1, 1, seq, hidden]");
@@ -366,10 +398,13 @@ public:
         if (opt.is_padding) {
             m_method_class->setPadding(opt.is_padding, opt.seq_before_padding, opt.chunk_size);
         }
+        m_rng.seed(opt.seed >= 0 ? (std::mt19937::result_type)opt.seed : std::random_device()());
+        m_repetition_window = opt.repetition_window;
+        m_method_class->setSampling(&m_rng, opt.repetition_penalty, &m_history);
     }
 
     inline unsigned int generate(Tensor &t) {
-        return m_method_class->generate(t);
+        return record(m_method_class->generate(t));
     }
 
     inline unsigned int generate_SD(Tensor &t, TracePool &tp) {
@@ -386,16 +421,33 @@ public:
         if (opt.is_padding) {
             m_method_class->setPadding(opt.is_padding, opt.seq_before_padding, opt.chunk_size);
         }
-        return m_method_class->generate(t);
+        return record(m_method_class->generate(t));
     }
 
     inline LLmTextGeneratorType type() {
         return m_type;
     }
 
+    inline void clearHistory() {
+        m_history.clear();
+    }
+
 private:
+    inline unsigned int record(unsigned int token) {
+        if (m_repetition_window > 0) {
+            if ((int)m_history.size() >= m_repetition_window) {
+                m_history.erase(m_history.begin());
+            }
+            m_history.push_back(token);
+        }
+        return token;
+    }
+
     LLmTextGeneratorType m_type;
     _LlmTextGenerateMethod *m_method_class = nullptr;
+    std::mt19937 m_rng;
+    std::vector<unsigned int> m_history; // generated tokens, for the repetition penalty
+    int m_repetition_window = 64;
 };
 
 } // namespace mllm
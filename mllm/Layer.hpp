@@ -47,6 +47,22 @@ public:
     bool ready() {
         return init_;
     }
+    /**
+     * @brief For fused layers that only have a CPU F32 kernel (SwiGLU, RoPE + KV cache, AddRMSNorm,
+     * LMHead): true once the op exists, else while the model being traced runs on the CPU and `input`
+     * is F32. Models build both the fused layer and the separate ones it replaces and pick with this
+     * in Forward, so every other backend and dtype runs the separate layers.
+     */
+    bool cpuFusable(const Tensor &input) const {
+        if (!init_) {
+            return false;
+        }
+        if (op_ != nullptr) {
+            return true;
+        }
+        auto *model = Module::llm_model_ptr;
+        return (model == nullptr || model->device() == MLLM_CPU) && input.dtype() == MLLM_TYPE_F32;
+    }
 
     /**** for forward ****/
     Tensor operator()(Tensor input) {
@@ -76,7 +92,11 @@ public:
         if (!loader) {
             loader = Module::llm_model_ptr->loader;
         }
-        op_->load(*loader);
+        if (auto *streaming = op_->streamingLoader()) {
+            streaming->load(op_, *loader);
+        } else {
+            op_->load(*loader);
+        }
         loaded_param = true;
         inited_loaded = true;
     }
@@ -141,7 +161,12 @@ protected:
         /*** part.3 load params(if) ***/
         if (module && (module->doLoad || !inited_loaded) && !module->doChangeBn) { // load
             if (module->doLoad) {
-                op_->load(*module->loader);
+                auto &streaming = module->streaming_loader_;
+                if (streaming && backend_->type() == MLLM_CPU) {
+                    streaming->enqueue(op_);
+                } else {
+                    op_->load(*module->loader);
+                }
                 inited_loaded = true;
             } else if (loaded_param) {
                 inited_loaded = loaded_param;
@@ -253,6 +278,35 @@ public:
     }
 };
 
+// logits of a tied-embedding model from the (quantized) embedding; name is <embedding>.lm_head
+class LMHead final : public Layer {
+public:
+    LMHead() = default;
+    explicit LMHead(int in_features, int vocab_size, std::string name) {
+        param_["in_features"] = in_features;
+        param_["vocab_size"] = vocab_size;
+        init(std::move(name), OpType::LMHEAD);
+    }
+    Tensor operator()(Tensor input) {
+        auto ts = run({input}, 1);
+        return ts[0];
+    }
+};
+
+// silu(gate_proj(x)) * up_proj(x) in one op; name is <base>gate_up_proj, see CPUSwiGLU for the weights
+class SwiGLU final : public Layer {
+public:
+    explicit SwiGLU(int in_features, int intermediate_size, std::string name) {
+        param_["in_features"] = in_features;
+        param_["intermediate_size"] = intermediate_size;
+        init(std::move(name), OpType::SWIGLU);
+    }
+    Tensor operator()(Tensor input) {
+        auto ts = run({input}, 1);
+        return ts[0];
+    }
+};
+
 class SparseIdLinear final : public Layer {
 public:
     SparseIdLinear(int in_dim, int out_dim, std::string name) {
@@ -406,6 +460,13 @@ public:
         param_["do_causal_mask"] = do_causal_mask;
         init(std::move(name), OpType::SOFTMAX);
     }
+    // kv_attention: the input are attention scores over a KV cache, masked per row under continuous batching
+    explicit Softmax(Chl axis, bool do_causal_mask, bool kv_attention, std::string name) {
+        param_["axis"] = axis;
+        param_["do_causal_mask"] = do_causal_mask;
+        param_["kv_attention"] = kv_attention;
+        init(std::move(name), OpType::SOFTMAX);
+    }
     Tensor operator()(Tensor input) {
         auto ts = run({input}, 1);
         return ts[0];
@@ -554,6 +615,9 @@ public:
         return ts[0];
     }
     void clearCache() {
+        if (op_ == nullptr) {
+            return;
+        }
         return op_->clearCache();
     }
 };
@@ -661,6 +725,9 @@ public:
         return ts[0];
     }
     void clearCache() {
+        if (op_ == nullptr) {
+            return;
+        }
         return op_->clearCache();
     }
 };
@@ -677,13 +744,16 @@ public:
         init(std::move(name), OpType::KVCACHE);
     }
 
-    explicit KVCache(int head, int hidden, int n_rep, int cache_max, string attn_impl, std::string name) {
+    // share_heads: store the KV heads once instead of n_rep copies; only for consumers whose
+    // attention matmul broadcasts KV heads over query-head groups (Tensor::mm does)
+    explicit KVCache(int head, int hidden, int n_rep, int cache_max, string attn_impl, std::string name, bool share_heads = false) {
         param_["head"] = head;
         param_["hidden"] = hidden;
         param_["n_rep"] = n_rep;
         param_["cache_max"] = cache_max;
         param_["for_xnn"] = false;
         param_["fa2"] = (attn_impl == "flash_attention_2" || attn_impl == "sage_attention");
+        param_["share_heads"] = share_heads;
         if (attn_impl == "sage_attention" && hidden % QK8_0F == 0 && KVCacheSageDtypeBit == 8) {
             init(std::move(name), OpType::KVCACHESAGE);
         } else {
@@ -691,6 +761,22 @@ public:
         }
     }
 
+    // q_rope, k_rope, k_cache and v_cache of an attention layer in one op (BSHD layout only):
+    // (q, k, v) -> (rotated q, k cache, v cache), rotated k and v are written into the cache slots.
+    // name must end with "rope_kv_cache", the rope/cache ops inside take its prefix.
+    explicit KVCache(int head, int hidden, int n_rep, int cache_max, int pose_type, float rope_theta,
+                     float partial_rotary_factor, int max_position_embeddings, std::string name) {
+        param_["head"] = head;
+        param_["hidden"] = hidden;
+        param_["n_rep"] = n_rep;
+        param_["cache_max"] = cache_max;
+        param_["pose_type"] = pose_type;
+        param_["rope_theta"] = rope_theta;
+        param_["partial_rotary_factor"] = partial_rotary_factor;
+        param_["max_position_embeddings"] = max_position_embeddings;
+        init(std::move(name), OpType::ROPEKVCACHE);
+    }
+
     explicit KVCache(int cache_max, std::string name) {
         param_["n_rep"] = 1;
         param_["cache_max"] = cache_max;
@@ -735,6 +821,9 @@ public:
         auto ts = run({input}, 1);
         return ts[0];
     }
+    vector<Tensor> operator()(Tensor q, Tensor k, Tensor v) {
+        return run({q, k, v}, 3);
+    }
     int getCacheSeqLen() {
         if (op_ == nullptr) {
             return -1;
@@ -785,6 +874,20 @@ public:
     }
 };
 
+// (x, residual) -> (x + residual, rmsnorm(x + residual)); name is that of the RMSNorm it replaces
+class AddRMSNorm final : public Layer {
+public:
+    AddRMSNorm() = default;
+    explicit AddRMSNorm(int norm_size, float epsilon, std::string name) {
+        param_["norm_size"] = norm_size;
+        param_["epsilon"] = epsilon;
+        init(std::move(name), OpType::ADDRMSNORM);
+    }
+    vector<Tensor> operator()(Tensor x, Tensor residual) {
+        return run({x, residual}, 2);
+    }
+};
+
 class Matmul final : public Layer {
 public:
     explicit Matmul(bool transpose0, bool transpose1, std::string name) {
@@ -21,6 +21,8 @@ std::stack<int> Module::listIdxStack;
 BackendType Module::tmp_device = MLLM_CPU;
 std::unordered_map<string, shared_ptr<Op>> Module::tensor_func_ops;
 bool Module::alloc_mmap = true;
+int Module::load_threads = 4;
+bool Module::stream_load = false;
 
 vector<double> Module::profiling(string name) {
     vector<double> output;
@@ -31,7 +33,28 @@ vector<double> Module::profiling(string name) {
         std::cout << "-------------------------------------------" << std::endl;
     }
     double load_time_s = load_time_ / 1000.0F;
-    std::cout << "  Load time: " << load_time_ / 1000.0F << " s" << std::endl;
+    std::cout << "  Load time: " << load_time_ / 1000.0F << " s";
+    if (streaming_loader_ && streaming_loader_->done()) {
+        // the load pass only queued the ops, the weights were read while the model ran
+        double stream_time_s = streaming_loader_->loadTimeMs() / 1000.0;
+        load_bytes_ = loader->loadedBytes();
+        std::cout << " (weights streamed in " << stream_time_s << " s";
+        if (load_bytes_ > 0 && stream_time_s > 0) {
+            std::cout << ", " << load_bytes_ / (1024.0 * 1024.0) / stream_time_s << " MB/s";
+        }
+        std::cout << ")";
+    } else if (load_bytes_ > 0 && load_time_ > 0) {
+        std::cout << " (" << load_bytes_ / (1024.0 * 1024.0) / load_time_s << " MB/s)";
+    }
+    std::cout << std::endl;
+    auto cpu_it = Backend::global_backends.find(MLLM_CPU);
+    if (cpu_it != Backend::global_backends.end()) {
+        auto *cpu_backend = dynamic_cast<CPUBackend *>(cpu_it->second.get());
+        if (cpu_backend && cpu_backend->decodePlanArenaBytes() > 0) {
+            std::cout << "  Decode activation arena: " << cpu_backend->decodePlanArenaBytes() / (1024.0 * 1024.0) << " MB (planned "
+                      << cpu_backend->decodePlanArenaPlannedBytes() / (1024.0 * 1024.0) << " MB)" << std::endl;
+        }
+    }
     if (inference_times_.size() > 1 && decoding_token_size_ != prefilling_token_size_) {
         double prefile_speed = 1000 * prefilling_token_size_ / inference_times_[0];
         std::cout << "  Prefilling speed: " << prefile_speed << " tokens/s , TTFT: " << inference_times_[0] / 1000.0F << " s" << std::endl;
@@ -87,6 +110,8 @@ void Module::generate(
         if (!text_generator_ || text_generator_->type() != LLmTextGeneratorType::kTopkSampling)
             text_generator_ = std::make_shared<LlmTextGenerator>(LLmTextGeneratorType::kTopkSampling, opt);
     }
+    // the repetition penalty looks at this answer only, not at the previous prompt's
+    text_generator_->clearHistory();
 
     for (int step = 0; step < opt.max_new_tokens; ++step) {
         auto _out = (*this)({input_ids});
@@ -170,6 +195,7 @@ vector<vector<unsigned>> Module::generate(Tensor &input_ids, const LlmTextGenera
         if (!text_generator_ || text_generator_->type() != LLmTextGeneratorType::kTopkSampling)
             text_generator_ = std::make_shared<LlmTextGenerator>(LLmTextGeneratorType::kTopkSampling, opt);
     }
+    text_generator_->clearHistory();
     auto batch_size = input_ids.batch();
     vector<vector<unsigned>> results(batch_size);
     vector<bool> is_end(batch_size, false);
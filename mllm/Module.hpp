@@ -10,6 +10,7 @@
 #include "ParamLoader.hpp"
 #include "Backend.hpp"
 #include "Timing.hpp"
+#include "StreamingLoader.hpp"
 #include "Trace.hpp"
 #include "Types.hpp"
 #include "backends/cpu/CPUBackend.hpp"
@@ -51,6 +52,7 @@ protected:
 
 public:
     double load_time_;
+    uint64_t load_bytes_ = 0;
     int prefilling_token_size_ = 0;
     int decoding_token_size_ = 0;
     vector<double> inference_times_;
@@ -59,6 +61,8 @@ public:
     map<string, shared_ptr<Tensor>> activation_tensors;
     map<string, int> activation_tensors_num;
     std::shared_ptr<AbstructLoader> loader;
+    // set by load() when stream_load is on, see StreamingLoader
+    std::shared_ptr<StreamingLoader> streaming_loader_;
     bool doLoad = false;
     bool doChangeBn = false;
     bool doTrace = false;
@@ -80,6 +84,10 @@ public:
 
     static std::unordered_map<string, shared_ptr<Op>> tensor_func_ops; // use for QNN
     static bool alloc_mmap;
+    // threads reading one tensor in parallel when weights are not mmap-ed
+    static int load_threads;
+    // load() returns after the load pass and the weights are read by a background thread
+    static bool stream_load;
 
 private:
     template <typename... Args>
@@ -191,6 +199,9 @@ public:
 
     // TODO: Deprecated, the module is not backend specific, the backend should be set in the SubGraphStart and SubGraphFinalize
     Module &to(BackendType type) {
+        if (streaming_loader_) {
+            streaming_loader_->waitAll();
+        }
         initBackend(type);
         device_ = type;
         doChangeBn = true;
@@ -214,14 +225,25 @@ public:
 
     void load(string path) {
         // create global loader and save to llm_model_ptr.loader as QNNBackend needs to load weights in runtime
-        loader = std::make_unique<ParamLoader>(std::move(path), alloc_mmap); // todo
+        int readers = load_threads;
+        if (stream_load) {
+            // the reads overlap the forward: keep the readers off the cores of the compute threads
+            int spare = (int)std::thread::hardware_concurrency() - CPUBackend::cpu_threads;
+            readers = std::max(1, std::min(load_threads, spare));
+        }
+        loader = std::make_unique<ParamLoader>(std::move(path), alloc_mmap, readers); // todo
+        streaming_loader_ = stream_load ? std::make_shared<StreamingLoader>(loader) : nullptr;
         Tensor::tensor_status = TENSOR_STATIC_INIT;
         doLoad = true;
         doTrace = true;
         load_time_ = forwardNoInput(); // ms
+        load_bytes_ = loader->loadedBytes();
         doLoad = false;
         tracedFlag = true;
         doTrace = false;
+        if (streaming_loader_) {
+            streaming_loader_->start();
+        }
     }
     void load_multifile(const std::initializer_list<string> path) {
         loader = std::make_unique<MultiFileParamLoader>(std::move(path));
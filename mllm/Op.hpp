@@ -16,6 +16,7 @@ namespace mllm {
 class Backend;
 class Tensor;
 class ParamLoader;
+class StreamingLoader;
 
 class Op {
 public:
@@ -135,6 +136,10 @@ public:
     bool &traced() {
         return traced_;
     }
+    // set while the weights of this op are queued on its model's StreamingLoader
+    StreamingLoader *&streamingLoader() {
+        return streaming_loader_;
+    }
 
 protected:
     Backend *backend_;
@@ -142,9 +147,10 @@ protected:
     vector<Tensor *> outputs_;
     string name_;
     DataType activation_dtype_ = MLLM_TYPE_F32;
-    OpType type_;
+    OpType type_ = INVALID_VALUE;
     static DataType no_load_weights_dtype_;
     bool traced_ = false;
+    StreamingLoader *streaming_loader_ = nullptr;
 };
 
 class Callable {
@@ -7,130 +7,143 @@ using std::string;
 using std::vector;
 
 namespace mllm {
-enum OpType {
-    INVALID_VALUE = 0,    // 0
-    PARAMETER,            // 1
-    ADD,                  // 2
-    SOFTMAX,              // 3
-    SILU,                 // 4
-    SILU_FULL_PRECISION,  // 5
-    MATMUL,               // 6
-    SCALE,                // 7
-    ROPE,                 // 8
-    ROPESIMPLE,           // 9
-    POSITIOANL_EMBEDDING, // 10
-    RMSNORM,              // 11
-    CAUSALMASK,           // 12
-    SLIDINGWINDOWMASK,    // 13
-    LINEAR,               // 14
-    LINEARINT8,           // 15
-    LINEARINT8SHADOW,     // 16
-    EMBEDDING,            // 17
-    MUL,                  // 18
-    VIEW,                 // 19
-    KVCACHE,              // 20
-    KVCACHENPU,           // 21
-    RELU,                 // 22
-    RELU2,                // 23
-    OP_GELU,              // 24
-    QUICKGLUE,            // 25
-    LAYERNORM,            // 26
-    SPLIT,                // 27
-    GATHER,               // 28
-    CONVOLUTION2D,        // 29
-    CONVOLUTION3D,        // 30
-    VISIONROPE,           // 31
-    VISIONROPESIN,        // 32
-    VISIONROPECOS,        // 33
-    MULTIMODALROPEPIP,    // 34
-    MULTIMODALROPE,       // 35
-    AVGPOOL2D,            // 36
-    MAXPOOL2D,            // 37
-    CAT,                  // 38
-    TRANSPOSE,            // 39
-    SUBDIM,               // 40
-    DIVISION,             // 41
-    NORM,                 // 42
-    SHAPE,                // 43
-    MEAN,                 // 44
-    RANGE,                // 45
-    WHERE,                // 46
-    REPLACE,              // 47
-    PREDICTOR,            // 48
-    SPARSELINEAR,         // 49
-    SPARSEIDLINEAR,       // 50
-    ELASTICLINEAR,        // 51
-    POSITION,             // 52
-    WNOP,                 // 53
-    QUANTIZE,             // 54
-    DEQUANTIZE,           // 55
-    DEQUANTIZEADD,        // 56
-    MERGEOUTPUT,          // 57
-    SPLITINPUT,           // 58
-    IROPE,                // 59
-    OP_NUM,               // 60
-    NTKROPE,              // 61
-    SCATTER,              // 62
-    TILDE,                // 63
-    MASKEDFILL,           // 64
-    SIGMOID,              // 65
-
-    // add in xnnpack
-    DIRECT,           // 66
-    DISPATCH,         // 67
-    SUBGRAPHSTART,    // 68
-    SUBGRAPHFINALIZE, // 69
-    D2H,              // 70
-    XP_KVCACHE,       // 71
-    SDPA,             // 72
-
-    // new front-end
-    SUPERSILU,  // 73
-    HEADLINEAR, // 74
+// every OpType in declaration order; expanded into the enum below and into OpTracer::opTypeName,
+// so a new op is added here once
+#define MLLM_OP_TYPES(X)                \
+    X(INVALID_VALUE)          /* 0 */   \
+    X(PARAMETER)              /* 1 */   \
+    X(ADD)                    /* 2 */   \
+    X(SOFTMAX)                /* 3 */   \
+    X(SILU)                   /* 4 */   \
+    X(SILU_FULL_PRECISION)    /* 5 */   \
+    X(MATMUL)                 /* 6 */   \
+    X(SCALE)                  /* 7 */   \
+    X(ROPE)                   /* 8 */   \
+    X(ROPESIMPLE)             /* 9 */   \
+    X(POSITIOANL_EMBEDDING)   /* 10 */  \
+    X(RMSNORM)                /* 11 */  \
+    X(CAUSALMASK)             /* 12 */  \
+    X(SLIDINGWINDOWMASK)      /* 13 */  \
+    X(LINEAR)                 /* 14 */  \
+    X(LINEARINT8)             /* 15 */  \
+    X(LINEARINT8SHADOW)       /* 16 */  \
+    X(EMBEDDING)              /* 17 */  \
+    X(MUL)                    /* 18 */  \
+    X(VIEW)                   /* 19 */  \
+    X(KVCACHE)                /* 20 */  \
+    X(KVCACHENPU)             /* 21 */  \
+    X(RELU)                   /* 22 */  \
+    X(RELU2)                  /* 23 */  \
+    X(OP_GELU)                /* 24 */  \
+    X(QUICKGLUE)              /* 25 */  \
+    X(LAYERNORM)              /* 26 */  \
+    X(SPLIT)                  /* 27 */  \
+    X(GATHER)                 /* 28 */  \
+    X(CONVOLUTION2D)          /* 29 */  \
+    X(CONVOLUTION3D)          /* 30 */  \
+    X(VISIONROPE)             /* 31 */  \
+    X(VISIONROPESIN)          /* 32 */  \
+    X(VISIONROPECOS)          /* 33 */  \
+    X(MULTIMODALROPEPIP)      /* 34 */  \
+    X(MULTIMODALROPE)         /* 35 */  \
+    X(AVGPOOL2D)              /* 36 */  \
+    X(MAXPOOL2D)              /* 37 */  \
+    X(CAT)                    /* 38 */  \
+    X(TRANSPOSE)              /* 39 */  \
+    X(SUBDIM)                 /* 40 */  \
+    X(DIVISION)               /* 41 */  \
+    X(NORM)                   /* 42 */  \
+    X(SHAPE)                  /* 43 */  \
+    X(MEAN)                   /* 44 */  \
+    X(RANGE)                  /* 45 */  \
+    X(WHERE)                  /* 46 */  \
+    X(REPLACE)                /* 47 */  \
+    X(PREDICTOR)              /* 48 */  \
+    X(SPARSELINEAR)           /* 49 */  \
+    X(SPARSEIDLINEAR)         /* 50 */  \
+    X(ELASTICLINEAR)          /* 51 */  \
+    X(POSITION)               /* 52 */  \
+    X(WNOP)                   /* 53 */  \
+    X(QUANTIZE)               /* 54 */  \
+    X(DEQUANTIZE)             /* 55 */  \
+    X(DEQUANTIZEADD)          /* 56 */  \
+    X(MERGEOUTPUT)            /* 57 */  \
+    X(SPLITINPUT)             /* 58 */  \
+    X(IROPE)                  /* 59 */  \
+    X(OP_NUM)                 /* 60 */  \
+    X(NTKROPE)                /* 61 */  \
+    X(SCATTER)                /* 62 */  \
+    X(TILDE)                  /* 63 */  \
+    X(MASKEDFILL)             /* 64 */  \
+    X(SIGMOID)                /* 65 */  \
+                                        \
+    /* add in xnnpack */                \
+    X(DIRECT)                 /* 66 */  \
+    X(DISPATCH)               /* 67 */  \
+    X(SUBGRAPHSTART)          /* 68 */  \
+    X(SUBGRAPHFINALIZE)       /* 69 */  \
+    X(D2H)                    /* 70 */  \
+    X(XP_KVCACHE)             /* 71 */  \
+    X(SDPA)                   /* 72 */  \
+                                        \
+    /* new front-end */                 \
+    X(SUPERSILU)              /* 73 */  \
+    X(HEADLINEAR)             /* 74 */  \
+                                        \
+    /* for speculative decoding */      \
+    X(ROPETREE)               /* 75 */  \
+    X(CAUSALTREEMASK)         /* 76 */  \
+    X(KVCACHESAGE)            /* 77 */  \
+                                        \
+                                        \
+    X(F_ADD)                  /* 78 */  \
+    X(F_SUB)                  /* 79 */  \
+    X(F_MUL)                  /* 80 */  \
+    X(F_DIV)                  /* 81 */  \
+    X(F_DIVINT)               /* 82 */  \
+    X(F_TTADD)                /* 83 */  \
+    X(F_TTSUB)                /* 84 */  \
+    X(F_TTMUL)                /* 85 */  \
+    X(F_TTDIV)                /* 86 */  \
+    X(F_MM)                   /* 87 */  \
+    X(F_NORM)                 /* 88 */  \
+    X(F_MEAN)                 /* 89 */  \
+    X(F_CAT)                  /* 90 */  \
+    X(F_VIEW)                 /* 91 */  \
+    X(F_TRANPOSE)             /* 92 */  \
+    X(F_FLATTEN)              /* 93 */  \
+    X(F_CLIP)                 /* 94 */  \
+    X(F_CLIPAXIS)             /* 95 */  \
+    X(F_CLIPTENSOR)           /* 96 */  \
+    X(F_RANGE)                /* 97 */  \
+    X(F_WHERE)                /* 98 */  \
+    X(F_INDEX_PUT)            /* 99 */  \
+    X(F_SPLIT)                /* 100 */ \
+    X(F_SUM)                  /* 101 */ \
+    X(F_TOPK)                 /* 102 */ \
+    X(F_EXPPAND)              /* 103 */ \
+    X(F_ARGSORT)              /* 104 */ \
+    X(F_BINCOUNT)             /* 105 */ \
+    X(F_REPEAT)               /* 106 */ \
+    X(F_LIKE)                 /* 107 */ \
+    X(F_SCATTERRADD)          /* 108 */ \
+    X(F_APPLY_VISIOROPE)      /* 109 */ \
+    X(F_FA2)                  /* 110 */ \
+    X(F_SAGEATTN)             /* 111 */ \
+    /* models use only */               \
+    X(F_FUYU_GATHER_EMBD)     /* 112 */ \
+    X(F_PHI3V_HD_MERGE)       /* 113 */ \
+                                        \
+    /* fused ops */                     \
+    X(SWIGLU)                 /* 114 */ \
+    X(ROPEKVCACHE)            /* 115 */ \
+    X(LMHEAD)                 /* 116 */ \
+    X(ADDRMSNORM)             /* 117 */
 
-    // for speculative decoding
-    ROPETREE,       // 75
-    CAUSALTREEMASK, // 76
-    KVCACHESAGE,    // 77
-
-    //
-    F_ADD,             // 78
-    F_SUB,             // 79
-    F_MUL,             // 80
-    F_DIV,             // 81
-    F_DIVINT,          // 82
-    F_TTADD,           // 83
-    F_TTSUB,           // 84
-    F_TTMUL,           // 85
-    F_TTDIV,           // 86
-    F_MM,              // 87
-    F_NORM,            // 88
-    F_MEAN,            // 89
-    F_CAT,             // 90
-    F_VIEW,            // 91
-    F_TRANPOSE,        // 92
-    F_FLATTEN,         // 93
-    F_CLIP,            // 94
-    F_CLIPAXIS,        // 95
-    F_CLIPTENSOR,      // 96
-    F_RANGE,           // 97
-    F_WHERE,           // 98
-    F_INDEX_PUT,       // 99
-    F_SPLIT,           // 100
-    F_SUM,             // 101
-    F_TOPK,            // 102
-    F_EXPPAND,         // 103
-    F_ARGSORT,         // 104
-    F_BINCOUNT,        // 105
-    F_REPEAT,          // 106
-    F_LIKE,            // 107
-    F_SCATTERRADD,     // 108
-    F_APPLY_VISIOROPE, // 109
-    F_FA2,             // 110
-    F_SAGEATTN,        // 111
-    // models use only
-    F_FUYU_GATHER_EMBD, // 112
-    F_PHI3V_HD_MERGE,   // 113
+enum OpType {
+#define MLLM_OP_TYPE_ENUM(name) name,
+    MLLM_OP_TYPES(MLLM_OP_TYPE_ENUM)
+#undef MLLM_OP_TYPE_ENUM
 };
 
 enum TensorFuncType {
@@ -0,0 +1,211 @@
+#include "OpTracer.hpp"
+#include "Op.hpp"
+#include "Tensor.hpp"
+#include "Timing.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace mllm {
+
+std::atomic<bool> OpTracer::enabled_{false};
+
+OpTracer &OpTracer::instance() {
+    static OpTracer tracer;
+    return tracer;
+}
+
+OpTracer::OpTracer() {
+    origin_ns_ = mllm_time_ns();
+    if (const char *path = std::getenv("MLLM_TRACE")) {
+        if (*path != '\0') {
+            exit_path_ = path;
+            enabled_.store(true, std::memory_order_relaxed);
+        }
+    }
+}
+
+OpTracer::~OpTracer() {
+    if (!exit_path_.empty()) {
+        enabled_.store(false, std::memory_order_relaxed);
+        exportChromeTrace(exit_path_);
+    }
+}
+
+void OpTracer::start() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    events_.clear();
+    origin_ns_ = mllm_time_ns();
+    enabled_.store(true, std::memory_order_relaxed);
+}
+
+void OpTracer::stop() {
+    enabled_.store(false, std::memory_order_relaxed);
+}
+
+void OpTracer::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    events_.clear();
+}
+
+static int thread_index() {
+    static std::atomic<int> next{0};
+    thread_local int index = next.fetch_add(1);
+    return index;
+}
+
+static std::string describe(const std::vector<std::shared_ptr<Tensor>> &tensors, uint64_t &bytes) {
+    std::string desc;
+    for (const auto &t : tensors) {
+        if (t == nullptr) {
+            continue;
+        }
+        if (!desc.empty()) {
+            desc += ' ';
+        }
+        desc += '[';
+        // batch, head, sequence, dimension as printShape, whatever the layout; 5-D tensors as stored
+        auto shape = t->shape();
+        if (shape.size() == 4) {
+            shape = {t->batch(), t->head(), t->sequence(), t->dimension()};
+        }
+        for (size_t i = 0; i < shape.size(); ++i) {
+            desc += (i ? "," : "") + std::to_string(shape[i]);
+        }
+        desc += "]:" + DataTypeName(t->dtype());
+        bytes += t->cntSize();
+    }
+    return desc;
+}
+
+// rough count: 2*M*N*K for the GEMM-like ops (K = input dimension), one per output element otherwise
+static double estimate_flops(OpType type, const std::vector<std::shared_ptr<Tensor>> &inputs,
+                             const std::vector<std::shared_ptr<Tensor>> &outputs) {
+    if (inputs.empty() || outputs.empty() || inputs[0] == nullptr || outputs[0] == nullptr) {
+        return 0;
+    }
+    const double out = (double)outputs[0]->count();
+    const double k = inputs[0]->dimension();
+    switch (type) {
+    case LINEAR:
+    case LINEARINT8:
+    case LINEARINT8SHADOW:
+    case LMHEAD:
+    case MATMUL:
+    case F_MM:
+        return 2 * out * k;
+    case SWIGLU: // gate and up projections + silu * up
+        return 4 * out * k + 5 * out;
+    case F_FA2: {
+        // q [B, H, Sq, D] against k/v [B, H_kv, Skv, D]: q*k^T and p*v
+        if (inputs.size() < 3 || inputs[1] == nullptr) return 0;
+        return 4.0 * inputs[0]->batch() * inputs[0]->head() * inputs[0]->sequence() * inputs[1]->sequence() * k;
+    }
+    default:
+        return out;
+    }
+}
+
+void OpTracer::push(Event &&event) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    event.start_ns -= origin_ns_;
+    events_.push_back(std::move(event));
+}
+
+void OpTracer::recordOp(Op *op, const std::vector<std::shared_ptr<Tensor>> &inputs,
+                        const std::vector<std::shared_ptr<Tensor>> &outputs, int64_t t0, int64_t t1) {
+    Event event;
+    event.name = op->name();
+    if (event.name.empty() && !outputs.empty() && outputs[0] != nullptr) {
+        event.name = outputs[0]->name();
+    }
+    event.type = op->type();
+    event.start_ns = t0;
+    event.dur_ns = t1 - t0;
+    event.tid = thread_index();
+    event.inputs = describe(inputs, event.activation_bytes);
+    event.outputs = describe(outputs, event.activation_bytes);
+    event.flops = estimate_flops(event.type, inputs, outputs);
+    push(std::move(event));
+}
+
+void OpTracer::recordStep(const std::string &name, int64_t t0, int64_t t1) {
+    Event event;
+    event.name = name;
+    event.start_ns = t0;
+    event.dur_ns = t1 - t0;
+    event.tid = thread_index();
+    push(std::move(event));
+}
+
+std::vector<OpTracer::Event> OpTracer::events() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return events_;
+}
+
+static std::string json_escape(const std::string &s) {
+    std::string out;
+    out.reserve(s.size());
+    for (char c : s) {
+        switch (c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if ((unsigned char)c < 0x20) {
+                char buf[8];
+                snprintf(buf, sizeof(buf), "\\u%04x", c);
+                out += buf;
+            } else {
+                out += c;
+            }
+        }
+    }
+    return out;
+}
+
+bool OpTracer::exportChromeTrace(const std::string &path) {
+    auto all = events();
+    std::ofstream file(path);
+    if (!file) {
+        std::cerr << "OpTracer: cannot write " << path << std::endl;
+        return false;
+    }
+    // complete ("X") events, timestamps in microseconds
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    file << std::fixed << std::setprecision(3);
+    for (size_t i = 0; i < all.size(); ++i) {
+        const auto &e = all[i];
+        const bool step = e.type == INVALID_VALUE;
+        file << (i ? ",\n" : "\n")
+             << "{\"name\":\"" << json_escape(e.name) << "\",\"cat\":\"" << (step ? "forward" : opTypeName(e.type))
+             << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << e.tid
+             << ",\"ts\":" << e.start_ns / 1000.0 << ",\"dur\":" << e.dur_ns / 1000.0;
+        if (!step) {
+            file << ",\"args\":{\"type\":\"" << opTypeName(e.type) << "\",\"inputs\":\"" << json_escape(e.inputs)
+                 << "\",\"outputs\":\"" << json_escape(e.outputs) << "\",\"activation_bytes\":" << e.activation_bytes
+                 << ",\"flops\":" << std::setprecision(0) << e.flops << std::setprecision(3) << "}";
+        }
+        file << "}";
+    }
+    file << "\n]}\n";
+    return (bool)file;
+}
+
+const char *OpTracer::opTypeName(OpType type) {
+    static const char *const names[] = {
+#define MLLM_OP_TYPE_NAME(name) #name,
+        MLLM_OP_TYPES(MLLM_OP_TYPE_NAME)
+#undef MLLM_OP_TYPE_NAME
+    };
+    if (type < 0 || type >= (int)(sizeof(names) / sizeof(names[0]))) {
+        return "UNKNOWN";
+    }
+    return names[type];
+}
+
+} // namespace mllm
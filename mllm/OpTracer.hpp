@@ -0,0 +1,80 @@
+#ifndef MLLM_OPTRACER_H
+#define MLLM_OPTRACER_H
+
+#include "OpDefined.hpp"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace mllm {
+
+class Op;
+class Tensor;
+
+/**
+ * @brief Runtime op tracer, independent of the DEBUGOPTIME build flag.
+ *
+ * While enabled, CPUBackend::runOp records one event per executed op (monotonic start/duration,
+ * op name and type, input/output shapes and dtypes, calling thread, bytes of the input and output
+ * tensors and an estimate of the FLOPs) and runForward one event per forward step. exportChromeTrace writes
+ * the events as Chrome trace JSON, which chrome://tracing and ui.perfetto.dev open.
+ * When disabled the only cost per op is one relaxed atomic load.
+ *
+ * Setting the MLLM_TRACE environment variable to a file name enables the tracer at start-up and
+ * writes that file at exit, so a release build can be traced without recompiling.
+ */
+class OpTracer {
+public:
+    struct Event {
+        std::string name;
+        OpType type = INVALID_VALUE; // INVALID_VALUE for a forward step
+        int64_t start_ns = 0;        // since start()
+        int64_t dur_ns = 0;
+        int tid = 0; // small per-thread index, 0 for the first thread that recorded
+        std::string inputs;  // "[1,1,7,896]:F32 ..."
+        std::string outputs;
+        uint64_t activation_bytes = 0; // input + output tensors, weights not included
+        double flops = 0;
+    };
+
+    static OpTracer &instance();
+    ~OpTracer();
+
+    static bool enabled() {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+    // drops the recorded events and starts recording
+    void start();
+    void stop();
+    void clear();
+
+    // t0/t1 from mllm_time_ns()
+    void recordOp(Op *op, const std::vector<std::shared_ptr<Tensor>> &inputs,
+                  const std::vector<std::shared_ptr<Tensor>> &outputs, int64_t t0, int64_t t1);
+    void recordStep(const std::string &name, int64_t t0, int64_t t1);
+
+    std::vector<Event> events();
+    bool exportChromeTrace(const std::string &path);
+
+    static const char *opTypeName(OpType type);
+
+private:
+    OpTracer();
+    OpTracer(const OpTracer &) = delete;
+    OpTracer &operator=(const OpTracer &) = delete;
+
+    void push(Event &&event);
+
+    static std::atomic<bool> enabled_;
+    int64_t origin_ns_ = 0;
+    std::mutex mutex_;
+    std::vector<Event> events_;
+    std::string exit_path_; // from MLLM_TRACE
+};
+
+} // namespace mllm
+
+#endif // MLLM_OPTRACER_H
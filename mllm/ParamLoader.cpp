@@ -1,13 +1,17 @@
 #include "ParamLoader.hpp"
 #include "Types.hpp"
+#include <algorithm>
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <fcntl.h>
 #include <iostream>
 #include <string>
 #include <sys/mman.h>
+#include <unistd.h>
 #include <tuple>
+#include <vector>
 #include <utility>
 // TODO:
 // #define USE_MMAP
@@ -28,6 +32,9 @@
  * │       │      │       │        │           │         │         │      │                      │                         │
  * └───────┴──────┴───────┴────────┴───────────┴─────────┴─────────┴──────┴──────────────────────┴─────────────────────────┘
  * Weights File Structure
+ *
+ * The v2 layout (_MAGIC_NUMBER_V2) adds an Alignment INT after the magic and pads every
+ * Weights Contents to a multiple of it, see ParamLoader.hpp.
  */
 namespace mllm {
 
@@ -92,14 +99,13 @@ bool ParamLoader::load(mllm::Tensor *tensor) {
 
     string name = tensor->name();
     if (!use_mmap_) {
-        std::lock_guard<std::mutex> lock(mtx);
-        if (offsets_.find(name) == offsets_.end()) { return false; }
-        std::pair<uint64_t, uint64_t> offset = offsets_[name];
+        // offsets_ is read-only after construction, every read has its own pread
+        auto it = offsets_.find(name);
+        if (it == offsets_.end() || fp_ == nullptr) { return false; }
         auto *p = tensor->hostPtr<char>();
-        fseek(fp_, offset.first, SEEK_SET);
-        size_t read_size = std::min(tensor->cntSize(), static_cast<size_t>(offset.second));
-        auto _ = fread(p, sizeof(uint8_t), read_size, fp_);
-        return true;
+        size_t read_size = std::min(tensor->cntSize(), static_cast<size_t>(it->second.second));
+        readAhead(it->second.first);
+        return readAt(p, it->second.first, read_size);
 
     } else {
         // --- mmap 模式，实现智能选择 ---
@@ -120,6 +126,9 @@ bool ParamLoader::load(mllm::Tensor *tensor) {
         int required_alignment = DataTypeSize(tensor->dtype());
         if (required_alignment == 0) required_alignment = 1;
         bool is_aligned = (offset_info.first % required_alignment == 0);
+        if (version_ >= 2) {
+            is_aligned = (offset_info.first % alignment_ == 0);
+        }
 
         if (is_aligned) {
             // -- 对齐：执行零拷贝 --
@@ -132,8 +141,7 @@ bool ParamLoader::load(mllm::Tensor *tensor) {
 
             // 因为 fp_ 现在是有效的，我们可以直接使用普通加载逻辑
             auto *p = tensor->hostPtr<char>();
-            fseek(fp_, offset_info.first, SEEK_SET);
-            auto _ = fread(p, sizeof(uint8_t), tensor->cntSize(), fp_);
+            readAt(p, offset_info.first, tensor->cntSize());
         }
 
         return true;
@@ -154,8 +162,9 @@ ParamLoader::~ParamLoader() {
 // #ifdef ANDROID_API
 // ParamLoader::ParamLoader(std::string filename, AAssetManager *asset_manager,
 // bool use_mmap ):asset_manager_(asset_manager), #else
-ParamLoader::ParamLoader(std::string filename, bool use_mmap_param) :                                 // Renamed parameter
-    path_(std::move(filename)), use_mmap_(use_mmap_param), fp_(nullptr), buffer_(nullptr), size_(0) { // Initialize new members
+ParamLoader::ParamLoader(std::string filename, bool use_mmap_param, int load_threads) :               // Renamed parameter
+    path_(std::move(filename)), use_mmap_(use_mmap_param), fp_(nullptr), buffer_(nullptr), size_(0), // Initialize new members
+    load_threads_(std::max(1, load_threads)) {
 
     if (use_mmap_) {
         // --- 1. 打开文件并获取文件描述符，直接使用成员变量 fp_ ---
@@ -215,43 +224,27 @@ ParamLoader::ParamLoader(std::string filename, bool use_mmap_param) :
             ptr += sizeof(uint64_t); // 移动指针
             return val;
         };
-        auto mmap_readString = [&](uint8_t *&ptr) {
-            int len = mmap_readInt(ptr);
-            if (len == 0) return std::string("");
-            std::string str(reinterpret_cast<const char *>(ptr), len);
-            ptr += len; // 移动指针
-            return str;
-        };
-
         // 获取指向 mmap 区域开头的当前指针
         uint8_t *current_ptr = mmap_buffer_.get();
 
         // a. 读取并验证幻数
         int magic = mmap_readInt(current_ptr);
-        if (magic != _MAGIC_NUMBER) {
+        if (magic != _MAGIC_NUMBER && magic != _MAGIC_NUMBER_V2) {
             fprintf(stderr, "Mmap: magic number error\n");
             this->mmap_buffer_.reset(); // 释放 shared_ptr，触发 munmap
             use_mmap_ = false;
             return;
         }
+        if (magic == _MAGIC_NUMBER_V2) {
+            version_ = 2;
+            alignment_ = (uint32_t)mmap_readInt(current_ptr);
+        }
 
         // b. 读取索引区域的总长度
         uint64_t index_size = mmap_readu64(current_ptr);
 
-        // c. 计算索引区域的结束地址
-        uint8_t *index_end_ptr = current_ptr + index_size;
-
-        // d. 循环读取所有张量的元信息，直到遍历完整个索引区域
-        while (current_ptr < index_end_ptr) {
-            std::string name = mmap_readString(current_ptr);
-            uint64_t length = mmap_readu64(current_ptr);
-            uint64_t offset_in_file = mmap_readu64(current_ptr);
-
-            // 将解析出的信息存入 map
-            offsets_[name] = std::make_pair(offset_in_file, length);
-            data_type_[name] = static_cast<DataType>(mmap_readInt(current_ptr));
-        }
-
+        // c. 解析索引区域，索引直接在映射内存上读取
+        parseIndex(current_ptr, index_size);
     } else { // USE_MMAP is NOT defined
         // Original logic when USE_MMAP is not defined (ensures use_mmap_param is ignored)
         use_mmap_ = false; // Force false if USE_MMAP macro is not defined
@@ -266,24 +259,92 @@ ParamLoader::ParamLoader(std::string filename, bool use_mmap_param) :
         }
         fseek(fp_, 0, SEEK_SET);
         int magic = readInt(fp_);
-        if (magic != _MAGIC_NUMBER) {
+        if (magic != _MAGIC_NUMBER && magic != _MAGIC_NUMBER_V2) {
             fprintf(stderr, "File: magic number error\n");
             fclose(fp_);
             fp_ = nullptr;
             // exit(1);
             return;
         }
+        if (magic == _MAGIC_NUMBER_V2) {
+            version_ = 2;
+            alignment_ = (uint32_t)readInt(fp_);
+        }
+        // the whole index with a single pread
         uint64_t index_size = readu64(fp_);
-        uint64_t index_offset = index_size + ftell(fp_);
-        while (ftell(fp_) < index_offset) {
-            std::string name = readString(fp_);
-            uint64_t length = readu64(fp_);
-            uint64_t offset = readu64(fp_);
-            offsets_[name] = std::make_pair(offset, length);
-            data_type_[name] = readInt(fp_);
+        std::vector<uint8_t> index(index_size);
+        if (pread(fileno(fp_), index.data(), index_size, ftell(fp_)) != (ssize_t)index_size) {
+            fprintf(stderr, "File: truncated index\n");
+            fclose(fp_);
+            fp_ = nullptr;
+            return;
         }
+        parseIndex(index.data(), index_size);
     }
 }
+void ParamLoader::parseIndex(const uint8_t *ptr, uint64_t index_size) {
+    const uint8_t *end = ptr + index_size;
+    auto read = [&](void *dst, size_t n) {
+        memcpy(dst, ptr, n);
+        ptr += n;
+    };
+    while (ptr < end) {
+        int32_t name_len;
+        read(&name_len, sizeof(int32_t));
+        std::string name(reinterpret_cast<const char *>(ptr), name_len);
+        ptr += name_len;
+        uint64_t length, offset;
+        int32_t type;
+        read(&length, sizeof(uint64_t));
+        read(&offset, sizeof(uint64_t));
+        read(&type, sizeof(int32_t));
+        offsets_[name] = std::make_pair(offset, length);
+        data_type_[name] = type;
+    }
+    for (auto &[name, info] : offsets_) {
+        file_order_.push_back(info);
+    }
+    std::sort(file_order_.begin(), file_order_.end());
+}
+
+bool ParamLoader::readAt(void *dst, uint64_t offset, uint64_t size) {
+    const uint64_t chunk = 4UL * 1024 * 1024;
+    const int64_t n_chunks = (size + chunk - 1) / chunk;
+    const int fd = fileno(fp_);
+    std::atomic<bool> ok{true};
+    // one reader per chunk at most, a small tensor does not wake the whole team
+    const int threads = (int)std::min<int64_t>(load_threads_, n_chunks);
+#pragma omp parallel for num_threads(threads) if (threads > 1)
+    for (int64_t c = 0; c < n_chunks; ++c) {
+        uint64_t begin = c * chunk;
+        uint64_t left = std::min(chunk, size - begin);
+        auto *p = static_cast<char *>(dst) + begin;
+        while (left > 0) {
+            ssize_t n = pread(fd, p, left, offset + begin);
+            if (n <= 0) {
+                ok = false;
+                break;
+            }
+            p += n;
+            begin += n;
+            left -= n;
+        }
+    }
+    loaded_bytes_ += size;
+    return ok;
+}
+
+void ParamLoader::readAhead(uint64_t offset) {
+    if (load_threads_ <= 1) {
+        return;
+    }
+    // the next tensor in the file is usually the next one loaded, start its I/O now
+    auto next = std::upper_bound(file_order_.begin(), file_order_.end(), std::make_pair(offset, UINT64_MAX));
+    if (next != file_order_.end()) {
+        posix_fadvise(fileno(fp_), next->first, next->second, POSIX_FADV_WILLNEED);
+    }
+}
+
 bool ParamLoader::load(std::shared_ptr<mllm::Tensor> tensor) {
     return load(tensor.get());
 }
@@ -299,8 +360,7 @@ vector<std::string> ParamLoader::getParamNames() {
 std::tuple<uint8_t *, uint64_t> ParamLoader::load(string name) {
     auto [offset, length] = offsets_[name];
     auto *data = new uint8_t[length];
-    fseek(fp_, offset, SEEK_SET);
-    auto _ = fread(data, sizeof(uint8_t), length, fp_);
+    readAt(data, offset, length);
     return std::make_tuple(data, length);
 }
 
@@ -373,9 +433,12 @@ void MultiFileParamLoader::load_file(const string &filename) {
     }
 
     int magic = readInt(fp);
-    if (magic != _MAGIC_NUMBER) {
+    if (magic != _MAGIC_NUMBER && magic != _MAGIC_NUMBER_V2) {
         throw std::runtime_error("Open file " + filename + "error: Magic number error");
     }
+    if (magic == _MAGIC_NUMBER_V2) {
+        readInt(fp); // alignment, offsets are absolute
+    }
 
     uint64_t index_size = readu64(fp);
     uint64_t index_end = index_size + ftell(fp);
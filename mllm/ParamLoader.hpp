@@ -6,8 +6,10 @@
 #include <utility>
 #include "Tensor.hpp"
 #include "Types.hpp"
+#include <atomic>
 #include <initializer_list>
 #include <mutex>
+#include <vector>
 #define mllm_file FILE
 
 namespace mllm {
@@ -46,6 +48,14 @@ static std::string readString(mllm_file *fp_) {
 }
 
 #define _MAGIC_NUMBER 20012
+/*
+ * v2: Magic(INT) | Alignment(INT) | Index Len(UINT64) | Index (same items as v1) | Weights Contents
+ * Every tensor starts at a multiple of Alignment (64 or the page size), so an mmap-ed file
+ * can hand out pointers into the mapping for every tensor and the index is one contiguous read.
+ */
+#define _MAGIC_NUMBER_V2 20014
+#define _MLLM_V2_HEADER_SIZE 16
+#define _MLLM_V2_ALIGNMENT 4096
 /**
  * \brief The AbstructLoader abstract class provides an interface for loading parameters.
  */
@@ -62,6 +72,10 @@ public:
     virtual DataType getDataType(string name) {
         return MLLM_TYPE_COUNT;
     }
+    // bytes read from storage so far (zero-copy mmap loads are not counted)
+    virtual uint64_t loadedBytes() const {
+        return 0;
+    }
     // virtual bool partialLoad(mllm::Tensor *tensor, std::set<int> validRow, int rowNum, int colNum) = 0;
 };
 
@@ -77,7 +91,9 @@ class ParamLoader : public AbstructLoader {
     friend class QuantWriter;
 
 public:
-    ParamLoader(std::string filename, bool use_mmap = false);
+    // load_threads > 1 splits every tensor read into chunks read concurrently with pread and
+    // reads ahead the next tensor of the file while the caller builds its op
+    ParamLoader(std::string filename, bool use_mmap = false, int load_threads = 1);
 
 #ifdef USE_MMAP
     ParamLoader(void *buffer);
@@ -95,18 +111,31 @@ public:
     vector<std::string> getParamNames();
     std::tuple<uint8_t *, uint64_t> load(string name);
     DataType getDataType(string name) override;
+    uint64_t loadedBytes() const override {
+        return loaded_bytes_;
+    }
     bool isAvailible() const {
         return fp_ != nullptr && !offsets_.empty();
     }
     unsigned int getParamSize() const {
         return offsets_.size();
     }
+    // 1 for the packed v1 layout, 2 for the aligned layout
+    int getVersion() const {
+        return version_;
+    }
 
     ParamMetadata getParamMetadata(const std::string &name);
     FILE *getInputStream();
     std::string getParamPath() const;
 
 protected:
+    // fill offsets_/data_type_ from an index held in memory
+    void parseIndex(const uint8_t *ptr, uint64_t index_size);
+    // pread [offset, offset + size) into dst; no shared file position, so no lock either
+    bool readAt(void *dst, uint64_t offset, uint64_t size);
+    void readAhead(uint64_t offset);
+
     std::mutex mtx;
     mllm_file *fp_;
     uint8_t *buffer_;
@@ -116,6 +145,11 @@ protected:
     std::map<std::string, int> data_type_;
     bool use_mmap_;
     std::shared_ptr<uint8_t> mmap_buffer_;
+    int version_ = 1;
+    uint64_t alignment_ = 1;
+    int load_threads_ = 1;
+    std::atomic<uint64_t> loaded_bytes_{0};
+    std::vector<std::pair<uint64_t, uint64_t>> file_order_; // (offset, length) sorted by offset
 };
 
 /**
@@ -15,7 +15,10 @@
 #pragma once
 
 #include "Types.hpp"
+#include <cstdint>
 #include <string>
+#include <vector>
+#include <utility>
 
 namespace mllm {
 
@@ -136,4 +139,141 @@ private:
     unsigned int last_draft_length_ = 0;
 };
 
+/**
+ * @brief State of a continuous-batching step (see BatchScheduler).
+ *
+ * Every batch row is an independent sequence. All rows advance the KV cache by the same
+ * number of physical positions per step, so a row may hold positions that do not belong
+ * to its sequence (left padding, positions written before the sequence was admitted).
+ * CPUSoftMax masks those out with kv_valid, CPURoPE rotates each row at its logical
+ * position `physical - position_shift[row]`. CPUKVCache then applies kv_moves: the K/V a
+ * decoding row wrote at the end of the step is moved down to the row's own next free position.
+ */
+class BatchingStateManager : public StateManager {
+public:
+    std::string name() const override {
+        return "BatchingStateManager";
+    }
+    void reset() override {
+        active_ = false;
+        step_start_ = 0;
+        position_shift_.clear();
+        kv_valid_.clear();
+        kv_moves_.clear();
+    }
+
+    void setActive(bool active) {
+        active_ = active;
+    }
+    bool isActive() const {
+        return active_;
+    }
+    // physical KV position of the first token of the current step
+    void setStepStart(int step_start) {
+        step_start_ = step_start;
+    }
+    int getStepStart() const {
+        return step_start_;
+    }
+    std::vector<int> &positionShift() {
+        return position_shift_;
+    }
+    std::vector<std::vector<uint8_t>> &kvValid() {
+        return kv_valid_;
+    }
+    bool isKeyValid(int row, int pos) const {
+        return row < (int)kv_valid_.size() && pos < (int)kv_valid_[row].size() && kv_valid_[row][pos];
+    }
+    // physical KV position `from` of batch row `row` moves to `to` once the step has written it
+    struct KVMove {
+        int row;
+        int from;
+        int to;
+    };
+    std::vector<KVMove> &kvMoves() {
+        return kv_moves_;
+    }
+
+private:
+    bool active_ = false;
+    int step_start_ = 0;
+    std::vector<int> position_shift_;
+    std::vector<std::vector<uint8_t>> kv_valid_;
+    std::vector<KVMove> kv_moves_;
+};
+
+/**
+ * @brief Vocabulary shortlist of the LM head (see CPULMHead).
+ *
+ * While enabled, a decode step computes logits only for the shortlist (frequent tokens); the other
+ * logits are -inf. When the largest shortlist probability (softmax over the shortlist) is below
+ * `confidence`, the step falls back to the full vocabulary. Approximate: meant for greedy / top-k
+ * decoding. A step with allowed tokens (e.g. from a grammar) computes exactly those instead, or
+ * masks the full vocabulary to them when the step is computed in full.
+ */
+class LMHeadStateManager : public StateManager {
+public:
+    std::string name() const override {
+        return "LMHeadStateManager";
+    }
+    void reset() override {
+        enabled_ = false;
+        shortlist_.clear();
+        allowed_.clear();
+        confidence_ = 0.9f;
+        shortlist_steps_ = 0;
+        fallback_steps_ = 0;
+    }
+
+    void setEnabled(bool enabled) {
+        enabled_ = enabled;
+    }
+    bool isEnabled() const {
+        return enabled_ && (!shortlist_.empty() || !allowed_.empty());
+    }
+    // frequent tokens; BPE vocabularies roughly order ids by merge rank, so the first n ids are a start
+    void setShortlist(std::vector<int> tokens) {
+        shortlist_ = std::move(tokens);
+    }
+    void setShortlistFirst(int n) {
+        shortlist_.resize(n);
+        for (int i = 0; i < n; ++i) {
+            shortlist_[i] = i;
+        }
+    }
+    const std::vector<int> &shortlist() const {
+        return shortlist_;
+    }
+    // tokens allowed for the next step only
+    void setAllowed(std::vector<int> tokens) {
+        allowed_ = std::move(tokens);
+    }
+    std::vector<int> &allowed() {
+        return allowed_;
+    }
+    void setConfidence(float confidence) {
+        confidence_ = confidence;
+    }
+    float confidence() const {
+        return confidence_;
+    }
+    void countStep(bool fallback) {
+        (fallback ? fallback_steps_ : shortlist_steps_)++;
+    }
+    uint64_t shortlistSteps() const {
+        return shortlist_steps_;
+    }
+    uint64_t fallbackSteps() const {
+        return fallback_steps_;
+    }
+
+private:
+    bool enabled_ = false;
+    std::vector<int> shortlist_;
+    std::vector<int> allowed_;
+    float confidence_ = 0.9f;
+    uint64_t shortlist_steps_ = 0;
+    uint64_t fallback_steps_ = 0;
+};
+
 } // namespace mllm
@@ -0,0 +1,74 @@
+#include "StreamingLoader.hpp"
+#include "Op.hpp"
+#include "Timing.hpp"
+
+namespace mllm {
+
+StreamingLoader::~StreamingLoader() {
+    stop_ = true;
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void StreamingLoader::enqueue(Op *op) {
+    // the load pass may run the model more than once, every op is loaded once
+    if (position_.emplace(op, ops_.size()).second) {
+        ops_.push_back(op);
+    }
+    // runOp waits on the loader of the op's own model, not on whichever model ran last
+    op->streamingLoader() = this;
+}
+
+void StreamingLoader::start() {
+    start_us_ = mllm_time_us();
+    thread_ = std::thread(&StreamingLoader::run, this);
+}
+
+void StreamingLoader::run() {
+    for (size_t i = 0; i < ops_.size() && !stop_; ++i) {
+        ops_[i]->load(*loader_);
+        end_us_.store(mllm_time_us(), std::memory_order_release);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            loaded_.store(i + 1, std::memory_order_release);
+        }
+        cv_.notify_all();
+    }
+}
+
+void StreamingLoader::wait(Op *op) {
+    if (done()) {
+        return;
+    }
+    auto it = position_.find(op);
+    if (it == position_.end()) {
+        return;
+    }
+    size_t need = it->second + 1;
+    if (loaded_.load(std::memory_order_acquire) >= need) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [&] { return loaded_.load(std::memory_order_acquire) >= need; });
+}
+
+void StreamingLoader::load(Op *op, AbstructLoader &loader) {
+    auto it = position_.find(op);
+    bool pending = it != position_.end() && loaded_.load(std::memory_order_acquire) <= it->second;
+    if (pending && thread_.joinable()) {
+        // reading op here as well would race the loader thread, which reaches it in order
+        wait(op);
+        return;
+    }
+    // not queued, freed after the thread loaded it, or the thread has not started yet
+    op->load(loader);
+}
+
+void StreamingLoader::waitAll() {
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+} // namespace mllm
@@ -0,0 +1,71 @@
+#ifndef MLLM_STREAMINGLOADER_H
+#define MLLM_STREAMINGLOADER_H
+
+#include "ParamLoader.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace mllm {
+
+class Op;
+
+/**
+ * @brief Loads the weights of a model on a background thread while it already runs.
+ *
+ * During the load pass of Module::load ops are only queued, in the order the model reaches
+ * them (embedding, layer 0, layer 1, ...). After the pass one thread calls Op::load for every
+ * queued op in that order and CPUBackend::runOp waits for an op only if the forward gets
+ * ahead of the loader, so the first layers already prefill while the last ones are read.
+ * Each queued op points back at its loader (Op::streamingLoader), so several models can
+ * stream at the same time.
+ *
+ * The same idea as projection_loading_thread_func in models/ling/mbp, for all ops of any model.
+ */
+class StreamingLoader {
+public:
+    explicit StreamingLoader(std::shared_ptr<AbstructLoader> loader) :
+        loader_(std::move(loader)) {
+    }
+    ~StreamingLoader();
+
+    // load pass: remember op, it is loaded later in queue order
+    void enqueue(Op *op);
+    void start();
+    // block until op is loaded; ops that were never queued return at once
+    void wait(Op *op);
+    // Layer::load of op: waits if the thread has still to load it, else loads it here
+    void load(Op *op, AbstructLoader &loader);
+    void waitAll();
+
+    bool done() const {
+        return loaded_.load(std::memory_order_acquire) == ops_.size();
+    }
+    // time from start() until the last op was loaded
+    double loadTimeMs() const {
+        return (end_us_.load(std::memory_order_acquire) - start_us_) / 1000.0;
+    }
+
+private:
+    void run();
+
+    std::shared_ptr<AbstructLoader> loader_;
+    std::vector<Op *> ops_;
+    std::unordered_map<Op *, size_t> position_;
+    std::atomic<size_t> loaded_{0};
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::thread thread_;
+    std::atomic<bool> stop_{false};
+    int64_t start_us_ = 0;
+    std::atomic<int64_t> end_us_{0}; // written by the loader thread, read by profiling()
+};
+
+} // namespace mllm
+
+#endif // MLLM_STREAMINGLOADER_H
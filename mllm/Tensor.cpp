@@ -726,6 +726,12 @@ Tensor Tensor::flash_attention2_forward(Tensor q, Tensor k, Tensor v, bool causa
     return runFunc({q.name() + "-" + k.name() + "-fa2"}, F_FA2, param,
                    {q, k, v})[0];
 };
+Tensor Tensor::flash_attention2_varlen_forward(Tensor q, Tensor k, Tensor v, Tensor cu_seqlens, bool causal_mask) {
+    OpParam param;
+    param["causal_mask"] = causal_mask ? 1.0f : 0.0f;
+    return runFunc({q.name() + "-" + k.name() + "-fa2_varlen"}, F_FA2, param,
+                   {q, k, v, cu_seqlens})[0];
+};
 Tensor Tensor::sage_attention_forward(Tensor q, Tensor k, Tensor v, bool causal_mask) {
     Module *module = q.module();
     OpParam param;
@@ -655,14 +655,14 @@ public:
             impl_->chls()[TIME] = 1;
             impl_->chls()[HEIGHT] = 2;
             impl_->chls()[WIDTH] = 3;
-            impl_->chls()[CHANNLE] = 3;
+            impl_->chls()[CHANNLE] = 4;
             break;
         case BCTHW:
             impl_->chls()[BATCH] = 0;
             impl_->chls()[CHANNLE] = 1;
             impl_->chls()[TIME] = 2;
             impl_->chls()[HEIGHT] = 3;
-            impl_->chls()[WIDTH] = 3;
+            impl_->chls()[WIDTH] = 4;
             break;
         default:
             break;
@@ -910,6 +910,8 @@ public:
     static Tensor gather(Tensor input, Tensor index, Chl dim);
     static Tensor zero_like(Tensor input);
     static Tensor flash_attention2_forward(Tensor q, Tensor k, Tensor v, bool is_causal = true);
+    // attention restricted to the segments [cu_seqlens[i], cu_seqlens[i+1]) of the sequence (BSHD)
+    static Tensor flash_attention2_varlen_forward(Tensor q, Tensor k, Tensor v, Tensor cu_seqlens, bool is_causal = false);
     static Tensor sage_attention_forward(Tensor q, Tensor k, Tensor v, bool causal_mask = false);
     static Tensor apply_rotary_pos_emb_vision(Tensor input, Tensor rotary_pos_emb);
 
@@ -1006,6 +1008,44 @@ public:
         return shape_master_;
     }
 
+    /**
+     * @brief Called by the op that (re)wrote this activation: drops the previous quantized copy and lets
+     * mat_mul keep the one it makes, so the GEMMs reading this tensor quantize it only once.
+     */
+    void shareQuantizedCopy() {
+        impl_->share_quantized_ = true;
+        impl_->quantized_.reset();
+    }
+    // a copy made before the tensor was last written is never returned
+    std::shared_ptr<Tensor> quantizedCopy(DataType dtype, int interleave) const {
+        auto &q = impl_->quantized_;
+        if (q != nullptr && q->dtype() == dtype && impl_->quantized_interleave_ == interleave && q->shape() == shape()
+            && impl_->quantized_version_ == impl_->version_) {
+            return q;
+        }
+        return nullptr;
+    }
+    // false if the copy is not kept (the producer did not ask for it)
+    bool setQuantizedCopy(std::shared_ptr<Tensor> copy, int interleave) {
+        if (!impl_->share_quantized_ || masterTensor() != nullptr) {
+            return false;
+        }
+        impl_->quantized_ = std::move(copy);
+        impl_->quantized_interleave_ = interleave;
+        impl_->quantized_version_ = impl_->version_;
+        return true;
+    }
+    /**
+     * @brief Marks the data as rewritten; CPUBackend::runOp calls it for the outputs of every op it
+     * runs (in-place ones included). A view also bumps its master, whose memory it wrote.
+     */
+    void bumpVersion() {
+        ++impl_->version_;
+        if (auto master = masterTensor()) {
+            ++master->impl_->version_;
+        }
+    }
+
     std::shared_ptr<Tensor> masterTensor() const {
         return master_tensor_.lock();
     }
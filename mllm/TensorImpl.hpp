@@ -19,6 +19,7 @@
 namespace mllm {
 class Backend;
 class Module;
+class Tensor;
 
 enum DeviceMemType {
     MEM_TYPE_GENERIC,  // 通用设备指针 (可用于 CUDA 的 `cudaMalloc` 结果)
@@ -79,6 +80,14 @@ public:
     bool undiffusion_ = false;
     vector<std::pair<Chl, Chl>> trans_from_;
 
+    // vec_dot_type copy of this F32 activation, made by the first mat_mul that reads it and reused by the
+    // next ones (q/k/v, gate/up); only kept when the producing op asked for it with Tensor::shareQuantizedCopy()
+    bool share_quantized_ = false;
+    std::shared_ptr<Tensor> quantized_;
+    int quantized_interleave_ = 0; // 0: row by row, else the from_float_to_mat interleave
+    uint64_t version_ = 0;           // bumped by every op that writes this tensor (see Tensor::bumpVersion)
+    uint64_t quantized_version_ = 0; // version_ when quantized_ was made
+
     Module *module_ = nullptr;
 
     // 构造函数
@@ -141,6 +150,7 @@ public:
         }
         host_ptr_ = nullptr;
         allocated_ = 0;
+        quantized_.reset();
     }
 
     void unload() {
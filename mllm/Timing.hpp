@@ -6,22 +6,30 @@
 #define MLLM_TIMING_HPP
 
 #include <chrono>
+#include <cstdint>
 
 namespace mllm {
 
+// steady_clock: monotonic, intervals stay valid when the wall clock is adjusted (NTP, suspend)
 inline void mllm_time_init(void) {}
 inline int64_t mllm_time_ms(void) {
-    auto now = std::chrono::system_clock::now();
+    auto now = std::chrono::steady_clock::now();
     auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch());
     return ms.count();
 }
 
 inline int64_t mllm_time_us(void) {
-    auto now = std::chrono::system_clock::now();
+    auto now = std::chrono::steady_clock::now();
     auto us = std::chrono::duration_cast<std::chrono::microseconds>(now.time_since_epoch());
     return us.count();
 }
 
+inline int64_t mllm_time_ns(void) {
+    auto now = std::chrono::steady_clock::now();
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch());
+    return ns.count();
+}
+
 }
 
 #endif // MLLM_TIMING_HPP
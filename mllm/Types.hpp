@@ -31,6 +31,15 @@ inline int KVCache_Type_eager = 32;
 #endif
 inline int KVCacheSageDtypeBit = 8; // 8 or 16
 inline int KVCache_batch = 1;
+// > 0: CPUKVCache reserves its cache in pages of this many tokens and grows on demand (doubling,
+// in whole pages, up to `cache_max`) instead of allocating `cache_max` tokens up front.
+inline int KVCache_page_size = 0;
+// MultiHeadAttention runs q/k rope and the k/v cache append as one ROPEKVCACHE op (flash_attention_2).
+inline bool KVCache_fused_rope = true;
+// CPUSwiGLU interleaves separate gate_proj / up_proj weights into one tensor at load time (a copy of
+// the MLP weights, no zero-copy mmap). Off: they are used in place; the quantizer's `swiglu` flag
+// writes the interleaved tensor once offline.
+inline bool SwiGLU_interleave_on_load = false;
 typedef enum {
     MLLM_CPU,
     MLLM_OPENCL,
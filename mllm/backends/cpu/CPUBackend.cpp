@@ -8,13 +8,19 @@
 #include <memory>
 #include "Backend.hpp"
 #include "OpDefined.hpp"
+#include "OpTracer.hpp"
+#include "CPUThreadPool.hpp"
 #include "Types.hpp"
 // #include "memory/SystemMemoryManager.hpp"
 // #include <memory/MemoryPoolManager.hpp>
 #include <string>
 #include "Layer.hpp"
+#include "memory/StaticMemoryPlanner.hpp"
 
 #include "op/CPUHeadLinear.hpp"
+#include "op/CPUSwiGLU.hpp"
+#include "op/CPURoPEKVCache.hpp"
+#include "op/CPULMHead.hpp"
 #include "op/CPULinearInt8.hpp"
 #include "op/CPUMultimodalRoPEPipeline.hpp"
 #include "op/CPUNTKRoPE.hpp"
@@ -27,6 +33,7 @@
 #include "op/CPUSlidingWindowMask.hpp"
 #include "op/CPUMatmul.hpp"
 #include "op/CPURMSNorm.hpp"
+#include "op/CPUAddRMSNorm.hpp"
 #include "op/CPURoPE.hpp"
 #include "op/CPURoPETree.hpp"
 #include "op/CPUScale.hpp"
@@ -137,6 +144,7 @@ Op *CPUBackend::opCreate(const OpParam &op_param, string name, int threadCount)
         return nullptr;
     }
     Op *exe = iter->second->create(op_param, this, name, cpu_threads);
+    exe->setOpType(optype);
     return exe;
 }
 void CPUBackend::registerOps() {
@@ -197,6 +205,10 @@ void CPUBackend::registerOps() {
     addCreator(XP_KVCACHE, (CPUBackend::Creator *)(new CPUKVCacheXpCreator()));
     addCreator(NTKROPE, (CPUBackend::Creator *)(new CPUNTKRoPECreator()));
     addCreator(HEADLINEAR, (CPUBackend::Creator *)(new CPUHeadLinearCreator()));
+    addCreator(SWIGLU, (CPUBackend::Creator *)(new CPUSwiGLUCreator()));
+    addCreator(ROPEKVCACHE, (CPUBackend::Creator *)(new CPURoPEKVCacheCreator()));
+    addCreator(LMHEAD, (CPUBackend::Creator *)(new CPULMHeadCreator()));
+    addCreator(ADDRMSNORM, (CPUBackend::Creator *)(new CPUAddRMSNormCreator()));
     addCreator(KVCACHESAGE, (CPUBackend::Creator *)(new CPUKVCacheSageCreator()));
     addCreator(SIGMOID, (CPUBackend::Creator *)(new CPUSigmoidCreator()));
 
@@ -256,6 +268,16 @@ void CPUBackend::registerFuncs() {
 };
 
 int CPUBackend::cpu_threads = 4;
+int CPUBackend::cpu_core_set = CPUThreadPool::ALL_CORES;
+
+void CPUBackend::configureThreads(int threads, int core_set) {
+    cpu_threads = std::max(threads, 1);
+    cpu_core_set = core_set;
+    auto set = (CPUThreadPool::CoreSet)core_set;
+    CPUThreadPool::instance().configure(cpu_threads, set == CPUThreadPool::ALL_CORES ? std::vector<int>{} : CPUThreadPool::coresOf(set));
+}
+bool CPUBackend::use_decode_plan = false;
+bool CPUBackend::use_decode_plan_arena = false;
 
 void CPUBackend::convert_fp_data(Tensor *src, Tensor *dest) {
     // 根据源和目标的类型，执行相应的CPU循环转换
@@ -351,33 +373,56 @@ std::vector<Tensor> CPUBackend::runOp(Op *op, std::vector<Tensor> inputs, std::v
 #ifdef DEBUGOPTIME
     uint64_t time_start = mllm_time_us();
 #endif
+    const bool tracing = OpTracer::enabled();
+    const int64_t trace_start = tracing ? mllm_time_ns() : 0;
+    if (auto *streaming = op->streamingLoader()) {
+        // weights still being streamed in: wait only if this op is ahead of the loader
+        streaming->wait(op);
+        if (streaming->done()) {
+            op->streamingLoader() = nullptr;
+        }
+    }
     vector<shared_ptr<Tensor>> input_tensors;
     for (auto &input : inputs) {
         input_tensors.push_back(std::shared_ptr<Tensor>(&input, [](Tensor *) {}));
     }
     vector<shared_ptr<Tensor>> out_tensors;
-    // Part 1: Create tensor shells
-    if (!in_place) {
-        _create_output_tensors(out_tensors, input_tensors, out_names, module, activation_tensors, op->backend());
-    } else {
-        // If in-place, we already have out_tensors filled with input tensors.
-        for (size_t i = 0; i < input_tensors.size() && i < out_names.size(); ++i) {
-            input_tensors[i]->setName(out_names[i]);
-            out_tensors.push_back(input_tensors[i]);
+    if (!(decode_plan_active_ && _replay_decode_step(op, input_tensors, out_names.size(), out_tensors))) {
+        bool aggregated_input = input_tensors.size() == 1 && !input_tensors[0]->aggregatedTensors().empty();
+        vector<shared_ptr<Tensor>> templates;
+        // Part 1: Create tensor shells
+        if (!in_place) {
+            _create_output_tensors(out_tensors, input_tensors, out_names, module, activation_tensors, op->backend());
+        } else {
+            // If in-place, we already have out_tensors filled with input tensors.
+            for (size_t i = 0; i < input_tensors.size() && i < out_names.size(); ++i) {
+                input_tensors[i]->setName(out_names[i]);
+                out_tensors.push_back(input_tensors[i]);
+            }
         }
-    }
-    // Part 2: Reshape the tensors
-    op->reshape(input_tensors, out_tensors);
-    // Part 3: Allocate memory
-    if (!in_place) {
-        for (auto &out_tensor : out_tensors) {
-            auto act_it = activation_tensors.find(out_tensor->name());
-            auto template_it = act_it != activation_tensors.end() ? act_it->second : nullptr;
-            out_tensor->allocFromTemplate(template_it);
+        // Part 2: Reshape the tensors
+        op->reshape(input_tensors, out_tensors);
+        // Part 3: Allocate memory
+        if (!in_place) {
+            for (auto &out_tensor : out_tensors) {
+                auto act_it = activation_tensors.find(out_tensor->name());
+                auto template_it = act_it != activation_tensors.end() ? act_it->second : nullptr;
+                out_tensor->allocFromTemplate(template_it);
+                templates.push_back(template_it);
+            }
+        }
+        // Part 4: Execute the operation
+        op->execute(input_tensors, out_tensors);
+        if (decode_plan_active_ && !decode_plan_captured_) {
+            _capture_decode_step(op, in_place, aggregated_input, input_tensors, templates, out_tensors);
         }
     }
-    // Part 4: Execute the operation
-    op->execute(input_tensors, out_tensors);
+    for (auto &out_tensor : out_tensors) {
+        out_tensor->bumpVersion();
+    }
+    if (tracing) {
+        OpTracer::instance().recordOp(op, input_tensors, out_tensors, trace_start, mllm_time_ns());
+    }
 
 #ifdef DEBUGOPTIME
     uint64_t time_end = mllm_time_us();
@@ -404,6 +449,189 @@ std::vector<Tensor> CPUBackend::runOp(Op *op, std::vector<Tensor> inputs, std::v
     return results;
 }
 
+/**
+ * @brief Starts a (possibly replayed) decode step. Only 1-token steps use the plan, any
+ * other input (prefill, chunked prefill) drops the captured plan.
+ */
+void CPUBackend::_begin_decode_plan(std::vector<Tensor> &inputs) {
+    if (!use_decode_plan || inputs.empty()) {
+        return;
+    }
+    if (inputs[0].sequence() != 1 || (decode_plan_captured_ && decode_plan_batch_ != inputs[0].batch())) {
+        resetDecodePlan();
+        if (inputs[0].sequence() != 1) {
+            return;
+        }
+    }
+    decode_plan_batch_ = inputs[0].batch();
+    decode_plan_cursor_ = 0;
+    decode_plan_active_ = true;
+}
+
+void CPUBackend::_end_decode_plan(const std::vector<Tensor> &outputs) {
+    if (!decode_plan_active_) {
+        return;
+    }
+    if (!decode_plan_captured_) {
+        // the caller keeps what the step returns: the ops producing it take the normal path and
+        // allocate new outputs every step instead of overwriting the last ones
+        for (auto &step : decode_plan_) {
+            for (size_t o = 0; step.replayable && o < step.output_ptrs.size(); ++o) {
+                auto begin = reinterpret_cast<uintptr_t>(step.output_ptrs[o]);
+                auto end = begin + step.output_bytes[o];
+                for (const auto &output : outputs) {
+                    auto addr = reinterpret_cast<uintptr_t>(output.rawHostPtr());
+                    if (begin != 0 && addr >= begin && addr < end) {
+                        step.replayable = false;
+                        step.templates.clear();
+                        step.outputs.clear();
+                        break;
+                    }
+                }
+            }
+        }
+        decode_plan_captured_ = true;
+    } else if (decode_plan_cursor_ != decode_plan_.size()) {
+        // the step ran fewer ops than captured, the plan no longer describes the model
+        resetDecodePlan();
+    } else if (use_decode_plan_arena && decode_plan_arena_ == nullptr) {
+        // first replayed step: output sizes of the capture and the replay can be compared now
+        _plan_decode_arena();
+    }
+    decode_plan_active_ = false;
+}
+
+/**
+ * @brief Static activation memory planning for the decode plan. Outputs with the same size in the
+ * capture step and the first replayed step are static; each of them lives from the step producing it
+ * to the last step reading any address inside it (outputs never read stay alive to the end of the
+ * step; the ones returned to the caller are not replayed and never enter the arena). The StaticMemoryPlanner assigns arena offsets and the
+ * output shells are rebound to the arena, so replayed steps no longer touch the allocator for them.
+ * Outputs growing with the KV length keep their own (pool) buffers.
+ */
+void CPUBackend::_plan_decode_arena() {
+    struct Slot {
+        size_t step;
+        size_t out;
+    };
+    vector<Slot> slots;
+    vector<StaticMemoryPlanner::Request> requests;
+    const int end_step = static_cast<int>(decode_plan_.size());
+    for (size_t i = 0; i < decode_plan_.size(); ++i) {
+        auto &step = decode_plan_[i];
+        if (!step.replayable) {
+            continue;
+        }
+        for (size_t o = 0; o < step.outputs.size(); ++o) {
+            auto &out = step.outputs[o];
+            if (step.output_ptrs[o] == nullptr || out->cntSize() != step.output_bytes[o]
+                || out->rawHostPtr() != step.output_ptrs[o]) {
+                continue;
+            }
+            auto begin = reinterpret_cast<uintptr_t>(step.output_ptrs[o]);
+            auto end = begin + step.output_bytes[o];
+            int last_use = -1;
+            for (size_t j = i + 1; j < decode_plan_.size(); ++j) {
+                for (auto *ptr : decode_plan_[j].input_ptrs) {
+                    auto addr = reinterpret_cast<uintptr_t>(ptr);
+                    if (addr >= begin && addr < end) {
+                        last_use = static_cast<int>(j);
+                    }
+                }
+            }
+            slots.push_back({i, o});
+            requests.push_back({step.output_bytes[o], static_cast<int>(i), last_use < 0 ? end_step : last_use});
+        }
+    }
+    if (requests.empty()) {
+        return;
+    }
+    vector<size_t> offsets;
+    StaticMemoryPlanner planner(128);
+    size_t arena_bytes = planner.plan(requests, offsets);
+    void *arena = nullptr;
+    alloc(&arena, arena_bytes, 128);
+    // tensors bound to the arena keep it alive even after the plan is reset, or the backend is gone:
+    // the deleter holds the memory manager, not the backend
+    decode_plan_arena_ = std::shared_ptr<void>(arena, [mm = mem_manager_](void *ptr) { mm->free(ptr); });
+    decode_plan_arena_bytes_ = arena_bytes;
+    decode_plan_arena_planned_bytes_ = 0;
+    for (size_t k = 0; k < slots.size(); ++k) {
+        auto &step = decode_plan_[slots[k].step];
+        auto &out = step.outputs[slots[k].out];
+        out->setHostPtr(static_cast<char *>(arena) + offsets[k], decode_plan_arena_);
+        decode_plan_arena_planned_bytes_ += requests[k].size;
+    }
+}
+
+/**
+ * @brief Replays one captured step: the output shells and activation templates resolved in the
+ * capture step are reused, only reshape (the KV length grows every step), a size-checked alloc
+ * and execute are run.
+ * @return false if the normal runOp path must be taken for this call.
+ */
+bool CPUBackend::_replay_decode_step(Op *op, std::vector<std::shared_ptr<Tensor>> &input_tensors,
+                                     size_t out_size, std::vector<std::shared_ptr<Tensor>> &out_tensors) {
+    if (!decode_plan_captured_) {
+        return false;
+    }
+    if (decode_plan_cursor_ >= decode_plan_.size() || decode_plan_[decode_plan_cursor_].op != op) {
+        // op sequence diverged from the captured one, recapture on the next decode step
+        resetDecodePlan();
+        return false;
+    }
+    auto &step = decode_plan_[decode_plan_cursor_++];
+    if (!step.replayable || step.outputs.size() != out_size) {
+        return false;
+    }
+    out_tensors = step.outputs;
+    op->reshape(input_tensors, out_tensors);
+    for (size_t i = 0; i < out_tensors.size(); ++i) {
+        out_tensors[i]->allocFromTemplate(step.templates[i]);
+    }
+    op->execute(input_tensors, out_tensors);
+    return true;
+}
+
+/**
+ * @brief Records one runOp call of the capture step. Outputs that are views (KV cache slices,
+ * transposes of cache/weights), aggregated tensors or share memory with an input are rebuilt
+ * every step through the normal path.
+ */
+void CPUBackend::_capture_decode_step(Op *op, bool in_place, bool aggregated_input,
+                                      const std::vector<std::shared_ptr<Tensor>> &input_tensors,
+                                      const std::vector<std::shared_ptr<Tensor>> &templates,
+                                      const std::vector<std::shared_ptr<Tensor>> &out_tensors) {
+    DecodePlanStep step;
+    step.op = op;
+    for (const auto &input : input_tensors) {
+        step.input_ptrs.push_back(input->rawHostPtr());
+    }
+    for (const auto &out : out_tensors) {
+        step.output_ptrs.push_back(out->rawHostPtr());
+        step.output_bytes.push_back(out->cntSize());
+    }
+    step.replayable = !in_place && !aggregated_input && templates.size() == out_tensors.size();
+    for (size_t i = 0; step.replayable && i < out_tensors.size(); ++i) {
+        const auto &out = out_tensors[i];
+        const auto &tmpl = templates[i];
+        if (out->masterTensor() != nullptr || !out->aggregatedTensors().empty() || out->undiffusion()
+            || (tmpl != nullptr && (tmpl->masterTensor() != nullptr || !tmpl->aggregatedTensors().empty()))) {
+            step.replayable = false;
+        }
+        for (const auto &input : input_tensors) {
+            if (input->rawHostPtr() != nullptr && input->rawHostPtr() == out->rawHostPtr()) {
+                step.replayable = false;
+            }
+        }
+    }
+    if (step.replayable) {
+        step.templates = templates;
+        step.outputs = out_tensors;
+    }
+    decode_plan_.push_back(std::move(step));
+}
+
 std::vector<Tensor> CPUBackend::runLayer(Layer *layer, std::vector<Tensor> inputs, int N) {
     Module *module = inputs.empty() ? Module::llm_model_ptr : inputs[0].module();
     map<string, shared_ptr<Tensor>> &activation_tensors = module->activation_tensors;
@@ -422,6 +650,7 @@ std::vector<Tensor> CPUBackend::runForward(Module *module, std::vector<Tensor> i
         return outputs;
     }
     uint64_t time_start, time_end;
+    int64_t trace_start = 0;
     bool ouilter_flag = (inputs[0].ttype() == TensorType::INPUT_TENSOR);
     if (ouilter_flag) {
         for (int i = 0; i < inputs.size(); i++) {
@@ -436,17 +665,24 @@ std::vector<Tensor> CPUBackend::runForward(Module *module, std::vector<Tensor> i
             module->decoding_token_size_ = inputs[0].sequence() * inputs[0].batch();
         }
         time_start = mllm_time_us();
+        trace_start = OpTracer::enabled() ? mllm_time_ns() : 0;
 #ifdef DEBUGOPTIME
         op_inference_time_.clear();
 #endif
+        _begin_decode_plan(inputs);
+        CPUKVCache::reserveAll(inputs[0].sequence(), module);
     }
 
     auto output = module->Forward(inputs, args);
 
     if (ouilter_flag) {
+        _end_decode_plan(output);
         time_end = mllm_time_us();
         double inference_time_ = (time_end - time_start) / 1000.0F; // ms
         module->inference_times_.push_back(inference_time_);
+        if (trace_start != 0 && OpTracer::enabled()) {
+            OpTracer::instance().recordStep(inputs[0].sequence() > 1 ? "prefill" : "decode", trace_start, mllm_time_ns());
+        }
 #ifdef DEBUGOPTIME
         _print_op_inference_time(true);
         std::cout << "Token inference e2e time: " << inference_time_ << "ms" << std::endl;
@@ -45,6 +45,48 @@ public:
     std::vector<Tensor> runForward(Module *module, std::vector<Tensor> inputs, std::vector<std::any> args) override;
 
     static int cpu_threads;
+    // CPUThreadPool::CoreSet the workers run on; ALL_CORES leaves placement to the OS
+    static int cpu_core_set;
+    /**
+     * @brief Sets cpu_threads / cpu_core_set and restarts the worker pool with them (the workers of a
+     * restricted core set are pinned). Without this call the pool starts lazily on cpu_core_set.
+     */
+    static void configureThreads(int threads, int core_set = 0);
+
+    /**
+     * @brief Decode plan: when enabled, the first 1-token decode step records every runOp call
+     * (op, activation template, output shells). Later decode steps replay the recorded steps
+     * and skip the per-op output creation and activation_tensors name lookups. The plan is
+     * dropped whenever a prefill (sequence > 1) runs or the op sequence diverges.
+     * Replayed steps write into the same output buffers every token. The ops producing the tensors
+     * runForward returns are never replayed, so every step hands the caller fresh tensors; a
+     * tensor taken from inside Forward (e.g. a hook on a hidden state) is only valid until the
+     * next step and has to be copied to be kept.
+     * With use_decode_plan_arena, the outputs whose size does not change between decode steps are
+     * additionally placed into one arena by a liveness-based static memory planner.
+     */
+    static bool use_decode_plan;
+    static bool use_decode_plan_arena;
+    void resetDecodePlan() {
+        decode_plan_.clear();
+        decode_plan_cursor_ = 0;
+        decode_plan_captured_ = false;
+        decode_plan_active_ = false;
+        decode_plan_arena_.reset();
+        decode_plan_arena_bytes_ = 0;
+        decode_plan_arena_planned_bytes_ = 0;
+    }
+    size_t decodePlanSize() const {
+        return decode_plan_.size();
+    }
+    // peak activation memory of a decode step served from the arena (bytes)
+    size_t decodePlanArenaBytes() const {
+        return decode_plan_arena_bytes_;
+    }
+    // sum of the sizes of all arena tensors, i.e. the footprint without memory reuse (bytes)
+    size_t decodePlanArenaPlannedBytes() const {
+        return decode_plan_arena_planned_bytes_;
+    }
 
     // #ifdef USE_QNN
     void setCurSequenceLength(int sequence_length) {
@@ -121,6 +163,34 @@ private:
     unsigned int last_draft_length = 0;
     // #endif
 
+    struct DecodePlanStep {
+        Op *op = nullptr;
+        bool replayable = false;
+        vector<shared_ptr<Tensor>> templates;
+        vector<shared_ptr<Tensor>> outputs;
+        // recorded in the capture step for the liveness analysis
+        vector<void *> input_ptrs;
+        vector<void *> output_ptrs;
+        vector<size_t> output_bytes;
+    };
+    vector<DecodePlanStep> decode_plan_;
+    std::shared_ptr<void> decode_plan_arena_;
+    size_t decode_plan_arena_bytes_ = 0;
+    size_t decode_plan_arena_planned_bytes_ = 0;
+    void _plan_decode_arena();
+    size_t decode_plan_cursor_ = 0;
+    int decode_plan_batch_ = 0;
+    bool decode_plan_captured_ = false;
+    bool decode_plan_active_ = false;
+    void _begin_decode_plan(std::vector<Tensor> &inputs);
+    void _end_decode_plan(const std::vector<Tensor> &outputs);
+    bool _replay_decode_step(Op *op, std::vector<std::shared_ptr<Tensor>> &input_tensors,
+                             size_t out_size, std::vector<std::shared_ptr<Tensor>> &out_tensors);
+    void _capture_decode_step(Op *op, bool in_place, bool aggregated_input,
+                              const std::vector<std::shared_ptr<Tensor>> &input_tensors,
+                              const std::vector<std::shared_ptr<Tensor>> &templates,
+                              const std::vector<std::shared_ptr<Tensor>> &out_tensors);
+
     void _create_output_tensors(
         std::vector<std::shared_ptr<Tensor>> &out_tensors,
         const std::vector<std::shared_ptr<Tensor>> &input_tensors,
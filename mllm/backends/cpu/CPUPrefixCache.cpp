@@ -0,0 +1,245 @@
+#include "CPUPrefixCache.hpp"
+#include "op/CPUKVCache.hpp"
+#include "op/CPURoPE.hpp"
+#include "Log.h"
+#include "Types.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+namespace mllm {
+
+#define _PREFIX_CACHE_MAGIC 20013
+#define _PREFIX_CACHE_VERSION 1
+
+static constexpr uint64_t kHashSeed = 14695981039346656037ULL; // FNV-1a offset basis
+
+uint64_t CPUPrefixCache::hashStep(uint64_t hash, unsigned token) {
+    // FNV-1a over the 4 bytes of the token id
+    for (int i = 0; i < 4; ++i) {
+        hash ^= (token >> (8 * i)) & 0xff;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+size_t CPUPrefixCache::snapshotBytes(const CPUKVCache *cache, int len) {
+    size_t bytes = 0;
+    cache->forEachRow(len, [&](size_t, size_t row) { bytes += row; });
+    return bytes;
+}
+
+bool CPUPrefixCache::supported() const {
+    if (CPUKVCache::otherCaches().count(model_)) {
+        MLLM_LOG_ERROR_STREAM << "Prefix cache: SAGE / XP KV caches cannot be snapshot" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+std::vector<int> CPUPrefixCache::signature() const {
+    std::vector<int> sig;
+    for (auto *cache : CPUKVCache::cachesOf(model_)) {
+        auto &t = cache->cache_;
+        sig.insert(sig.end(), {t->batch(), t->head(), t->dimension(), (int)t->dtype(), (int)t->ctype()});
+    }
+    return sig;
+}
+
+bool CPUPrefixCache::insert(const std::vector<unsigned> &tokens) {
+    auto caches = CPUKVCache::cachesOf(model_);
+    int len = tokens.size();
+    if (len == 0 || caches.empty() || !supported()) {
+        return false;
+    }
+    Entry entry;
+    entry.hash = kHashSeed;
+    for (auto token : tokens) {
+        entry.hash = hashStep(entry.hash, token);
+    }
+    entry.tokens = tokens;
+    for (auto *cache : caches) {
+        if (cache->cache_seq_len_ < len || cache->cache_->count() == 0) {
+            return false;
+        }
+        std::vector<char> snapshot;
+        auto *base = (const char *)cache->cache_->rawHostPtr();
+        cache->forEachRow(len, [&](size_t offset, size_t bytes) {
+            snapshot.insert(snapshot.end(), base + offset, base + offset + bytes);
+        });
+        entry.bytes += snapshot.size();
+        entry.caches.push_back(std::move(snapshot));
+    }
+    add(std::move(entry));
+    return true;
+}
+
+int CPUPrefixCache::restore(const std::vector<unsigned> &tokens) {
+    if (!supported()) {
+        return 0;
+    }
+    auto caches = CPUKVCache::cachesOf(model_);
+    // keep at least one token to prefill, the next logits come from it
+    EntryList::iterator best = entries_.end();
+    uint64_t hash = kHashSeed;
+    for (size_t i = 0; i + 1 < tokens.size(); ++i) {
+        hash = hashStep(hash, tokens[i]);
+        auto it = index_.find(hash);
+        if (it == index_.end()) {
+            continue;
+        }
+        auto &tk = it->second->tokens;
+        if (tk.size() == i + 1 && std::equal(tk.begin(), tk.end(), tokens.begin())) {
+            best = it->second;
+        }
+    }
+    if (best == entries_.end() || best->caches.size() != caches.size()) {
+        return 0;
+    }
+    int len = best->tokens.size();
+    for (size_t c = 0; c < caches.size(); ++c) {
+        auto *cache = caches[c];
+        if (!cache->setCacheSeqLen(len)) {
+            for (auto *reset : caches) {
+                reset->clearCache();
+            }
+            return 0;
+        }
+        auto *base = (char *)cache->cache_->rawHostPtr();
+        const char *src = best->caches[c].data();
+        cache->forEachRow(len, [&](size_t offset, size_t bytes) {
+            memcpy(base + offset, src, bytes);
+            src += bytes;
+        });
+    }
+    for (auto *rope : CPURoPE::ropesOf(model_)) {
+        rope->h_cnt_ = len;
+    }
+    entries_.splice(entries_.begin(), entries_, best);
+    return len;
+}
+
+void CPUPrefixCache::add(Entry entry) {
+    auto it = index_.find(entry.hash);
+    if (it != index_.end()) {
+        bytes_ -= it->second->bytes;
+        entries_.erase(it->second);
+        index_.erase(it);
+    }
+    bytes_ += entry.bytes;
+    entries_.push_front(std::move(entry));
+    index_[entries_.front().hash] = entries_.begin();
+    evict();
+}
+
+void CPUPrefixCache::evict() {
+    // the entry just added is kept even if it alone exceeds the budget
+    while (bytes_ > max_bytes_ && entries_.size() > 1) {
+        auto &last = entries_.back();
+        bytes_ -= last.bytes;
+        index_.erase(last.hash);
+        entries_.pop_back();
+    }
+}
+
+void CPUPrefixCache::clear() {
+    entries_.clear();
+    index_.clear();
+    bytes_ = 0;
+}
+
+bool CPUPrefixCache::save(const std::string &path) const {
+    std::ofstream out(path, std::ios::binary);
+    if (!out) {
+        MLLM_LOG_ERROR_STREAM << "Cannot write prefix cache " << path << std::endl;
+        return false;
+    }
+    auto write_i32 = [&](int32_t v) { out.write((const char *)&v, sizeof(v)); };
+    auto write_u64 = [&](uint64_t v) { out.write((const char *)&v, sizeof(v)); };
+    write_i32(_PREFIX_CACHE_MAGIC);
+    write_i32(_PREFIX_CACHE_VERSION);
+    auto sig = signature();
+    write_i32(sig.size());
+    for (auto v : sig) {
+        write_i32(v);
+    }
+    write_i32(entries_.size());
+    // least recently used first, so load() rebuilds the same LRU order
+    for (auto it = entries_.rbegin(); it != entries_.rend(); ++it) {
+        write_i32(it->tokens.size());
+        out.write((const char *)it->tokens.data(), it->tokens.size() * sizeof(unsigned));
+        write_i32(it->caches.size());
+        for (auto &snapshot : it->caches) {
+            write_u64(snapshot.size());
+            out.write(snapshot.data(), snapshot.size());
+        }
+    }
+    return (bool)out;
+}
+
+bool CPUPrefixCache::load(const std::string &path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in || !supported()) {
+        return false;
+    }
+    auto read_i32 = [&]() { int32_t v = 0; in.read((char *)&v, sizeof(v)); return v; };
+    auto read_u64 = [&]() { uint64_t v = 0; in.read((char *)&v, sizeof(v)); return v; };
+    if (read_i32() != _PREFIX_CACHE_MAGIC || read_i32() != _PREFIX_CACHE_VERSION) {
+        MLLM_LOG_ERROR_STREAM << "Not a prefix cache file: " << path << std::endl;
+        return false;
+    }
+    auto expected_sig = signature();
+    int sig_size = read_i32();
+    std::vector<int> sig(sig_size == (int)expected_sig.size() ? sig_size : 0);
+    for (auto &v : sig) {
+        v = read_i32();
+    }
+    if (!in || sig != expected_sig) {
+        MLLM_LOG_ERROR_STREAM << "Prefix cache " << path << " was saved for a different model" << std::endl;
+        return false;
+    }
+    // every size read below is checked against the model's caches before anything is allocated
+    auto caches = CPUKVCache::cachesOf(model_);
+    auto bad = [&](const char *what) {
+        MLLM_LOG_ERROR_STREAM << "Prefix cache " << path << ": " << what << ", ignoring the rest of the file" << std::endl;
+        return false;
+    };
+    int n_entries = read_i32();
+    if (n_entries < 0) {
+        return bad("bad entry count");
+    }
+    for (int e = 0; e < n_entries && in; ++e) {
+        int len = read_i32();
+        for (auto *cache : caches) {
+            if (len <= 0 || len > cache->cache_limit_) {
+                return bad("prefix longer than the KV cache");
+            }
+        }
+        Entry entry;
+        entry.tokens.resize(len);
+        in.read((char *)entry.tokens.data(), entry.tokens.size() * sizeof(unsigned));
+        entry.hash = kHashSeed;
+        for (auto token : entry.tokens) {
+            entry.hash = hashStep(entry.hash, token);
+        }
+        if (read_i32() != (int)caches.size()) {
+            return bad("snapshot count does not match the model");
+        }
+        entry.caches.resize(caches.size());
+        for (size_t c = 0; c < caches.size(); ++c) {
+            auto &snapshot = entry.caches[c];
+            if (read_u64() != snapshotBytes(caches[c], len)) {
+                return bad("snapshot size does not match the cache head / dimension / dtype");
+            }
+            snapshot.resize(snapshotBytes(caches[c], len));
+            in.read(snapshot.data(), snapshot.size());
+            entry.bytes += snapshot.size();
+        }
+        if (in) {
+            add(std::move(entry));
+        }
+    }
+    return (bool)in;
+}
+
+} // namespace mllm
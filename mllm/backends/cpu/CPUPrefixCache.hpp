@@ -0,0 +1,95 @@
+#ifndef MLLM_CPUPREFIXCACHE_H
+#define MLLM_CPUPREFIXCACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace mllm {
+
+class CPUKVCache;
+class Module;
+
+/**
+ * @brief Prompt cache for the CPU KV caches.
+ *
+ * insert() snapshots the first tokens of every live CPUKVCache for a token prefix;
+ * restore() finds the longest stored prefix of a new prompt, copies the snapshot back,
+ * sets cache_seq_len_ and moves every CPURoPE to that position, so only the remaining
+ * tokens have to be prefilled. Prefixes are keyed by a rolling hash over the token ids
+ * (one hash per prefix length, i.e. a hashed trie), the tokens are compared on a hit.
+ * Snapshots are evicted LRU once max_bytes is exceeded and can be saved next to the
+ * model file to survive a restart.
+ *
+ * Snapshots cover the caches and ropes of one model (the ops its load created, see
+ * CPUKVCache::cachesOf), so a draft model or a second model in the process is left alone.
+ * load() checks the cache shapes and every snapshot size against the model's caches. A snapshot
+ * holds exactly the first tokens.size() rows of each cache, independent of how far a paged cache
+ * has grown. Models with SAGE or XP caches (CPUKVCacheSage / CPUKVCacheXp) are refused: insert,
+ * restore and load fail with an error instead of restoring the ropes without their K/V.
+ *
+ * usage:
+ *   CPUPrefixCache prefix_cache(model);
+ *   model.clear_kvcache();
+ *   int hit = prefix_cache.restore(ids);        // ids[0, hit) are now in the KV cache
+ *   ... prefill ids[hit, n) and decode ...
+ *   prefix_cache.insert(system_prompt_ids);     // once the prompt has been prefilled
+ */
+class CPUPrefixCache {
+public:
+    explicit CPUPrefixCache(const Module &model, size_t max_bytes = 512UL * 1024 * 1024) :
+        model_(&model), max_bytes_(max_bytes) {
+    }
+
+    // snapshot the first tokens.size() cached tokens; they must be the tokens already prefilled
+    bool insert(const std::vector<unsigned> &tokens);
+    // restore the longest cached strict prefix of tokens, return its length (0 on a miss)
+    int restore(const std::vector<unsigned> &tokens);
+
+    bool save(const std::string &path) const;
+    bool load(const std::string &path);
+    // <model>.mllm -> <model>.mllm.prefix
+    static std::string defaultPath(const std::string &model_path) {
+        return model_path + ".prefix";
+    }
+
+    size_t size() const {
+        return entries_.size();
+    }
+    size_t bytes() const {
+        return bytes_;
+    }
+    void clear();
+
+private:
+    struct Entry {
+        uint64_t hash;
+        std::vector<unsigned> tokens;
+        std::vector<std::vector<char>> caches; // one snapshot per live CPUKVCache
+        size_t bytes = 0;
+    };
+    using EntryList = std::list<Entry>;
+
+    static uint64_t hashStep(uint64_t hash, unsigned token);
+    // false (and an error) if the model has caches that cannot be snapshot
+    bool supported() const;
+    // (batch, head, dimension, dtype, ctype) of every cache of the model, used to validate snapshots
+    std::vector<int> signature() const;
+    // bytes of the first len tokens of a cache, as insert() snapshots them
+    static size_t snapshotBytes(const CPUKVCache *cache, int len);
+    void add(Entry entry);
+    void evict();
+
+    const Module *model_;
+    size_t max_bytes_;
+    size_t bytes_ = 0;
+    EntryList entries_; // most recently used first
+    std::unordered_map<uint64_t, EntryList::iterator> index_;
+};
+
+} // namespace mllm
+
+#endif // MLLM_CPUPREFIXCACHE_H
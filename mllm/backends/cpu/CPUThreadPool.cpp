@@ -0,0 +1,248 @@
+#include "CPUThreadPool.hpp"
+#include "CPUBackend.hpp"
+#include <chrono>
+#include <fstream>
+#include <string>
+#if defined(__linux__) || defined(__ANDROID__)
+#include <sched.h>
+#endif
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace mllm {
+
+int CPUThreadPool::spin_count = 1 << 14;
+bool CPUThreadPool::enabled = true;
+
+// set on pool workers and on the caller while it runs a job: nested parallelFor runs inline
+static thread_local bool in_pool_job = false;
+
+static inline void cpu_relax() {
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+    _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    asm volatile("yield");
+#endif
+}
+
+CPUThreadPool &CPUThreadPool::instance() {
+    static CPUThreadPool pool;
+    return pool;
+}
+
+CPUThreadPool::~CPUThreadPool() {
+    stop();
+}
+
+std::vector<int> CPUThreadPool::coresOf(CoreSet core_set) {
+    const int n = std::thread::hardware_concurrency();
+    std::vector<long> max_freq(n, 0);
+    long highest = 0;
+    for (int c = 0; c < n; ++c) {
+        std::ifstream f("/sys/devices/system/cpu/cpu" + std::to_string(c) + "/cpufreq/cpuinfo_max_freq");
+        if (f >> max_freq[c]) {
+            highest = std::max(highest, max_freq[c]);
+        }
+    }
+    std::vector<int> cores;
+    for (int c = 0; c < n; ++c) {
+        bool fast = highest == 0 || max_freq[c] == highest;
+        if (core_set == ALL_CORES || (core_set == PERFORMANCE_CORES && fast) || (core_set == EFFICIENCY_CORES && !fast)) {
+            cores.push_back(c);
+        }
+    }
+    if (cores.empty()) { // homogeneous part asked for efficiency cores
+        for (int c = 0; c < n; ++c) {
+            cores.push_back(c);
+        }
+    }
+    return cores;
+}
+
+void CPUThreadPool::pin(int core) {
+#if defined(__linux__) || defined(__ANDROID__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core, &set);
+    sched_setaffinity(0, sizeof(set), &set);
+#else
+    (void)core;
+#endif
+}
+
+// speed of the current core: inverse of the best of a few runs of a dependent FMA chain
+float CPUThreadPool::calibrate() {
+    double best = 1e30;
+    volatile float sink = 0;
+    for (int run = 0; run < 3; ++run) {
+        auto t0 = std::chrono::steady_clock::now();
+        float a = 1.0f, b = 1.0000001f;
+        for (int i = 0; i < 200000; ++i) {
+            a = a * b + 1e-7f;
+        }
+        sink = a;
+        auto t1 = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double>(t1 - t0).count());
+    }
+    (void)sink;
+    return (float)(1.0 / std::max(best, 1e-9));
+}
+
+void CPUThreadPool::configure(int threads, const std::vector<int> &cores) {
+    std::lock_guard<std::mutex> lock(dispatch_mutex_);
+    stop();
+    start(threads, cores);
+    configured_ = true;
+}
+
+std::vector<int> CPUThreadPool::lazyCores() {
+    // ALL_CORES leaves placement to the OS, a restricted set pins the workers
+    return CPUBackend::cpu_core_set == ALL_CORES ? std::vector<int>{} : coresOf((CoreSet)CPUBackend::cpu_core_set);
+}
+
+void CPUThreadPool::start(int threads, const std::vector<int> &cores) {
+    size_ = std::min(std::max(threads, 1), (int)kParticipantsMask);
+    // spinning only pays off when every worker has a core of its own
+    spin_limit_ = size_ <= (int)std::thread::hardware_concurrency() ? spin_count : 0;
+    shares_.reset(new Share[size_]);
+    speed_.assign(size_, 1.0f);
+    stop_ = false;
+    // workers measure their core once pinned, the caller measures itself meanwhile
+    pending_ = size_ - 1;
+    for (int id = 1; id < size_; ++id) {
+        workers_.emplace_back([this, id, cores] {
+            in_pool_job = true;
+            if (!cores.empty()) {
+                pin(cores[id % cores.size()]);
+            }
+            speed_[id] = calibrate();
+            pending_.fetch_sub(1);
+            workerLoop(id);
+        });
+    }
+    speed_[0] = calibrate();
+    while (pending_.load() > 0) {
+        std::this_thread::yield();
+    }
+    const float fastest = *std::max_element(speed_.begin(), speed_.end());
+    for (auto &s : speed_) {
+        // differences under 10% are timing noise on a homogeneous part
+        s = s / fastest > 0.9f ? 1.0f : s / fastest;
+    }
+}
+
+void CPUThreadPool::stop() {
+    if (workers_.empty()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        stop_ = true;
+    }
+    sleep_cv_.notify_all();
+    for (auto &w : workers_) {
+        w.join();
+    }
+    workers_.clear();
+}
+
+void CPUThreadPool::workerLoop(int id) {
+    uint64_t seen = generation_.load();
+    while (true) {
+        int spins = 0;
+        uint64_t generation;
+        while ((generation = generation_.load()) == seen && !stop_.load()) {
+            if (++spins < spin_limit_) {
+                cpu_relax();
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleep_mutex_);
+            sleepers_.fetch_add(1);
+            sleep_cv_.wait(lock, [&] { return generation_.load() != seen || stop_.load(); });
+            sleepers_.fetch_sub(1);
+        }
+        if (stop_.load()) {
+            return;
+        }
+        seen = generation;
+        // the participant count comes with the generation: a worker that slept through jobs it was
+        // not part of must not join a later job by reading a newer count. A participant's job
+        // cannot end (and fn_ / grain_ / shares_ cannot change) before it has acked it.
+        const int participants = (int)(generation & kParticipantsMask);
+        if (id < participants) {
+            work(id, participants);
+            pending_.fetch_sub(1);
+        }
+    }
+}
+
+void CPUThreadPool::work(int id, int participants) {
+    const auto &fn = *fn_;
+    // own share first, then steal from the others
+    for (int k = 0; k < participants; ++k) {
+        Share &share = shares_[(id + k) % participants];
+        while (true) {
+            const int64_t begin = share.next.fetch_add(grain_);
+            if (begin >= share.end) {
+                break;
+            }
+            fn(begin, std::min(begin + grain_, share.end));
+        }
+    }
+}
+
+void CPUThreadPool::parallelFor(int64_t n, int threads, const std::function<void(int64_t, int64_t)> &fn, int64_t grain) {
+    if (n <= 0) {
+        return;
+    }
+    grain = std::max<int64_t>(grain, 1);
+    const int64_t chunks = (n + grain - 1) / grain;
+    if (threads <= 1 || chunks == 1 || in_pool_job) {
+        fn(0, n);
+        return;
+    }
+    std::lock_guard<std::mutex> lock(dispatch_mutex_);
+    if (!configured_ && workers_.size() + 1 < (size_t)std::max(threads, CPUBackend::cpu_threads)) {
+        stop();
+        start(std::max(threads, CPUBackend::cpu_threads), lazyCores());
+    }
+    const int participants = (int)std::min<int64_t>({(int64_t)threads, (int64_t)size_, chunks});
+    // static split in grains, proportional to the worker speeds
+    float total = 0;
+    for (int w = 0; w < participants; ++w) {
+        total += speed_[w];
+    }
+    int64_t assigned = 0;
+    float acc = 0;
+    for (int w = 0; w < participants; ++w) {
+        acc += speed_[w];
+        const int64_t end_chunk = w == participants - 1 ? chunks : (int64_t)(chunks * (acc / total) + 0.5f);
+        shares_[w].next.store(assigned * grain);
+        shares_[w].end = std::min(n, std::max(end_chunk, assigned) * grain);
+        assigned = std::max(end_chunk, assigned);
+    }
+    fn_ = &fn;
+    grain_ = grain;
+    pending_.store(participants - 1);
+    // next sequence number in the high bits, this job's participants in the low ones
+    const uint64_t sequence = (generation_.load() >> kParticipantsBits) + 1;
+    generation_.store((sequence << kParticipantsBits) | (uint64_t)participants);
+    if (sleepers_.load() > 0) {
+        std::lock_guard<std::mutex> sleep_lock(sleep_mutex_);
+        sleep_cv_.notify_all();
+    }
+    in_pool_job = true;
+    work(0, participants);
+    in_pool_job = false;
+    int spins = 0;
+    while (pending_.load() > 0) {
+        if (++spins < spin_limit_) {
+            cpu_relax();
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+} // namespace mllm
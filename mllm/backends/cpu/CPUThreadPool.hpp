@@ -0,0 +1,122 @@
+#ifndef MLLM_CPUTHREADPOOL_H
+#define MLLM_CPUTHREADPOOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mllm {
+
+/**
+ * @brief Persistent worker pool for CPU ops, used instead of a per-op OpenMP team.
+ *
+ * Workers are started once (by configure(), or lazily with CPUBackend::cpu_threads), optionally
+ * pinned to a core set, and wait for work by spinning briefly and then sleeping. parallelFor splits
+ * the range statically in proportion to the core speed measured at start-up; a worker that runs out
+ * of its share steals grain-sized chunks from the others, so uneven big.LITTLE / hybrid cores finish
+ * together. The calling thread takes part as worker 0, and a parallelFor issued from inside a running
+ * job runs inline.
+ */
+class CPUThreadPool {
+public:
+    enum CoreSet {
+        ALL_CORES = 0,
+        PERFORMANCE_CORES, // cores with the highest max frequency
+        EFFICIENCY_CORES,  // the others (all cores on a homogeneous part)
+    };
+
+    static CPUThreadPool &instance();
+    ~CPUThreadPool();
+
+    /**
+     * @brief (Re)start the pool with `threads` workers, the caller included. Worker i is pinned to
+     * cores[i % cores.size()] (worker 0 is the caller and is not pinned); empty cores: no pinning.
+     */
+    void configure(int threads, const std::vector<int> &cores = {});
+    void configure(int threads, CoreSet core_set) {
+        configure(threads, coresOf(core_set));
+    }
+    static std::vector<int> coresOf(CoreSet core_set);
+
+    int threads() const {
+        return size_;
+    }
+    // relative speed of each worker slot, as used for the static split
+    const std::vector<float> &speeds() const {
+        return speed_;
+    }
+
+    /**
+     * @brief Run fn(begin, end) on disjoint chunks covering [0, n) with at most `threads` workers.
+     * Chunks are multiples of `grain` (except the last one of a worker's share).
+     */
+    void parallelFor(int64_t n, int threads, const std::function<void(int64_t, int64_t)> &fn, int64_t grain = 1);
+
+    // spin iterations before a waiting worker sleeps
+    static int spin_count;
+    // when false, parallel_for runs on OpenMP like before
+    static bool enabled;
+
+private:
+    CPUThreadPool() = default;
+    struct alignas(64) Share {
+        std::atomic<int64_t> next{0};
+        int64_t end = 0;
+    };
+
+    // generation_ packs a job sequence number with the job's participant count
+    static constexpr int kParticipantsBits = 16;
+    static constexpr uint64_t kParticipantsMask = (1u << kParticipantsBits) - 1;
+
+    void start(int threads, const std::vector<int> &cores);
+    void stop();
+    void workerLoop(int id);
+    void work(int id, int participants);
+    // cores for a pool started lazily, from CPUBackend::cpu_core_set
+    static std::vector<int> lazyCores();
+    static void pin(int core);
+    static float calibrate();
+
+    int size_ = 1;
+    int spin_limit_ = 0;
+    bool configured_ = false;
+    std::vector<std::thread> workers_;
+    std::vector<float> speed_ = {1.0f};
+    std::unique_ptr<Share[]> shares_;
+
+    // current job, published by generation_
+    const std::function<void(int64_t, int64_t)> *fn_ = nullptr;
+    int64_t grain_ = 1;
+
+    std::atomic<uint64_t> generation_{0};
+    std::atomic<int> pending_{0};
+    std::atomic<int> sleepers_{0};
+    std::atomic<bool> stop_{false};
+    std::mutex sleep_mutex_;
+    std::condition_variable sleep_cv_;
+    std::mutex dispatch_mutex_;
+};
+
+// fn(begin, end) over [0, n) on the pool, or an OpenMP loop over grain-sized chunks when the pool is disabled
+template <typename F>
+inline void parallel_for(int64_t n, int threads, F &&fn, int64_t grain = 1) {
+    if (CPUThreadPool::enabled) {
+        CPUThreadPool::instance().parallelFor(n, threads, std::function<void(int64_t, int64_t)>(std::forward<F>(fn)), grain);
+        return;
+    }
+    const int64_t chunks = (n + grain - 1) / grain;
+#pragma omp parallel for num_threads(threads)
+    for (int64_t c = 0; c < chunks; ++c) {
+        fn(c * grain, std::min(n, (c + 1) * grain));
+    }
+}
+
+} // namespace mllm
+
+#endif // MLLM_CPUTHREADPOOL_H
@@ -4,6 +4,8 @@
 
 #include "Convolution.hpp"
 #include "backends/cpu/third_party/ggml/VecDotFP32.hpp"
+#include "Matmul.hpp"
+#include <cstring>
 
 float **reshape_conv2d_kernal_fp32(Tensor *kernel) {
     int in_channel = kernel->sequence();
@@ -233,4 +235,170 @@ void conv3d_fp32_VALID(Tensor *input, Tensor *output, float **k_new, int kernel_
             }
         }
     }
-}
\ No newline at end of file
+}
+
+// F32 [rows, cols] tensor over memory owned by someone else
+static void row_view(Tensor &view, void *ptr, DataType dtype, int rows, int cols) {
+    view.setDtype(dtype);
+    view.reshape(1, 1, rows, cols);
+    view.setHostPtr(ptr, nullptr);
+}
+
+// rows x weight^T into gemm_out, or straight into `direct` when the conv output already is [rows, out_channel]
+static float *patchify_gemm(Tensor *rows, Tensor *weight, int out_channel, bool support_bias, Tensor *bias,
+                            Tensor *gemm_out, void *direct, int thread_count) {
+    const int N = rows->sequence();
+    const int K = rows->dimension();
+    Tensor w(weight->backend());
+    row_view(w, weight->rawHostPtr(), weight->dtype(), out_channel, K);
+    Tensor out_view(rows->backend());
+    Tensor *out = gemm_out;
+    if (direct != nullptr) {
+        row_view(out_view, direct, MLLM_TYPE_F32, N, out_channel);
+        out = &out_view;
+    } else {
+        gemm_out->setDtype(MLLM_TYPE_F32);
+        gemm_out->reshape(1, 1, N, out_channel);
+        gemm_out->alloc();
+    }
+    mat_mul(rows, &w, out, false, nullptr, false, true, thread_count);
+    float *o = out->hostPtr<float>();
+    if (support_bias) {
+        const float *bias_p = bias->hostPtr<float>();
+#pragma omp parallel for num_threads(thread_count)
+        for (int n = 0; n < N; ++n) {
+            for (int oc = 0; oc < out_channel; ++oc) {
+                o[n * out_channel + oc] += bias_p[oc];
+            }
+        }
+    }
+    return o;
+}
+
+void conv2d_fp32_patchify(Tensor *input, Tensor *output, Tensor *weight, bool support_bias, Tensor *bias, Tensor *patches, Tensor *gemm_out, int thread_count) {
+    const int batch = input->batch();
+    const int in_channel = input->sequence();
+    const int kernel_h = weight->head();
+    const int kernel_w = weight->dimension();
+    const int out_height = output->head();
+    const int out_width = output->dimension();
+    const int out_channel = output->sequence();
+    const int K = in_channel * kernel_h * kernel_w;
+    const int N = batch * out_height * out_width;
+
+    // rows: (b, out_h, out_w), columns: (in_ch, k_h, k_w) like the [out_channel, in_ch, k_h, k_w] weight
+    Tensor input_rows(input->backend());
+    Tensor *rows = patches;
+    if (input->ctype() == BSHD && input->masterTensor() == nullptr && input->head() == kernel_h && input->dimension() == kernel_w) {
+        row_view(input_rows, input->rawHostPtr(), MLLM_TYPE_F32, N, K);
+        rows = &input_rows;
+    } else {
+        patches->setDtype(MLLM_TYPE_F32);
+        patches->reshape(1, 1, N, K);
+        patches->alloc();
+#pragma omp parallel for collapse(3) num_threads(thread_count)
+        for (int b = 0; b < batch; ++b) {
+            for (int out_h = 0; out_h < out_height; ++out_h) {
+                for (int out_w = 0; out_w < out_width; ++out_w) {
+                    float *row = patches->ptrAt<float>(0, 0, (b * out_height + out_h) * out_width + out_w, 0);
+                    for (int in_ch = 0; in_ch < in_channel; ++in_ch) {
+                        for (int k_h = 0; k_h < kernel_h; ++k_h) {
+                            memcpy(row + (in_ch * kernel_h + k_h) * kernel_w,
+                                   input->ptrAt<float>(b, out_h * kernel_h + k_h, in_ch, out_w * kernel_w),
+                                   kernel_w * sizeof(float));
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // output is [b, out_channel, out_h, out_w]: already the row layout for a 1x1 output
+    const bool in_place = out_height == 1 && out_width == 1 && output->ctype() == BSHD && output->masterTensor() == nullptr;
+    const float *o = patchify_gemm(rows, weight, out_channel, support_bias, bias, gemm_out,
+                                   in_place ? output->rawHostPtr() : nullptr, thread_count);
+    if (in_place) {
+        return;
+    }
+#pragma omp parallel for collapse(2) num_threads(thread_count)
+    for (int b = 0; b < batch; ++b) {
+        for (int out_ch = 0; out_ch < out_channel; ++out_ch) {
+            for (int out_h = 0; out_h < out_height; ++out_h) {
+                for (int out_w = 0; out_w < out_width; ++out_w) {
+                    const int n = (b * out_height + out_h) * out_width + out_w;
+                    output->setDataAt<float>(b, out_h, out_ch, out_w, o[n * out_channel + out_ch]);
+                }
+            }
+        }
+    }
+}
+
+void conv3d_fp32_patchify(Tensor *input, Tensor *output, Tensor *weight, bool support_bias, Tensor *bias, Tensor *patches, Tensor *gemm_out, int thread_count) {
+    assert(input->ctype() == BCTHW);
+    assert((output->ctype() == BCTHW || output->ctype() == BTHWC));
+    const int batch = input->batch();
+    const int in_channel = input->channel();
+    const int kernel_t = weight->time();
+    const int kernel_h = weight->height();
+    const int kernel_w = weight->width();
+    const int out_time = output->time();
+    const int out_height = output->height();
+    const int out_width = output->width();
+    const int out_channel = output->channel();
+    const int K = in_channel * kernel_t * kernel_h * kernel_w;
+    const int N = batch * out_time * out_height * out_width;
+
+    // rows: (b, out_t, out_h, out_w), columns: (in_ch, k_t, k_h, k_w) like the weight
+    Tensor input_rows(input->backend());
+    Tensor *rows = patches;
+    if (input->masterTensor() == nullptr && input->time() == kernel_t && input->height() == kernel_h && input->width() == kernel_w) {
+        // e.g. Qwen2-VL, the processor already hands over one flattened patch per batch
+        row_view(input_rows, input->rawHostPtr(), MLLM_TYPE_F32, N, K);
+        rows = &input_rows;
+    } else {
+        patches->setDtype(MLLM_TYPE_F32);
+        patches->reshape(1, 1, N, K);
+        patches->alloc();
+#pragma omp parallel for collapse(4) num_threads(thread_count)
+        for (int b = 0; b < batch; ++b) {
+            for (int out_t = 0; out_t < out_time; ++out_t) {
+                for (int out_h = 0; out_h < out_height; ++out_h) {
+                    for (int out_w = 0; out_w < out_width; ++out_w) {
+                        float *row = patches->ptrAt<float>(0, 0, ((b * out_time + out_t) * out_height + out_h) * out_width + out_w, 0);
+                        for (int in_ch = 0; in_ch < in_channel; ++in_ch) {
+                            for (int k_t = 0; k_t < kernel_t; ++k_t) {
+                                for (int k_h = 0; k_h < kernel_h; ++k_h) {
+                                    memcpy(row + ((in_ch * kernel_t + k_t) * kernel_h + k_h) * kernel_w,
+                                           input->ptrAt<float>(b, in_ch, out_t * kernel_t + k_t, out_h * kernel_h + k_h, out_w * kernel_w),
+                                           kernel_w * sizeof(float));
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // BTHWC output is the row layout, and so is BCTHW with a 1x1x1 output
+    const bool in_place = output->masterTensor() == nullptr
+                          && (output->ctype() == BTHWC || (out_time == 1 && out_height == 1 && out_width == 1));
+    const float *o = patchify_gemm(rows, weight, out_channel, support_bias, bias, gemm_out,
+                                   in_place ? output->rawHostPtr() : nullptr, thread_count);
+    if (in_place) {
+        return;
+    }
+#pragma omp parallel for collapse(2) num_threads(thread_count)
+    for (int b = 0; b < batch; ++b) {
+        for (int out_ch = 0; out_ch < out_channel; ++out_ch) {
+            for (int out_t = 0; out_t < out_time; ++out_t) {
+                for (int out_h = 0; out_h < out_height; ++out_h) {
+                    for (int out_w = 0; out_w < out_width; ++out_w) {
+                        const int n = ((b * out_time + out_t) * out_height + out_h) * out_width + out_w;
+                        output->setDataAt<float>(b, out_ch, out_t, out_h, out_w, o[n * out_channel + out_ch]);
+                    }
+                }
+            }
+        }
+    }
+}
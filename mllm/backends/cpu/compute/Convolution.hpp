@@ -18,4 +18,11 @@ float **reshape_conv3d_kernal_fp32(Tensor *kernel);
 
 void conv3d_fp32_VALID(Tensor *input, Tensor *output, float **k_new, int kernel_t, int kernel_h, int kernel_w, bool support_bias, Tensor *bias, int stride_t, int stride_h, int stride_w, int thread_count = 4);
 
+// stride == kernel, no padding: the receptive fields do not overlap, so the convolution is the patches
+// gathered as rows [N, C*k] times the weight [out_channel, C*k] with mat_mul (weight in its stored dtype).
+// `patches` and `gemm_out` are scratch owned by the op; an input or output that already has the row
+// layout (a single patch per batch, BTHWC output) is used in place.
+void conv2d_fp32_patchify(Tensor *input, Tensor *output, Tensor *weight, bool support_bias, Tensor *bias, Tensor *patches, Tensor *gemm_out, int thread_count = 4);
+void conv3d_fp32_patchify(Tensor *input, Tensor *output, Tensor *weight, bool support_bias, Tensor *bias, Tensor *patches, Tensor *gemm_out, int thread_count = 4);
+
 #endif // CONVOLUTION2D_HPP
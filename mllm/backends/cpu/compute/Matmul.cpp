@@ -10,6 +10,7 @@
 #include <iostream>
 #include "Arithmetic.hpp"
 #include "GemmSme.hpp"
+#include "backends/cpu/CPUThreadPool.hpp"
 
 #ifdef __ARM_NEON
 #include <arm_neon.h>
@@ -23,6 +24,8 @@ ErrorCode mat_mul(Tensor *src0, Tensor *src1, Tensor *dst, bool support_bias, Te
     const int M = transpose0 ? src0->dimension() : src0->sequence();
     const int K = transpose0 ? src0->sequence() : src0->dimension();
     const int N = transpose1 ? src1->sequence() : src1->dimension();
+    // GQA: src1 may hold fewer heads than src0 (un-replicated KV cache), head h reads src1 head h / head_rep
+    const int head_rep = (src1->head() > 0 && src0->head() % src1->head() == 0) ? src0->head() / src1->head() : 1;
 
     auto src0_dtype = src0->dtype();
     auto src1_dtype = src1->dtype();
@@ -48,70 +51,79 @@ ErrorCode mat_mul(Tensor *src0, Tensor *src1, Tensor *dst, bool support_bias, Te
     if (check_llamafile_sgemm(N, M, K / blck_size(src0->dtype()), src1->dtype(), src0->dtype(), dst->dtype(), ld_src1 / src1_blck_size, ld_src0 / src0_blck_size, ld_dst / blck_size(dst->dtype()))
         && dst->ctype() == BSHD && dst->aggregatedTensors().empty()) {
         int is_0 = (src1->batch() == 1 && src1->head() == 1 && src1->batch() != src0->batch()) ? 0 : 1;
-#pragma omp parallel for collapse(3) num_threads(thread_count)
-        for (int64_t b = 0; b < dst->batch(); b++) {
-            for (int64_t h = 0; h < dst->head(); h++) {
-                for (int id = 0; id < thread_count; id++) {
-                    llamafile_sgemm(
-                        N, M, K / blck_size(src0->dtype()),
-                        (char *)src1->rawHostPtr()
-                            + src1->offset(b * is_0, h * is_0, 0, 0) * src1_type_size
-                                  / src1_blck_size,
-                        ld_src1 / src1_blck_size,
-                        (char *)src0->rawHostPtr()
-                            + src0->offset(b, h, 0, 0) * src0_type_size / src0_blck_size,
-                        ld_src0 / src0_blck_size,
-                        (char *)dst->rawHostPtr()
-                            + dst->offset(b, h, 0, 0) * type_size(dst->dtype())
-                                  / blck_size(dst->dtype()),
-                        ld_dst / blck_size(dst->dtype()), id, thread_count, src1->dtype(),
-                        src0->dtype(), dst->dtype(),
-                        /*bias=*/support_bias ? bias->hostPtr<float>() : nullptr,
-                        /*BiasType=*/support_bias ? bias->dtype() : DataType::MLLM_TYPE_F32);
-                }
+        const int64_t heads = dst->head();
+        parallel_for(dst->batch() * heads * thread_count, thread_count, [&](int64_t begin, int64_t end) {
+            for (int64_t idx = begin; idx < end; idx++) {
+                const int64_t b = idx / (heads * thread_count);
+                const int64_t h = idx / thread_count % heads;
+                const int id = idx % thread_count;
+                llamafile_sgemm(
+                    N, M, K / blck_size(src0->dtype()),
+                    (char *)src1->rawHostPtr()
+                        + src1->offset(b * is_0, (h / head_rep) * is_0, 0, 0) * src1_type_size
+                              / src1_blck_size,
+                    ld_src1 / src1_blck_size,
+                    (char *)src0->rawHostPtr()
+                        + src0->offset(b, h, 0, 0) * src0_type_size / src0_blck_size,
+                    ld_src0 / src0_blck_size,
+                    (char *)dst->rawHostPtr()
+                        + dst->offset(b, h, 0, 0) * type_size(dst->dtype())
+                              / blck_size(dst->dtype()),
+                    ld_dst / blck_size(dst->dtype()), id, thread_count, src1->dtype(),
+                    src0->dtype(), dst->dtype(),
+                    /*bias=*/support_bias ? bias->hostPtr<float>() : nullptr,
+                    /*BiasType=*/support_bias ? bias->dtype() : DataType::MLLM_TYPE_F32);
             }
-        }
+        });
         return MLLM_NO_ERROR;
     }
 #endif
     auto not_vec_dot_type = src0_dtype != vec_dot_type;
-    std::unique_ptr<Tensor> to; // later this tensor will be freed by ~Tensor
+    std::shared_ptr<Tensor> to; // later this tensor will be freed by ~Tensor
+    bool free_to = false;
     if (not_vec_dot_type) {
         // convert x.dtype to vec_dot_type
         // so that we can use vec_dot to calculate dot product
         assert(src0_dtype == MLLM_TYPE_F32); // x should be fp32
-        to = std::make_unique<Tensor>(src0->shape());
-        to->setBackend(src0->backend());
-        to->setDtype(vec_dot_type);
-        to->alloc();
-        to->setName(src0->name() + "-vec_dot");
-        int64_t i_processed = 0;
-        if ((from_float_to_mat != nullptr) && (gemv != nullptr) && dst->masterTensor() == nullptr) {
+        const bool to_mat = (from_float_to_mat != nullptr) && (gemv != nullptr) && dst->masterTensor() == nullptr;
+        const int interleave = to_mat ? blck_size_interleave : 0;
+        // an activation read by several GEMMs (see Tensor::shareQuantizedCopy) is converted by the first one
+        to = src0->quantizedCopy(vec_dot_type, interleave);
+        if (to == nullptr) {
+            to = std::make_shared<Tensor>(src0->shape());
+            to->setBackend(src0->backend());
+            to->setDtype(vec_dot_type);
+            to->alloc();
+            to->setName(src0->name() + "-vec_dot");
+            int64_t i_processed = 0;
+            if (to_mat) {
+                for (int b = 0; b < src0->batch(); b++) {
+                    for (int h = 0; h < src0->head(); h++) {
+#pragma omp parallel for collapse(1) num_threads(thread_count)
+                        for (int64_t s = 0; s < src0->sequence() - src0->sequence() % 4; s += 4) {
+                            from_float_to_mat(src0->hostPtr<float>() + src0->offset(b, h, s, 0),
+                                              (char *)to->rawHostPtr()
+                                                  + to->offset(b, h, s, 0) * type_size(to->dtype())
+                                                        / blck_size(to->dtype()),
+                                              4, src0->dimension(), blck_size_interleave);
+                        }
+                        i_processed = src0->sequence() - src0->sequence() % 4;
+                    }
+                }
+            }
+#pragma omp parallel for collapse(3) num_threads(thread_count)
             for (int b = 0; b < src0->batch(); b++) {
                 for (int h = 0; h < src0->head(); h++) {
-#pragma omp parallel for collapse(1) num_threads(thread_count)
-                    for (int64_t s = 0; s < src0->sequence() - src0->sequence() % 4; s += 4) {
-                        from_float_to_mat(src0->hostPtr<float>() + src0->offset(b, h, s, 0),
+                    for (int s = i_processed; s < src0->sequence(); s++) {
+                        x_to_vec_dot_type(src0->hostPtr<float>() + src0->offset(b, h, s, 0),
                                           (char *)to->rawHostPtr()
                                               + to->offset(b, h, s, 0) * type_size(to->dtype())
                                                     / blck_size(to->dtype()),
-                                          4, src0->dimension(), blck_size_interleave);
+                                          src0->dimension());
                     }
-                    i_processed = src0->sequence() - src0->sequence() % 4;
-                }
-            }
-        }
-#pragma omp parallel for collapse(3) num_threads(thread_count)
-        for (int b = 0; b < src0->batch(); b++) {
-            for (int h = 0; h < src0->head(); h++) {
-                for (int s = i_processed; s < src0->sequence(); s++) {
-                    x_to_vec_dot_type(src0->hostPtr<float>() + src0->offset(b, h, s, 0),
-                                      (char *)to->rawHostPtr()
-                                          + to->offset(b, h, s, 0) * type_size(to->dtype())
-                                                / blck_size(to->dtype()),
-                                      src0->dimension());
                 }
             }
+            free_to = !src0->setQuantizedCopy(to, interleave);
         }
         src0 = to.get();
         src0_dtype = src0->dtype();
@@ -128,69 +140,51 @@ ErrorCode mat_mul(Tensor *src0, Tensor *src1, Tensor *dst, bool support_bias, Te
         && dst->dtypeAt(0, 0, 0, 0) == MLLM_TYPE_F32 && dst->ctype() == BSHD
         && dst->aggregatedTensors().empty()) {
         int is_0 = (src1->batch() == 1 && src1->head() == 1 && src1->batch() != src0->batch()) ? 0 : 1;
-#pragma omp parallel for collapse(3) num_threads(thread_count)
-        for (int64_t b = 0; b < dst->batch(); b++) {
-            for (int64_t h = 0; h < dst->head(); h++) {
-                for (int id = 0; id < thread_count; id++) {
-                    llamafile_sgemm(
-                        N, M, K / blck_size(src1->dtype()),
-                        (char *)src1->rawHostPtr()
-                            + src1->offset(b * is_0, h, 0, 0) * src1_type_size / src1_blck_size,
-                        ld_src1 / src1_blck_size,
-                        (char *)src0->rawHostPtr()
-                            + src0->offset(b, h, 0, 0) * src0_type_size / src0_blck_size,
-                        ld_src0 / src0_blck_size,
-                        (char *)dst->rawHostPtr()
-                            + dst->offset(b, h, 0, 0) * type_size(dst->dtype())
-                                  / blck_size(dst->dtype()),
-                        ld_dst / blck_size(dst->dtype()), id, thread_count, src1->dtype(),
-                        src0->dtype(), dst->dtype(),
-                        /*bias=*/
-                        support_bias ? bias->hostPtr<float>() + bias->offset(b, h, 0, 0) : nullptr,
-                        /*BiasType=*/support_bias ? bias->dtype() : DataType::MLLM_TYPE_F32);
-                }
+        const int64_t heads = dst->head();
+        parallel_for(dst->batch() * heads * thread_count, thread_count, [&](int64_t begin, int64_t end) {
+            for (int64_t idx = begin; idx < end; idx++) {
+                const int64_t b = idx / (heads * thread_count);
+                const int64_t h = idx / thread_count % heads;
+                const int id = idx % thread_count;
+                llamafile_sgemm(
+                    N, M, K / blck_size(src1->dtype()),
+                    (char *)src1->rawHostPtr()
+                        + src1->offset(b * is_0, h / head_rep, 0, 0) * src1_type_size / src1_blck_size,
+                    ld_src1 / src1_blck_size,
+                    (char *)src0->rawHostPtr()
+                        + src0->offset(b, h, 0, 0) * src0_type_size / src0_blck_size,
+                    ld_src0 / src0_blck_size,
+                    (char *)dst->rawHostPtr()
+                        + dst->offset(b, h, 0, 0) * type_size(dst->dtype())
+                              / blck_size(dst->dtype()),
+                    ld_dst / blck_size(dst->dtype()), id, thread_count, src1->dtype(),
+                    src0->dtype(), dst->dtype(),
+                    /*bias=*/
+                    support_bias ? bias->hostPtr<float>() + bias->offset(b, h, 0, 0) : nullptr,
+                    /*BiasType=*/support_bias ? bias->dtype() : DataType::MLLM_TYPE_F32);
             }
-        }
-        if (not_vec_dot_type) to->free();
+        });
+        if (free_to) to->free();
         return MLLM_NO_ERROR;
     }
 #endif
     if ((gemv != nullptr) && dst->dtypeAt(0, 0, 0, 0) == MLLM_TYPE_F32) {
         int nth = thread_count;
-        if (!support_bias) {
-#pragma omp parallel for collapse(1) num_threads(thread_count)
-            for (int ith = 0; ith < nth; ith++) {
-                int64_t i_processed = 0;
-                int64_t seq_start = (ith * N) / nth;
-                int64_t seq_end = ((ith + 1) * N) / nth;
-                if ((gemm != nullptr) && (M > 3) && dst->masterTensor() == nullptr) {
-                    gemm(K, dst->hostPtr<float>() + dst->offset(0, 0, 0, seq_start), N,
-                         (char *)src1->rawHostPtr()
-                             + src1->offset(0, 0, seq_start, 0) * src1_type_size / src1_blck_size,
-                         (char *)src0->rawHostPtr(), M - M % 4, N / nth, /*bias=*/nullptr);
-                    i_processed = M - M % 4;
-                }
-                for (int iter = i_processed; iter < M; iter++) { // M-M%4
-                    gemv(K, dst->hostPtr<float>() + dst->offset(0, 0, iter, seq_start), N,
-                         (char *)src1->rawHostPtr()
-                             + src1->offset(0, 0, seq_start, 0) * src1_type_size / src1_blck_size,
-                         (char *)src0->rawHostPtr()
-                             + src0->offset(0, 0, iter, 0) * src0_type_size / src0_blck_size,
-                         1, N / nth, /*bias=*/nullptr);
-                }
-            }
-        } else {
-#pragma omp parallel for collapse(1) num_threads(thread_count)
-            for (int ith = 0; ith < nth; ith++) {
+        // column blocks of 64 (a multiple of every interleave) let fast workers take more of them,
+        // otherwise one block of about N / nth columns per thread, rounded to whole interleave
+        // groups of 8; the last block also takes the N % cols tail
+        const int64_t cols = (N % 64 == 0 && N / 64 >= nth) ? 64 : std::max<int64_t>(8, N / nth / 8 * 8);
+        const int64_t blocks = std::max<int64_t>(1, N / cols);
+        parallel_for(blocks, thread_count, [&](int64_t begin, int64_t end) {
+            for (int64_t blk = begin; blk < end; blk++) {
                 int64_t i_processed = 0;
-                int64_t seq_start = (ith * N) / nth;
-                int64_t seq_end = ((ith + 1) * N) / nth;
+                int64_t seq_start = blk * cols;
+                const int64_t width = blk == blocks - 1 ? N - seq_start : cols;
                 if ((gemm != nullptr) && (M > 3) && dst->masterTensor() == nullptr) {
                     gemm(K, dst->hostPtr<float>() + dst->offset(0, 0, 0, seq_start), N,
                          (char *)src1->rawHostPtr()
                              + src1->offset(0, 0, seq_start, 0) * src1_type_size / src1_blck_size,
-                         (char *)src0->rawHostPtr(), M - M % 4, N / nth,
-                         /*bias=*/nullptr); // bias->hostPtr<float>()+ bias->offset(/*b=*/0, /*h=*/0, /*s=*/0, /*d=*/seq_start)
+                         (char *)src0->rawHostPtr(), M - M % 4, width, /*bias=*/nullptr);
                     i_processed = M - M % 4;
                 }
                 for (int iter = i_processed; iter < M; iter++) { // M-M%4
@@ -199,9 +193,11 @@ ErrorCode mat_mul(Tensor *src0, Tensor *src1, Tensor *dst, bool support_bias, Te
                              + src1->offset(0, 0, seq_start, 0) * src1_type_size / src1_blck_size,
                          (char *)src0->rawHostPtr()
                              + src0->offset(0, 0, iter, 0) * src0_type_size / src0_blck_size,
-                         1, N / nth, nullptr);
+                         1, width, /*bias=*/nullptr);
                 }
             }
+        });
+        if (support_bias) {
 #pragma omp parallel for collapse(3) num_threads(thread_count)
             for (int b = 0; b < dst->batch(); b++) {
                 for (int h = 0; h < dst->head(); h++) {
@@ -212,7 +208,7 @@ ErrorCode mat_mul(Tensor *src0, Tensor *src1, Tensor *dst, bool support_bias, Te
                 }
             }
         }
-        if (not_vec_dot_type) to->free();
+        if (free_to) to->free();
         return MLLM_NO_ERROR;
     }
 
@@ -220,61 +216,62 @@ ErrorCode mat_mul(Tensor *src0, Tensor *src1, Tensor *dst, bool support_bias, Te
     Tensor *src1_cal = src1;
     const int64_t blck_0 = 16;
     int is_0 = (src1->batch() == 1 && src1->head() == 1 && src1->batch() != src0->batch()) ? 0 : 1;
-#pragma omp parallel for collapse(4) num_threads(thread_count)
-    for (int b = 0; b < src0->batch(); b++) {
-        for (int h = 0; h < src0->head(); h++) {
-            for (int m = 0; m < M; m++) {
-                for (int block = 0; block < N / blck_0 + 1; block++) {
-                    for (int n = block * blck_0; n < (block + 1) * blck_0 && n < N; n++) {
-                        int s_1;
-                        int d_1;
-                        int s_0;
-                        int d_0;
-                        if (!transpose0 && transpose1) {
-                            s_1 = n;
-                            d_1 = 0;
-                            s_0 = m;
-                            d_0 = 0;
-                        } else if (!transpose0 && !transpose1) {
-                            s_1 = 0;
-                            d_1 = n;
-                            s_0 = m;
-                            d_0 = 0;
-                        } else {
-                            s_1 = 0;
-                            d_1 = n;
-                            s_0 = 0;
-                            d_0 = m;
-                        }
-                        float tmp = 0;
-                        vec_dot(K, &tmp,
-                                (char *)src1_cal->rawHostPtr()
-                                    + src1_cal->offset(b * is_0, h * is_0, s_1, d_1)
-                                          * src1_type_size / src1_blck_size,
-                                (char *)src0_cal->rawHostPtr()
-                                    + src0_cal->offset(b, h, s_0, d_0) * src0_type_size
-                                          / src0_blck_size);
-                        if (dst->dtypeAt(b, h, m, n) == MLLM_TYPE_F32) {
-                            dst->setDataAt<float>(b, h, m, n, tmp);
-                            if (support_bias) {
-                                *dst->ptrAt<float>(b, h, m, n) += bias->dataAt<float>(0, 0, 0, n);
-                            }
-                        } else if (dst->dtypeAt(b, h, m, n) == MLLM_TYPE_F16) {
-                            if (support_bias) {
-                                *dst->ptrAt<mllm_fp16_t>(b, h, m, n) =
-                                    MLLM_FP32_TO_FP16(tmp + bias->dataAt<float>(0, 0, 0, n));
-                            } else {
-                                *dst->ptrAt<mllm_fp16_t>(b, h, m, n) = MLLM_FP32_TO_FP16(tmp);
-                            }
-                        } else {
-                            std::cout << "Not support type [Matmul]" << std::endl;
-                        }
+    const int64_t n_blocks = N / blck_0 + 1;
+    const int64_t heads0 = src0->head();
+    parallel_for(src0->batch() * heads0 * M * n_blocks, thread_count, [&](int64_t begin, int64_t end) {
+        for (int64_t idx = begin; idx < end; idx++) {
+            const int b = idx / (heads0 * M * n_blocks);
+            const int h = idx / (M * n_blocks) % heads0;
+            const int m = idx / n_blocks % M;
+            const int block = idx % n_blocks;
+            for (int n = block * blck_0; n < (block + 1) * blck_0 && n < N; n++) {
+                int s_1;
+                int d_1;
+                int s_0;
+                int d_0;
+                if (!transpose0 && transpose1) {
+                    s_1 = n;
+                    d_1 = 0;
+                    s_0 = m;
+                    d_0 = 0;
+                } else if (!transpose0 && !transpose1) {
+                    s_1 = 0;
+                    d_1 = n;
+                    s_0 = m;
+                    d_0 = 0;
+                } else {
+                    s_1 = 0;
+                    d_1 = n;
+                    s_0 = 0;
+                    d_0 = m;
+                }
+                float tmp = 0;
+                vec_dot(K, &tmp,
+                        (char *)src1_cal->rawHostPtr()
+                            + src1_cal->offset(b * is_0, (h / head_rep) * is_0, s_1, d_1)
+                                  * src1_type_size / src1_blck_size,
+                        (char *)src0_cal->rawHostPtr()
+                            + src0_cal->offset(b, h, s_0, d_0) * src0_type_size
+                                  / src0_blck_size);
+                if (dst->dtypeAt(b, h, m, n) == MLLM_TYPE_F32) {
+                    dst->setDataAt<float>(b, h, m, n, tmp);
+                    if (support_bias) {
+                        *dst->ptrAt<float>(b, h, m, n) += bias->dataAt<float>(0, 0, 0, n);
                     }
+                } else if (dst->dtypeAt(b, h, m, n) == MLLM_TYPE_F16) {
+                    if (support_bias) {
+                        *dst->ptrAt<mllm_fp16_t>(b, h, m, n) =
+                            MLLM_FP32_TO_FP16(tmp + bias->dataAt<float>(0, 0, 0, n));
+                    } else {
+                        *dst->ptrAt<mllm_fp16_t>(b, h, m, n) = MLLM_FP32_TO_FP16(tmp);
+                    }
+                } else {
+                    std::cout << "Not support type [Matmul]" << std::endl;
                 }
             }
         }
-    }
-    if (not_vec_dot_type) to->free();
+    });
+    if (free_to) to->free();
     return MLLM_NO_ERROR;
 }
 
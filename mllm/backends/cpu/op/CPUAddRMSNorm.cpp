@@ -0,0 +1,54 @@
+#include "CPUAddRMSNorm.hpp"
+#include "Types.hpp"
+#include "../compute/Arithmetic.hpp"
+
+namespace mllm {
+
+CPUAddRMSNorm::CPUAddRMSNorm(Backend *bn, string opName, int normSize, float epsilon, bool add_unit_offset, int threadCount) :
+    thread_count(threadCount),
+    Op(bn, opName) {
+    norm_ = std::make_unique<CPURMSNorm>(bn, opName, normSize, epsilon, add_unit_offset, threadCount);
+}
+
+ErrorCode CPUAddRMSNorm::reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
+    assert(inputs.size() == 2);
+    assert(outputs.size() == 2);
+    assert(inputs[0]->shape() == inputs[1]->shape());
+    for (auto &out : outputs) {
+        out->reshape(inputs[0]->batch(), inputs[0]->head(), inputs[0]->sequence(), inputs[0]->dimension());
+    }
+    return Op::reshape(inputs, outputs);
+}
+
+ErrorCode CPUAddRMSNorm::load(AbstructLoader &loader) {
+    norm_->load(loader);
+    return Op::load(loader);
+}
+
+ErrorCode CPUAddRMSNorm::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
+    auto &x = inputs[0];
+    auto &residual = inputs[1];
+    auto &sum = outputs[0];
+    auto &out = outputs[1];
+    assert(x->dtype() == MLLM_TYPE_F32 && residual->dtype() == MLLM_TYPE_F32);
+    const int dim = x->dimension();
+#pragma omp parallel for collapse(3) num_threads(thread_count)
+    for (int n = 0; n < x->batch(); n++) {
+        for (int h = 0; h < x->head(); h++) {
+            for (int s = 0; s < x->sequence(); s++) {
+                float *sum_row = sum->ptrAt<float>(n, h, s, 0);
+                mllm_add_fp32(x->ptrAt<float>(n, h, s, 0), residual->ptrAt<float>(n, h, s, 0), sum_row, dim);
+                norm_->normalize(sum_row, out->ptrAt<float>(n, h, s, 0), dim);
+            }
+        }
+    }
+    out->shareQuantizedCopy();
+    return Op::execute(inputs, outputs);
+}
+
+ErrorCode CPUAddRMSNorm::free(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
+    norm_->free({}, {});
+    return Op::free(inputs, outputs);
+}
+
+} // namespace mllm
@@ -0,0 +1,44 @@
+#ifndef MLLM_CPUADDRMSNORM_H
+#define MLLM_CPUADDRMSNORM_H
+
+#include "Op.hpp"
+#include "../CPUBackend.hpp"
+#include "CPURMSNorm.hpp"
+#include <memory>
+
+namespace mllm {
+
+/**
+ * Residual add + RMSNorm in one pass over each row: (x, residual) -> (x + residual, rmsnorm(x + residual)).
+ *
+ * The norm weights are those of the RMSNorm with the same name (<name>.weight), held by an inner
+ * CPURMSNorm. Like CPURMSNorm, the normalized output keeps the quantized copy made by the first
+ * mat_mul reading it (Tensor::shareQuantizedCopy).
+ */
+class CPUAddRMSNorm final : public Op {
+public:
+    CPUAddRMSNorm(Backend *bn, string opName, int normSize, float epsilon, bool add_unit_offset, int threadCount);
+    virtual ~CPUAddRMSNorm() = default;
+    virtual ErrorCode reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
+    virtual ErrorCode load(AbstructLoader &loader) override;
+    virtual ErrorCode execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
+    virtual ErrorCode free(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
+
+private:
+    int thread_count = 4;
+    std::unique_ptr<CPURMSNorm> norm_;
+};
+
+class CPUAddRMSNormCreator : public CPUBackend::Creator {
+public:
+    virtual Op *create(OpParam op_param, Backend *bn, string name, int threadCount) const {
+        int normSize = (int)op_param["norm_size"];
+        float epsilon = (float)op_param["epsilon"];
+        bool add_unit_offset = (op_param.find("add_unit_offset") == op_param.end()) ? false : op_param["add_unit_offset"];
+        return new CPUAddRMSNorm(bn, name, normSize, epsilon, add_unit_offset, threadCount);
+    }
+};
+
+} // namespace mllm
+
+#endif // MLLM_CPUADDRMSNORM_H
@@ -20,6 +20,9 @@ CPUConvolution2D::CPUConvolution2D(Backend *bn, string opName, int in_channel, i
     support_bias_ = bias;
     weight_.setBackend(bn);
     bias_.setBackend(bn);
+    patches_.setBackend(bn);
+    gemm_out_.setBackend(bn);
+    patchify_ = stride_[0] == kernel_size_[0] && stride_[1] == kernel_size_[1];
 
 #ifdef __ARM_NEON
     im2col_layout_.setBackend(bn);
@@ -86,15 +89,13 @@ ErrorCode CPUConvolution2D::load(AbstructLoader &loader) {
         weight_.setDtype(loader.getDataType(weight_.name()));
         weight_.alloc();
         loader.load(&weight_);
-        // #ifndef __ARM_NEON
-        kernal_ = reshape_conv2d_kernal_fp32(&weight_);
-        // #endif
     } else {
         weight_.setDtype(MLLM_TYPE_F32);
         weight_.alloc();
-        // #ifndef __ARM_NEON
+    }
+    // the patchify path reads weight_ as is, only the direct kernels need the reshaped copy
+    if (!(patchify_ && padding_type_ == VALID)) {
         kernal_ = reshape_conv2d_kernal_fp32(&weight_);
-        // #endif
     }
     if (support_bias_) {
         bias_.setName(name() + ".bias");
@@ -144,6 +145,10 @@ ErrorCode CPUConvolution2D::execute(vector<shared_ptr<Tensor>> inputs, vector<sh
         break;
     }
     case VALID: {
+        if (patchify_) {
+            conv2d_fp32_patchify(inputs[0].get(), outputs[0].get(), &weight_, support_bias_, &bias_, &patches_, &gemm_out_, thread_count);
+            break;
+        }
         conv2d_fp32_VALID(inputs[0].get(), outputs[0].get(), kernal_, kernel_size_[0], kernel_size_[1], support_bias_, &bias_, stride_[0], stride_[1], thread_count);
         break;
     }
@@ -153,6 +158,8 @@ ErrorCode CPUConvolution2D::execute(vector<shared_ptr<Tensor>> inputs, vector<sh
 
 ErrorCode CPUConvolution2D::free(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
     weight_.free();
+    patches_.free();
+    gemm_out_.free();
     return Op::free(inputs, outputs);
 }
 
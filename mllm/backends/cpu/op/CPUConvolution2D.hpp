@@ -33,13 +33,17 @@ private:
     int padding_w_;
     Tensor weight_;
     Tensor bias_;
+    // stride == kernel: conv as patch gather + mat_mul (conv2d_fp32_patchify)
+    bool patchify_ = false;
+    Tensor patches_;
+    Tensor gemm_out_;
 
 #ifdef __ARM_NEON
     Tensor im2col_layout_;
     Tensor output_not_transposed_;
 #endif //! __ARM_NEON
 
-    float **kernal_;
+    float **kernal_ = nullptr;
     bool support_bias_;
 };
 
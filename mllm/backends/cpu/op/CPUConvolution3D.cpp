@@ -19,6 +19,9 @@ CPUConvolution3D::CPUConvolution3D(Backend *bn, string opName, int in_channel, i
     support_bias_ = bias;
     weight_.setBackend(bn);
     bias_.setBackend(bn);
+    patches_.setBackend(bn);
+    gemm_out_.setBackend(bn);
+    patchify_ = stride_[0] == kernel_size_[0] && stride_[1] == kernel_size_[1] && stride_[2] == kernel_size_[2];
 }
 
 ErrorCode CPUConvolution3D::reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
@@ -60,10 +63,12 @@ ErrorCode CPUConvolution3D::load(AbstructLoader &loader) {
         weight_.setDtype(loader.getDataType(weight_.name()));
         weight_.alloc();
         loader.load(&weight_);
-        kernal_ = reshape_conv3d_kernal_fp32(&weight_);
     } else {
         weight_.setDtype(MLLM_TYPE_F32);
         weight_.alloc();
+    }
+    // the patchify path reads weight_ as is, only conv3d_fp32_VALID needs the reshaped copy
+    if (!(patchify_ && padding_type_ == VALID)) {
         kernal_ = reshape_conv3d_kernal_fp32(&weight_);
     }
     if (support_bias_) {
@@ -90,6 +95,10 @@ ErrorCode CPUConvolution3D::execute(vector<shared_ptr<Tensor>> inputs, vector<sh
     }
     case VALID: {
         // conv3d_fp32_VALID(inputs[0].get(), outputs[0].get(), &weight_, support_bias_, &bias_,stride_[0], stride_[1], stride_[2], thread_count);
+        if (patchify_) {
+            conv3d_fp32_patchify(inputs[0].get(), outputs[0].get(), &weight_, support_bias_, &bias_, &patches_, &gemm_out_, thread_count);
+            break;
+        }
         conv3d_fp32_VALID(inputs[0].get(), outputs[0].get(), kernal_, kernel_size_[0], kernel_size_[1], kernel_size_[2], support_bias_, &bias_, stride_[0], stride_[1], stride_[2], thread_count);
         break;
     }
@@ -99,6 +108,8 @@ ErrorCode CPUConvolution3D::execute(vector<shared_ptr<Tensor>> inputs, vector<sh
 
 ErrorCode CPUConvolution3D::free(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
     weight_.free();
+    patches_.free();
+    gemm_out_.free();
     return Op::free(inputs, outputs);
 }
 
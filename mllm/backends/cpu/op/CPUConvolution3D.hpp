@@ -34,8 +34,12 @@ private:
     int padding_w_;
     Tensor weight_;
     Tensor bias_;
+    // stride == kernel: conv as patch gather + mat_mul (conv3d_fp32_patchify)
+    bool patchify_ = false;
+    Tensor patches_;
+    Tensor gemm_out_;
 
-    float **kernal_;
+    float **kernal_ = nullptr;
     bool support_bias_;
 };
 
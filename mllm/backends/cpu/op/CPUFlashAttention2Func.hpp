@@ -68,6 +68,11 @@ public:
         int threads = thread_count;
         threads = std::min(threads, v_head);
 
+        if (inputs.size() > 3) {
+            executeVarlen(inputs, outputs, kv_use_fp32, threads);
+            return ErrorCode::MLLM_NO_ERROR;
+        }
+
         int32_t br = q_sequence >= 4 ? 4 : 1;
         int32_t bc = q_sequence >= 4 ? 4 : 1;
         constexpr bool high_precision_exp = true;
@@ -123,6 +128,48 @@ public:
         }
         return ErrorCode::MLLM_NO_ERROR;
     }
+
+private:
+    // block-diagonal attention: inputs[3] holds cu_seqlens [0, e1, e2, ...], every [e_i, e_i+1) of the
+    // sequence only attends to itself (one image, or one Qwen2.5-VL window), so the cost is the sum of
+    // the squared segment lengths instead of the square of their sum
+    void executeVarlen(vector<shared_ptr<Tensor>> &inputs, vector<shared_ptr<Tensor>> &outputs, bool kv_use_fp32, int threads) {
+        auto q_tensor = inputs[0];
+        auto k_tensor = inputs[1];
+        auto v_tensor = inputs[2];
+        auto cu_seqlens = inputs[3];
+        auto o_tensor = outputs[0];
+        assert(q_tensor->ctype() != BHSD);
+        assert(q_tensor->sequence() == k_tensor->sequence());
+        const int q_head = q_tensor->head();
+        const int k_head = k_tensor->head();
+        const int dimension = q_tensor->dimension();
+        const int kv_type_size = kv_use_fp32 ? sizeof(float) : sizeof(mllm_fp16_t);
+        constexpr bool high_precision_exp = true;
+        for (int bch = 0; bch < q_tensor->batch(); ++bch) {
+            auto *o_ptr = o_tensor->ptrAt<float>(bch, 0, 0, 0);
+            auto *q_ptr = q_tensor->ptrAt<float>(bch, 0, 0, 0);
+            auto *k_ptr = (char *)k_tensor->rawHostPtr() + (size_t)k_tensor->offset(bch, 0, 0, 0) * kv_type_size;
+            auto *v_ptr = (char *)v_tensor->rawHostPtr() + (size_t)v_tensor->offset(bch, 0, 0, 0) * kv_type_size;
+            for (int sid = 1; sid < cu_seqlens->dimension(); ++sid) {
+                const int start = (int)cu_seqlens->dataAt<float>(0, 0, 0, sid - 1);
+                const int end = std::min((int)cu_seqlens->dataAt<float>(0, 0, 0, sid), q_tensor->sequence());
+                const int len = end - start;
+                if (len <= 0) {
+                    continue;
+                }
+                const int32_t block = len >= 4 ? 4 : 1;
+                flash_attention_2_forward(
+                    q_ptr + (size_t)start * q_head * dimension,
+                    k_ptr + (size_t)start * k_head * dimension * kv_type_size,
+                    v_ptr + (size_t)start * k_head * dimension * kv_type_size,
+                    o_ptr + (size_t)start * q_head * dimension,
+                    1, q_head, len, len, dimension,
+                    causal_mask_, kv_use_fp32, threads, block, block,
+                    q_head, k_head, high_precision_exp);
+            }
+        }
+    }
 };
 
 class CPUFlashAttention2FuncCreator : public CPUBackend::Creator {
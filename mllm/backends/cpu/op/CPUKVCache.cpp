@@ -2,12 +2,14 @@
 
 #include "CPUKVCache.hpp"
 #include "Context.hpp"
+#include "Module.hpp"
 #include "ParamLoader.hpp"
 #include "Types.hpp"
+#include "backends/cpu/third_party/ggml/VecDotType.hpp"
 
 int n_pack = 16;
 namespace mllm {
-CPUKVCache::CPUKVCache(Backend *bn, string opName, int hidden, int head, int n_rep, bool fa2, int cache_max, int threadCount) :
+CPUKVCache::CPUKVCache(Backend *bn, string opName, int hidden, int head, int n_rep, bool fa2, bool share_heads, int cache_max, int threadCount) :
     thread_count(threadCount), Op(bn, opName) {
     cache_ = std::make_shared<Tensor>(1, head * n_rep, cache_max, hidden, bn, false);
     fa2_ = fa2;
@@ -45,12 +47,17 @@ CPUKVCache::CPUKVCache(Backend *bn, string opName, int hidden, int head, int n_r
     } else { // fa2
         n_rep = 1;
     }
+    if (share_heads) { // GQA heads are broadcast by the attention matmul
+        n_rep = 1;
+    }
     cache_limit_ = cache_max;
     n_rep_ = n_rep;
+    owner_ = Module::llm_model_ptr;
+    liveCaches().push_back(this);
     if (head > 0) {
         if (for_xnn_) cache_->setDtype(MLLM_TYPE_F32);
 
-        cache_->reshape(KVCache_batch, head * n_rep_, cache_limit_, hidden);
+        cache_->reshape(KVCache_batch, head * n_rep_, initialCapacity(), hidden);
         cache_->setName(name() + ".Cache");
         cache_->alloc();
 
@@ -79,7 +86,7 @@ ErrorCode CPUKVCache::reshape(vector<shared_ptr<Tensor>> inputs,
     if (cache_seq_len_ < 0) { //|| inputs[0]->batch() != cache_->batch()
         if (for_xnn_) cache_->setDtype(MLLM_TYPE_F32);
 
-        cache_->reshape(inputs[0]->batch(), inputs[0]->head() * n_rep_, cache_limit_,
+        cache_->reshape(inputs[0]->batch(), inputs[0]->head() * n_rep_, initialCapacity(),
                         inputs[0]->dimension());
         cache_->setName(name() + ".Cache");
         cache_->alloc();
@@ -126,10 +133,192 @@ ErrorCode CPUKVCache::reshape(vector<shared_ptr<Tensor>> inputs,
         exit(1);
         outputs[0]->reshape(inputs[0]->batch(), inputs[0]->head() * n_rep_, cache_limit_,
                             inputs[0]->dimension());
+    } else if (sequence > cache_->sequence()) {
+        // the rope output of this step already views the current buffer, growing here would lose it
+        MLLM_LOG_ERROR_STREAM << "\n[ERROR]: " << name() << " has room for " << cache_->sequence() << " tokens, "
+                              << sequence << " needed; call CPUKVCache::reserveAll before the forward" << std::endl;
+        exit(1);
     }
     return Op::reshape(inputs, outputs);
 }
 
+CPUKVCache::~CPUKVCache() {
+    auto &caches = liveCaches();
+    caches.erase(std::remove(caches.begin(), caches.end(), this), caches.end());
+}
+
+std::vector<CPUKVCache *> &CPUKVCache::liveCaches() {
+    static std::vector<CPUKVCache *> caches;
+    return caches;
+}
+
+std::map<const Module *, int> &CPUKVCache::otherCaches() {
+    static std::map<const Module *, int> caches;
+    return caches;
+}
+
+int CPUKVCache::initialCapacity() const {
+    if (KVCache_page_size <= 0) {
+        return cache_limit_;
+    }
+    int page = ((KVCache_page_size + (n_pack - 1)) / n_pack) * n_pack;
+    return std::min(page, cache_limit_);
+}
+
+std::vector<CPUKVCache *> CPUKVCache::cachesOf(const Module *model) {
+    std::vector<CPUKVCache *> caches;
+    for (auto *cache : liveCaches()) {
+        if (model == nullptr || cache->owner_ == model) {
+            caches.push_back(cache);
+        }
+    }
+    return caches;
+}
+
+void CPUKVCache::reserveAll(int sequence, const Module *model) {
+    if (KVCache_page_size <= 0) {
+        return;
+    }
+    for (auto *cache : liveCaches()) {
+        if (cache->owner_ == model) {
+            cache->reserve(sequence);
+        }
+    }
+}
+
+void CPUKVCache::reserve(int sequence) {
+    if (KVCache_page_size <= 0 || cache_seq_len_ < 0 || cache_->count() == 0) {
+        return;
+    }
+    int need = cache_seq_len_ + sequence;
+    if (need > cache_limit_) {
+        MLLM_LOG_ERROR_STREAM << "\n[ERROR]: Current tokens exceed cache limit: " << need << ">"
+                              << cache_limit_ << ";"
+                              << "\n         Please set args `--limits` >" << cache_limit_ << std::endl;
+        exit(1);
+    }
+    if (need > cache_->sequence()) {
+        growCache(need);
+    }
+}
+
+/**
+ * @brief grow the sequence capacity of cache_ to a whole number of pages >= min_sequence
+ * (min_sequence <= cache_limit_). The capacity at least doubles and stops at cache_limit_, so a long
+ * generation copies each cached token O(1) times on average instead of once per page.
+ * The grown buffer is filled before the old one is released, one copy of the first cache_seq_len_
+ * tokens per layout (BSHD/BHSD/BHDS); cache_ keeps its identity as the master of the K/V views.
+ * Views taken before the call still point at the old buffer, so this only runs between forwards.
+ */
+void CPUKVCache::growCache(int min_sequence) {
+    int page = ((KVCache_page_size + (n_pack - 1)) / n_pack) * n_pack;
+    int target = std::max(min_sequence, 2 * cache_->sequence());
+    int new_capacity = std::min(((target + page - 1) / page) * page, cache_limit_);
+    assert(new_capacity >= min_sequence);
+
+    auto grown = std::make_shared<Tensor>(backend_);
+    grown->setCtype(cache_->ctype());
+    grown->setDtype(cache_->dtype());
+    grown->reshape(cache_->batch(), cache_->head(), new_capacity, cache_->dimension());
+    grown->alloc();
+    memset(grown->rawHostPtr(), 0, grown->cntSize());
+
+    auto dtype = cache_->dtype();
+    const int used = std::max(0, std::min(cache_seq_len_, cache_->sequence()));
+    // a BHDS row runs along the sequence and is stored in whole blocks, as in forEachRow
+    const int block = blck_size(dtype);
+    const int bhds_len = std::min((used + block - 1) / block * block, cache_->sequence());
+    char *src = (char *)cache_->rawHostPtr();
+    char *dst = (char *)grown->rawHostPtr();
+    for (int b = 0; b < cache_->batch(); ++b) {
+        for (int h = 0; h < cache_->head(); ++h) {
+            if (cache_->ctype() == BHDS) {
+                for (int d = 0; d < cache_->dimension(); ++d) {
+                    memcpy(dst + DataTypeSize(dtype, grown->offset(b, h, 0, d)),
+                           src + DataTypeSize(dtype, cache_->offset(b, h, 0, d)),
+                           DataTypeSize(dtype, bhds_len));
+                }
+            } else {
+                for (int s = 0; s < used; ++s) {
+                    memcpy(dst + DataTypeSize(dtype, grown->offset(b, h, s, 0)),
+                           src + DataTypeSize(dtype, cache_->offset(b, h, s, 0)),
+                           DataTypeSize(dtype, cache_->dimension()));
+                }
+            }
+        }
+    }
+    cache_->reshape(cache_->batch(), cache_->head(), new_capacity, cache_->dimension());
+    // cache_ drops its old buffer and keeps `grown` alive through the handle
+    cache_->setHostPtr(grown->rawHostPtr(), std::shared_ptr<void>(grown, grown->rawHostPtr()));
+    cache_->cache_seq_len_ = cache_seq_len_;
+}
+
+void CPUKVCache::forEachRow(int len, const std::function<void(size_t, size_t)> &fn) const {
+    auto dtype = cache_->dtype();
+    // a BHDS row runs along the sequence and a quantized one (Q8_0) is stored in whole blocks,
+    // so the first len tokens take ceil(len / block) blocks whatever the current capacity
+    const int block = blck_size(dtype);
+    const int row_len = (len + block - 1) / block * block;
+    assert(cache_->ctype() != BHDS || row_len <= cache_->sequence());
+    for (int b = 0; b < cache_->batch(); ++b) {
+        for (int h = 0; h < cache_->head(); ++h) {
+            if (cache_->ctype() == BHDS) {
+                for (int d = 0; d < cache_->dimension(); ++d) {
+                    fn(DataTypeSize(dtype, cache_->offset(b, h, 0, d)), DataTypeSize(dtype, row_len));
+                }
+            } else {
+                for (int s = 0; s < len; ++s) {
+                    fn(DataTypeSize(dtype, cache_->offset(b, h, s, 0)), DataTypeSize(dtype, cache_->dimension()));
+                }
+            }
+        }
+    }
+}
+
+bool CPUKVCache::setCacheSeqLen(int len) {
+    if (cache_seq_len_ < 0 || cache_->count() == 0) {
+        return false;
+    }
+    if (len > cache_limit_) {
+        return false;
+    }
+    // room for the whole blocks forEachRow copies
+    const int block = blck_size(cache_->dtype());
+    const int rows = cache_->ctype() == BHDS ? std::min((len + block - 1) / block * block, cache_limit_) : len;
+    if (rows > cache_->sequence()) {
+        growCache(rows);
+    }
+    cache_seq_len_ = len;
+    cache_->cache_seq_len_ = cache_seq_len_;
+    return true;
+}
+
+void CPUKVCache::compactRow(int b, const std::vector<int> &keep) {
+    for (int i = 0; i < (int)keep.size(); ++i) {
+        if (keep[i] != i) {
+            moveToken(b, keep[i], i);
+        }
+    }
+}
+
+void CPUKVCache::moveToken(int b, int from, int to) {
+    auto dtype = cache_->dtype();
+    char *base = (char *)cache_->rawHostPtr();
+    for (int h = 0; h < cache_->head(); ++h) {
+        if (cache_->ctype() == BHDS) {
+            for (int d = 0; d < cache_->dimension(); ++d) {
+                memmove(base + DataTypeSize(dtype, cache_->offset(b, h, to, d)),
+                        base + DataTypeSize(dtype, cache_->offset(b, h, from, d)),
+                        DataTypeSize(dtype, 1));
+            }
+        } else {
+            memmove(base + DataTypeSize(dtype, cache_->offset(b, h, to, 0)),
+                    base + DataTypeSize(dtype, cache_->offset(b, h, from, 0)),
+                    DataTypeSize(dtype, cache_->dimension()));
+        }
+    }
+}
+
 ErrorCode CPUKVCache::load(AbstructLoader &loader) {
     return Op::load(loader);
 }
@@ -243,6 +432,15 @@ ErrorCode CPUKVCache::execute(vector<shared_ptr<Tensor>> inputs,
             std::cout << "ERROR Ctype in KVCcache;" << std::endl;
         }
     }
+    // continuous batching: decoding rows keep their K/V packed instead of at the padded step end
+    auto &batching = Context::Instance().batching_state();
+    if (batching.isActive()) {
+        for (const auto &move : batching.kvMoves()) {
+            if (move.row < cache_->batch()) {
+                moveToken(move.row, move.from, move.to);
+            }
+        }
+    }
     return Op::execute(inputs, outputs);
 }
 
@@ -5,13 +5,18 @@
 #include "Op.hpp"
 #include "../CPUBackend.hpp"
 #include "ParamLoader.hpp"
+#include <functional>
+#include <map>
 
 namespace mllm {
 
+class Module;
+
 class CPUKVCache final : public Op {
 public:
-    CPUKVCache(Backend *bn, string opName, int hidden, int head, int n_rep, bool fa2, int cache_max = 100, int threadCount = 4);
-    virtual ~CPUKVCache() = default;
+    // share_heads: keep only the KV heads (no n_rep copies), the consumer indexes head h / n_rep itself
+    CPUKVCache(Backend *bn, string opName, int hidden, int head, int n_rep, bool fa2, bool share_heads = false, int cache_max = 100, int threadCount = 4);
+    virtual ~CPUKVCache();
     virtual ErrorCode reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
     virtual ErrorCode load(AbstructLoader &loader) override;
     virtual ErrorCode execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
@@ -34,8 +39,40 @@ public:
 
     ErrorCode updateVerifiedKVCache(const std::vector<unsigned int> &verified_position_ids);
 
+    // paged mode (KVCache_page_size > 0): make room for `sequence` more tokens in every cache of
+    // `model`. Must run before the step writes K/V, i.e. before the rope outputs are viewed into the cache.
+    static void reserveAll(int sequence, const Module *model);
+    void reserve(int sequence);
+
+    // the live caches created while `model` was loaded or traced (Module::llm_model_ptr), in
+    // creation order; every live cache for nullptr
+    static std::vector<CPUKVCache *> cachesOf(const Module *model);
+    // live CPUKVCacheSage / CPUKVCacheXp per model; CPUPrefixCache cannot snapshot those
+    static std::map<const Module *, int> &otherCaches();
+
 private:
+    // CPUPrefixCache snapshots / restores the first tokens of cache_ through these,
+    // BatchScheduler sets the shared length and compacts rows, DraftModelDecoder drops rejected drafts
+    friend class CPUPrefixCache;
+    friend class BatchScheduler;
+    friend class DraftModelDecoder;
+    // the fused rope + kv cache op drives a k and a v cache directly
+    friend class CPURoPEKVCache;
+    // visit the first `len` tokens of cache_ as contiguous rows of (byte offset, bytes)
+    void forEachRow(int len, const std::function<void(size_t, size_t)> &fn) const;
+    // make room for `len` tokens and mark them as cached; false if they cannot fit
+    bool setCacheSeqLen(int len);
+    // move the tokens at positions `keep` (ascending) of batch row b to positions [0, keep.size())
+    void compactRow(int b, const std::vector<int> &keep);
+    // copy the K/V of position `from` of batch row b to position `to`, every head
+    void moveToken(int b, int from, int to);
+
+    int initialCapacity() const;
+    void growCache(int min_sequence);
+    static std::vector<CPUKVCache *> &liveCaches();
+
     int thread_count = 4;
+    const Module *owner_ = nullptr;
 
     int cache_seq_len_ = -999;
     int n_rep_ = 1;
@@ -55,7 +92,8 @@ public:
         int hidden = (int)op_param["hidden"];
         int head = (int)op_param["head"];
         bool fa2 = (bool)op_param["fa2"];
-        auto ret = new CPUKVCache(bn, name, hidden, head, n_rep, fa2, cache_max, threadCount);
+        bool share_heads = (bool)op_param["share_heads"];
+        auto ret = new CPUKVCache(bn, name, hidden, head, n_rep, fa2, share_heads, cache_max, threadCount);
         ret->setForXnn(for_xnn);
         return ret;
     }
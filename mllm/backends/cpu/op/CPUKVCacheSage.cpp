@@ -1,6 +1,8 @@
 
 
 #include "CPUKVCacheSage.hpp"
+#include "CPUKVCache.hpp"
+#include "Module.hpp"
 #include "ParamLoader.hpp"
 #include "Types.hpp"
 #include "../compute/SageQuantize.hpp"
@@ -16,6 +18,8 @@ CPUKVCacheSage::CPUKVCacheSage(Backend *bn, string opName, int hidden, int head,
 
     cache_limit_ = cache_max;
     n_rep_ = n_rep;
+    owner_ = Module::llm_model_ptr;
+    CPUKVCache::otherCaches()[owner_]++;
     if (head > 0) {
         // cache_->setCtype(BHSD);
         cache_->reshape(1, head * n_rep_, cache_limit_, hidden);
@@ -29,6 +33,12 @@ CPUKVCacheSage::CPUKVCacheSage(Backend *bn, string opName, int hidden, int head,
     }
 }
 
+CPUKVCacheSage::~CPUKVCacheSage() {
+    if (--CPUKVCache::otherCaches()[owner_] == 0) {
+        CPUKVCache::otherCaches().erase(owner_);
+    }
+}
+
 ErrorCode CPUKVCacheSage::reshape(vector<shared_ptr<Tensor>> inputs,
                                   vector<shared_ptr<Tensor>> outputs) {
     assert(inputs.size() == 1);
@@ -9,10 +9,12 @@
 
 namespace mllm {
 
+class Module;
+
 class CPUKVCacheSage final : public Op {
 public:
     CPUKVCacheSage(Backend *bn, string opName, int hidden, int head, int n_rep, bool fa2, int cache_max = 100, int threadCount = 4);
-    virtual ~CPUKVCacheSage() = default;
+    virtual ~CPUKVCacheSage();
     virtual ErrorCode reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
     virtual ErrorCode load(AbstructLoader &loader) override;
     virtual ErrorCode execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
@@ -31,6 +33,7 @@ public:
 
 private:
     int thread_count = 4;
+    const Module *owner_ = nullptr;
 
     int cache_seq_len_ = -999;
     int n_rep_ = 1;
@@ -1,4 +1,6 @@
 #include "backends/cpu/op/CPUKVCacheXp.hpp"
+#include "backends/cpu/op/CPUKVCache.hpp"
+#include "Module.hpp"
 #include "Types.hpp"
 
 namespace mllm {
@@ -7,6 +9,14 @@ CPUKVCacheXp::CPUKVCacheXp(Backend *bn, const string &op_name, int n_rep, int ca
     Op(bn, op_name), n_rep_(n_rep), cache_limit_(cache_max), thread_count_(thread_count) {
     cache_.setBackend(bn);
     cache_.setDtype(MLLM_TYPE_F32);
+    owner_ = Module::llm_model_ptr;
+    CPUKVCache::otherCaches()[owner_]++;
+}
+
+CPUKVCacheXp::~CPUKVCacheXp() {
+    if (--CPUKVCache::otherCaches()[owner_] == 0) {
+        CPUKVCache::otherCaches().erase(owner_);
+    }
 }
 
 ErrorCode CPUKVCacheXp::reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
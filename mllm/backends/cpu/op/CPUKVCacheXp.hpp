@@ -15,9 +15,11 @@
 
 namespace mllm {
 
+class Module;
+
 class CPUKVCacheXp final : public Op {
 public:
-    ~CPUKVCacheXp() override = default;
+    ~CPUKVCacheXp() override;
     CPUKVCacheXp(Backend *bn, const string &op_name, int n_rep, int cache_max = 100, int thread_count = 4);
     ErrorCode reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
     ErrorCode load(AbstructLoader &loader) override;
@@ -35,6 +37,7 @@ public:
 
 private:
     Tensor cache_;
+    const Module *owner_ = nullptr;
     int thread_count_ = 4;
     int cache_seq_len_ = -999;
     int n_rep_ = 1;
@@ -0,0 +1,159 @@
+#include "CPULMHead.hpp"
+#include "Context.hpp"
+#include "Types.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "backends/cpu/third_party/ggml/VecDotType.hpp"
+
+namespace mllm {
+
+// rows per step above which the shortlist is not tried (prefill logits are computed in full)
+static constexpr int kShortlistMaxRows = 4;
+
+CPULMHead::CPULMHead(Backend *bn, string opName, int in_features, int vocab_size, int threadCount) :
+    thread_count(threadCount),
+    Op(bn, opName) {
+    in_features_ = in_features;
+    vocab_size_ = vocab_size;
+    weight_.setBackend(bn);
+}
+
+ErrorCode CPULMHead::reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
+    assert(inputs.size() == 1);
+    assert(outputs.size() == 1);
+    if (inputs[0]->count() == 0) {
+        outputs[0]->reshape(0, 0, 0, 0);
+        return Op::reshape(inputs, outputs);
+    }
+    assert(inputs[0]->head() == 1);
+    assert(in_features_ == inputs[0]->dimension());
+    outputs[0]->reshape(inputs[0]->batch(), inputs[0]->head(), inputs[0]->sequence(), vocab_size_);
+    return Op::reshape(inputs, outputs);
+}
+
+ErrorCode CPULMHead::load(AbstructLoader &loader) {
+    weight_.setName(name().substr(0, name().rfind(".lm_head")) + ".weight");
+    weight_.reshape(1, 1, vocab_size_, in_features_);
+    if (loader.getDataType(weight_.name()) != MLLM_TYPE_COUNT) {
+        weight_.setDtype(loader.getDataType(weight_.name()));
+        weight_.alloc();
+        loader.load(&weight_);
+    } else {
+        weight_.setDtype(Op::noLoadWeightsDtype());
+        weight_.alloc();
+    }
+    return Op::load(loader);
+}
+
+bool CPULMHead::shortlistRows(Tensor *input, Tensor *output) {
+    auto &state = Context::Instance().lm_head_state();
+    marked_.assign(vocab_size_, 0);
+    tokens_.clear();
+    // an allowed set is exact on its own: every token that may be picked gets its logit
+    const bool constrained = !state.allowed().empty();
+    for (int t : constrained ? state.allowed() : state.shortlist()) {
+        if (t >= 0 && t < vocab_size_ && !marked_[t]) {
+            marked_[t] = 1;
+            tokens_.push_back(t);
+        }
+    }
+    if (tokens_.empty()) {
+        return false;
+    }
+    const int K = in_features_;
+    const int B = input->batch();
+    const int S = input->sequence();
+    const int T = tokens_.size();
+    const auto w_type = weight_.dtype();
+    const auto vec_dot_type = type_traits[w_type].vec_dot_type;
+    auto vec_dot = type_traits[w_type].vec_dot;
+    const size_t w_row = row_size(w_type, K);
+    const size_t x_row = row_size(vec_dot_type, K);
+    const bool convert = vec_dot_type != MLLM_TYPE_F32;
+    if (convert) {
+        x_vec_dot_.resize(B * S * x_row);
+        for (int r = 0; r < B * S; r++) {
+            type_traits[vec_dot_type].from_float(input->ptrAt<float>(r / S, 0, r % S, 0), x_vec_dot_.data() + r * x_row, K);
+        }
+    }
+    const auto *w = (const char *)weight_.rawHostPtr();
+    for (int r = 0; r < B * S; r++) {
+        const int b = r / S;
+        const int s = r % S;
+        const void *x = convert ? (const void *)(x_vec_dot_.data() + r * x_row) : (const void *)input->ptrAt<float>(b, 0, s, 0);
+        float *logits = output->ptrAt<float>(b, 0, s, 0);
+        std::fill(logits, logits + vocab_size_, -std::numeric_limits<float>::infinity());
+#pragma omp parallel for num_threads(thread_count)
+        for (int i = 0; i < T; i++) {
+            vec_dot(K, &logits[tokens_[i]], w + tokens_[i] * w_row, x);
+        }
+        if (constrained) {
+            continue;
+        }
+        float max_logit = -std::numeric_limits<float>::infinity();
+        for (int t : tokens_) {
+            max_logit = std::max(max_logit, logits[t]);
+        }
+        float sum = 0;
+        for (int t : tokens_) {
+            sum += std::exp(logits[t] - max_logit);
+        }
+        if (1.0f / sum < state.confidence()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void CPULMHead::maskToAllowed(Tensor *output) {
+    auto &allowed = Context::Instance().lm_head_state().allowed();
+    marked_.assign(vocab_size_, 0);
+    for (int t : allowed) {
+        if (t >= 0 && t < vocab_size_) {
+            marked_[t] = 1;
+        }
+    }
+    for (int b = 0; b < output->batch(); b++) {
+        for (int s = 0; s < output->sequence(); s++) {
+            float *logits = output->ptrAt<float>(b, 0, s, 0);
+            for (int t = 0; t < vocab_size_; t++) {
+                if (!marked_[t]) {
+                    logits[t] = -std::numeric_limits<float>::infinity();
+                }
+            }
+        }
+    }
+}
+
+ErrorCode CPULMHead::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
+    if (inputs[0]->count() == 0) {
+        return Op::execute(inputs, outputs);
+    }
+    assert(inputs[0]->dtype() == MLLM_TYPE_F32);
+    assert(outputs[0]->dtype() == MLLM_TYPE_F32);
+    auto &state = Context::Instance().lm_head_state();
+    const bool enabled = state.isEnabled();
+    const bool rows_independent = weight_.dtype() != MLLM_TYPE_KLEIDIAI_Q4_0 && type_traits[weight_.dtype()].vec_dot != nullptr;
+    if (enabled && rows_independent && inputs[0]->batch() * inputs[0]->sequence() <= kShortlistMaxRows) {
+        bool confident = shortlistRows(inputs[0].get(), outputs[0].get());
+        state.countStep(!confident);
+        if (confident) {
+            state.allowed().clear();
+            return Op::execute(inputs, outputs);
+        }
+    }
+    mat_mul(inputs[0].get(), &weight_, outputs[0].get(), false, nullptr, false, true, thread_count);
+    if (enabled && !state.allowed().empty()) {
+        maskToAllowed(outputs[0].get());
+    }
+    state.allowed().clear();
+    return Op::execute(inputs, outputs);
+}
+
+ErrorCode CPULMHead::free(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
+    weight_.free();
+    return Op::free(inputs, outputs);
+}
+
+} // namespace mllm
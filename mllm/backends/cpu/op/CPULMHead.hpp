@@ -0,0 +1,59 @@
+#ifndef MLLM_CPULMHEAD_H
+#define MLLM_CPULMHEAD_H
+
+#include "Op.hpp"
+#include "../CPUBackend.hpp"
+#include "../compute/Matmul.hpp"
+
+namespace mllm {
+
+class Tensor;
+/**
+ * LM head of a tied-embedding model: logits = x * embedding^T.
+ *
+ * The op is named <embedding>.lm_head and loads <embedding>.weight in its stored dtype, the
+ * logits go through mat_mul / vec_dot of that dtype (no dequantized copy). With
+ * Context::lm_head_state() enabled, decode rows only dot the shortlist and fall back to the full
+ * vocabulary when the shortlist is not confident; a step with allowed tokens dots exactly those,
+ * and the full pass masks the others to -inf (see LMHeadStateManager).
+ */
+class CPULMHead final : public Op {
+public:
+    CPULMHead(Backend *bn, string opName, int in_features, int vocab_size, int threadCount);
+    virtual ~CPULMHead() = default;
+    virtual ErrorCode reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
+    virtual ErrorCode load(AbstructLoader &loader) override;
+    virtual ErrorCode execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
+    virtual ErrorCode free(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
+
+    Tensor &weight() {
+        return weight_;
+    }
+
+private:
+    // false if some row was not confident and the full pass has to run
+    bool shortlistRows(Tensor *input, Tensor *output);
+    // -inf for every token outside the allowed set of this step
+    void maskToAllowed(Tensor *output);
+
+    int in_features_;
+    int vocab_size_;
+    int thread_count = 4;
+    Tensor weight_;
+    std::vector<int> tokens_;     // shortlist or allowed, deduplicated
+    std::vector<uint8_t> marked_; // per vocab id, for the deduplication and the allowed mask
+    std::vector<char> x_vec_dot_;
+};
+
+class CPULMHeadCreator : public CPUBackend::Creator {
+public:
+    virtual Op *create(OpParam op_param, Backend *bn, string name, int threadCount) const {
+        int in_features = op_param["in_features"];
+        int vocab_size = op_param["vocab_size"];
+        return new CPULMHead(bn, name, in_features, vocab_size, threadCount);
+    }
+};
+
+} // namespace mllm
+
+#endif // MLLM_CPULMHEAD_H
@@ -112,6 +112,8 @@ public:
             outputs[0]->setCtype(BHSD);
         }
         assert(inputs[0]->dimension() == inputs[1]->sequence());
+        // inputs[1] may be an un-replicated GQA KV cache with fewer heads, see execute
+        assert(inputs[1]->head() > 0 && inputs[0]->head() % inputs[1]->head() == 0);
         outputs[0]->reshape(inputs[0]->batch(), inputs[0]->head(), inputs[0]->sequence(), inputs[1]->dimension());
         outputs[0]->setDtype(inputs[0]->dtype());
         // 遵从原始 reshape 逻辑，在这里 alloc
@@ -121,30 +123,38 @@ public:
 
     ErrorCode execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override {
         if (inputs[0]->ctype() == BHSD) {
+            // head h of inputs[0] reads head h / head_rep of inputs[1] (GQA without replicated KV heads)
+            const int head_rep = inputs[0]->head() / inputs[1]->head();
 #ifdef ARM
             auto M = inputs[0]->sequence();
             auto N = inputs[1]->dimension();
             auto K = inputs[0]->dimension();
             size_t packed_b_size = mllm_kleidai_get_packed_b_fp32_size(N, K);
+            std::vector<float> packed_b_data(inputs[1]->dtype() == MLLM_TYPE_F32 ? packed_b_size : 0);
+            std::vector<mllm_fp16_t> packed_b_data_fp16(inputs[1]->dtype() == MLLM_TYPE_F32 ? 0 : packed_b_size);
             for (int b = 0; b < inputs[0]->batch(); b++) {
                 for (int h = 0; h < inputs[0]->head(); h++) {
+                    // the packed B is shared by the head_rep query heads of one KV group
+                    bool repack = h % head_rep == 0;
                     if (inputs[1]->dtype() == MLLM_TYPE_F32) {
-                        std::vector<float> packed_b_data(packed_b_size);
-                        mllm_kleidai_pack_b_and_bias_fp32(packed_b_data.data(),
-                                                          inputs[1]->ptrAt<float>(b, h, 0, 0),
-                                                          nullptr, N, K); // Pass nullptr for bias
+                        if (repack) {
+                            mllm_kleidai_pack_b_and_bias_fp32(packed_b_data.data(),
+                                                              inputs[1]->ptrAt<float>(b, h / head_rep, 0, 0),
+                                                              nullptr, N, K); // Pass nullptr for bias
+                        }
                         mllm_kleidai_gemm_fp32(outputs[0]->ptrAt<float>(b, h, 0, 0),
                                                inputs[0]->ptrAt<float>(b, h, 0, 0),
                                                packed_b_data.data(),
                                                M, N, K);
                     } else { // inputs[1]->dtype() == MLLM_TYPE_F16
-                        std::vector<mllm_fp16_t> packed_b_data(packed_b_size);
-                        mllm_kleidai_pack_b_and_bias_fp16(packed_b_data.data(),
-                                                          inputs[1]->ptrAt<mllm_fp16_t>(b, h, 0, 0),
-                                                          nullptr, N, K); // Pass nullptr for bias
+                        if (repack) {
+                            mllm_kleidai_pack_b_and_bias_fp16(packed_b_data_fp16.data(),
+                                                              inputs[1]->ptrAt<mllm_fp16_t>(b, h / head_rep, 0, 0),
+                                                              nullptr, N, K); // Pass nullptr for bias
+                        }
                         mllm_kleidai_gemm_fp16(outputs[0]->ptrAt<float>(b, h, 0, 0),
                                                inputs[0]->ptrAt<float>(b, h, 0, 0),
-                                               packed_b_data.data(),
+                                               packed_b_data_fp16.data(),
                                                M, N, K);
                     }
                 }
@@ -160,13 +170,13 @@ public:
                     if (inputs[1]->dtype() == MLLM_TYPE_F32) {
                         gemm_fp32(outputs[0]->ptrAt<float>(b, h, 0, 0),
                                   inputs[0]->ptrAt<float>(b, h, 0, 0),
-                                  inputs[1]->ptrAt<float>(b, h, 0, 0),
+                                  inputs[1]->ptrAt<float>(b, h / head_rep, 0, 0),
                                   M, N, K);
 
                     } else { // inputs[1]->dtype() == MLLM_TYPE_F16
                         gemm_fp32_fp16(outputs[0]->ptrAt<float>(b, h, 0, 0),
                                        inputs[0]->ptrAt<float>(b, h, 0, 0),
-                                       inputs[1]->ptrAt<mllm_fp16_t>(b, h, 0, 0),
+                                       inputs[1]->ptrAt<mllm_fp16_t>(b, h / head_rep, 0, 0),
                                        M, N, K);
                     }
                 }
@@ -3,7 +3,8 @@
 #include "Tensor.hpp"
 #include "Timing.hpp"
 #include "backends/cpu/third_party/ggml/VecDotFP32.hpp"
-#include "backends/cpu/third_party/ggml/VecDotQ4.hpp"
+#include "backends/cpu/third_party/ggml/QuantizeQ4.hpp"
+#include <cstring>
 
 namespace mllm {
 
@@ -28,6 +29,21 @@ ErrorCode CPURMSNorm::reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_p
     return Op::reshape(inputs, outputs);
 }
 
+void CPURMSNorm::normalize(const float *in, float *out, int dim) {
+    double sum_squares = 0.0F;
+    for (int d = 0; d < dim; d++) {
+        sum_squares += (double)in[d] * in[d];
+    }
+    const float mean = sum_squares / dim;
+    const float rms = 1.0f / sqrtf(mean + epsilon_);
+    if (out != in) {
+        memcpy(out, in, dim * sizeof(float));
+    }
+    vec_scale_f32(dim, out, rms);
+    const float *scale = scale_.empty() ? weight_.hostPtr<float>() : scale_.data();
+    vec_mul_fp32(dim, out, out, scale);
+}
+
 ErrorCode CPURMSNorm::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
     auto input = inputs[0];
     int batch = input->batch();
@@ -38,100 +54,12 @@ ErrorCode CPURMSNorm::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_p
     for (int h = 0; h < head; h++) {
         for (int n = 0; n < batch; n++) {
             for (int s = 0; s < seq; s++) {
-                double sum_squares = 0.0F;
-                // sum
-                for (int d = 0; d < dim; d++) {
-                    float value = input->dataAt<float>(n, h, s, d);
-                    sum_squares += (double)value * value;
-                }
-                const float mean = sum_squares / dim;
-                const float rms = 1.0f / sqrtf(mean + epsilon_);
-
-                memcpy(outputs[0]->ptrAt<float>(n, h, s, 0),
-                       inputs[0]->ptrAt<float>(n, h, s, 0),
-                       dim * sizeof(float));
-                vec_scale_f32(dim, outputs[0]->ptrAt<float>(n, h, s, 0), rms);
-            }
-        }
-    }
-
-// #pragma omp parallel for collapse(4) num_threads(thread_count)
-//     for (int h = 0; h < head; h++) {
-//         for (int n = 0; n < batch; n++) {
-//             for (int s = 0; s < seq; s++) {
-//                 for (int d = 0; d < dim; d++) {
-//                     float weight = weight_.dataAt<float>(0, 0, 0, d);
-//                     if (add_unit_offset_) {
-//                         *outputs[0]->ptrAt<float>(n, h, s, d) *= (1 + weight);
-//                     } else {
-//                         *outputs[0]->ptrAt<float>(n, h, s, d) *= (weight);
-//                     }
-//                 }
-//             }
-//         }
-//     }
-// 第二部分：应用权重乘法
-#pragma omp parallel for collapse(3) num_threads(thread_count)
-    for (int h = 0; h < head; h++) {
-        for (int n = 0; n < batch; n++) {
-            for (int s = 0; s < seq; s++) {
-                float *output_vec_ptr = outputs[0]->ptrAt<float>(n, h, s, 0);
-
-                // 根据 weight_ 的数据类型处理
-                if (weight_.dtype() == MLLM_TYPE_F32) {
-                    // 如果权重是FP32类型
-                    float *weight_vec_ptr = weight_.ptrAt<float>(0, 0, 0, 0);
-                    if (add_unit_offset_) {
-                        // 如果需要加1，创建 (1 + weight) 的临时向量
-                        float *adjusted_weight_vec = new float[dim];
-                        for (int d_idx = 0; d_idx < dim; ++d_idx) {
-                            adjusted_weight_vec[d_idx] = 1.0f + weight_vec_ptr[d_idx];
-                        }
-                        // 进行逐元素乘法：output_vec_ptr *= adjusted_weight_vec
-                        vec_mul_fp32(dim, output_vec_ptr, output_vec_ptr, adjusted_weight_vec);
-                        delete[] adjusted_weight_vec; // 释放临时内存
-                    } else {
-                        // 直接使用 vec_mul_fp32 进行逐元素乘法：output_vec_ptr *= weight_vec_ptr
-                        vec_mul_fp32(dim, output_vec_ptr, output_vec_ptr, weight_vec_ptr);
-                    }
-                } else if (weight_.dtype() == MLLM_TYPE_Q4_0) {
-                    // 如果权重是 Q4_0 类型
-
-                    if (add_unit_offset_) {
-                        // 场景：output_fp32[i] = output_fp32_original[i] * (1.0f + Dequantize(weight_q4_0[i]))
-                        // 这里的 `+1` 操作需要浮点数精度，因此必须先反量化 Q4_0 权重。
-                        // 这将导致操作回到 FP32 * FP32 的逐元素乘法。
-                        float *dequantized_and_adjusted_weight_fp32 = new float[dim];
-                        // 反量化 Q4_0 权重
-                        dequantize_row_q4_0(weight_.ptrAt<float>(0, 0, 0, 0), dequantized_and_adjusted_weight_fp32, dim);
-                        // 逐元素添加 1
-                        for (int i = 0; i < dim; ++i) {
-                            dequantized_and_adjusted_weight_fp32[i] = 1.0f + dequantized_and_adjusted_weight_fp32[i];
-                        }
-                        // 执行 FP32 向量的逐元素乘法：output_vec_ptr *= dequantized_and_adjusted_weight_fp32
-                        vec_mul_fp32(dim, output_vec_ptr, output_vec_ptr, dequantized_and_adjusted_weight_fp32);
-                        delete[] dequantized_and_adjusted_weight_fp32; // 释放临时内存
-
-                    } else {
-                        // 场景：output_fp32[i] = Dequantize(output_q8_0[i]) * Dequantize(weight_q4_0[i])
-                        // 这是用户期望的 Q4_0 * Q8_0 混合精度逐元素乘法。
-                        // 首先，将当前 FP32 输出向量量化为临时的 Q8_0 缓冲区。
-                        block_q8_0 *temp_output_q8_0 = new block_q8_0[dim / QK8_0];
-                        quantize_row_q8_0(output_vec_ptr, temp_output_q8_0, dim);
-
-                        // 执行 Q4_0 权重和 Q8_0 量化输出之间的逐元素乘法
-                        // 结果直接存储回 output_vec_ptr (FP32)
-                        vec_mul_q4_0_q8_0(dim, output_vec_ptr, weight_.hostPtr<void>(), temp_output_q8_0);
-
-                        delete[] temp_output_q8_0; // 释放临时内存
-                    }
-                } else {
-                    // 对于不支持的权重类型，此处断言以指示错误。
-                    assert(false && "Unsupported weight_ dtype in CPURMSNorm::execute");
-                }
+                normalize(input->ptrAt<float>(n, h, s, 0), outputs[0]->ptrAt<float>(n, h, s, 0), dim);
             }
         }
     }
+    // the q/k/v (or gate/up) projections reading the output quantize it once
+    outputs[0]->shareQuantizedCopy();
     return Op::execute(inputs, outputs);
 }
 ErrorCode CPURMSNorm::load(AbstructLoader &loader) {
@@ -146,6 +74,21 @@ ErrorCode CPURMSNorm::load(AbstructLoader &loader) {
         weight_.setDtype(MLLM_TYPE_F32);
         weight_.alloc();
     }
+    scale_.clear();
+    if (weight_.dtype() == MLLM_TYPE_Q4_0) {
+        scale_.resize(normSize_);
+        dequantize_row_q4_0(weight_.rawHostPtr(), scale_.data(), normSize_);
+    } else if (add_unit_offset_) {
+        assert(weight_.dtype() == MLLM_TYPE_F32 && "Unsupported weight_ dtype in CPURMSNorm");
+        scale_.assign(weight_.hostPtr<float>(), weight_.hostPtr<float>() + normSize_);
+    } else {
+        assert(weight_.dtype() == MLLM_TYPE_F32 && "Unsupported weight_ dtype in CPURMSNorm");
+    }
+    if (add_unit_offset_) {
+        for (auto &w : scale_) {
+            w += 1.0f;
+        }
+    }
     return Op::load(loader);
 }
 ErrorCode CPURMSNorm::free(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
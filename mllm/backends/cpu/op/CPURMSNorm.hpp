@@ -3,6 +3,7 @@
 
 #include "Op.hpp"
 #include "../CPUBackend.hpp"
+#include <vector>
 
 namespace mllm {
 
@@ -19,6 +20,9 @@ public:
         return weight_;
     }
 
+    // out = in / rms(in) * weight, in and out may alias
+    void normalize(const float *in, float *out, int dim);
+
 private:
     int thread_count = 4;
     float epsilon_;
@@ -26,6 +30,8 @@ private:
     Tensor weight_;
     int normSize_;
     bool add_unit_offset_;
+    // (1 + weight) or the dequantized weight, filled at load; empty when weight_ (F32) is used as is
+    std::vector<float> scale_;
     // Tensor bias_;
 };
 
@@ -1,22 +1,20 @@
 
 #include "CPURoPE.hpp"
 #include "Context.hpp"
+#include "Module.hpp"
 #include "Timing.hpp"
 #include "Types.hpp"
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <iostream>
+#include <map>
 #include "backends/cpu/third_party/ggml/QuantizeQ8.hpp"
 
 namespace mllm {
 
 vector<float> CPURoPE::theta_;
 
-vector<vector<float>> CPURoPE::sin_;
-vector<vector<float>> CPURoPE::cos_;
-int CPURoPE::global_pose_type_ = -1;
-int CPURoPE::ishape_old;
-
 // typedef float (*mllm_rope_init_func)(const OpParam &, std::vector<float> &);
 
 float _default_init_rope(const OpParam &config, vector<float> &theta) {
@@ -126,43 +124,19 @@ void sinusoidal_position_embedding_huggingface(int seq_len, int output_dim, cons
         }
     }
 }
-void sinusoidal_position_embedding_persimmon(int seq_len, int output_dim, vector<vector<float>> &sin, vector<vector<float>> &cos, int base = 10000) {
-    sin.resize(seq_len);
-    for (int i = 0; i < seq_len; ++i) {
-        sin[i].resize(output_dim);
-    }
-    cos.resize(seq_len);
-    for (int i = 0; i < seq_len; ++i) {
-        cos[i].resize(output_dim);
-    }
-#pragma omp parallel for num_threads(4)
-    for (int s = 0; s < seq_len; ++s) {
-        for (int d = 0; d < output_dim / 2; d += 1) {
-            int i = (int)d / 1;
-            float sin_value = sinf(s / std::pow(base, 2.0 * i / output_dim));
-            float cos_value = cosf(s / std::pow(base, 2.0 * i / output_dim));
-            sin[s][d] = sin_value;
-            cos[s][d] = cos_value;
-        }
-        for (int d = output_dim / 2; d < output_dim; d += 1) {
-            int i = (int)(d - output_dim / 2);
-            float sin_value = sinf(s / std::pow(base, 2.0 * i / output_dim));
-            float cos_value = cosf(s / std::pow(base, 2.0 * i / output_dim));
-            sin[s][d] = sin_value;
-            cos[s][d] = cos_value;
-        }
-    }
-}
-
 CPURoPE::CPURoPE(Backend *bn, string opName, int pose_type, int threadCount) :
     thread_count(threadCount),
     Op(bn, opName) {
+    owner_ = Module::llm_model_ptr;
+    liveRoPEs().push_back(this);
     pose_type_ = pose_type;
 }
 
 CPURoPE::CPURoPE(Backend *bn, string opName, int pose_type, float rope_theta, int max_position_embeddings, int threadCount) :
     thread_count(threadCount),
     Op(bn, opName) {
+    owner_ = Module::llm_model_ptr;
+    liveRoPEs().push_back(this);
     pose_type_ = pose_type;
     rope_theta_ = rope_theta;
     pos_max_ = max_position_embeddings;
@@ -171,6 +145,8 @@ CPURoPE::CPURoPE(Backend *bn, string opName, int pose_type, float rope_theta, in
 CPURoPE::CPURoPE(Backend *bn, string opName, int pose_type, float rope_theta, float partial_rotary_factor, int max_position_embeddings, int threadCount) :
     thread_count(threadCount),
     Op(bn, opName) {
+    owner_ = Module::llm_model_ptr;
+    liveRoPEs().push_back(this);
     pose_type_ = pose_type;
     rope_theta_ = rope_theta;
     partial_rotary_factor_ = partial_rotary_factor;
@@ -180,6 +156,8 @@ CPURoPE::CPURoPE(Backend *bn, string opName, int pose_type, float rope_theta, fl
 CPURoPE::CPURoPE(Backend *bn, string opName, OpParam &config, int threadCount) :
     thread_count(threadCount),
     Op(bn, opName) {
+    owner_ = Module::llm_model_ptr;
+    liveRoPEs().push_back(this);
     config_ = config;
     pose_type_ = config.at("pose_type");
     auto it = config.find("rope_theta");
@@ -197,33 +175,119 @@ CPURoPE::CPURoPE(Backend *bn, string opName, OpParam &config, int threadCount) :
     rope_type = (RoPEThetaType)config.at("rope_type");
 }
 
-ErrorCode CPURoPE::reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
-    //    std::cout << name() << "  CPURoPE  reshape" << std::endl;
-    assert(inputs.size() == 1);
-    assert(outputs.size() == 1);
-    outputs[0]->reshape(inputs[0]->batch(), inputs[0]->head(), inputs[0]->sequence(), inputs[0]->dimension());
-    ishape = inputs[0]->dimension() * partial_rotary_factor_;
-    // pos_max_ = 16384;
+CPURoPE::~CPURoPE() {
+    auto &ropes = liveRoPEs();
+    ropes.erase(std::remove(ropes.begin(), ropes.end(), this), ropes.end());
+    if (ropesOf(owner_).empty()) { // the last rope of its model
+        auto &windows = ropeWindows();
+        for (auto it = windows.begin(); it != windows.end();) {
+            it = std::get<0>(it->first) == owner_ ? windows.erase(it) : std::next(it);
+        }
+    }
+}
 
-    if (sin_.empty() || ishape_old < ishape || global_pose_type_ != pose_type_) {
+std::vector<CPURoPE *> &CPURoPE::liveRoPEs() {
+    static std::vector<CPURoPE *> ropes;
+    return ropes;
+}
+
+std::vector<CPURoPE *> CPURoPE::ropesOf(const Module *model) {
+    std::vector<CPURoPE *> ropes;
+    for (auto *rope : liveRoPEs()) {
+        if (model == nullptr || rope->owner_ == model) {
+            ropes.push_back(rope);
+        }
+    }
+    return ropes;
+}
+
+std::map<CPURoPE::RoPEKey, CPURoPE::RoPEWindow> &CPURoPE::ropeWindows() {
+    static std::map<RoPEKey, RoPEWindow> windows;
+    return windows;
+}
+
+// column d of a sin/cos row is sin/cos(angle) * scale[d] in the layout the kernels index, the
+// angle rounded to float as sinusoidal_position_embedding_* (and the persimmon table) did
+void CPURoPE::configure(RoPEWindow &w) {
+    w.dim = ishape;
+    w.freq.assign(ishape, 0.0f);
+    w.period.clear();
+    w.scale.assign(ishape, 1.0f);
+    if (pose_type_ == PERSIMMONROPE) {
+        // both halves of the first ishape / 2 columns use base 25000 over ishape / 2
+        const int out = ishape / 2;
+        w.period.assign(ishape, 1.0);
+        for (int d = 0; d < out; ++d) {
+            int i = d < out / 2 ? d : d - out / 2;
+            w.period[d] = std::pow(25000, 2.0 * i / out);
+        }
+        for (int d = out; d < ishape; ++d) {
+            w.scale[d] = 0;
+        }
+    } else {
         auto calc_theta = rope_init_func_map.at(rope_type);
         auto config = config_;
         config["base"] = (float)rope_theta_;
         config["dim"] = ishape;
         float attention_scaling = calc_theta(config, theta_);
+        const int mid = ishape / 2;
+        for (int d = 0; d < ishape; ++d) {
+            if (pose_type_ == LLAMAROPE) {
+                w.freq[d] = theta_[d / 2];
+                w.scale[d] = d % 2 ? attention_scaling : 1.0f;
+            } else { // HFHUBROPE, MLAROPE
+                w.freq[d] = theta_[d < mid ? d : d - mid];
+                w.scale[d] = d < mid ? 1.0f : attention_scaling;
+            }
+        }
+    }
+}
 
-        global_pose_type_ = pose_type_;
-        ishape_old = ishape;
-        if (pose_type_ == LLAMAROPE) {
-            sinusoidal_position_embedding_llama(pos_max_, ishape, theta_, sin_, cos_, attention_scaling);
-        } else if (pose_type_ == PERSIMMONROPE) {
-            // sinusoidal_position_embedding_huggingface(pos_max_, ishape / 2, theta_, sin_, cos_, 25000);
-            sinusoidal_position_embedding_persimmon(pos_max_, ishape / 2, sin_, cos_, 25000);
-        } else if (pose_type_ == HFHUBROPE || pose_type_ == MLAROPE) {
-            sinusoidal_position_embedding_huggingface(pos_max_, ishape, theta_, sin_, cos_, attention_scaling);
-        } else {
+// make [lo, hi] resident, one sincos per column of the new rows
+void CPURoPE::fillWindow(int lo, int hi) {
+    auto &w = *window_;
+    if (lo >= w.begin && hi < w.begin + w.len) {
+        return;
+    }
+    w.begin = lo;
+    w.len = std::max(hi - lo + 1, kRoPEWindow);
+    const size_t size = (size_t)w.len * w.dim;
+    w.sin.resize(size);
+    w.cos.resize(size);
+    if (w.sin.capacity() > 4 * size) { // a long prefill is over
+        w.sin.shrink_to_fit();
+        w.cos.shrink_to_fit();
+    }
+    const int dim = w.dim;
+#pragma omp parallel for num_threads(thread_count)
+    for (int p = 0; p < w.len; ++p) {
+        const int pos = w.begin + p;
+        float *sin_row = w.sin.data() + (size_t)p * dim;
+        float *cos_row = w.cos.data() + (size_t)p * dim;
+        for (int d = 0; d < dim; ++d) {
+            float t = w.period.empty() ? pos * w.freq[d] : (float)(pos / w.period[d]);
+            sin_row[d] = std::sin(t) * w.scale[d];
+            cos_row[d] = std::cos(t) * w.scale[d];
         }
     }
+}
+
+ErrorCode CPURoPE::reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
+    //    std::cout << name() << "  CPURoPE  reshape" << std::endl;
+    assert(inputs.size() == 1);
+    assert(outputs.size() == 1);
+    outputs[0]->reshape(inputs[0]->batch(), inputs[0]->head(), inputs[0]->sequence(), inputs[0]->dimension());
+    ishape = inputs[0]->dimension() * partial_rotary_factor_;
+    // pos_max_ = 16384;
+
+    auto &windows = ropeWindows();
+    RoPEKey key(owner_, pose_type_, ishape, rope_theta_, (int)rope_type, config_);
+    auto it = windows.find(key);
+    if (it == windows.end()) {
+        it = windows.emplace(key, RoPEWindow()).first;
+        configure(it->second);
+    }
+    window_ = &it->second;
 #ifdef USE_QNN
     if (Context::Instance().inference_state().isStageSwitching()) {
         h_cnt_ = Context::Instance().inference_state().getCurSequenceLength();
@@ -242,8 +306,8 @@ void CPURoPE::rope_llama(shared_ptr<Tensor> input, shared_ptr<Tensor> output) {
                 for (int d = 0; d < partial_dimension; d += 2) {
                     float in_value = input->dataAt<float>(n, h, s, d);
                     float in_value_2 = input->dataAt<float>(n, h, s, d + 1);
-                    float sin_value = sin_[s + h_cnt_][d];
-                    float cos_value = cos_[s + h_cnt_][d];
+                    float sin_value = sinRow(position(n, s))[d];
+                    float cos_value = cosRow(position(n, s))[d];
                     auto value = in_value * cos_value - in_value_2 * sin_value;
                     auto value2 = in_value * sin_value + in_value_2 * cos_value;
                     if (out_dtype == MLLM_TYPE_F32) {
@@ -274,8 +338,8 @@ void CPURoPE::rope_hf(shared_ptr<Tensor> input, shared_ptr<Tensor> output) {
                             auto o = output->ptrAt<mllm_fp16_t>(n, h, s, d);
                             float in_value = static_cast<float>(v[0]);
                             float in_value_2 = static_cast<float>(v[half]);
-                            float sin_value = sin_[s + h_cnt_][d];
-                            float cos_value = cos_[s + h_cnt_][d];
+                            float sin_value = sinRow(position(n, s))[d];
+                            float cos_value = cosRow(position(n, s))[d];
                             auto value = in_value * cos_value - in_value_2 * sin_value;
                             auto value2 = in_value * sin_value + in_value_2 * cos_value;
                             o[0] = MLLM_FP32_TO_FP16(value);
@@ -296,8 +360,8 @@ void CPURoPE::rope_hf(shared_ptr<Tensor> input, shared_ptr<Tensor> output) {
                                 auto o = output->ptrAt<float>(n, h, s, d);
                                 float in_value = v[0];
                                 float in_value_2 = v[half];
-                                float sin_value = sin_[s + h_cnt_][d];
-                                float cos_value = cos_[s + h_cnt_][d];
+                                float sin_value = sinRow(position(n, s))[d];
+                                float cos_value = cosRow(position(n, s))[d];
                                 auto value = in_value * cos_value - in_value_2 * sin_value;
                                 auto value2 = in_value * sin_value + in_value_2 * cos_value;
                                 o[0] = value;
@@ -316,8 +380,8 @@ void CPURoPE::rope_hf(shared_ptr<Tensor> input, shared_ptr<Tensor> output) {
                                 auto o = output->ptrAt<mllm_fp16_t>(n, h, s, d);
                                 float in_value = v[0];
                                 float in_value_2 = v[half];
-                                float sin_value = sin_[s + h_cnt_][d];
-                                float cos_value = cos_[s + h_cnt_][d];
+                                float sin_value = sinRow(position(n, s))[d];
+                                float cos_value = cosRow(position(n, s))[d];
                                 auto value = in_value * cos_value - in_value_2 * sin_value;
                                 auto value2 = in_value * sin_value + in_value_2 * cos_value;
                                 o[0] = MLLM_FP32_TO_FP16(value);
@@ -338,8 +402,8 @@ void CPURoPE::rope_hf(shared_ptr<Tensor> input, shared_ptr<Tensor> output) {
                     if (input->dtype() == MLLM_TYPE_F16) {
                         float in_value = static_cast<float>(input->dataAt<mllm_fp16_t>(n, h, s, d));
                         float in_value_2 = static_cast<float>(input->dataAt<mllm_fp16_t>(n, h, s, d + partial_dimension / 2));
-                        float sin_value = sin_[s + h_cnt_][d];
-                        float cos_value = cos_[s + h_cnt_][d];
+                        float sin_value = sinRow(position(n, s))[d];
+                        float cos_value = cosRow(position(n, s))[d];
                         auto value = in_value * cos_value - in_value_2 * sin_value;
                         auto value2 = in_value * sin_value + in_value_2 * cos_value;
                         if (out_dtype == MLLM_TYPE_F32) {
@@ -353,8 +417,8 @@ void CPURoPE::rope_hf(shared_ptr<Tensor> input, shared_ptr<Tensor> output) {
                     } else {
                         float in_value = input->dataAt<float>(n, h, s, d);
                         float in_value_2 = input->dataAt<float>(n, h, s, d + partial_dimension / 2);
-                        float sin_value = sin_[s + h_cnt_][d];
-                        float cos_value = cos_[s + h_cnt_][d];
+                        float sin_value = sinRow(position(n, s))[d];
+                        float cos_value = cosRow(position(n, s))[d];
                         auto value = in_value * cos_value - in_value_2 * sin_value;
                         auto value2 = in_value * sin_value + in_value_2 * cos_value;
                         if (out_dtype == MLLM_TYPE_F32) {
@@ -380,8 +444,8 @@ void CPURoPE::rope_permission(shared_ptr<Tensor> input, shared_ptr<Tensor> outpu
                 for (int d = 0; d < partial_dimension; ++d) {
                     float in_value = input->dataAt<float>(n, h, s, d);
                     float in_value_2;
-                    float sin_value = sin_[s + h_cnt_][d];
-                    float cos_value = cos_[s + h_cnt_][d];
+                    float sin_value = sinRow(position(n, s))[d];
+                    float cos_value = cosRow(position(n, s))[d];
                     if (d < partial_dimension / 4) {
                         in_value_2 = -input->dataAt<float>(n, h, s, d + partial_dimension / 4);
                         auto value = in_value * cos_value + in_value_2 * sin_value;
@@ -432,8 +496,8 @@ void CPURoPE::rope_mla(shared_ptr<Tensor> input, shared_ptr<Tensor> output) {
                         in_value_2 = input->dataAt<float>(n, h, s, 2 * (d - half_dim));
                     }
                     // no change
-                    float sin_value = sin_[s + h_cnt_][d];
-                    float cos_value = cos_[s + h_cnt_][d];
+                    float sin_value = sinRow(position(n, s))[d];
+                    float cos_value = cosRow(position(n, s))[d];
                     auto value = in_value * cos_value + in_value_2 * sin_value;
                     if (out_dtype == MLLM_TYPE_F32) {
                         output->setDataAt<float>(n, h, s, d, value);
@@ -482,6 +546,15 @@ ErrorCode CPURoPE::doExecute(vector<shared_ptr<Tensor>> inputs, vector<shared_pt
     auto out_dtype = output->dtype();
     int partial_dimension = (input->dimension()) * partial_rotary_factor_;
     // auto start_t = mllm_time_us();
+    auto &batching = Context::Instance().batching_state();
+    row_shift_ = batching.isActive() ? batching.positionShift().data() : nullptr;
+    int lo = position(0, 0);
+    int hi = position(0, input->sequence() - 1);
+    for (int n = 1; n < input->batch(); ++n) {
+        lo = std::min(lo, position(n, 0));
+        hi = std::max(hi, position(n, input->sequence() - 1));
+    }
+    fillWindow(lo, std::max(lo, hi));
     if (pose_type_ == LLAMAROPE) {
         rope_llama(input, output);
     } else if (pose_type_ == HFHUBROPE) {
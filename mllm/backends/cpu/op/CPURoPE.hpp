@@ -3,9 +3,13 @@
 
 #include "Op.hpp"
 #include "../CPUBackend.hpp"
+#include <map>
+#include <tuple>
 
 namespace mllm {
 
+class Module;
+
 typedef float (*mllm_rope_init_func)(const OpParam &, std::vector<float>&);
 
 float _default_init_rope(const OpParam& config, vector<float>& theta);
@@ -27,7 +31,7 @@ public:
     CPURoPE(Backend *bn, string opName, int pose_type, float rope_theta, int max_position_embeddings, int threadCount);
     CPURoPE(Backend *bn, string opName, int pose_type, float rope_theta, float partial_rotary_factor, int max_position_embeddings, int threadCount);
     CPURoPE(Backend *bn, string opName, OpParam &config, int threadCount);
-    virtual ~CPURoPE() = default;
+    virtual ~CPURoPE();
     virtual ErrorCode reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
     virtual ErrorCode load(AbstructLoader &loader) override;
     virtual ErrorCode execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
@@ -36,14 +40,34 @@ public:
     virtual ErrorCode setUp(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
 
 private:
-    //    Tensor freq_;
-    // static Tensor sin_;
-    // static Tensor cos_;
+    // sin/cos rows of the positions in use, computed on the fly instead of max_position_embeddings
+    // precomputed rows with the same float arithmetic as those tables; shared by the RoPEs of one
+    // model with the same pose_type, dim, theta, rope_type and scaling params, so models running in
+    // turn keep their own windows.
+    struct RoPEWindow {
+        int dim = 0;
+        int begin = 0;
+        int len = 0;
+        vector<float> freq;    // per column, angle = pos * freq
+        vector<double> period; // PERSIMMONROPE: angle = pos / period instead
+        vector<float> scale;   // attention scaling, 0 for unused columns
+        vector<float> sin;     // [len, dim], row p is position begin + p
+        vector<float> cos;
+    };
+    using RoPEKey = std::tuple<const Module *, int, int, int, int, OpParam>;
+    static constexpr int kRoPEWindow = 128; // positions per refill during decode
+    static std::map<RoPEKey, RoPEWindow> &ropeWindows();
+    void configure(RoPEWindow &w);
+    void fillWindow(int lo, int hi);
+    const float *sinRow(int pos) const {
+        return window_->sin.data() + (size_t)(pos - window_->begin) * window_->dim;
+    }
+    const float *cosRow(int pos) const {
+        return window_->cos.data() + (size_t)(pos - window_->begin) * window_->dim;
+    }
+
     static vector<float> theta_;
-    static vector<vector<float>> sin_;
-    static vector<vector<float>> cos_;
-    static int global_pose_type_;
-    static int ishape_old;
+    RoPEWindow *window_ = nullptr;
     int rope_theta_ = 10000;
     int h_cnt_ = 0;
     int pos_max_ = 16384;
@@ -56,6 +80,13 @@ private:
 
     RoPEThetaType rope_type = DEFAULT;
 
+    // continuous batching: per-row offset between the physical step position and the row's own position
+    const int *row_shift_ = nullptr;
+    int position(int n, int s) const {
+        int pos = s + h_cnt_;
+        return row_shift_ ? std::max(0, pos - row_shift_[n]) : pos;
+    }
+
     void rope_llama(shared_ptr<Tensor> input, shared_ptr<Tensor> output);
     void rope_hf(shared_ptr<Tensor> input, shared_ptr<Tensor> output);
     void rope_permission(shared_ptr<Tensor> input, shared_ptr<Tensor> output);
@@ -63,6 +94,17 @@ private:
     void clearCache() override {
         h_cnt_ = 0;
     }
+
+    // CPUPrefixCache / BatchScheduler / DraftModelDecoder move the position of every live RoPE
+    // (prefix restore, KV compaction, draft rollback)
+    friend class CPUPrefixCache;
+    friend class BatchScheduler;
+    friend class DraftModelDecoder;
+    friend class CPURoPEKVCache;
+    static std::vector<CPURoPE *> &liveRoPEs();
+    // the live ropes created while `model` was loaded or traced, every live rope for nullptr
+    static std::vector<CPURoPE *> ropesOf(const Module *model);
+    const Module *owner_ = nullptr;
 };
 
 class CPURoPECreator : public CPUBackend::Creator {
@@ -0,0 +1,102 @@
+#include "CPURoPEKVCache.hpp"
+#include "Types.hpp"
+#include <cstring>
+#include <utility>
+
+namespace mllm {
+
+CPURoPEKVCache::CPURoPEKVCache(Backend *bn, string opName, int head, int hidden, int n_rep, int cache_max,
+                               int pose_type, float rope_theta, float partial_rotary_factor, int max_position_embeddings, int threadCount) :
+    thread_count(threadCount),
+    Op(bn, opName) {
+    auto base = opName.substr(0, opName.rfind("rope_kv_cache"));
+    q_rope_ = std::make_unique<CPURoPE>(bn, base + "q_rope", pose_type, rope_theta, partial_rotary_factor, max_position_embeddings, threadCount);
+    k_rope_ = std::make_unique<CPURoPE>(bn, base + "k_rope", pose_type, rope_theta, partial_rotary_factor, max_position_embeddings, threadCount);
+    k_cache_ = std::make_unique<CPUKVCache>(bn, base + "k_cache", hidden, head, n_rep, true, false, cache_max, threadCount);
+    v_cache_ = std::make_unique<CPUKVCache>(bn, base + "v_cache", hidden, head, n_rep, true, false, cache_max, threadCount);
+    k_slot_ = std::make_shared<Tensor>(bn);
+    v_slot_ = std::make_shared<Tensor>(bn);
+}
+
+void CPURoPEKVCache::viewAppendRows(CPUKVCache &cache, const shared_ptr<Tensor> &slot) {
+    slot->setDtype(cache.cache_->dtype());
+    slot->shallowCopyFrom(cache.cache_, false, {0, 0, cache.cache_seq_len_ % cache.cache_limit_, 0});
+}
+
+ErrorCode CPURoPEKVCache::reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
+    assert(inputs.size() == 3);
+    assert(outputs.size() == 3);
+    q_rope_->reshape({inputs[0]}, {outputs[0]});
+    for (auto &[slot, like] : {std::pair{k_slot_, inputs[1]}, std::pair{v_slot_, inputs[2]}}) {
+        slot->setCtype(like->ctype());
+        slot->reshape(like->batch(), like->head(), like->sequence(), like->dimension());
+    }
+    k_rope_->reshape({inputs[1]}, {k_slot_});
+    k_cache_->reshape({k_slot_}, {outputs[1]});
+    v_cache_->reshape({v_slot_}, {outputs[2]});
+    return Op::reshape(inputs, outputs);
+}
+
+ErrorCode CPURoPEKVCache::setUp(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
+    q_rope_->setUp({inputs[0]}, {outputs[0]});
+    k_cache_->setUp({k_slot_}, {outputs[1]});
+    // v becomes a view of its cache slot, so the projection writes into the cache directly
+    v_cache_->setUp({inputs[2]}, {outputs[2]});
+    return MLLM_NO_ERROR;
+}
+
+ErrorCode CPURoPEKVCache::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
+    auto &q = inputs[0];
+    auto &k = inputs[1];
+    auto &v = inputs[2];
+    q_rope_->execute({q}, {outputs[0]});
+
+    // the slots move with cache_seq_len_ and a paged cache may have a new buffer, so they are re-viewed every step
+    viewAppendRows(*k_cache_, k_slot_);
+    k_rope_->execute({k}, {k_slot_});
+    k_cache_->execute({k_slot_}, {outputs[1]});
+
+    if (v->masterTensor() == v_cache_->cache_) {
+        v_cache_->execute({v}, {outputs[2]});
+        return Op::execute(inputs, outputs);
+    }
+    viewAppendRows(*v_cache_, v_slot_);
+    auto dtype = v_slot_->dtype();
+#pragma omp parallel for collapse(3) num_threads(thread_count)
+    for (int b = 0; b < v->batch(); ++b) {
+        for (int h = 0; h < v->head(); ++h) {
+            for (int s = 0; s < v->sequence(); ++s) {
+                if (v->dtype() == dtype) {
+                    memcpy(v_slot_->ptrAt<char>(b, h, s, 0), v->ptrAt<char>(b, h, s, 0), DataTypeSize(dtype, v->dimension()));
+                } else if (dtype == MLLM_TYPE_F16) {
+                    for (int d = 0; d < v->dimension(); ++d) {
+                        v_slot_->setDataAt<mllm_fp16_t>(b, h, s, d, MLLM_FP32_TO_FP16(v->dataAt<float>(b, h, s, d)));
+                    }
+                } else {
+                    for (int d = 0; d < v->dimension(); ++d) {
+                        v_slot_->setDataAt<float>(b, h, s, d, v->dataAt<float>(b, h, s, d));
+                    }
+                }
+            }
+        }
+    }
+    v_cache_->execute({v_slot_}, {outputs[2]});
+    return Op::execute(inputs, outputs);
+}
+
+void CPURoPEKVCache::clearCache() {
+    k_cache_->clearCache();
+    v_cache_->clearCache();
+    q_rope_->clearCache();
+    k_rope_->clearCache();
+}
+
+ErrorCode CPURoPEKVCache::load(AbstructLoader &loader) {
+    return Op::load(loader);
+}
+
+ErrorCode CPURoPEKVCache::free(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
+    return Op::free(inputs, outputs);
+}
+
+} // namespace mllm
@@ -0,0 +1,72 @@
+#ifndef MLLM_CPUROPEKVCACHE_H
+#define MLLM_CPUROPEKVCACHE_H
+
+#include "Op.hpp"
+#include "../CPUBackend.hpp"
+#include "CPUKVCache.hpp"
+#include "CPURoPE.hpp"
+#include <memory>
+
+namespace mllm {
+
+/**
+ * q_rope + k_rope + k_cache + v_cache of an attention layer as one op: (q, k, v) -> (rotated q, k cache, v cache).
+ *
+ * Rotated K is written straight into the k cache rows at cache_seq_len_, in the cache dtype
+ * (F32/F16/Q8_0), V is appended to the v cache (zero-copy when the projection already writes
+ * into the rows, as set up by the trace pass). The cache ops are set up once by the trace pass;
+ * execute only re-views two slot tensors at the rows of the step. The op owns a CPURoPE pair and
+ * a CPUKVCache pair named <base>q_rope, <base>k_rope, <base>k_cache and <base>v_cache, so cache
+ * paging, the prefix cache, continuous batching and speculative decoding see them like the
+ * unfused ops.
+ * Only for the BSHD (flash_attention_2) cache layout.
+ */
+class CPURoPEKVCache final : public Op {
+public:
+    CPURoPEKVCache(Backend *bn, string opName, int head, int hidden, int n_rep, int cache_max,
+                   int pose_type, float rope_theta, float partial_rotary_factor, int max_position_embeddings, int threadCount);
+    virtual ~CPURoPEKVCache() = default;
+    virtual ErrorCode reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
+    virtual ErrorCode load(AbstructLoader &loader) override;
+    virtual ErrorCode execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
+    virtual ErrorCode free(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
+    virtual ErrorCode setUp(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
+
+    int getCacheSeqLen() override {
+        return k_cache_->getCacheSeqLen();
+    }
+    void clearCache() override;
+
+private:
+    // make `slot` a view of the rows of `cache` this step appends, in the cache dtype
+    static void viewAppendRows(CPUKVCache &cache, const shared_ptr<Tensor> &slot);
+
+    int thread_count = 4;
+    // rotated k / copied v of the current step, views of the cache rows they are appended at
+    shared_ptr<Tensor> k_slot_;
+    shared_ptr<Tensor> v_slot_;
+    std::unique_ptr<CPURoPE> q_rope_;
+    std::unique_ptr<CPURoPE> k_rope_;
+    std::unique_ptr<CPUKVCache> k_cache_;
+    std::unique_ptr<CPUKVCache> v_cache_;
+};
+
+class CPURoPEKVCacheCreator : public CPUBackend::Creator {
+public:
+    virtual Op *create(OpParam op_param, Backend *bn, string name, int threadCount) const {
+        int head = (int)op_param["head"];
+        int hidden = (int)op_param["hidden"];
+        int n_rep = (int)op_param["n_rep"];
+        int cache_max = (int)op_param["cache_max"];
+        int pose_type = (int)op_param["pose_type"];
+        float rope_theta = op_param["rope_theta"];
+        float partial_rotary_factor = op_param["partial_rotary_factor"];
+        int max_position_embeddings = (int)op_param["max_position_embeddings"];
+        return new CPURoPEKVCache(bn, name, head, hidden, n_rep, cache_max, pose_type, rope_theta,
+                                  partial_rotary_factor, max_position_embeddings, threadCount);
+    }
+};
+
+} // namespace mllm
+
+#endif // MLLM_CPUROPEKVCACHE_H
@@ -2,16 +2,19 @@
 #include "CPUSoftMax.hpp"
 #include <cmath>
 #include "Tensor.hpp"
+#include "Context.hpp"
+#include <algorithm>
 #include "backends/cpu/third_party/ggml/Quantize.hpp"
 #include "backends/cpu/third_party/ggml/VecDotFP32.hpp"
 #include "../compute/ActivationFunction.hpp"
 namespace mllm {
 
-CPUSoftMax::CPUSoftMax(Backend *bn, string opName, int axis, bool do_causal_mask, int threadCount) :
+CPUSoftMax::CPUSoftMax(Backend *bn, string opName, int axis, bool do_causal_mask, int threadCount, bool kv_attention) :
     thread_count(threadCount),
     Op(bn, opName) {
     axis_ = axis;
     do_causal_mask_ = do_causal_mask;
+    kv_attention_ = kv_attention;
     if (axis_ != DIMENSION && !init_table_exp_f16_flag) {
         init_table_exp_f16();
         init_table_exp_f16_flag = true;
@@ -43,7 +46,37 @@ ErrorCode CPUSoftMax::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_p
 #endif
     }
     memset(output->hostPtr<float>(), 0, output->count() * sizeof(float));
-    if (axis_ == DIMENSION) {
+    auto &batching = Context::Instance().batching_state();
+    if (axis_ == DIMENSION && kv_attention_ && batching.isActive()) {
+        // continuous batching: every row only attends to its own valid KV positions
+        int num_classes = num_classes_in > 0 ? num_classes_in : input->dimension();
+        int step_start = batching.getStepStart();
+#pragma omp parallel for collapse(3) num_threads(thread_count)
+        for (int n = 0; n < input->batch(); ++n) {
+            for (int h = 0; h < input->head(); ++h) {
+                for (int s = 0; s < input->sequence(); ++s) {
+                    int masked_num_classes = do_causal_mask_ ? std::min(num_classes, step_start + s + 1) : num_classes;
+                    const float *x = input->ptrAt<float>(n, h, s, 0);
+                    float *dp = output->ptrAt<float>(n, h, s, 0);
+                    float max = -INFINITY;
+                    for (int j = 0; j < masked_num_classes; ++j) {
+                        if (batching.isKeyValid(n, j)) max = MAX(max, x[j]);
+                    }
+                    if (max == -INFINITY) { // padding query without any valid key, keep zeros
+                        continue;
+                    }
+                    float sum = 0;
+                    for (int j = 0; j < masked_num_classes; ++j) {
+                        if (batching.isKeyValid(n, j)) {
+                            dp[j] = expf(x[j] - max);
+                            sum += dp[j];
+                        }
+                    }
+                    vec_scale_f32(masked_num_classes, dp, 1.0f / sum);
+                }
+            }
+        }
+    } else if (axis_ == DIMENSION) {
         int num_classes = num_classes_in > 0 ? num_classes_in : input->dimension(); // 获取类别数量
 #pragma omp parallel for collapse(3) num_threads(thread_count)
         for (int n = 0; n < input->batch(); ++n) {
@@ -8,7 +8,7 @@ namespace mllm {
 
 class CPUSoftMax final : public Op {
 public:
-    CPUSoftMax(Backend *bn, string opName, int axis, bool do_causal_mask, int threadCount);
+    CPUSoftMax(Backend *bn, string opName, int axis, bool do_causal_mask, int threadCount, bool kv_attention = false);
     virtual ~CPUSoftMax() = default;
     virtual ErrorCode reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
     virtual ErrorCode execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
@@ -17,6 +17,8 @@ private:
     int axis_ = 0;
     int thread_count = 4;
     bool do_causal_mask_ = false;
+    // scores over a KV cache: the rows of a continuous batch only see their own KV positions
+    bool kv_attention_ = false;
 };
 
 class CPUSoftMaxCreator : public CPUBackend::Creator {
@@ -24,7 +26,8 @@ public:
     virtual Op *create(OpParam op_param, Backend *bn, string name, int threadCount) const {
         int axis = op_param["axis"];
         bool do_causal_mask = op_param["do_causal_mask"];
-        return new CPUSoftMax(bn, name, axis, do_causal_mask, threadCount);
+        bool kv_attention = op_param["kv_attention"];
+        return new CPUSoftMax(bn, name, axis, do_causal_mask, threadCount, kv_attention);
     }
 };
 } // namespace mllm
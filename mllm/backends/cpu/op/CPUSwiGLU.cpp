@@ -0,0 +1,251 @@
+#include "CPUSwiGLU.hpp"
+#include "Types.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include "../compute/ActivationFunction.hpp"
+#include "../compute/Arithmetic.hpp"
+#include "../compute/GemmKleidiai.hpp"
+#include "backends/cpu/third_party/ggml/VecDotType.hpp"
+
+namespace mllm {
+
+// inputs with more rows go through one GEMM on the interleaved weight (llamafile_sgemm when it applies)
+static constexpr int kFusedMaxRows = 4;
+// gate/up outputs computed per step, they stay on the stack until the product is written
+static constexpr int kFusedBlock = 16;
+
+// rows can be interleaved and dotted one by one; not true for the packed Q4_0_x_x and KleidiAI layouts
+static bool rowsIndependent(DataType type) {
+    return type != MLLM_TYPE_KLEIDIAI_Q4_0 && type_traits[type].vec_dot != nullptr;
+}
+
+static void projection(Tensor *input, Tensor &weight, Tensor *out, int thread_count) {
+    if (weight.dtype() == MLLM_TYPE_KLEIDIAI_Q4_0) {
+#if defined(__aarch64__) || defined(__arm__) || defined(__arm64__)
+        kai_thread_count = thread_count;
+        for (int b = 0; b < input->batch(); b++) {
+            mllm_kleidai_gemm_qsi4(out->ptrAt<float>(b, 0, 0, 0), input->ptrAt<float>(b, 0, 0, 0),
+                                   (const uint8_t *)weight.rawHostPtr(), input->sequence(), out->dimension(), input->dimension());
+        }
+        return;
+#else
+        std::cerr << "KLEIDIAI_Q4_0 is not supported on this platform!" << std::endl;
+        exit(-1);
+#endif
+    }
+    mat_mul(input, &weight, out, false, nullptr, false, true, thread_count);
+}
+
+CPUSwiGLU::CPUSwiGLU(Backend *bn, string opName, int in_features, int intermediate_size, int threadCount) :
+    thread_count(threadCount),
+    Op(bn, opName) {
+    in_features_ = in_features;
+    intermediate_size_ = intermediate_size;
+    weight_.setBackend(bn);
+    gate_.setBackend(bn);
+    up_.setBackend(bn);
+}
+
+ErrorCode CPUSwiGLU::reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
+    assert(inputs.size() == 1);
+    assert(outputs.size() == 1);
+    if (inputs[0]->count() == 0 && inputs[0]->sequence() != 0) {
+        outputs[0]->reshape(0, 0, 0, 0);
+        return Op::reshape(inputs, outputs);
+    }
+    assert(inputs[0]->head() == 1);
+    assert(in_features_ == inputs[0]->dimension());
+    outputs[0]->reshape(inputs[0]->batch(), inputs[0]->head(), inputs[0]->sequence(), intermediate_size_);
+    return Op::reshape(inputs, outputs);
+}
+
+bool CPUSwiGLU::loadSeparate(AbstructLoader &loader) {
+    auto prefix = name().substr(0, name().rfind("gate_up_proj"));
+    gate_.setName(prefix + "gate_proj.weight");
+    up_.setName(prefix + "up_proj.weight");
+    auto gate_type = loader.getDataType(gate_.name());
+    auto up_type = loader.getDataType(up_.name());
+    if (gate_type == MLLM_TYPE_COUNT || up_type == MLLM_TYPE_COUNT) {
+        return false;
+    }
+    for (auto *t : {&gate_, &up_}) {
+        auto type = loader.getDataType(t->name());
+        t->reshape(1, 1, intermediate_size_, in_features_);
+        if (type == MLLM_TYPE_KLEIDIAI_Q4_0) {
+#if defined(__aarch64__) || defined(__arm__) || defined(__arm64__)
+#ifndef KAI_FP16_CAL
+            t->reshape(1, 1, 1, mllm_kleidai_get_packed_b_qsi4_size(intermediate_size_, in_features_));
+#else
+            t->reshape(1, 1, 1, mllm_kleidai_get_packed_b_qsi4_size_to_fp16(intermediate_size_, in_features_));
+#endif
+#endif
+        }
+        t->setDtype(type);
+        t->alloc();
+        loader.load(t);
+    }
+    row_dot_ = gate_type == up_type && rowsIndependent(gate_type);
+    interleaved_ = false;
+    if (!row_dot_ || !SwiGLU_interleave_on_load) {
+        return true;
+    }
+    interleaved_ = true;
+    weight_.setDtype(gate_type);
+    weight_.alloc();
+    const size_t row = row_size(gate_type, in_features_);
+    auto *dst = (char *)weight_.rawHostPtr();
+    auto *gate = (const char *)gate_.rawHostPtr();
+    auto *up = (const char *)up_.rawHostPtr();
+#pragma omp parallel for num_threads(thread_count)
+    for (int i = 0; i < intermediate_size_; ++i) {
+        memcpy(dst + (2 * i) * row, gate + i * row, row);
+        memcpy(dst + (2 * i + 1) * row, up + i * row, row);
+    }
+    gate_.unload();
+    up_.unload();
+    return true;
+}
+
+ErrorCode CPUSwiGLU::load(AbstructLoader &loader) {
+    weight_.setName(name() + ".interleaved.weight");
+    weight_.reshape(1, 1, 2 * intermediate_size_, in_features_);
+    interleaved_ = true;
+    row_dot_ = true;
+    if (loader.getDataType(weight_.name()) != MLLM_TYPE_COUNT) {
+        weight_.setDtype(loader.getDataType(weight_.name()));
+        weight_.alloc();
+        loader.load(&weight_);
+        row_dot_ = rowsIndependent(weight_.dtype());
+    } else if (!loadSeparate(loader)) {
+        auto type = Op::noLoadWeightsDtype();
+        weight_.setDtype(rowsIndependent(type) ? type : MLLM_TYPE_Q4_0);
+        weight_.alloc();
+    }
+    return Op::load(loader);
+}
+
+void CPUSwiGLU::fusedRows(Tensor *input, Tensor *output) {
+    const int K = in_features_;
+    const int N = intermediate_size_;
+    const int B = input->batch();
+    const int S = input->sequence();
+    const auto w_type = interleaved_ ? weight_.dtype() : gate_.dtype();
+    const auto vec_dot_type = type_traits[w_type].vec_dot_type;
+    auto vec_dot = type_traits[w_type].vec_dot;
+    const size_t w_row = row_size(w_type, K);
+    const size_t x_row = row_size(vec_dot_type, K);
+    const bool convert = vec_dot_type != MLLM_TYPE_F32;
+    if (convert) {
+        auto x_to_vec_dot_type = type_traits[vec_dot_type].from_float;
+        x_vec_dot_.resize(B * S * x_row);
+#pragma omp parallel for collapse(2) num_threads(thread_count)
+        for (int b = 0; b < B; b++) {
+            for (int s = 0; s < S; s++) {
+                x_to_vec_dot_type(input->ptrAt<float>(b, 0, s, 0), x_vec_dot_.data() + (b * S + s) * x_row, K);
+            }
+        }
+    }
+    // gate row j at gate_w + j * stride, up row j at up_w + j * stride
+    const char *gate_w;
+    const char *up_w;
+    size_t stride;
+    if (interleaved_) {
+        gate_w = (const char *)weight_.rawHostPtr();
+        up_w = gate_w + w_row;
+        stride = 2 * w_row;
+    } else {
+        gate_w = (const char *)gate_.rawHostPtr();
+        up_w = (const char *)up_.rawHostPtr();
+        stride = w_row;
+    }
+    const int blocks = (N + kFusedBlock - 1) / kFusedBlock;
+    // rows innermost: a thread reuses its weight block for every row
+#pragma omp parallel for collapse(2) num_threads(thread_count)
+    for (int blk = 0; blk < blocks; blk++) {
+        for (int r = 0; r < B * S; r++) {
+            const int b = r / S;
+            const int s = r % S;
+            const void *x = convert ? (const void *)(x_vec_dot_.data() + r * x_row) : (const void *)input->ptrAt<float>(b, 0, s, 0);
+            const int j0 = blk * kFusedBlock;
+            const int n = std::min(kFusedBlock, N - j0);
+            float gate[kFusedBlock];
+            float up[kFusedBlock];
+            for (int j = 0; j < n; j++) {
+                vec_dot(K, &gate[j], gate_w + (j0 + j) * stride, x);
+                vec_dot(K, &up[j], up_w + (j0 + j) * stride, x);
+            }
+            mllm_vec_silu_f32(n, gate, gate);
+            if (output->dtype() == MLLM_TYPE_F32) {
+                mllm_mul_fp32(gate, up, output->ptrAt<float>(b, 0, s, j0), n);
+            } else {
+                for (int j = 0; j < n; j++) {
+                    *output->ptrAt<mllm_fp16_t>(b, 0, s, j0 + j) = MLLM_FP32_TO_FP16(gate[j] * up[j]);
+                }
+            }
+        }
+    }
+}
+
+void CPUSwiGLU::gemmRows(Tensor *input, Tensor *output) {
+    const int N = intermediate_size_;
+    const int B = input->batch();
+    const int S = input->sequence();
+    // interleaved_: one [.., 2N] product with gate/up interleaved; else a gate and an up product
+    auto gate_up = std::make_shared<Tensor>(backend_);
+    auto up_out = std::make_shared<Tensor>(backend_);
+    gate_up->reshape(B, 1, S, interleaved_ ? 2 * N : N);
+    gate_up->setDtype(MLLM_TYPE_F32);
+    gate_up->alloc();
+    if (interleaved_) {
+        projection(input, weight_, gate_up.get(), thread_count);
+    } else {
+        up_out->reshape(B, 1, S, N);
+        up_out->setDtype(MLLM_TYPE_F32);
+        up_out->alloc();
+        projection(input, gate_, gate_up.get(), thread_count);
+        projection(input, up_, up_out.get(), thread_count);
+    }
+#pragma omp parallel for collapse(2) num_threads(thread_count)
+    for (int b = 0; b < B; b++) {
+        for (int s = 0; s < S; s++) {
+            const float *g = gate_up->ptrAt<float>(b, 0, s, 0);
+            const float *u = interleaved_ ? g + 1 : up_out->ptrAt<float>(b, 0, s, 0);
+            const int step = interleaved_ ? 2 : 1;
+            for (int j = 0; j < N; j++) {
+                float v = mllm_silu_f32(g[j * step]) * u[j * step];
+                if (output->dtype() == MLLM_TYPE_F32) {
+                    *output->ptrAt<float>(b, 0, s, j) = v;
+                } else {
+                    *output->ptrAt<mllm_fp16_t>(b, 0, s, j) = MLLM_FP32_TO_FP16(v);
+                }
+            }
+        }
+    }
+}
+
+ErrorCode CPUSwiGLU::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
+    if (inputs[0]->count() == 0) {
+        return Op::execute(inputs, outputs);
+    }
+    if (inputs[0]->sequence() != outputs[0]->sequence() && outputs[0]->masterTensor() == nullptr) {
+        outputs[0]->reshape(outputs[0]->batch(), outputs[0]->head(), inputs[0]->sequence(), outputs[0]->dimension());
+        outputs[0]->alloc();
+    }
+    assert(inputs[0]->dtype() == MLLM_TYPE_F32);
+    if (row_dot_ && inputs[0]->batch() * inputs[0]->sequence() <= kFusedMaxRows) {
+        fusedRows(inputs[0].get(), outputs[0].get());
+    } else {
+        gemmRows(inputs[0].get(), outputs[0].get());
+    }
+    return Op::execute(inputs, outputs);
+}
+
+ErrorCode CPUSwiGLU::free(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
+    weight_.unload();
+    gate_.unload();
+    up_.unload();
+    return Op::free(inputs, outputs);
+}
+
+} // namespace mllm
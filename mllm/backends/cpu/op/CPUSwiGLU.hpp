@@ -0,0 +1,61 @@
+#ifndef MLLM_CPUSWIGLU_H
+#define MLLM_CPUSWIGLU_H
+
+#include "Op.hpp"
+#include "../CPUBackend.hpp"
+#include "../compute/Matmul.hpp"
+
+namespace mllm {
+
+class Tensor;
+/**
+ * silu(x * gate^T) * (x * up^T) in one op, the MLP of Llama-like models without its down_proj.
+ *
+ * The op is named <base>gate_up_proj. It loads <name>.interleaved.weight (written by the quantizer
+ * with the `swiglu` flag), whose row 2i is gate row i and row 2i+1 is up row i; without it
+ * <base>gate_proj.weight and <base>up_proj.weight are used as they are (interleaved at load time only
+ * with SwiGLU_interleave_on_load). Each input row is converted to the vec_dot type once and every
+ * gate/up pair is computed next to each other, only the product is written. Weights with packed rows
+ * (Q4_0_4_4, KleidiAI) run as two GEMMs. F32 activations, CPU only.
+ */
+class CPUSwiGLU final : public Op {
+public:
+    CPUSwiGLU(Backend *bn, string opName, int in_features, int intermediate_size, int threadCount);
+    virtual ~CPUSwiGLU() = default;
+    virtual ErrorCode reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
+    virtual ErrorCode load(AbstructLoader &loader) override;
+    virtual ErrorCode execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
+    virtual ErrorCode free(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
+
+    Tensor &weight() {
+        return weight_;
+    }
+
+private:
+    bool loadSeparate(AbstructLoader &loader);
+    void fusedRows(Tensor *input, Tensor *output);
+    void gemmRows(Tensor *input, Tensor *output);
+
+    int in_features_;
+    int intermediate_size_;
+    int thread_count = 4;
+    bool interleaved_ = true; // weight_ holds gate and up, else gate_ and up_
+    bool row_dot_ = true;     // rows can be dotted one by one (not a packed layout)
+    Tensor weight_;           // interleaved [2 * intermediate, in]
+    Tensor gate_;             // only when !interleaved_
+    Tensor up_;
+    std::vector<char> x_vec_dot_; // input rows in the vec_dot type, reused between calls
+};
+
+class CPUSwiGLUCreator : public CPUBackend::Creator {
+public:
+    virtual Op *create(OpParam op_param, Backend *bn, string name, int threadCount) const {
+        int in_features = op_param["in_features"];
+        int intermediate_size = op_param["intermediate_size"];
+        return new CPUSwiGLU(bn, name, in_features, intermediate_size, threadCount);
+    }
+};
+
+} // namespace mllm
+
+#endif // MLLM_CPUSWIGLU_H
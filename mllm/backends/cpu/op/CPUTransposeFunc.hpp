@@ -71,7 +71,12 @@ public:
         if (inputs[0]->masterTensor() != nullptr && (inputs[0]->masterTensor()->name().find("Cache") != std::string::npos || inputs[0]->masterTensor()->name().find("weight") != std::string::npos)) {
             if (outputs[0]->masterTensor() == nullptr) {
                 outputs[0]->setDtype(inputs[0]->dtype());
-                outputs[0]->shallowCopyFrom(inputs[0], false);
+                // a KV cache view: view the cache itself so offsets keep its batch stride
+                if (inputs[0]->shapeOffset().size() == 4) {
+                    outputs[0]->shallowCopyFrom(inputs[0]->masterTensor(), false, inputs[0]->shapeOffset());
+                } else {
+                    outputs[0]->shallowCopyFrom(inputs[0], false);
+                }
             }
         } else {
             if (inputs[0]->masterTensor() == nullptr) {
@@ -121,7 +126,11 @@ public:
         if (inputs[0]->masterTensor() != nullptr && (inputs[0]->masterTensor()->name().find("Cache") != std::string::npos || inputs[0]->masterTensor()->name().find("weight") != std::string::npos)) {
             if (outputs[0]->masterTensor() == nullptr) {
                 outputs[0]->setDtype(inputs[0]->dtype());
-                outputs[0]->shallowCopyFrom(inputs[0], false);
+                if (inputs[0]->shapeOffset().size() == 4) {
+                    outputs[0]->shallowCopyFrom(inputs[0]->masterTensor(), false, inputs[0]->shapeOffset());
+                } else {
+                    outputs[0]->shallowCopyFrom(inputs[0], false);
+                }
             }
         }
         return MLLM_NO_ERROR;
@@ -0,0 +1,64 @@
+#include "StaticMemoryPlanner.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+
+namespace mllm {
+
+size_t StaticMemoryPlanner::plan(const std::vector<Request> &requests, std::vector<size_t> &offsets) const {
+    offsets.assign(requests.size(), 0);
+    std::vector<size_t> order(requests.size());
+    std::iota(order.begin(), order.end(), 0);
+    // 大张量优先放置，碎片更少
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return requests[a].size > requests[b].size;
+    });
+
+    struct Placed {
+        size_t offset;
+        size_t size;
+        int first_use;
+        int last_use;
+    };
+    std::vector<Placed> placed;
+    placed.reserve(requests.size());
+    size_t arena_size = 0;
+    for (size_t idx : order) {
+        const auto &req = requests[idx];
+        size_t size = (req.size + alignment_ - 1) / alignment_ * alignment_;
+        // 与当前张量生命周期重叠的已放置张量，按偏移排序后寻找最小的可用空隙
+        std::vector<const Placed *> live;
+        for (const auto &p : placed) {
+            if (p.first_use <= req.last_use && req.first_use <= p.last_use) {
+                live.push_back(&p);
+            }
+        }
+        std::sort(live.begin(), live.end(), [](const Placed *a, const Placed *b) {
+            return a->offset < b->offset;
+        });
+        size_t best_offset = 0;
+        size_t best_gap = SIZE_MAX;
+        size_t cursor = 0;
+        bool found = false;
+        for (const auto *p : live) {
+            if (p->offset >= cursor + size) {
+                size_t gap = p->offset - cursor;
+                if (gap < best_gap) {
+                    best_gap = gap;
+                    best_offset = cursor;
+                    found = true;
+                }
+            }
+            cursor = std::max(cursor, p->offset + p->size);
+        }
+        if (!found) {
+            best_offset = cursor;
+        }
+        offsets[idx] = best_offset;
+        placed.push_back({best_offset, size, req.first_use, req.last_use});
+        arena_size = std::max(arena_size, best_offset + size);
+    }
+    return arena_size;
+}
+
+} // namespace mllm
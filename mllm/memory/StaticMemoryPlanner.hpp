@@ -0,0 +1,37 @@
+#ifndef MLLM_STATIC_MEMORY_PLANNER_H
+#define MLLM_STATIC_MEMORY_PLANNER_H
+
+#include <cstddef>
+#include <vector>
+
+namespace mllm {
+
+// 离线激活内存规划：根据张量的生命周期 [first_use, last_use] 为每个张量分配一个
+// 固定的 arena 偏移，生命周期不重叠的张量复用同一段内存（greedy by size）。
+class StaticMemoryPlanner {
+public:
+    struct Request {
+        size_t size;   // bytes
+        int first_use; // step that produces the tensor
+        int last_use;  // last step that reads the tensor (inclusive)
+    };
+
+    explicit StaticMemoryPlanner(size_t alignment = 128) :
+        alignment_(alignment) {
+    }
+
+    /**
+     * @brief assign an offset to every request so that requests with overlapping lifetimes never overlap in memory.
+     * @param requests  tensors to place
+     * @param offsets   output, offsets[i] is the arena offset of requests[i]
+     * @return the arena size (peak activation memory) in bytes
+     */
+    size_t plan(const std::vector<Request> &requests, std::vector<size_t> &offsets) const;
+
+private:
+    size_t alignment_;
+};
+
+} // namespace mllm
+
+#endif // MLLM_STATIC_MEMORY_PLANNER_H
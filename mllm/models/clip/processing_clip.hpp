@@ -42,6 +42,43 @@ public:
         }
         return tensor1;
     }
+    // decodes the images and writes each one preprocessed as planes at dst + i * image_stride, images in parallel
+    void imagesToPlanes(const vector<string> &images_path, int hw, float *dst, size_t image_stride, size_t channel_stride) {
+        const int n = images_path.size();
+        // exit() may not leave an omp loop, failed images are reported after it
+        vector<char> failed(n, 0);
+#pragma omp parallel for num_threads(CPUBackend::cpu_threads) if (n > 1)
+        for (int i = 0; i < n; ++i) {
+            int width, height, channels;
+            auto data = stbi_load(images_path[i].c_str(), &width, &height, &channels, 3);
+            if (data == nullptr) {
+                failed[i] = 1;
+                continue;
+            }
+            PreProcessor::ImageToPlanes(data, width, height, dst + i * image_stride, channel_stride, hw, hw,
+                                        do_rescale_ ? scale_ : 1.0F, do_resize_,
+                                        do_normalize_ ? mean_ : vector<float>{}, do_normalize_ ? std_ : vector<float>{});
+            stbi_image_free(data);
+        }
+        if (std::find(failed.begin(), failed.end(), 1) != failed.end()) {
+            for (int i = 0; i < n; ++i) {
+                if (failed[i]) {
+                    MLLM_LOG_ERROR_STREAM << "Cannot open file: " << images_path[i] << std::endl;
+                }
+            }
+            exit(-1);
+        }
+    }
+    // [n, hw, 3, hw] input tensor (planes per image), same values as PreProcessImages + img2Tensor
+    Tensor imagesToTensor(const vector<string> &images_path, int hw, string name = "input", BackendType type = MLLM_CPU) {
+        const int n = images_path.size();
+        Tensor tensor1(n, hw, 3, hw, Backend::global_backends[type].get(), true);
+        tensor1.setName(std::move(name));
+        Tensor::tensor_status = TENSOR_STATIC_INIT;
+        tensor1.setTtype(INPUT_TENSOR);
+        imagesToPlanes(images_path, hw, tensor1.hostPtr<float>(), (size_t)3 * hw * hw, (size_t)hw * hw);
+        return tensor1;
+    }
     vector<float> softmax(const vector<float> &scores) {
         vector<float> exps;
         float max_val = *max_element(scores.begin(), scores.end());
@@ -172,10 +209,7 @@ public:
             tokenizer->tokenize(in_str, tokens_id, true, true, "</w>");
             tokens_ids.push_back(tokens_id);
         }
-        PreProcessImages({std::move(img_path)}, hw, hw);
-        auto images = pixel_values_[0];
-
-        return {Tokenizer::tokens2Input(tokens_ids), img2Tensor(images, std::move(img_name))};
+        return {Tokenizer::tokens2Input(tokens_ids), imagesToTensor({img_path}, hw, std::move(img_name))};
     }
     vector<float> postProcess(Tensor &result) {
         vector<float> scores;
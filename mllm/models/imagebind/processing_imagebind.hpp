@@ -5,6 +5,7 @@
 #ifndef PROCESSING_IMAGEBIND_HPP
 #define PROCESSING_IMAGEBIND_HPP
 #include <utility>
+#include <cstring>
 
 #include "tokenizers/BPE/Bpe.hpp"
 #include "models/clip/processing_clip.hpp"
@@ -29,6 +30,25 @@ class ImagebindProcessor final : public ClipProcessor {
         }
         return tensor1;
     }
+    // [n, 3, 2, hw, hw]: the preprocessed planes written at t = 0 and copied to t = 1
+    Tensor imagesToTensor5D(const vector<string> &images_path, int hw, string name = "input", BackendType type = MLLM_CPU) {
+        const int n = images_path.size();
+        Tensor tensor1(Backend::global_backends[type].get());
+        tensor1.reshape(n, 3, 2, hw, hw);
+        tensor1.setDtype(MLLM_TYPE_F32);
+        tensor1.alloc();
+        tensor1.setName(std::move(name));
+        Tensor::tensor_status = TENSOR_STATIC_INIT;
+        tensor1.setTtype(INPUT_TENSOR);
+        const size_t plane = (size_t)hw * hw;
+        imagesToPlanes(images_path, hw, tensor1.hostPtr<float>(), 3 * 2 * plane, 2 * plane);
+        for (int bi = 0; bi < n; ++bi) {
+            for (int c = 0; c < 3; ++c) {
+                memcpy(tensor1.ptrAt<float>(bi, c, 1, 0, 0), tensor1.ptrAt<float>(bi, c, 0, 0, 0), plane * sizeof(float));
+            }
+        }
+        return tensor1;
+    }
     static Tensor img2Tensor(vector<vector<vector<vector<float>>>> imgs, string name = "input", BackendType type = MLLM_CPU) {
         int channel = imgs[0].size();
         int height = imgs[0][0].size();
@@ -114,13 +134,11 @@ public:
             input_text_lens.push_back(tokens_id.size() - 1);
         }
 
-        PreProcessImages(img_path, hw, hw);
-        auto images = pixel_values_;
 
         auto audios = PreProcessor::ProcessAudio(std::move(wav_path));
 
         return {tokens2Input(tokens_ids, max_pos, std::move(text_name)),
-                img2Tensor(images, std::move(img_name)),
+                imagesToTensor5D(img_path, hw, std::move(img_name)),
                 audio2Tensor(audios, std::move(wav_name)), input_text_lens};
     }
 
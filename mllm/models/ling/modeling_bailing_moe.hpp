@@ -7,6 +7,7 @@
 #include "Types.hpp"
 #include "configuration_bailing_moe.hpp"
 #include "models/transformer/modeling_transformer.hpp"
+#include "ExpertCache.hpp"
 #include <any>
 #include <cmath>
 #include <cstdlib>
@@ -34,6 +35,10 @@ public:
         return {x};
     }
 
+    std::vector<Layer *> projections() {
+        return {&gate_proj, &up_proj, &down_proj};
+    }
+
 private:
     Layer gate_proj;
     Layer up_proj;
@@ -110,10 +115,17 @@ public:
         auto tokens_per_expert = topk_idx.bincount(); // (1, 1, 1, 0) 1, 1, 1, k
         idxs = idxs.to(device).to(dtype);
         auto token_idxs = idxs / num_experts_per_tok; // 1, 1, 1, k* batch*seq
+        bool offload = expert_cache_ != nullptr && !Module::llm_model_ptr->doLoad;
+        if (offload) {
+            auto weights = topk_weight.fp32().cpu();
+            expert_cache_->acquire(layer_idx_, ExpertCache::routing(weights, topk_idx));
+        }
         int start_idx = 0;
         int end_idx = start_idx;
         auto expert_cache = Tensor::zero_like(hidden_states); // 1, batch*seq, 1, hidden
         for (int i = 0; i < experts.size(); ++i) {
+            if (expert_cache_ && Module::llm_model_ptr->doLoad) // experts are loaded by the ExpertCache
+                break;
             if (tokens_per_expert.dimension() != 0 && i >= tokens_per_expert.dimension())
                 break;
             int this_token_num = tokens_per_expert.dimension() == 0 ?
@@ -134,15 +146,28 @@ public:
             //
             start_idx = end_idx;
         }
+        if (offload) {
+            expert_cache_->release(layer_idx_);
+        }
         return expert_cache; // 1, batch*seq, 1, hidden
     }
 
+    void setExpertCache(ExpertCache *cache, int layer_idx) {
+        expert_cache_ = cache;
+        layer_idx_ = layer_idx;
+        for (int i = 0; i < experts.size(); ++i) {
+            expert_cache_->registerExpert(layer_idx_, i, experts[i].projections());
+        }
+    }
+
 private:
     BailingMoeMLP shared_experts;
     std::vector<BailingMoeMLP> experts;
     BailingMoeGate gate;
     int num_shared_experts{};
     int num_experts_per_tok{};
+    ExpertCache *expert_cache_ = nullptr;
+    int layer_idx_ = 0;
 };
 
 class BailingMoeDecoder final : public Module {
@@ -176,6 +201,9 @@ public:
     MultiHeadAttention &get_attention() {
         return self_atten;
     }
+    BailingMoeSparseMoeBlock &get_moe() {
+        return moe;
+    }
 
 private:
     MultiHeadAttention self_atten;
@@ -210,6 +238,12 @@ public:
         }
     }
 
+    void setExpertCache(ExpertCache *cache) {
+        for (int i = 0; i < blocks.size(); ++i) {
+            blocks[i].get_moe().setExpertCache(cache, i);
+        }
+    }
+
 private:
     std::vector<BailingMoeDecoder> blocks;
     Layer norm;
@@ -225,6 +259,11 @@ public:
         embedding = Embedding(config.vocab_size, config.hidden_size, names.token_embd_name);
         model = BailingMoeModel(config, names, names.blk_name);
         lm_head = Linear(config.hidden_size, config.vocab_size, false, names.lm_head_name);
+        if (config.expert_cache_size > 0) {
+            expert_cache_ = std::make_shared<ExpertCache>(config.num_hidden_layers, config.num_experts, config.expert_cache_size,
+                                                          ExpertCache::policyFromString(config.expert_cache_policy));
+            model.setExpertCache(expert_cache_.get());
+        }
     }
 
     std::vector<Tensor> Forward(std::vector<Tensor> inputs, std::vector<std::any> args) override {
@@ -247,4 +286,5 @@ private:
     Layer lm_head;
     BailingMoeModel model;
     DataType dtype;
+    std::shared_ptr<ExpertCache> expert_cache_; // after model: stops its loader before the experts go away
 };
@@ -13,6 +13,7 @@
 using namespace mllm;
 
 class LLaMAMLP final : public Module {
+    Layer gate_up_proj;
     Layer gate_proj;
     Layer silu;
     Layer up_proj;
@@ -21,12 +22,18 @@ class LLaMAMLP final : public Module {
 public:
     LLaMAMLP() = default;
     LLaMAMLP(int hidden_dim, int ffn_hidden, const LLaMANameConfig &names, const string &base_name) {
+        if (names._gate_proj_name == "gate_proj" && names._up_proj_name == "up_proj") {
+            gate_up_proj = SwiGLU(hidden_dim, ffn_hidden, base_name + "gate_up_proj");
+        }
         gate_proj = Linear(hidden_dim, ffn_hidden, false, base_name + names._gate_proj_name);
         silu = SiLU(base_name + "act");
         up_proj = Linear(hidden_dim, ffn_hidden, false, base_name + names._up_proj_name);
         down_proj = Linear(ffn_hidden, hidden_dim, false, base_name + names._down_proj_name);
     }
     vector<Tensor> Forward(vector<Tensor> inputs, vector<std::any> args) override {
+        if (gate_up_proj.cpuFusable(inputs[0])) {
+            return {down_proj(gate_up_proj(inputs[0]))};
+        }
         auto x = gate_proj(inputs[0]);
         x = silu(x);
         auto y = up_proj(inputs[0]);
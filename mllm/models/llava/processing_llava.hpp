@@ -44,10 +44,7 @@ public:
         vector<mllm::token_id_t> tokens_id = {};
         tokenizer->tokenize(BPETokenizer::replaceString(text, ' ', "▁"), tokens_id, {"<image>", "<pad>", "\n"});
         tokens_ids.push_back(tokens_id);
-        PreProcessImages({std::move(img_path)}, hw, hw);
-        auto images = pixel_values_[0];
-
-        return {Tokenizer::tokens2Input(tokens_ids, std::move(text_name)), img2Tensor(images, std::move(img_name))};
+        return {Tokenizer::tokens2Input(tokens_ids, std::move(text_name)), imagesToTensor({img_path}, hw, std::move(img_name))};
     }
 
     std::string detokenize(const std::vector<token_id_t> &tokens) {
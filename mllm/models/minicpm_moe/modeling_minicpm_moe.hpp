@@ -7,6 +7,7 @@
 #include "Types.hpp"
 #include "configuration_minicpm_moe.hpp"
 #include "models/transformer/modeling_transformer.hpp"
+#include "ExpertCache.hpp"
 #include <any>
 #include <cmath>
 
@@ -31,6 +32,10 @@ public:
         return {x};
     }
 
+    std::vector<Layer *> projections() {
+        return {&gate_proj, &up_proj, &down_proj};
+    }
+
 private:
     Layer gate_proj;
     Layer up_proj;
@@ -65,10 +70,16 @@ public:
         auto idxs = expert_indices.argsort();               // 1, 1, 1, k* batch*seq
         auto tokens_per_expert = expert_indices.bincount(); // (1, 1, 1, 0) 1, 1, 1, k
         auto token_idxs = idxs / num_experts_per_tok;       // 1, 1, 1, k* batch*seq
+        bool offload = expert_cache_ != nullptr && !Module::llm_model_ptr->doLoad;
+        if (offload) {
+            expert_cache_->acquire(layer_idx_, ExpertCache::routing(expert_weights, expert_indices));
+        }
         int start_idx = 0;
         int end_idx = start_idx;
         auto expert_cache = Tensor::zero_like(hidden_states); // 1, batch*seq, 1, hidden
         for (int i = 0; i < experts.size(); ++i) {
+            if (expert_cache_ && Module::llm_model_ptr->doLoad) // experts are loaded by the ExpertCache
+                break;
             if (tokens_per_expert.dimension() != 0 && i >= tokens_per_expert.dimension())
                 break;
             int this_token_num = tokens_per_expert.dimension() == 0 ?
@@ -88,18 +99,31 @@ public:
             //
             start_idx = end_idx;
         }
+        if (offload) {
+            expert_cache_->release(layer_idx_);
+        }
         if (hidden_states.batch() > 1) {
             // expert_cache.view(ANYDIM, seq, -1, -1);//TODO
         }
         return {expert_cache};
     }
 
+    void setExpertCache(ExpertCache *cache, int layer_idx) {
+        expert_cache_ = cache;
+        layer_idx_ = layer_idx;
+        for (int i = 0; i < experts.size(); ++i) {
+            expert_cache_->registerExpert(layer_idx_, i, experts[i].projections());
+        }
+    }
+
 private:
     std::vector<MiniCPMMLP> experts;
     Layer gate;
     Softmax softmax;
 
     int num_experts_per_tok{};
+    ExpertCache *expert_cache_ = nullptr;
+    int layer_idx_ = 0;
 };
 
 class MiniCPMDecoder final : public Module {
@@ -133,6 +157,9 @@ public:
     MultiHeadAttention &get_attention() {
         return self_atten;
     }
+    MiniCPMMoE &get_moe() {
+        return moe;
+    }
 
 private:
     MultiHeadAttention self_atten;
@@ -169,6 +196,12 @@ public:
         }
     }
 
+    void setExpertCache(ExpertCache *cache) {
+        for (int i = 0; i < blocks.size(); ++i) {
+            blocks[i].get_moe().setExpertCache(cache, i);
+        }
+    }
+
 private:
     std::vector<MiniCPMDecoder> blocks;
     Layer norm;
@@ -184,6 +217,11 @@ public:
         embedding = Embedding(config.vocab_size, config.hidden_size, names.token_embd_name);
         model = MiniCPMModel(config, names, names.blk_name);
         lm_head = Parameter(1, config.vocab_size, 1, config.hidden_size, names.token_embd_name + ".weight");
+        if (config.expert_cache_size > 0) {
+            expert_cache_ = std::make_shared<ExpertCache>(config.num_hidden_layers, config.num_experts, config.expert_cache_size,
+                                                          ExpertCache::policyFromString(config.expert_cache_policy));
+            model.setExpertCache(expert_cache_.get());
+        }
     }
 
     std::vector<Tensor> Forward(std::vector<Tensor> inputs, std::vector<std::any> args) override {
@@ -208,6 +246,7 @@ private:
     Layer embedding;
     Parameter lm_head;
     MiniCPMModel model;
+    std::shared_ptr<ExpertCache> expert_cache_; // after model: stops its loader before the experts go away
 };
 
 #endif // MODELING_MINICPMMOE_HPP
\ No newline at end of file
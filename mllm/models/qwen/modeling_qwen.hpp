@@ -29,6 +29,9 @@ public:
     QWenMLP() = default;
     QWenMLP(int hidden_size, int intermediate_size, const QWenNameConfig &names,
             const std::string &base_name) {
+        if (names._gate_proj_name == "gate_proj" && names._up_proj_name == "up_proj") {
+            gate_up_proj = SwiGLU(hidden_size, intermediate_size, base_name + "gate_up_proj");
+        }
         gate_proj =
             Linear(hidden_size, intermediate_size, false, base_name + names._gate_proj_name);
         silu = SiLU(base_name + "act");
@@ -38,6 +41,9 @@ public:
     }
 
     std::vector<Tensor> Forward(std::vector<Tensor> inputs, std::vector<std::any> args) override {
+        if (gate_up_proj.cpuFusable(inputs[0])) {
+            return {down_proj(gate_up_proj(inputs[0]))};
+        }
         auto x = gate_proj(inputs[0]);
         x = silu(x);
         auto y = up_proj(inputs[0]);
@@ -47,6 +53,7 @@ public:
     }
 
 private:
+    Layer gate_up_proj;
     Layer gate_proj;
     Layer up_proj;
     Layer down_proj;
@@ -73,13 +80,23 @@ public:
             RMSNorm(config.hidden_size, config.rms_norm_eps, base_name + names._attn_norm_name);
         post_attention_layernorm =
             RMSNorm(config.hidden_size, config.rms_norm_eps, base_name + names._ffn_norm_name);
+        // residual add + post_attention_layernorm in one op, same weights
+        add_post_attention_layernorm =
+            AddRMSNorm(config.hidden_size, config.rms_norm_eps, base_name + names._ffn_norm_name);
     }
 
     std::vector<Tensor> Forward(std::vector<Tensor> inputs, std::vector<std::any> args) override {
         auto x = input_layernorm(inputs[0]);
         x = self_atten({x, x, x})[0];
-        auto tmp = x + inputs[0];
-        x = post_attention_layernorm(tmp);
+        Tensor tmp;
+        if (add_post_attention_layernorm.cpuFusable(x)) {
+            auto res_norm = add_post_attention_layernorm(x, inputs[0]);
+            tmp = res_norm[0];
+            x = res_norm[1];
+        } else {
+            tmp = x + inputs[0];
+            x = post_attention_layernorm(tmp);
+        }
         x = mlp({x})[0];
         x = x + tmp;
         return {x};
@@ -94,6 +111,7 @@ private:
     QWenMLP mlp;
     Layer input_layernorm;
     Layer post_attention_layernorm;
+    AddRMSNorm add_post_attention_layernorm;
 };
 
 // Copied from GemmaModel with Gemma->Qwen and set RmsNorm(without add_unit_offset)
@@ -142,8 +160,9 @@ public:
         // Qwen-0.5 use tied embedding
         // Others use nn.Linear()
         if (tie_embedding_words) {
-            lm_head = Parameter(1, config.vocab_size, 1, config.hidden_size,
-                                names.token_embd_name + ".weight");
+            lm_head = LMHead(config.hidden_size, config.vocab_size, names.token_embd_name + ".lm_head");
+            lm_head_weight = Parameter(1, config.vocab_size, 1, config.hidden_size,
+                                       names.token_embd_name + ".weight");
         } else {
             lm_head_layer =
                 Linear(config.hidden_size, config.vocab_size, false, names.lm_head_name);
@@ -157,8 +176,10 @@ public:
         if (outputs.sequence() > 1) {
             outputs = outputs.clip({}, {}, {-1}, {});
         }
-        if (tie_embedding_words) {
-            outputs = Tensor::mm(outputs, lm_head().transpose(Chl::SEQUENCE, Chl::DIMENSION));
+        if (tie_embedding_words && lm_head.cpuFusable(outputs)) {
+            outputs = lm_head(outputs);
+        } else if (tie_embedding_words) {
+            outputs = Tensor::mm(outputs, lm_head_weight().transpose(Chl::SEQUENCE, Chl::DIMENSION));
         } else {
             outputs = lm_head_layer(outputs);
         }
@@ -172,7 +193,8 @@ private:
     int hidden_size;
     bool tie_embedding_words;
     Layer embedding;
-    Parameter lm_head;
+    LMHead lm_head;
+    Parameter lm_head_weight;
     Layer lm_head_layer;
     QWenModel model;
     DataType dtype;
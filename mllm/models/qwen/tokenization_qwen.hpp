@@ -334,6 +334,13 @@ public:
         return ret;
     }
 
+    std::string tokenBytes(token_id_t id) override {
+        auto text = BPETokenizer::detokenize({id});
+        // the control tokens postprocess() hides print nothing when streamed
+        if (text == "<|im_start|>" || text == "<|im_end|>" || text == "<|endoftext|>" || text == "<unk>") return "";
+        return _byte_decode_(text);
+    }
+
     std::string detokenize(const std::vector<token_id_t> &tokens) override {
         return _byte_decode_(BPETokenizer::detokenize(tokens));
     }
@@ -72,10 +72,10 @@ public:
         q = Tensor::apply_rotary_pos_emb_vision(q, rotary_pos_emb);
         k = Tensor::apply_rotary_pos_emb_vision(k, rotary_pos_emb);
         Tensor o;
-        // if (attn_impl == "flash_attention_2") {
-        //     o = Tensor::flash_attention2_forward(q, k, v, false);
-        // } else
-        { // eager implementation
+        if (attn_impl == "flash_attention_2") {
+            // full attention layers get the per-image cu_seqlens, window layers cu_window_seqlens
+            o = Tensor::flash_attention2_varlen_forward(q, k, v, cu_seqlens);
+        } else { // eager implementation
             k = k.transpose(SEQUENCE, DIMENSION);
             auto qk = Tensor::mm(q, k);
             qk = qk / std::sqrt(head_dim_);
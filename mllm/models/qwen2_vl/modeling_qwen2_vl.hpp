@@ -74,7 +74,7 @@ public:
         k = Tensor::apply_rotary_pos_emb_vision(k, rotary_pos_emb);
         Tensor o;
         if (attn_impl == "flash_attention_2") {
-            o = Tensor::flash_attention2_forward(q, k, v, false);
+            o = Tensor::flash_attention2_varlen_forward(q, k, v, cu_seqlens);
         } else { // eager implementation
             k = k.transpose(SEQUENCE, DIMENSION);
             auto qk = Tensor::mm(q, k);
@@ -7,6 +7,7 @@
 #include "Types.hpp"
 #include "configuration_smallthinker.hpp"
 #include "models/transformer/modeling_transformer.hpp"
+#include "ExpertCache.hpp"
 #include <any>
 using namespace mllm;
 
@@ -29,6 +30,10 @@ public:
         return {x};
     }
 
+    std::vector<Layer *> projections() {
+        return {&gate_proj, &up_proj, &down_proj};
+    }
+
 private:
     Layer gate_proj;
     Layer up_proj;
@@ -57,10 +62,19 @@ public:
         auto idxs = expert_indices.argsort();               // 1, 1, 1, k* batch*seq
         auto tokens_per_expert = expert_indices.bincount(); // (1, 1, 1, 0) 1, 1, 1, k
         auto token_idxs = idxs / num_experts_per_tok;       // 1, 1, 1, k* batch*seq
+        bool offload = expert_cache_ != nullptr && !Module::llm_model_ptr->doLoad;
+        if (expert_cache_ && Module::llm_model_ptr->doLoad) {
+            expert_cache_->setLoader(Module::llm_model_ptr->loader);
+        }
+        if (offload) {
+            expert_cache_->acquire(layer_idx_, ExpertCache::routing(expert_weights, expert_indices));
+        }
         int start_idx = 0;
         int end_idx = start_idx;
         auto expert_cache = Tensor::zero_like(hidden_states); // 1, batch*seq, 1, hidden
         for (int i = 0; i < experts.size(); ++i) {
+            if (expert_cache_ && Module::llm_model_ptr->doLoad) // experts are loaded by the ExpertCache
+                break;
             if (tokens_per_expert.dimension() != 0 && i >= tokens_per_expert.dimension())
                 break;
             int this_token_num = tokens_per_expert.dimension() == 0 ?
@@ -80,17 +94,30 @@ public:
             //
             start_idx = end_idx;
         }
+        if (offload) {
+            expert_cache_->release(layer_idx_);
+        }
         if (hidden_states.batch() > 1) {
             // expert_cache.view(ANYDIM, seq, -1, -1);//TODO
         }
         return {expert_cache};
     }
 
+    void setExpertCache(ExpertCache *cache, int layer_idx) {
+        expert_cache_ = cache;
+        layer_idx_ = layer_idx;
+        for (int i = 0; i < experts.size(); ++i) {
+            expert_cache_->registerExpert(layer_idx_, i, experts[i].projections());
+        }
+    }
+
 private:
     std::vector<SmallThinkerMLP> experts;
     // Layer primary_router;
     Layer sigmoid;
     int num_experts_per_tok{};
+    ExpertCache *expert_cache_ = nullptr;
+    int layer_idx_ = 0;
 };
 
 class SmallThinkerDecoder final : public Module {
@@ -132,6 +159,9 @@ public:
     MultiHeadAttention &get_attention() {
         return self_atten;
     }
+    SmallThinkerMoeBlock &get_moe() {
+        return block_sparse_moe;
+    }
 
 private:
     MultiHeadAttention self_atten;
@@ -168,6 +198,12 @@ public:
         }
     }
 
+    void setExpertCache(ExpertCache *cache) {
+        for (int i = 0; i < blocks.size(); ++i) {
+            blocks[i].get_moe().setExpertCache(cache, i);
+        }
+    }
+
 private:
     std::vector<SmallThinkerDecoder> blocks;
     Layer norm;
@@ -187,6 +223,11 @@ public:
         } else {
             lm_head_layer = Linear(config.hidden_size, config.vocab_size, false, names.lm_head_name);
         }
+        if (config.expert_cache_size > 0) {
+            expert_cache_ = std::make_shared<ExpertCache>(config.num_hidden_layers, config.num_experts, config.expert_cache_size,
+                                                          ExpertCache::policyFromString(config.expert_cache_policy));
+            model.setExpertCache(expert_cache_.get());
+        }
     }
 
     std::vector<Tensor> Forward(std::vector<Tensor> inputs, std::vector<std::any> args) override {
@@ -213,6 +254,7 @@ private:
     Parameter lm_head;
     Layer lm_head_layer;
     SmallThinkerModel model;
+    std::shared_ptr<ExpertCache> expert_cache_; // after model: stops its loader before the experts go away
 };
 
 #endif // MODELING_SMOLTHINKER_HPP
\ No newline at end of file
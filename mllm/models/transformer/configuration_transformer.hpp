@@ -39,5 +39,8 @@ public:
     }
     string attn_implementation = "flash_attention_2"; // Options: "flash_attention_2", "eager"
     DataType dtype = MLLM_TYPE_F32;
+    // MoE models: experts kept in memory over all layers, the others are loaded on demand (0 keeps all)
+    int expert_cache_size = 0;
+    string expert_cache_policy = "lru"; // Options: "lru", "lfu", "score"
 };
 #endif // CONFIGURATION_TRANSFORMER_HPP
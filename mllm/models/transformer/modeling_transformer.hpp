@@ -43,6 +43,7 @@ class MultiHeadAttention final : public Module {
     Layer k_norm;
     KVCache k_cache;
     KVCache v_cache;
+    KVCache rope_kv_cache;
     Softmax softmax;
     Layer o_proj;
     Parameter bias_k;
@@ -110,19 +111,29 @@ public:
             q_norm = RMSNorm(head_dim, 1e-6, base_name + names._q_norm_name);
             k_norm = RMSNorm(head_dim, 1e-6, base_name + names._k_norm_name);
         }
+        if (KVCache_fused_rope && RoPE_type > 0 && cache_limit > 0 && attn_implementation_ == "flash_attention_2"
+            && post_qkv_norm == PostQkv_NONE && !bias_kv_cat) {
+            // q_rope, k_rope, k_cache and v_cache as one op
+            rope_kv_cache = KVCache(num_key_value_heads, head_dim,
+                                    num_heads / num_key_value_heads, cache_limit,
+                                    RoPE_type, rope_theta, partial_rotary_factor, max_position_embeddings,
+                                    base_name + "rope_kv_cache");
+        }
         if (RoPE_type > 0) {
             q_rope = RoPE(RoPE_type, rope_theta, partial_rotary_factor, max_position_embeddings, base_name + "q_rope");
             k_rope = RoPE(RoPE_type, rope_theta, partial_rotary_factor, max_position_embeddings, base_name + "k_rope");
         }
         if (cache_limit > 0) {
+            // the eager Tensor::mm path indexes KV head h / n_rep, so GQA heads are not replicated
+            bool share_heads = attn_implementation_ == "eager" || attn_implementation_ == "eager_notrans";
             k_cache = KVCache(num_key_value_heads, head_dim,
                               num_heads / num_key_value_heads, cache_limit,
-                              attn_implementation_, base_name + "k_cache");
+                              attn_implementation_, base_name + "k_cache", share_heads);
             v_cache = KVCache(num_key_value_heads, head_dim,
                               num_heads / num_key_value_heads, cache_limit,
-                              attn_implementation_, base_name + "v_cache");
+                              attn_implementation_, base_name + "v_cache", share_heads);
         }
-        softmax = Softmax(DIMENSION, is_causal, base_name + "softmax");
+        softmax = Softmax(DIMENSION, is_causal, cache_limit > 0, base_name + "softmax");
         o_proj = Linear(num_heads * head_dim, hidden_dim, o_bias, base_name + names._o_proj_name);
         if (bias_kv_cat) {
             bias_k = Parameter(1, 1, num_heads, head_dim, base_name + "bias_k");
@@ -166,7 +177,14 @@ public:
             k = Tensor::cat({k, bias_k()}, SEQUENCE);
             v = Tensor::cat({v, bias_v()}, SEQUENCE);
         }
-        if (q_rope.ready() && k_rope.ready()) {
+        const bool fused_rope_kv = rope_kv_cache.cpuFusable(q);
+        if (fused_rope_kv) {
+            auto qkv = rope_kv_cache(q, k, v);
+            q = qkv[0];
+            k = qkv[1];
+            v = qkv[2];
+        }
+        if (!fused_rope_kv && q_rope.ready() && k_rope.ready()) {
             q = q_rope(q);
             k = k_rope(k);
         }
@@ -175,7 +193,7 @@ public:
             k = k.transpose(HEAD, SEQUENCE);
             v = v.transpose(HEAD, SEQUENCE);
         }
-        if (k_cache.ready() && v_cache.ready()) {
+        if (!fused_rope_kv && k_cache.ready() && v_cache.ready()) {
             k = k_cache(k);
             v = v_cache(v);
         }
@@ -211,7 +229,7 @@ public:
         return {o};
     }
     vector<KVCache *> get_cache() {
-        return {&k_cache, &v_cache};
+        return {&k_cache, &v_cache, &rope_kv_cache};
     }
     vector<RoPE *> get_rope() {
         return {&q_rope, &k_rope};
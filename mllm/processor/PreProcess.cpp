@@ -392,4 +392,76 @@ void PreProcessor::ImageInfos2Pixels(std::vector<ImageInfo> &imageinfos, vector<
             pixel_values_.push_back(pixel_values);
         }
     }
-}
\ No newline at end of file
+}
+
+// crop window [oy, oy + out_height) x [ox, ox + out_width) of an interleaved RGB source, v * a[c] + b[c] per
+// channel, out-of-image pixels are the pad value 0 before the affine (as CenterCropImages then NormalizeImages)
+template <typename T>
+static void planes_from_rgb(const T *src, int width, int height, int oy, int ox, float *dst, size_t channel_stride,
+                            int out_height, int out_width, const float *a, const float *b) {
+#pragma omp parallel for num_threads(CPUBackend::cpu_threads) if (!omp_in_parallel())
+    for (int y = 0; y < out_height; ++y) {
+        const int sy = y + oy;
+        for (int c = 0; c < 3; ++c) {
+            float *out = dst + c * channel_stride + (size_t)y * out_width;
+            if (sy < 0 || sy >= height) {
+                std::fill(out, out + out_width, b[c]);
+                continue;
+            }
+            const int x0 = std::clamp(-ox, 0, out_width);
+            const int x1 = std::clamp(width - ox, x0, out_width);
+            std::fill(out, out + x0, b[c]);
+            std::fill(out + x1, out + out_width, b[c]);
+            const T *row = src + ((size_t)sy * width + ox) * 3 + c;
+            const float ac = a[c];
+            const float bc = b[c];
+#pragma omp simd
+            for (int x = x0; x < x1; ++x) {
+                out[x] = (float)row[x * 3] * ac + bc;
+            }
+        }
+    }
+}
+
+void PreProcessor::ImageToPlanes(const uint8_t *rgb, int width, int height, float *dst, size_t channel_stride,
+                                 int out_height, int out_width, float scale, bool do_resize,
+                                 const std::vector<float> &means, const std::vector<float> &stds,
+                                 ResampleType resample_type) {
+    int resized_height = height;
+    int resized_width = width;
+    if (do_resize) {
+        // same target size as ResizeImages(images, out_height, out_width, false, true, shortest)
+        int shortest = std::min(height, width);
+        int longest = std::max(height, width);
+        longest = std::round(out_height * longest / shortest);
+        shortest = out_height;
+        resized_height = height > width ? longest : shortest;
+        resized_width = height > width ? shortest : longest;
+    }
+    // the pixel value before normalization is raw / scale; stb decodes 8-bit input to [0, 1] for float output
+    const float raw_factor = do_resize ? 255.0f / scale : 1.0f / scale;
+    float a[3];
+    float b[3];
+    for (int c = 0; c < 3; ++c) {
+        const float mean = means.empty() ? 0.0f : means[means.size() == 3 ? c : 0];
+        const float std = stds.empty() ? 1.0f : stds[stds.size() == 3 ? c : 0];
+        a[c] = raw_factor / std;
+        b[c] = -mean / std;
+    }
+    const int oy = (resized_height - out_height) / 2;
+    const int ox = (resized_width - out_width) / 2;
+    if (!do_resize) {
+        planes_from_rgb(rgb, width, height, oy, ox, dst, channel_stride, out_height, out_width, a, b);
+        return;
+    }
+    stbir_filter filter = resample_type == ResampleType::BICUBIC ? STBIR_FILTER_CUBICBSPLINE : STBIR_FILTER_TRIANGLE;
+    thread_local std::vector<float> resized;
+    resized.resize((size_t)resized_height * resized_width * 3);
+    STBIR_RESIZE resize;
+    stbir_resize_init(&resize, rgb, width, height, 0, resized.data(), resized_width, resized_height, 0, STBIR_RGB, STBIR_TYPE_UINT8);
+    stbir_set_datatypes(&resize, STBIR_TYPE_UINT8, STBIR_TYPE_FLOAT);
+    stbir_set_edgemodes(&resize, STBIR_EDGE_CLAMP, STBIR_EDGE_CLAMP);
+    stbir_set_filters(&resize, filter, filter);
+    stbir_resize_extended(&resize);
+    planes_from_rgb(resized.data(), resized_width, resized_height, oy, ox, dst, channel_stride, out_height, out_width, a, b);
+}
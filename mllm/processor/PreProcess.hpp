@@ -115,6 +115,16 @@ public:
         return scaled_images;
     }
     static void ImageInfos2Pixels(std::vector<ImageInfo> &imageinfos, vector<vector<vector<vector<float>>>> &pixel_values_);
+    /**
+     * @brief Rescale -> resize (shortest edge to out_height, like ResizeImages(fit, shortest)) -> center crop
+     * -> normalize of one decoded RGB8 image in a single pass, written as planes: channel c of the result
+     * starts at dst + c * channel_stride. The resize reads the 8-bit pixels directly; no intermediate
+     * float image except the resized one, which is reused per thread.
+     */
+    static void ImageToPlanes(const uint8_t *rgb, int width, int height, float *dst, size_t channel_stride,
+                              int out_height, int out_width, float scale, bool do_resize,
+                              const std::vector<float> &means, const std::vector<float> &stds,
+                              ResampleType resample_type = ResampleType::BILINEAR);
 
     static std::vector<std::vector<std::vector<std::vector<float>>>> ProcessAudio(std::vector<std::string> waves) {
         return ProcessWAV(waves);
@@ -3,8 +3,10 @@
 //
 
 #include "Bpe.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
 #include <iostream>
-#include <regex>
 #include <codecvt>
 #include <unordered_map>
 
@@ -13,84 +15,105 @@ static size_t utf8_len(char src) {
     uint8_t highbits = static_cast<uint8_t>(src) >> 4;
     return lookup[highbits];
 }
-static std::vector<std::pair<string, string>> get_pairs(vector<string> word) {
-    std::vector<std::pair<string, string>> pairs;
-    for (int i = 1; i < word.size(); ++i) {
-        pairs.emplace_back(word[i - 1], word[i]);
+int mllm::BPETokenizer::symbolId(const string &symbol) {
+    auto it = symbol_ids_.find(symbol);
+    if (it != symbol_ids_.end()) {
+        return it->second;
     }
-    return pairs;
+    int id = symbols_text_.size();
+    symbols_text_.push_back(symbol);
+    symbol_ids_.emplace(symbol, id);
+    return id;
 }
-vector<std::string> mllm::BPETokenizer::bpe(const std::string &token, std::string end_symbol) {
-    std::wstring_convert<std::codecvt_utf8_utf16<char32_t>, char32_t> converter;
-    std::u32string u32_token = converter.from_bytes(token);
 
-    std::vector<std::string> word_splits;
-    for (char32_t c : u32_token) {
-        word_splits.push_back(converter.to_bytes(c));
+// Standard BPE: take the adjacent pair with the lowest rank and merge all its occurrences, left to
+// right, then repeat. The pairs sit in a heap keyed (rank, position) over integer symbol ids and are
+// invalidated lazily: a popped entry whose symbols changed is skipped.
+vector<std::string> mllm::BPETokenizer::bpe(const std::string &token, std::string end_symbol) {
+    struct Node {
+        int id; // -1: not in any merge
+        string text;
+        int prev;
+        int next;
+    };
+    std::vector<Node> word;
+    for (size_t offset = 0; offset < token.size();) {
+        size_t len = std::min(token.size() - offset, utf8_len(token[offset]));
+        word.push_back({-1, token.substr(offset, len), (int)word.size() - 1, (int)word.size() + 1});
+        offset += len;
     }
-    std::string last_str = word_splits.back();
-    word_splits.pop_back();
-    // word_splits.push_back(last_str + "</w>");
-    word_splits.push_back(last_str + end_symbol);
-
-    auto pairs = get_pairs(word_splits);
-    if (pairs.empty()) {
-        // return {token + "</w>"};
+    if (word.size() <= 1) {
         return {token + end_symbol};
     }
+    word.back().text += end_symbol;
+    word.back().next = -1;
+    for (auto &node : word) {
+        auto it = symbol_ids_.find(node.text);
+        node.id = it == symbol_ids_.end() ? -1 : it->second;
+    }
 
-    while (true) {
-        auto bigram = *std::min_element(pairs.begin(), pairs.end(), [this](const auto &a, const auto &b) {
-            auto string_a = std::string(a.first) + " " + std::string(a.second);
-            auto string_b = std::string(b.first) + " " + std::string(b.second);
-            auto rank_a = merge_rank.count(string_a) ? merge_rank.at(string_a) : INFINITY;
-            auto rank_b = merge_rank.count(string_b) ? merge_rank.at(string_b) : INFINITY;
-            return rank_a < rank_b;
-        });
-        auto bigram_string = std::string(bigram.first) + " " + std::string(bigram.second);
-        if (merge_rank.find(bigram_string) == merge_rank.end()) {
-            break;
+    struct Candidate {
+        unsigned rank;
+        int pos;
+        int left;
+        int right;
+        bool operator>(const Candidate &o) const {
+            return rank > o.rank || (rank == o.rank && pos > o.pos);
         }
-
-        string first = bigram.first, second = bigram.second;
-        vector<std::string> new_word;
-        int i = 0;
-        int j = 0;
-        while (i < word_splits.size()) {
-            // find first at word_splits[i:]
-            bool found = false;
-            for (j = i; j < word_splits.size(); ++j) {
-                if (word_splits[j] == first) {
-                    found = true;
-                    for (int k = i; k < j; ++k) {
-                        new_word.emplace_back(word_splits[k]);
-                    }
-                    i = j;
-                    break;
-                }
-            }
-            if (!found) {
-                new_word.insert(new_word.end(), word_splits.begin() + i, word_splits.end());
-                break;
+    };
+    std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> heap;
+    auto push = [&](int pos) {
+        if (pos < 0 || word[pos].next < 0) {
+            return;
+        }
+        int left = word[pos].id, right = word[word[pos].next].id;
+        if (left < 0 || right < 0) {
+            return;
+        }
+        auto it = pair_rank_.find((uint64_t)left << 32 | (uint32_t)right);
+        if (it != pair_rank_.end()) {
+            heap.push({it->second.first, pos, left, right});
+        }
+    };
+    for (int i = 0; i + 1 < (int)word.size(); ++i) {
+        push(i);
+    }
+    std::vector<Candidate> batch;
+    while (!heap.empty()) {
+        // every occurrence of the lowest ranked pair, leftmost first (positions follow word order);
+        // the pairs they create only join the heap after the whole batch, as in a rescan
+        batch.clear();
+        const unsigned rank = heap.top().rank;
+        while (!heap.empty() && heap.top().rank == rank) {
+            batch.push_back(heap.top());
+            heap.pop();
+        }
+        std::vector<int> merged;
+        for (const auto &c : batch) {
+            auto &first = word[c.pos];
+            if (first.id != c.left || first.next < 0 || word[first.next].id != c.right) {
+                continue; // stale, or overlapped by the merge on its left
             }
-            if (word_splits[i] == first && i < word_splits.size() - 1 && word_splits[i + 1] == second) {
-                new_word.emplace_back(first + second);
-                i += 2;
-            } else {
-                new_word.emplace_back(word_splits[i]);
-                i++;
+            auto &second = word[first.next];
+            first.id = pair_rank_.at((uint64_t)c.left << 32 | (uint32_t)c.right).second;
+            first.text = symbols_text_[first.id];
+            first.next = second.next;
+            if (second.next >= 0) {
+                word[second.next].prev = c.pos;
             }
+            second.id = -1;
+            merged.push_back(c.pos);
         }
-        word_splits = new_word;
-        if (word_splits.size() == 1) {
-            break;
-        } else {
-            pairs = get_pairs(word_splits);
+        for (int pos : merged) {
+            push(word[pos].prev);
+            push(pos);
         }
     }
-
-    // cache[token] = word_splits;
-    return word_splits;
+    vector<std::string> result;
+    for (int i = 0; i >= 0; i = word[i].next) {
+        result.push_back(std::move(word[i].text));
+    }
+    return result;
 }
 
 void mllm::BPETokenizer::tokenize(const std::string &text, std::vector<token_id_t> &tokens, bool bos, std::vector<std::string> &special_tokens, bool byte_fallback) {
@@ -115,27 +138,33 @@ void mllm::BPETokenizer::tokenize(const std::string &text, std::vector<token_id_
     }
     symbols_.clear();
     while (!queue_.empty()) queue_.pop();
+    words_.clear();
     size_t offset = 0;
     int idx = 0;
     if (bos) {
         tokens.emplace_back(mllm::BPETokenizer::TokenBos);
     }
     if (!merge_rank.empty()) {
-        std::vector<std::string> words;
-        std::regex pattern("<\\|startoftext\\|>|<\\|endoftext\\|>|'s|'t|'re|'ve|'m|'ll|'d|\\w+|\\d+|\\S+");
-        std::smatch match;
-
-        std::string::const_iterator searchStart(text.cbegin());
-        while (std::regex_search(searchStart, text.cend(), match, pattern)) {
-            words.push_back(match.str());
-            searchStart = match.suffix().first;
-        }
-
-        for (const auto &word : words) {
-            // Use the same algorithm as the else branch for vocab-based tokenization
+        indexVocab();
+        preTokenize(text, words_);
+        for (auto word : words_) {
+            std::string key(word);
+            key.push_back(byte_fallback ? '\1' : '\0');
+            auto cached = word_cache_.find(key);
+            if (cached != word_cache_.end()) {
+                word_lru_.splice(word_lru_.begin(), word_lru_, cached->second);
+                tokens.insert(tokens.end(), cached->second->second.begin(), cached->second->second.end());
+                continue;
+            }
             std::vector<token_id_t> word_tokens;
-            tokenizeWordWithVocab(word, word_tokens, byte_fallback);
+            tokenizeWordWithVocab(std::string(word), word_tokens, byte_fallback);
             tokens.insert(tokens.end(), word_tokens.begin(), word_tokens.end());
+            word_lru_.emplace_front(key, std::move(word_tokens));
+            word_cache_[key] = word_lru_.begin();
+            if (word_lru_.size() > kWordCacheSize) {
+                word_cache_.erase(word_lru_.back().first);
+                word_lru_.pop_back();
+            }
         }
         if (TokenEos > 0) {
             tokens.push_back(TokenEos);
@@ -182,10 +211,9 @@ void mllm::BPETokenizer::tokenize(const std::string &text, std::vector<token_id_
     // auto t = result->second;
     for (int i = 0; i < symbols_.size(); ++i) {
         if (symbols_[i].length > 0) {
-            auto token_text = std::string(symbols_[i].ch, symbols_[i].length);
-            auto result = this->vocab_map_.find(token_text);
-            if (result != this->vocab_map_.end()) {
-                tokens.emplace_back(result->second);
+            auto result = findToken(std::string_view(symbols_[i].ch, symbols_[i].length));
+            if (result) {
+                tokens.emplace_back(*result);
             } else {
                 if (!byte_fallback) {
                     tokens.emplace_back(mllm::BPETokenizer::TokenUnk);
@@ -200,18 +228,86 @@ void mllm::BPETokenizer::tokenize(const std::string &text, std::vector<token_id_
     }
 }
 
+void mllm::BPETokenizer::preTokenize(std::string_view text, std::vector<std::string_view> &words) {
+    static const char *const kLiterals[] = {"<|startoftext|>", "<|endoftext|>", "'s", "'t", "'re", "'ve", "'m", "'ll", "'d"};
+    auto is_space = [](unsigned char c) { return c == ' ' || (c >= '\t' && c <= '\r'); };
+    auto is_word = [](unsigned char c) { return std::isalnum(c) || c == '_'; };
+    const size_t n = text.size();
+    size_t pos = 0;
+    while (pos < n) {
+        if (is_space(text[pos])) {
+            ++pos;
+            continue;
+        }
+        size_t end = pos;
+        for (const char *literal : kLiterals) {
+            if (text.compare(pos, std::strlen(literal), literal) == 0) {
+                end = pos + std::strlen(literal);
+                break;
+            }
+        }
+        if (end == pos) {
+            if (is_word(text[pos])) {
+                while (end < n && is_word(text[end])) ++end;
+            } else {
+                while (end < n && !is_space(text[end])) ++end;
+            }
+        }
+        words.push_back(text.substr(pos, end - pos));
+        pos = end;
+    }
+}
+
 void mllm::BPETokenizer::setMergeRank(const std::unordered_map<string, unsigned> &merge_rank) {
     this->merge_rank = merge_rank;
+    symbol_ids_.clear();
+    symbols_text_.clear();
+    pair_rank_.clear();
+    word_lru_.clear();
+    word_cache_.clear();
+    for (const auto &[merge, rank] : merge_rank) {
+        auto space = merge.find(' ');
+        if (space == string::npos) {
+            continue;
+        }
+        auto left = merge.substr(0, space), right = merge.substr(space + 1);
+        int l = symbolId(left), r = symbolId(right);
+        int merged = symbolId(left + right);
+        pair_rank_[(uint64_t)l << 32 | (uint32_t)r] = {rank, merged};
+    }
+}
+
+void mllm::BPETokenizer::indexVocab() {
+    if (indexed_vocab_version_ == vocab_version_) {
+        return;
+    }
+    // the cached words were tokenized against the old vocabulary
+    word_lru_.clear();
+    word_cache_.clear();
+    indexed_vocab_version_ = vocab_version_;
+    vocab_view_.clear();
+    vocab_view_.reserve(vocab_map_.size());
+    max_token_len_ = 0;
+    for (const auto &[text, id] : vocab_map_) {
+        vocab_view_.emplace(std::string_view(text), id);
+        max_token_len_ = std::max(max_token_len_, text.size());
+    }
+}
+
+const mllm::token_id_t *mllm::BPETokenizer::findToken(std::string_view text) {
+    indexVocab();
+    auto it = vocab_view_.find(text);
+    return it == vocab_view_.end() ? nullptr : &it->second;
 }
 
 void mllm::BPETokenizer::tryMergeSymbol(size_t start, size_t end) {
     if (start == -1 || end == -1) {
         return;
     }
-    std::string merge_str = std::string(symbols_[start].ch, symbols_[end].ch + symbols_[end].length);
-    auto result = this->vocab_map_.find(merge_str);
-    if (result != this->vocab_map_.end() && result->second < id_token_.size()) {
-        auto token = this->id_token_[result->second];
+    auto merge_str = std::string_view(symbols_[start].ch, symbols_[end].ch + symbols_[end].length - symbols_[start].ch);
+    auto result = findToken(merge_str);
+    if (result && *result < id_token_.size()) {
+        const auto &token = this->id_token_[*result];
         TokenItem item;
         item.start = start;
         item.end = end;
@@ -222,60 +318,32 @@ void mllm::BPETokenizer::tryMergeSymbol(size_t start, size_t end) {
 }
 
 void mllm::BPETokenizer::tokenizeWordWithVocab(const std::string &word, std::vector<token_id_t> &tokens, bool byte_fallback) {
-    if (auto result = this->vocab_map_.find(word); result != this->vocab_map_.end()) {
-        tokens.emplace_back(result->second);
-        // std::cout << "Word: \"" << word << "\" -> [\"" << word << "\"]" << std::endl;
+    if (auto result = findToken(word)) {
+        tokens.emplace_back(*result);
         return;
     }
-    // Use greedy longest-match algorithm
+    // Greedy longest match: the longest vocab entry starting at pos, tried from the longest length down
     size_t pos = 0;
-    std::vector<std::string> token_strings; // For debug output
     while (pos < word.size()) {
-        int best_len = 0;
-        token_id_t best_token = TokenUnk;
-        std::string best_substr;
-        // Try all possible substrings starting from current position
-        for (size_t len = 1; len <= word.size() - pos; ++len) {
-            std::string substr = word.substr(pos, len);
-            auto result = this->vocab_map_.find(substr);
-            if (result != this->vocab_map_.end()) {
-                // Found a match, update best if this is longer
-                if (len > best_len) {
-                    best_len = len;
-                    best_token = result->second;
-                    best_substr = substr;
-                }
+        const token_id_t *best = nullptr;
+        size_t best_len = std::min(max_token_len_, word.size() - pos);
+        for (; best_len > 0; --best_len) {
+            if ((best = findToken(std::string_view(word).substr(pos, best_len)))) {
+                break;
             }
         }
-        if (best_len > 0) {
-            // Found a match, add the token
-            tokens.emplace_back(best_token);
-            token_strings.push_back(best_substr);
+        if (best) {
+            tokens.emplace_back(*best);
             pos += best_len;
+        } else if (!byte_fallback) {
+            tokens.emplace_back(TokenUnk);
+            pos += utf8_len(word[pos]); // Skip one UTF-8 character
         } else {
-            // No match found, handle the single character
-            if (!byte_fallback) {
-                tokens.emplace_back(TokenUnk);
-                token_strings.push_back("<UNK>");
-                pos += utf8_len(word[pos]); // Skip one UTF-8 character
-            } else {
-                // Byte fallback
-                token_id_t token_id = static_cast<uint8_t>(word[pos]) + 3;
-                tokens.emplace_back(token_id);
-                token_strings.push_back(std::string(1, word[pos]));
-                pos += 1;
-            }
+            // Byte fallback
+            tokens.emplace_back(static_cast<uint8_t>(word[pos]) + 3);
+            pos += 1;
         }
     }
-
-    // std::cout << "Word: \"" << word << "\" -> [";
-    // for (size_t i = 0; i < token_strings.size(); ++i) {
-    //     std::cout << "\"" << token_strings[i] << "\"";
-    //     if (i < token_strings.size() - 1) {
-    //         std::cout << ", ";
-    //     }
-    // }
-    // std::cout << "]" << std::endl;
 }
 void mllm::BPETokenizer::tokenize(const std::string &text, std::vector<token_id_t> &tokens, bool bos) {
     this->tokenize(std::move(text), tokens, bos, true);
@@ -4,7 +4,9 @@
 
 #ifndef MLLM_BPE_HPP
 #define MLLM_BPE_HPP
+#include <list>
 #include <queue>
+#include <string_view>
 #include "tokenizers/Tokenizer.hpp"
 #include <unordered_map>
 namespace mllm {
@@ -27,7 +29,25 @@ class BPETokenizer : public Tokenizer {
         int next;
     };
     std::unordered_map<string, unsigned> merge_rank;
+    // merge_rank as integers: (left symbol id << 32 | right symbol id) -> (rank, merged symbol id)
+    std::unordered_map<string, int> symbol_ids_;
+    std::vector<string> symbols_text_;
+    std::unordered_map<uint64_t, std::pair<unsigned, int>> pair_rank_;
+    int symbolId(const string &symbol);
+    // vocab_map_ keys without a std::string per lookup; rebuilt, and the word cache dropped,
+    // whenever vocab_version_ moves
+    std::unordered_map<std::string_view, token_id_t> vocab_view_;
+    size_t max_token_len_ = 0;
+    uint64_t indexed_vocab_version_ = UINT64_MAX;
+    void indexVocab();
+    const token_id_t *findToken(std::string_view text);
+    // pre-token -> ids of the merge_rank path, least recently used first out; cleared by
+    // setMergeRank and on any vocabulary change
+    static constexpr size_t kWordCacheSize = 16384;
+    std::list<std::pair<string, std::vector<token_id_t>>> word_lru_;
+    std::unordered_map<string, std::list<std::pair<string, std::vector<token_id_t>>>::iterator> word_cache_;
     std::vector<CharSymbol> symbols_;
+    std::vector<std::string_view> words_;
     std::priority_queue<TokenItem, std::vector<TokenItem>, TokenItem::Compare> queue_;
     void tryMergeSymbol(size_t start, size_t end);
     void tokenizeWordWithVocab(const std::string &word, std::vector<token_id_t> &tokens, bool byte_fallback);
@@ -39,6 +59,9 @@ public:
     }
     void tokenize(const std::string &text, std::vector<token_id_t> &tokens, bool bos) override;
     vector<std::string> bpe(const std::string &token, std::string end_symbol);
+    // the pre-tokens of the merge_rank path: <|startoftext|>|<|endoftext|>|'s|'t|'re|'ve|'m|'ll|'d|\w+|\d+|\S+
+    // (ECMAScript, first alternative wins), hand-written: std::regex costs more than the tokenization itself
+    static void preTokenize(std::string_view text, std::vector<std::string_view> &words);
     void tokenize(const std::string &text, std::vector<token_id_t> &tokens, bool bos, std::vector<std::string> &special_tokens, bool byte_fallback = false);
     void tokenize(const std::string &text, std::vector<token_id_t> &tokens, bool bos, bool byte_fallback, std::string end_symbol);
     void tokenize(const std::string &text, std::vector<token_id_t> &tokens, const std::vector<std::string> &special);
@@ -0,0 +1,47 @@
+#include "StreamDetokenizer.hpp"
+
+namespace mllm {
+
+// length of the UTF-8 sequence led by byte c, 0 for a continuation byte
+static inline int utf8Length(unsigned char c) {
+    if (c < 0x80) return 1;
+    if ((c & 0xE0) == 0xC0) return 2;
+    if ((c & 0xF0) == 0xE0) return 3;
+    if ((c & 0xF8) == 0xF0) return 4;
+    return (c & 0xC0) == 0x80 ? 0 : 1;
+}
+
+// end of the complete prefix of s: an unfinished code point at the tail is cut,
+// malformed bytes are let through so they are never held back forever
+static size_t completePrefix(const std::string &s) {
+    const size_t size = s.size();
+    for (size_t k = 1; k <= 4 && k <= size; k++) {
+        int len = utf8Length((unsigned char)s[size - k]);
+        if (len == 0) {
+            continue;
+        }
+        return (size_t)len > k ? size - k : size;
+    }
+    return size;
+}
+
+const std::string &StreamDetokenizer::push(token_id_t token) {
+    tokenizer_.appendTokenBytes(token, pending_);
+    size_t end = completePrefix(pending_);
+    out_.assign(pending_, 0, end);
+    pending_.erase(0, end);
+    return out_;
+}
+
+const std::string &StreamDetokenizer::flush() {
+    out_.swap(pending_);
+    pending_.clear();
+    return out_;
+}
+
+void StreamDetokenizer::reset() {
+    pending_.clear();
+    out_.clear();
+}
+
+} // namespace mllm
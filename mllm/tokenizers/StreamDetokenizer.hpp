@@ -0,0 +1,31 @@
+#ifndef MLLM_STREAMDETOKENIZER_HPP
+#define MLLM_STREAMDETOKENIZER_HPP
+#include <string>
+#include "tokenizers/Tokenizer.hpp"
+
+namespace mllm {
+/**
+ * @brief Incremental detokenizer of one generated sequence.
+ * push() appends the bytes of a token (Tokenizer::appendTokenBytes) and returns the text that is
+ * complete so far: only whole UTF-8 code points, the bytes of a code point split across tokens are
+ * held back until the token that completes it. The buffers are reused between calls.
+ */
+class StreamDetokenizer {
+public:
+    explicit StreamDetokenizer(Tokenizer &tokenizer) :
+        tokenizer_(tokenizer) {
+    }
+    // the returned reference stays valid until the next call
+    const std::string &push(token_id_t token);
+    // whatever is still held back (an unfinished code point at the end of the sequence)
+    const std::string &flush();
+    void reset();
+
+private:
+    Tokenizer &tokenizer_;
+    std::string pending_;
+    std::string out_;
+};
+} // namespace mllm
+
+#endif // MLLM_STREAMDETOKENIZER_HPP
@@ -4,6 +4,7 @@
 #include "Backend.hpp"
 #include "ParamLoader.hpp"
 #include "Tokenizer.hpp"
+#include <cctype>
 /* Vocab Structure
  * ┌──────┬──────┬─────┬────────┬──────┬──────┬───────┐
  * │      │      │     │        │      │      │       │
@@ -52,6 +53,7 @@ bool Tokenizer::load_vocab(const std::string &vocab_file) {
         auto token = readString(fp);
         auto score = readf32(fp);
         this->vocab_map_[token] = id;
+        this->vocab_version_++;
         if (score < min_score) {
             min_score = score;
         }
@@ -135,6 +137,47 @@ Tokenizer::Tokenizer(const std::string &vocab_file) :
     if (!load_vocab(vocab_file)) exit(-1);
     // #endif
 }
+string Tokenizer::tokenBytes(token_id_t id) {
+    if (id == TokenUnk) {
+        return "<unk>";
+    }
+    if (id == TokenBos) {
+        return "";
+    }
+    const auto &text = id_token_[id].token;
+    // SentencePiece byte fallback: <0x0A>
+    if (text.size() == 6 && text.compare(0, 3, "<0x") == 0 && text[5] == '>' && isxdigit(text[3]) && isxdigit(text[4])) {
+        return string(1, (char)std::stoi(text.substr(3, 2), nullptr, 16));
+    }
+    // SentencePiece word boundary "▁" (U+2581)
+    string ret;
+    ret.reserve(text.size());
+    for (size_t i = 0; i < text.size(); i++) {
+        if (text.compare(i, 3, "▁") == 0) {
+            ret += ' ';
+            i += 2;
+        } else {
+            ret += text[i];
+        }
+    }
+    return ret;
+}
+
+void Tokenizer::appendTokenBytes(token_id_t id, std::string &out) {
+    if (id >= id_token_.size()) {
+        return;
+    }
+    if (token_bytes_.size() != id_token_.size()) {
+        token_bytes_.assign(id_token_.size(), "");
+        token_bytes_ready_.assign(id_token_.size(), 0);
+    }
+    if (!token_bytes_ready_[id]) {
+        token_bytes_[id] = tokenBytes(id);
+        token_bytes_ready_[id] = 1;
+    }
+    out += token_bytes_[id];
+}
+
 string Tokenizer::detokenize(const vector<token_id_t> &tokens) {
     // int size = tokens.size() - 1;
     int size = tokens.size();
@@ -188,6 +231,7 @@ void Tokenizer::setSpecialToken(const string &bos, const string &eos, const stri
     }
 }
 void Tokenizer::setSpecialTokenMap(std::unordered_map<token_t, token_id_t> special_tokens_map) {
+    this->vocab_version_++;
     for (auto &special_token : special_tokens_map) {
         auto token = special_token.first;
         auto token_id = special_token.second;
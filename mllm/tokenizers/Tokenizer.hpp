@@ -39,6 +39,8 @@ protected:
     inline static token_id_t TokenUnk = 0;
     float min_score_ = 0.0;
     std::unordered_map<token_t, token_id_t> vocab_map_;
+    // bumped on every change of vocab_map_, for what subclasses derive from it
+    uint64_t vocab_version_ = 0;
     std::vector<Token> id_token_;
     std::string vocab_file_name_;
     // #ifdef ANDROID_API
@@ -46,6 +48,10 @@ protected:
     // #endif
 
     bool load_vocab(const std::string &vocab_file);
+    // raw bytes of a vocabulary entry, override when the vocab stores a byte mapping (e.g. byte-level BPE)
+    virtual std::string tokenBytes(token_id_t id);
+    std::vector<std::string> token_bytes_;
+    std::vector<uint8_t> token_bytes_ready_;
 
     std::string chat_template_pre;
     std::string chat_template_end;
@@ -156,6 +162,12 @@ public:
         return {tokenize(text)};
     }
     virtual std::string detokenize(const std::vector<token_id_t> &tokens);
+    /**
+     * @brief Append the raw bytes of one token to `out` (byte-fallback and "▁" already mapped).
+     * The bytes of a token may end inside a UTF-8 code point, see StreamDetokenizer.
+     * They are computed by tokenBytes() once per id and cached.
+     */
+    void appendTokenBytes(token_id_t id, std::string &out);
 
     virtual std::pair<std::string, unsigned> detokenize(Tensor &result) {
         assert(result.batch() == 1);
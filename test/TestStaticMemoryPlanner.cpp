@@ -0,0 +1,113 @@
+#undef NDEBUG // the checks below are the test
+#include "memory/StaticMemoryPlanner.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace std;
+using mllm::StaticMemoryPlanner;
+
+static size_t aligned(size_t size, size_t alignment) {
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+// every offset aligned, inside the arena, and no two requests with overlapping lifetimes overlap in memory
+void check_plan(const vector<StaticMemoryPlanner::Request> &requests, const vector<size_t> &offsets,
+                size_t arena, size_t alignment) {
+    assert(offsets.size() == requests.size());
+    for (size_t i = 0; i < requests.size(); i++) {
+        assert(offsets[i] % alignment == 0);
+        assert(offsets[i] + aligned(requests[i].size, alignment) <= arena);
+        for (size_t j = i + 1; j < requests.size(); j++) {
+            bool live_together = requests[i].first_use <= requests[j].last_use && requests[j].first_use <= requests[i].last_use;
+            if (!live_together) {
+                continue;
+            }
+            bool disjoint = offsets[i] + requests[i].size <= offsets[j] || offsets[j] + requests[j].size <= offsets[i];
+            assert(disjoint);
+        }
+    }
+}
+
+void disjoint_lifetimes_share_memory(size_t alignment) {
+    printf("disjoint_lifetimes_share_memory(%ld)\n", alignment);
+    StaticMemoryPlanner planner(alignment);
+    vector<StaticMemoryPlanner::Request> requests = {{1000, 0, 1}, {1000, 2, 3}, {1000, 4, 5}};
+    vector<size_t> offsets;
+    size_t arena = planner.plan(requests, offsets);
+    check_plan(requests, offsets, arena, alignment);
+    assert(offsets[0] == 0 && offsets[1] == 0 && offsets[2] == 0);
+    assert(arena == aligned(1000, alignment));
+    printf("pass disjoint_lifetimes_share_memory(%ld)\n", alignment);
+}
+
+void overlapping_lifetimes_stack_up(size_t alignment) {
+    printf("overlapping_lifetimes_stack_up(%ld)\n", alignment);
+    StaticMemoryPlanner planner(alignment);
+    // a step reading both of its inputs: all three live at step 2
+    vector<StaticMemoryPlanner::Request> requests = {{300, 0, 2}, {500, 1, 2}, {700, 2, 3}};
+    vector<size_t> offsets;
+    size_t arena = planner.plan(requests, offsets);
+    check_plan(requests, offsets, arena, alignment);
+    assert(arena == aligned(300, alignment) + aligned(500, alignment) + aligned(700, alignment));
+    printf("pass overlapping_lifetimes_stack_up(%ld)\n", alignment);
+}
+
+void small_request_fills_gap(size_t alignment) {
+    printf("small_request_fills_gap(%ld)\n", alignment);
+    StaticMemoryPlanner planner(alignment);
+    // the largest goes first at offset 0; once it is dead its space is reused by the small
+    // tensor living next to the long-lived one instead of growing the arena
+    vector<StaticMemoryPlanner::Request> requests = {{4096, 0, 1}, {1024, 0, 5}, {512, 3, 5}};
+    vector<size_t> offsets;
+    size_t arena = planner.plan(requests, offsets);
+    check_plan(requests, offsets, arena, alignment);
+    assert(offsets[0] == 0);
+    assert(offsets[2] == 0);
+    assert(arena == aligned(4096, alignment) + aligned(1024, alignment));
+    printf("pass small_request_fills_gap(%ld)\n", alignment);
+}
+
+void random_requests(int n, int steps, size_t alignment, unsigned seed) {
+    printf("random_requests(%d,%d,%ld)\n", n, steps, alignment);
+    std::mt19937 rng(seed);
+    vector<StaticMemoryPlanner::Request> requests(n);
+    size_t total = 0;
+    for (auto &req : requests) {
+        req.size = 1 + rng() % 65536;
+        req.first_use = rng() % steps;
+        req.last_use = req.first_use + rng() % 8;
+        total += aligned(req.size, alignment);
+    }
+    StaticMemoryPlanner planner(alignment);
+    vector<size_t> offsets;
+    size_t arena = planner.plan(requests, offsets);
+    check_plan(requests, offsets, arena, alignment);
+    // never worse than no reuse, never below the bytes live at the busiest step
+    size_t peak = 0;
+    for (int s = 0; s < steps + 8; s++) {
+        size_t live = 0;
+        for (auto &req : requests) {
+            if (req.first_use <= s && s <= req.last_use) live += aligned(req.size, alignment);
+        }
+        peak = max(peak, live);
+    }
+    assert(arena <= total);
+    assert(arena >= peak);
+    printf("pass random_requests(%d,%d,%ld) arena %ld, peak live %ld, no reuse %ld\n", n, steps, alignment, arena, peak, total);
+}
+
+int main() {
+    vector<size_t> offsets;
+    assert(StaticMemoryPlanner().plan({}, offsets) == 0 && offsets.empty());
+    for (size_t alignment : {16, 128, 4096}) {
+        disjoint_lifetimes_share_memory(alignment);
+        overlapping_lifetimes_stack_up(alignment);
+        small_request_fills_gap(alignment);
+        random_requests(300, 64, alignment, 7);
+    }
+    return 0;
+}
@@ -0,0 +1,67 @@
+#include "CPUTest.hpp"
+#include "backends/cpu/op/CPUAdd.hpp"
+#include "backends/cpu/op/CPUAddRMSNorm.hpp"
+#include "backends/cpu/op/CPURMSNorm.hpp"
+#include "backends/cpu/compute/Matmul.hpp"
+#include "backends/cpu/third_party/ggml/QuantizeQ4.hpp"
+
+// CPUAddRMSNorm against CPUAdd -> CPURMSNorm with the same weights
+TEST_F(CPUTest, CPUAddRMSNorm) {
+    const int D = 96;
+    auto weight = randomTensor(bn_, "norm.weight", 1, 1, 1, D, 1.0f, 1);
+    MemoryLoader loader;
+    loader.add("norm.weight", *weight);
+
+    for (int seq : {1, 7}) {
+        auto x = randomTensor(bn_, "x", 1, 1, seq, D, 2.0f, 2 + seq);
+        auto residual = randomTensor(bn_, "residual", 1, 1, seq, D, 2.0f, 3 + seq);
+        TENSOR(sum);
+        TENSOR(normed);
+        TENSOR(c_sum);
+        TENSOR(c_normed);
+
+        CPUAdd add(bn_, "add", 4);
+        CPURMSNorm norm(bn_, "norm", D, 1e-6, false, 4);
+        CPUAddRMSNorm op(bn_, "norm", D, 1e-6, false, 4);
+        auto run = [&](Op &o, vector<shared_ptr<Tensor>> in, vector<shared_ptr<Tensor>> out) {
+            ASSERT_FALSE(o.reshape(in, out));
+            ASSERT_FALSE(o.setUp(in, out));
+            ASSERT_FALSE(o.load(loader));
+            ASSERT_FALSE(o.execute(in, out));
+        };
+        run(add, {x, residual}, {sum});
+        run(norm, {sum}, {normed});
+        run(op, {x, residual}, {c_sum, c_normed});
+        COMPARE_TENSOR(c_sum.get(), sum.get(), true);
+        COMPARE_TENSOR(c_normed.get(), normed.get(), true);
+    }
+}
+
+// the Q8_0 copy a GEMM keeps on a shared activation is not reused once the activation is rewritten
+TEST_F(CPUTest, QuantizedCopyFollowsWrites) {
+    const int K = 64;
+    const int N = 32;
+    auto x = randomTensor(bn_, "x", 1, 1, 1, K, 1.0f, 7);
+    auto w = randomTensor(bn_, "w", 1, 1, N, K, 1.0f, 8);
+    Tensor q4(1, 1, N, K, bn_, false);
+    q4.setDtype(MLLM_TYPE_Q4_0);
+    q4.alloc();
+    quantize_row_q4_0(w->hostPtr<float>(), q4.rawHostPtr(), N * K);
+
+    x->shareQuantizedCopy();
+    Tensor first(1, 1, 1, N, bn_, true);
+    mat_mul(x.get(), &q4, &first, false, nullptr, false, true, 4);
+    ASSERT_NE(x->quantizedCopy(MLLM_TYPE_Q8_0, 0), nullptr);
+
+    // rewritten as an op run by CPUBackend::runOp would
+    for (int d = 0; d < K; ++d) {
+        x->setDataAt<float>(0, 0, 0, d, -x->dataAt<float>(0, 0, 0, d));
+    }
+    x->bumpVersion();
+    EXPECT_EQ(x->quantizedCopy(MLLM_TYPE_Q8_0, 0), nullptr);
+    Tensor second(1, 1, 1, N, bn_, true);
+    mat_mul(x.get(), &q4, &second, false, nullptr, false, true, 4);
+    for (int n = 0; n < N; ++n) {
+        EXPECT_NEAR(second.dataAt<float>(0, 0, 0, n), -first.dataAt<float>(0, 0, 0, n), 1e-4) << "column " << n;
+    }
+}
@@ -0,0 +1,63 @@
+#include "CPUToyLM.hpp"
+#include "BatchScheduler.hpp"
+
+// plain greedy decoding of one sequence, one token per forward
+static std::vector<unsigned> greedy(ToyLM &model, std::vector<unsigned> feed, size_t n) {
+    model.clear_kvcache();
+    std::vector<unsigned> out;
+    while (out.size() < n) {
+        auto logits = model.step(feed);
+        out.push_back(ToyLM::argmax(logits));
+        feed = {out.back()};
+    }
+    return out;
+}
+
+// requests joining a running batch decode exactly as they would alone, across a compaction
+TEST_F(CPUTest, BatchSchedulerStaggeredMatchesSingle) {
+    struct Case {
+        std::vector<unsigned> prompt;
+        size_t max_new_tokens;
+        int submit_at; // scheduler step the request arrives at
+    };
+    const std::vector<Case> cases = {
+        {{3, 1, 4, 1}, 40, 0},
+        {{2, 7, 1, 8, 2, 8, 1}, 12, 0},
+        {{5, 9, 2, 6, 5}, 30, 6},
+        {{14, 2, 13, 5, 6, 11}, 25, 15},
+        {{9, 9}, 8, 16},
+        {{1, 6, 1, 8, 0, 3, 3, 9}, 20, 30},
+    };
+    ToyLM single("single");
+    single.load(ToyLM::writeWeights("single", 7));
+    std::vector<std::vector<unsigned>> expect;
+    for (const auto &c : cases) {
+        expect.push_back(greedy(single, c.prompt, c.max_new_tokens));
+    }
+
+    ToyLM batched("batched");
+    batched.load(ToyLM::writeWeights("batched", 7));
+    LlmTextGeneratorOpts opt;
+    opt.do_sample = false;
+    BatchScheduler scheduler(batched, 3, opt, -1, 3);
+    std::vector<int> ids(cases.size(), -1);
+    for (int steps = 0;; ++steps) {
+        bool pending = false;
+        for (int i = 0; i < (int)cases.size(); ++i) {
+            if (ids[i] < 0 && cases[i].submit_at <= steps) {
+                ids[i] = scheduler.submit(cases[i].prompt, [](unsigned) { return true; }, cases[i].max_new_tokens);
+            }
+            pending |= ids[i] < 0;
+        }
+        if (!scheduler.step() && !pending) {
+            break;
+        }
+    }
+    for (int i = 0; i < (int)cases.size(); ++i) {
+        BatchScheduler::FinishReason reason;
+        EXPECT_EQ(scheduler.takeResult(ids[i], &reason), expect[i]) << "request " << i;
+        EXPECT_EQ(reason, BatchScheduler::FinishReason::MaxNewTokens) << "request " << i;
+    }
+    EXPECT_GT(scheduler.compactions(), 0);
+    Module::llm_model_ptr = nullptr;
+}
@@ -3,6 +3,7 @@
 //
 #include "CPUTest.hpp"
 #include "backends/cpu/op/CPUConvolution2D.hpp"
+#include "backends/cpu/compute/Convolution.hpp"
 TEST_F(CPUTest, CPUConvolution2D1) {
     SETUP_OP(CPUConvolution2D, 3, 768, {16, 16}, {16, 16}, VALID, true, 4);
     TENSOR(input0)
@@ -37,4 +38,41 @@ TEST_F(CPUTest, CPUConvolution2D2) {
     PRINT_TENSOR_SHAPES(input0, output, test_output);
     TEST_EXCUTE({input0}, {test_output});
     COMPARE_TENSOR(output.get(), test_output.get(), true);
-}
\ No newline at end of file
+}
+// stride == kernel runs through conv2d_fp32_patchify, checked against conv2d_fp32_VALID with the same weights
+static void checkPatchify(Backend *bn_, int batch, int height, int width) {
+    const int in_channel = 3;
+    const int out_channel = 8;
+    const int k = 4;
+    auto weight = randomTensor(bn_, "weight", out_channel, k, in_channel, k, 0.5f, 1);
+    auto bias = randomTensor(bn_, "bias", 1, 1, 1, out_channel, 0.5f, 2);
+    auto input0 = randomTensor(bn_, "input0", batch, height, in_channel, width, 1.0f, 3);
+    MemoryLoader loader;
+    loader.add("patch.weight", *weight);
+    loader.add("patch.bias", *bias);
+
+    CPUConvolution2D op(bn_, "patch", in_channel, out_channel, {k, k}, {k, k}, VALID, true, 4);
+    TENSOR(test_output);
+    ASSERT_FALSE(op.reshape({input0}, {test_output}));
+    ASSERT_FALSE(op.setUp({input0}, {test_output}));
+    ASSERT_FALSE(op.load(loader));
+    ASSERT_FALSE(op.execute({input0}, {test_output}));
+
+    TENSOR(output);
+    output->reshape(batch, height / k, out_channel, width / k);
+    output->setDtype(MLLM_TYPE_F32);
+    output->alloc();
+    float **kernal = reshape_conv2d_kernal_fp32(weight.get());
+    conv2d_fp32_VALID(input0.get(), output.get(), kernal, k, k, true, bias.get(), k, k, 4);
+    for (int i = 0; i < out_channel; ++i) {
+        delete[] kernal[i];
+    }
+    delete[] kernal;
+    COMPARE_TENSOR(output.get(), test_output.get(), true);
+}
+
+TEST_F(CPUTest, CPUConvolution2DPatchify) {
+    checkPatchify(bn_, 2, 12, 8);
+    // a single patch per image: the gemm writes straight into the output
+    checkPatchify(bn_, 3, 4, 4);
+}
@@ -3,6 +3,7 @@
 //
 #include "CPUTest.hpp"
 #include "backends/cpu/op/CPUConvolution3D.hpp"
+#include "backends/cpu/compute/Convolution.hpp"
 TEST_F(CPUTest, CPUConvolution3D1) {
     SETUP_OP(CPUConvolution3D, 3, 1280, {2, 14, 14}, {2, 14, 14}, VALID, false, 4);
     TENSOR(input0)
@@ -37,4 +38,71 @@ TEST_F(CPUTest, CPUConvolution3D1) {
 //     PRINT_TENSOR_SHAPES(input0, output, test_output);
 //     TEST_EXCUTE({input0}, {test_output});
 //     COMPARE_TENSOR(output.get(), test_output.get(), true);
-// }
\ No newline at end of file
+// }
+
+// the values of src as a BCTHW tensor of the given shape
+static shared_ptr<Tensor> as5D(Backend *bn, Tensor &src, int b, int c, int t, int h, int w) {
+    auto dst = std::make_shared<Tensor>(bn);
+    dst->setCtype(BCTHW);
+    dst->reshape(b, c, t, h, w);
+    dst->setDtype(MLLM_TYPE_F32);
+    dst->alloc();
+    memcpy(dst->rawHostPtr(), src.rawHostPtr(), src.count() * sizeof(float));
+    return dst;
+}
+
+// stride == kernel runs through conv3d_fp32_patchify, checked against conv3d_fp32_VALID with the same weights
+static void checkPatchify(Backend *bn_, int batch, int time, int height, int width) {
+    const int in_channel = 3;
+    const int out_channel = 8;
+    const int kt = 2;
+    const int k = 4;
+    auto weight = randomTensor(bn_, "weight", out_channel, in_channel * kt, k, k, 0.5f, 1);
+    auto bias = randomTensor(bn_, "bias", 1, 1, 1, out_channel, 0.5f, 2);
+    auto flat = randomTensor(bn_, "flat", batch, in_channel * time, height, width, 1.0f, 3);
+    auto input0 = as5D(bn_, *flat, batch, in_channel, time, height, width);
+    MemoryLoader loader;
+    loader.add("patch.weight", *weight);
+    loader.add("patch.bias", *bias);
+
+    CPUConvolution3D op(bn_, "patch", in_channel, out_channel, {kt, k, k}, {kt, k, k}, VALID, true, 4);
+    TENSOR(test_output);
+    test_output->setCtype(BCTHW);
+    ASSERT_FALSE(op.reshape({input0}, {test_output}));
+    ASSERT_FALSE(op.setUp({input0}, {test_output}));
+    ASSERT_FALSE(op.load(loader));
+    ASSERT_FALSE(op.execute({input0}, {test_output}));
+
+    TENSOR(output);
+    output->setCtype(BCTHW);
+    output->reshape(batch, out_channel, time / kt, height / k, width / k);
+    output->setDtype(MLLM_TYPE_F32);
+    output->alloc();
+    auto weight5 = as5D(bn_, *weight, out_channel, in_channel, kt, k, k);
+    auto bias5 = as5D(bn_, *bias, 1, 1, 1, 1, out_channel);
+    float **kernal = reshape_conv3d_kernal_fp32(weight5.get());
+    conv3d_fp32_VALID(input0.get(), output.get(), kernal, kt, k, k, true, bias5.get(), kt, k, k, 4);
+    for (int i = 0; i < out_channel; ++i) {
+        delete[] kernal[i];
+    }
+    delete[] kernal;
+    ASSERT_EQ(test_output->count(), output->count());
+    for (int b = 0; b < batch; ++b) {
+        for (int c = 0; c < out_channel; ++c) {
+            for (int t = 0; t < time / kt; ++t) {
+                for (int h = 0; h < height / k; ++h) {
+                    for (int w = 0; w < width / k; ++w) {
+                        ASSERT_NEAR(test_output->dataAt<float>(b, c, t, h, w), output->dataAt<float>(b, c, t, h, w), 1e-4)
+                            << "batch " << b << " channel " << c << " time " << t << " row " << h << " column " << w;
+                    }
+                }
+            }
+        }
+    }
+}
+
+TEST_F(CPUTest, CPUConvolution3DPatchify) {
+    checkPatchify(bn_, 2, 4, 12, 8);
+    // a single patch per batch, as the Qwen2-VL processor feeds it: the input is used in place
+    checkPatchify(bn_, 5, 2, 4, 4);
+}
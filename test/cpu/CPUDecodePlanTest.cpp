@@ -0,0 +1,46 @@
+#include "CPUToyLM.hpp"
+
+// logits of a prefill and `steps` greedy decode steps, read only after the last step so a step
+// writing into the tensors an earlier one returned shows up as a mismatch
+static std::vector<std::vector<float>> decodeLogits(const std::string &path, int steps, size_t *plan_size) {
+    auto *cpu = dynamic_cast<CPUBackend *>(Backend::global_backends[MLLM_CPU].get());
+    cpu->resetDecodePlan();
+    ToyLM model("plan");
+    model.load(path);
+    std::vector<Tensor> kept;
+    std::vector<unsigned> feed = {2, 7, 1, 8};
+    for (int i = 0; i <= steps; ++i) {
+        kept.push_back(model.step(feed));
+        feed = {ToyLM::argmax(kept.back())};
+    }
+    *plan_size = cpu->decodePlanSize();
+    std::vector<std::vector<float>> logits;
+    for (auto &t : kept) {
+        const float *row = t.ptrAt<float>(0, 0, t.sequence() - 1, 0);
+        logits.emplace_back(row, row + ToyLM::vocab);
+    }
+    cpu->resetDecodePlan();
+    return logits;
+}
+
+TEST_F(CPUTest, DecodePlanMatchesEager) {
+    auto path = ToyLM::writeWeights("plan", 5);
+    const int steps = 6;
+    size_t plan_size = 0;
+    CPUBackend::use_decode_plan = false;
+    auto eager = decodeLogits(path, steps, &plan_size);
+    EXPECT_EQ(plan_size, 0u);
+    for (bool arena : {false, true}) {
+        CPUBackend::use_decode_plan = true;
+        CPUBackend::use_decode_plan_arena = arena;
+        auto planned = decodeLogits(path, steps, &plan_size);
+        EXPECT_GT(plan_size, 0u) << "arena=" << arena;
+        ASSERT_EQ(planned.size(), eager.size());
+        for (size_t i = 0; i < eager.size(); ++i) {
+            EXPECT_EQ(planned[i], eager[i]) << "step " << i << " arena=" << arena;
+        }
+    }
+    CPUBackend::use_decode_plan = false;
+    CPUBackend::use_decode_plan_arena = false;
+    Module::llm_model_ptr = nullptr;
+}
@@ -0,0 +1,46 @@
+#include "CPUToyLM.hpp"
+#include "DraftDecoder.hpp"
+
+// plain greedy decoding with the model alone, one token per forward
+static std::vector<unsigned> greedy(ToyLM &model, std::vector<unsigned> feed, size_t n) {
+    model.clear_kvcache();
+    std::vector<unsigned> out;
+    while (out.size() < n) {
+        auto logits = model.step(feed);
+        out.push_back(ToyLM::argmax(logits));
+        feed = {out.back()};
+    }
+    return out;
+}
+
+// the draft decoder keeps exactly the target's greedy output, whatever the draft proposes
+TEST_F(CPUTest, DraftDecoderGreedyMatchesTarget) {
+    const std::vector<unsigned> prompt = {3, 1, 4, 1, 5};
+    LlmTextGeneratorOpts opt;
+    opt.do_sample = false;
+    opt.max_new_tokens = 24;
+
+    for (bool same_weights : {true, false}) {
+        ToyLM target("target");
+        ToyLM draft("draft");
+        ToyLM other("other");
+        other.load(ToyLM::writeWeights("other", 3));
+        const int other_len = other.cacheLength();
+
+        DraftModelDecoder decoder(target, draft, 4, 2);
+        decoder.load(ToyLM::writeWeights("target", 1), ToyLM::writeWeights("draft", same_weights ? 1 : 2));
+        auto result = decoder.generate(prompt, opt);
+        auto expect = greedy(target, prompt, opt.max_new_tokens);
+        EXPECT_EQ(result, expect) << "same_weights=" << same_weights;
+
+        const auto &stats = decoder.stats();
+        EXPECT_EQ(stats.generated, result.size());
+        if (same_weights) {
+            EXPECT_EQ(stats.accepted, stats.drafted);
+            EXPECT_GT(stats.tokensPerStep(), 1.0);
+        }
+        // only the caches of the decoder's two models are rolled back
+        EXPECT_EQ(other.cacheLength(), other_len);
+    }
+    Module::llm_model_ptr = nullptr;
+}
@@ -0,0 +1,135 @@
+#include "CPUTest.hpp"
+#include "ExpertCache.hpp"
+#include "Layer.hpp"
+#include "Module.hpp"
+#include "ParamWriter.hpp"
+#include <random>
+
+// an embedding through one routed expert (a Linear) per layer; the route is set per step
+class ExpertLM final : public Module {
+public:
+    static constexpr int vocab = 16;
+    static constexpr int hidden = 8;
+    static constexpr int layers = 2;
+    static constexpr int experts = 3;
+
+    ExpertLM(const std::string &name, ExpertCache *cache) :
+        cache_(cache) {
+        embedding = Embedding(vocab, hidden, name + ".embed");
+        experts_.resize(layers);
+        for (int l = 0; l < layers; ++l) {
+            for (int e = 0; e < experts; ++e) {
+                experts_[l].push_back(Linear(hidden, hidden, false, name + ".l" + std::to_string(l) + ".e" + std::to_string(e)));
+            }
+        }
+        if (cache_) {
+            for (int l = 0; l < layers; ++l) {
+                for (int e = 0; e < experts; ++e) {
+                    cache_->registerExpert(l, e, {&experts_[l][e]});
+                }
+            }
+        }
+    }
+    vector<Tensor> Forward(vector<Tensor> inputs, vector<std::any> args) override {
+        auto x = embedding(inputs[0]);
+        if (Module::llm_model_ptr->doLoad) {
+            // without a cache every expert is loaded now, with one only through the cache
+            if (cache_) {
+                cache_->setLoader(Module::llm_model_ptr->loader);
+            }
+            for (int l = 0; l < layers && cache_ == nullptr; ++l) {
+                for (auto &expert : experts_[l]) {
+                    expert(x);
+                }
+            }
+            return {x};
+        }
+        for (int l = 0; l < layers; ++l) {
+            if (cache_) {
+                cache_->acquire(l, {{route_[l], 1.0f}});
+            }
+            x = experts_[l][route_[l]](x);
+            if (cache_) {
+                cache_->release(l);
+            }
+        }
+        return {x};
+    }
+
+    // the same random weights for every name prefix and seed, returns the model file
+    static std::string writeWeights(const std::string &name, unsigned seed = 5) {
+        auto path = testing::TempDir() + name + "_" + std::to_string(seed) + ".mllm";
+        std::vector<std::pair<std::string, int>> params = {{name + ".embed.weight", vocab * hidden}};
+        for (int l = 0; l < layers; ++l) {
+            for (int e = 0; e < experts; ++e) {
+                params.emplace_back(name + ".l" + std::to_string(l) + ".e" + std::to_string(e) + ".weight", hidden * hidden);
+            }
+        }
+        std::vector<std::string> names;
+        for (auto &param : params) {
+            names.push_back(param.first);
+        }
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+        ParamWriter writer(path);
+        writer.paddingIndex(names);
+        for (auto &[param, size] : params) {
+            std::vector<float> weight(size);
+            for (auto &w : weight) {
+                w = dist(rng);
+            }
+            writer.beginWriteParam(param, MLLM_TYPE_F32);
+            writer.writeChunk(weight.data(), weight.size() * sizeof(float));
+            writer.endWriteParam();
+        }
+        writer.writeIndex();
+        return path;
+    }
+
+    Tensor step(unsigned token, std::vector<int> route) {
+        route_ = std::move(route);
+        Tensor input(1, 1, 1, 1, Backend::global_backends[MLLM_CPU].get(), true);
+        input.setName("input");
+        Tensor::tensor_status = TENSOR_STATIC_INIT;
+        input.setTtype(INPUT_TENSOR);
+        input.setDataAt<float>(0, 0, 0, 0, token);
+        return (*this)({input})[0];
+    }
+
+private:
+    ExpertCache *cache_;
+    Layer embedding;
+    std::vector<std::vector<Layer>> experts_;
+    std::vector<int> route_;
+};
+
+// experts evicted and loaded again, with and without prefetch, give the outputs of a model that
+// keeps every expert resident; a decoy with the same names but other weights is loaded last, so
+// Module::llm_model_ptr points at it while the cached model reloads its experts
+TEST_F(CPUTest, ExpertCacheEvictAndRerun) {
+    const std::vector<std::vector<int>> routes = {{0, 1}, {2, 1}, {0, 0}, {1, 2}, {2, 2}, {0, 1}, {1, 0}, {2, 1}, {0, 2}, {1, 1}};
+    for (bool prefetch : {false, true}) {
+        ExpertCache cache(ExpertLM::layers, ExpertLM::experts, 1, ExpertEvictPolicy::LRU, prefetch);
+        ExpertLM cached("expert_cached", &cache);
+        cached.load(ExpertLM::writeWeights("expert_cached"));
+        ExpertLM reference("expert_ref", nullptr);
+        reference.load(ExpertLM::writeWeights("expert_ref"));
+        ExpertLM decoy("expert_cached", nullptr);
+        decoy.load(ExpertLM::writeWeights("expert_cached", 6));
+        for (int round = 0; round < 3; ++round) {
+            for (int i = 0; i < (int)routes.size(); ++i) {
+                unsigned token = (i * 7 + round) % ExpertLM::vocab;
+                auto a = cached.step(token, routes[i]);
+                auto b = reference.step(token, routes[i]);
+                for (int d = 0; d < ExpertLM::hidden; ++d) {
+                    ASSERT_FLOAT_EQ(a.dataAt<float>(0, 0, 0, d), b.dataAt<float>(0, 0, 0, d))
+                        << "prefetch " << prefetch << " round " << round << " step " << i << " column " << d;
+                }
+            }
+        }
+        // one resident expert for two layers: every layer switch evicted
+        EXPECT_GT(cache.misses(), ExpertLM::layers * ExpertLM::experts);
+        EXPECT_LE(cache.resident(), ExpertLM::layers);
+    }
+    Module::llm_model_ptr = nullptr;
+}
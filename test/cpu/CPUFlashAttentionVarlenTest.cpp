@@ -0,0 +1,111 @@
+#include "CPUTest.hpp"
+#include <cmath>
+#include <limits>
+
+// the F_FA2 op of Tensor::flash_attention2_(varlen_)forward, plain with three inputs
+static vector<shared_ptr<Tensor>> runFA2(Backend *bn, bool causal, vector<shared_ptr<Tensor>> inputs) {
+    OpParam param;
+    param["type"] = F_FA2;
+    param["causal_mask"] = causal ? 1.0f : 0.0f;
+    std::unique_ptr<Op> op(bn->opCreate(param, "fa2", 4));
+    auto out = std::make_shared<Tensor>(bn);
+    op->reshape(inputs, {out});
+    out->alloc();
+    op->execute(inputs, {out});
+    return {out};
+}
+
+// rows [start, start + len) of t, heads and dimension kept
+static shared_ptr<Tensor> rows(Backend *bn, Tensor &t, int start, int len) {
+    auto r = std::make_shared<Tensor>(bn);
+    r->reshape(1, t.head(), len, t.dimension());
+    r->setDtype(MLLM_TYPE_F32);
+    r->alloc();
+    for (int h = 0; h < t.head(); ++h) {
+        for (int s = 0; s < len; ++s) {
+            for (int d = 0; d < t.dimension(); ++d) {
+                r->setDataAt<float>(0, h, s, d, t.dataAt<float>(0, h, start + s, d));
+            }
+        }
+    }
+    return r;
+}
+
+// cu_seqlens [0, 5, 6, 13, 20]: segments of 5, 1 and twice 7 rows, some not a multiple of the
+// 4-row block, with GQA KV heads; the varlen output equals the plain op run on every segment
+// alone and a softmax over the whole sequence with a block-diagonal mask
+TEST_F(CPUTest, CPUFlashAttention2Varlen) {
+    const std::vector<int> cu = {0, 5, 6, 13, 20};
+    const int seq = cu.back();
+    const int q_heads = 4;
+    const int kv_heads = 2;
+    const int dim = 16;
+    auto q = randomTensor(bn_, "q", 1, q_heads, seq, dim, 1.0f, 1);
+    auto k = randomTensor(bn_, "k", 1, kv_heads, seq, dim, 1.0f, 2);
+    auto v = randomTensor(bn_, "v", 1, kv_heads, seq, dim, 1.0f, 3);
+    auto cu_seqlens = std::make_shared<Tensor>(bn_);
+    cu_seqlens->reshape(1, 1, 1, cu.size());
+    cu_seqlens->setDtype(MLLM_TYPE_F32);
+    cu_seqlens->alloc();
+    for (int i = 0; i < (int)cu.size(); ++i) {
+        cu_seqlens->setDataAt<float>(0, 0, 0, i, cu[i]);
+    }
+
+    for (bool causal : {false, true}) {
+        auto out = runFA2(bn_, causal, {q, k, v, cu_seqlens})[0];
+        ASSERT_EQ(out->sequence(), seq);
+        const char *what = causal ? "causal" : "full";
+
+        for (int i = 1; i < (int)cu.size(); ++i) {
+            int start = cu[i - 1];
+            int len = cu[i] - start;
+            auto seg = runFA2(bn_, causal, {rows(bn_, *q, start, len), rows(bn_, *k, start, len), rows(bn_, *v, start, len)})[0];
+            for (int h = 0; h < q_heads; ++h) {
+                for (int s = 0; s < len; ++s) {
+                    for (int d = 0; d < dim; ++d) {
+                        ASSERT_NEAR(out->dataAt<float>(0, h, start + s, d), seg->dataAt<float>(0, h, s, d), 1e-5)
+                            << what << " segment " << i << " head " << h << " row " << s << " column " << d;
+                    }
+                }
+            }
+        }
+
+        std::vector<int> segment(seq);
+        for (int i = 1; i < (int)cu.size(); ++i) {
+            std::fill(segment.begin() + cu[i - 1], segment.begin() + cu[i], i);
+        }
+        const float scale = 1.0f / std::sqrt((float)dim);
+        std::vector<float> p(seq);
+        for (int h = 0; h < q_heads; ++h) {
+            int kh = h / (q_heads / kv_heads);
+            for (int s = 0; s < seq; ++s) {
+                float max = -std::numeric_limits<float>::infinity();
+                for (int t = 0; t < seq; ++t) {
+                    p[t] = -std::numeric_limits<float>::infinity();
+                    if (segment[t] != segment[s] || (causal && t > s)) {
+                        continue;
+                    }
+                    float dot = 0;
+                    for (int d = 0; d < dim; ++d) {
+                        dot += q->dataAt<float>(0, h, s, d) * k->dataAt<float>(0, kh, t, d);
+                    }
+                    p[t] = dot * scale;
+                    max = std::max(max, p[t]);
+                }
+                float sum = 0;
+                for (int t = 0; t < seq; ++t) {
+                    p[t] = std::exp(p[t] - max);
+                    sum += p[t];
+                }
+                for (int d = 0; d < dim; ++d) {
+                    float o = 0;
+                    for (int t = 0; t < seq; ++t) {
+                        o += p[t] / sum * v->dataAt<float>(0, kh, t, d);
+                    }
+                    ASSERT_NEAR(out->dataAt<float>(0, h, s, d), o, 1e-4)
+                        << what << " masked head " << h << " row " << s << " column " << d;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,72 @@
+#include "CPUTest.hpp"
+#include "Generate.hpp"
+#include <set>
+
+// one row of logits [1, 1, 1, V]
+static Tensor logitsRow(Backend *bn, const std::vector<float> &values) {
+    Tensor t(1, 1, 1, values.size(), bn, true);
+    for (size_t i = 0; i < values.size(); ++i) {
+        t.setDataAt<float>(0, 0, 0, i, values[i]);
+    }
+    return t;
+}
+
+TEST_F(CPUTest, GenerateRepetitionPenaltyOncePerToken) {
+    LlmTextGeneratorOpts opt;
+    opt.do_sample = false;
+    opt.repetition_penalty = 1.2f;
+    LlmTextGenerator generator(LLmTextGeneratorType::kGreedySearch, opt);
+    auto strong = logitsRow(bn_, {0.f, 10.f, 1.f});
+    for (int i = 0; i < 3; ++i) {
+        ASSERT_EQ(generator.generate(strong), 1u);
+    }
+    // history {1, 1, 1}: 2.0 / 1.2 still beats 1.5, 2.0 / 1.2^3 would not
+    auto row = logitsRow(bn_, {0.f, 2.f, 1.5f});
+    EXPECT_EQ(generator.generate(row), 1u);
+    // the caller's logits are left as they were
+    EXPECT_EQ(row.dataAt<float>(0, 0, 0, 1), 2.f);
+    EXPECT_EQ(strong.dataAt<float>(0, 0, 0, 1), 10.f);
+}
+
+TEST_F(CPUTest, GenerateClearHistory) {
+    LlmTextGeneratorOpts opt;
+    opt.do_sample = false;
+    opt.repetition_penalty = 1.2f;
+    LlmTextGenerator generator(LLmTextGeneratorType::kGreedySearch, opt);
+    auto first = logitsRow(bn_, {0.f, 10.f, 1.f});
+    ASSERT_EQ(generator.generate(first), 1u);
+    auto row = logitsRow(bn_, {0.f, 1.6f, 1.5f});
+    EXPECT_EQ(generator.generate(row), 2u);
+    generator.clearHistory();
+    EXPECT_EQ(generator.generate(row), 1u);
+}
+
+TEST_F(CPUTest, GenerateTopkStaysInTopk) {
+    LlmTextGeneratorOpts opt;
+    opt.top_k = 3;
+    opt.temperature = 1.0f;
+    opt.seed = 7;
+    LlmTextGenerator generator(LLmTextGeneratorType::kTopkSampling, opt);
+    auto row = logitsRow(bn_, {0.1f, 3.f, -1.f, 2.9f, 0.5f, 2.8f, 0.f, 1.f});
+    std::set<unsigned> seen;
+    for (int i = 0; i < 200; ++i) {
+        seen.insert(generator.generate(row));
+    }
+    EXPECT_EQ(seen, (std::set<unsigned>{1, 3, 5}));
+}
+
+TEST_F(CPUTest, GenerateToppStaysInNucleus) {
+    LlmTextGeneratorOpts opt;
+    opt.top_k = 0;
+    opt.top_p = 0.75f;
+    opt.temperature = 1.0f;
+    opt.seed = 11;
+    LlmTextGenerator generator(LLmTextGeneratorType::kToppSampling, opt);
+    // 0.5 + 0.3 covers top_p, the tail is never drawn
+    auto row = logitsRow(bn_, {0.05f, 0.5f, 0.1f, 0.3f, 0.05f});
+    std::set<unsigned> seen;
+    for (int i = 0; i < 200; ++i) {
+        seen.insert(generator.generate(row));
+    }
+    EXPECT_EQ(seen, (std::set<unsigned>{1, 3}));
+}
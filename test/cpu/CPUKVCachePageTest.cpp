@@ -0,0 +1,47 @@
+#include "CPUToyLM.hpp"
+#include "backends/cpu/op/CPUKVCache.hpp"
+
+// greedy decode logits of a prefill and `steps` decode steps; `capacities` gets the cache capacity
+// after every step
+static std::vector<std::vector<float>> decodeLogits(const std::string &path, int page_size, int steps, std::vector<int> &capacities) {
+    int saved = KVCache_page_size;
+    KVCache_page_size = page_size;
+    ToyLM model("paged");
+    model.load(path);
+    auto caches = CPUKVCache::cachesOf(&model);
+    std::vector<std::vector<float>> logits;
+    std::vector<unsigned> feed = {2, 7, 1, 8};
+    for (int i = 0; i <= steps; ++i) {
+        auto out = model.step(feed);
+        const float *row = out.ptrAt<float>(0, 0, out.sequence() - 1, 0);
+        logits.emplace_back(row, row + ToyLM::vocab);
+        capacities.push_back(caches.empty() ? 0 : caches[0]->cache_->sequence());
+        feed = {ToyLM::argmax(out)};
+    }
+    KVCache_page_size = saved;
+    return logits;
+}
+
+// a paged cache grown across several page boundaries decodes exactly like one allocated to cache_max
+TEST_F(CPUTest, CPUKVCachePagedMatchesFull) {
+    auto path = ToyLM::writeWeights("paged", 4);
+    const int steps = 50;
+    std::vector<int> full_capacity;
+    std::vector<int> paged_capacity;
+    auto full = decodeLogits(path, 0, steps, full_capacity);
+    auto paged = decodeLogits(path, 8, steps, paged_capacity);
+    ASSERT_EQ(paged.size(), full.size());
+    for (size_t i = 0; i < full.size(); ++i) {
+        EXPECT_EQ(paged[i], full[i]) << "step " << i;
+    }
+    EXPECT_EQ(full_capacity.front(), full_capacity.back());
+    int grows = 0;
+    for (size_t i = 1; i < paged_capacity.size(); ++i) {
+        EXPECT_GE(paged_capacity[i], paged_capacity[i - 1]);
+        grows += paged_capacity[i] > paged_capacity[i - 1];
+    }
+    EXPECT_GE(grows, 2);
+    EXPECT_LT(paged_capacity.front(), full_capacity.front());
+    EXPECT_LE(paged_capacity.back(), full_capacity.back());
+    Module::llm_model_ptr = nullptr;
+}
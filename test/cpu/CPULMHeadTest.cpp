@@ -0,0 +1,64 @@
+#include "CPUTest.hpp"
+#include "Context.hpp"
+#include "backends/cpu/op/CPULinear.hpp"
+#include "backends/cpu/op/CPULMHead.hpp"
+#include <limits>
+
+// CPULMHead against CPULinear over the same embedding rows, in full and through the allowed set
+static void checkLMHead(Backend *bn_, DataType dtype, int seq, const std::vector<int> &allowed) {
+    const int K = 64;
+    const int V = 200;
+    auto emb = randomTensor(bn_, "emb", 1, 1, V, K, 0.5f, 1);
+    auto x = randomTensor(bn_, "x", 1, 1, seq, K, 1.0f, 2);
+    MemoryLoader loader;
+    loader.add("embed.weight", *emb, dtype);
+
+    auto &state = Context::Instance().lm_head_state();
+    state.reset();
+    state.setEnabled(!allowed.empty());
+    state.setAllowed(allowed);
+
+    TENSOR(expect);
+    TENSOR(output);
+    CPULinear linear(bn_, "embed", K, V, false, 4);
+    CPULMHead op(bn_, "embed.lm_head", K, V, 4);
+    auto run = [&](Op &o, vector<shared_ptr<Tensor>> in, vector<shared_ptr<Tensor>> out) {
+        ASSERT_FALSE(o.reshape(in, out));
+        ASSERT_FALSE(o.setUp(in, out));
+        ASSERT_FALSE(o.load(loader));
+        ASSERT_FALSE(o.execute(in, out));
+    };
+    run(linear, {x}, {expect});
+    run(op, {x}, {output});
+    EXPECT_TRUE(state.allowed().empty()) << "the allowed set holds for one step";
+    state.reset();
+
+    std::vector<uint8_t> keep(V, allowed.empty());
+    for (int t : allowed) {
+        keep[t] = 1;
+    }
+    for (int s = 0; s < seq; ++s) {
+        for (int t = 0; t < V; ++t) {
+            float got = output->dataAt<float>(0, 0, s, t);
+            if (keep[t]) {
+                ASSERT_NEAR(got, expect->dataAt<float>(0, 0, s, t), 1e-3) << "s=" << s << " t=" << t;
+            } else {
+                ASSERT_EQ(got, -std::numeric_limits<float>::infinity()) << "s=" << s << " t=" << t;
+            }
+        }
+    }
+}
+
+TEST_F(CPUTest, CPULMHeadFull) {
+    checkLMHead(bn_, MLLM_TYPE_F32, 1, {});
+    checkLMHead(bn_, MLLM_TYPE_Q4_0, 3, {});
+}
+TEST_F(CPUTest, CPULMHeadAllowed) {
+    // decode rows dot the allowed tokens only
+    checkLMHead(bn_, MLLM_TYPE_F32, 1, {3, 17, 17, 199});
+    checkLMHead(bn_, MLLM_TYPE_Q4_0, 1, {0, 42, 100});
+}
+TEST_F(CPUTest, CPULMHeadAllowedFullPass) {
+    // too many rows for the shortlist pass: the full logits are masked to the allowed set
+    checkLMHead(bn_, MLLM_TYPE_Q4_0, 6, {5, 6, 150});
+}
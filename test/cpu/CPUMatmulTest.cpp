@@ -3,6 +3,9 @@
 //
 #include "CPUTest.hpp"
 #include "backends/cpu/op/CPUMatmul.hpp"
+#include "backends/cpu/compute/Matmul.hpp"
+#include "backends/cpu/third_party/ggml/GemmPack.hpp"
+#include "backends/cpu/third_party/ggml/QuantizeQ4.hpp"
 // TEST_F(CPUTest, CPUMatmul1) {
 //     SETUP_OP(CPUMatmul, false, false, 4);
 //     TENSOR(input0);
@@ -51,4 +54,97 @@ TEST_F(CPUTest, CPUMatmul1) {
 //     TEST_EXCUTE({input0, input1}, {c_output});
 ////     c_output->printData<float>();
 //     COMPARE_TENSOR(c_output.get(), output.get(), true);
-// }
\ No newline at end of file
+// }
+// interleaved Q4_0 weights take the gemv column-block path; with 4 threads N = 76 leaves a tail
+// after the 16-column blocks, which must come out like the plain Q4_0 vec_dot columns
+TEST_F(CPUTest, CPUMatmulGemvTailColumns) {
+    const int K = 64;
+    const int N = 76;
+    auto x = randomTensor(bn_, "x", 1, 1, 1, K, 1.0f, 1);
+    auto w = randomTensor(bn_, "w", 1, 1, N, K, 1.0f, 2);
+    Tensor q4(1, 1, N, K, bn_, false);
+    q4.setDtype(MLLM_TYPE_Q4_0);
+    q4.alloc();
+    quantize_row_q4_0(w->hostPtr<float>(), q4.rawHostPtr(), N * K);
+    Tensor q4x8(1, 1, N, K, bn_, false);
+    q4x8.setDtype(MLLM_TYPE_Q4_0_4_8);
+    q4x8.alloc();
+    quantize_q4_0_4x8(w->hostPtr<float>(), q4x8.rawHostPtr(), N, K, nullptr);
+
+    Tensor expect(1, 1, 1, N, bn_, true);
+    Tensor out(1, 1, 1, N, bn_, true);
+    memset(out.hostPtr<float>(), 0, N * sizeof(float));
+    mat_mul(x.get(), &q4, &expect, false, nullptr, false, true, 4);
+    mat_mul(x.get(), &q4x8, &out, false, nullptr, false, true, 4);
+    for (int n = 0; n < N; ++n) {
+        EXPECT_NEAR(out.dataAt<float>(0, 0, 0, n), expect.dataAt<float>(0, 0, 0, n), 1e-3) << "column " << n;
+    }
+}
+
+// copy of kv with every head repeated n_rep times, as a replicated KV cache stores it
+static shared_ptr<Tensor> repeatHeads(Backend *bn, Tensor &kv, int n_rep, DataType dtype, ChlType ctype = BSHD) {
+    auto t = std::make_shared<Tensor>(bn);
+    t->setCtype(ctype);
+    t->reshape(kv.batch(), kv.head() * n_rep, kv.sequence(), kv.dimension());
+    t->setDtype(dtype);
+    t->alloc();
+    for (int b = 0; b < kv.batch(); ++b) {
+        for (int h = 0; h < t->head(); ++h) {
+            for (int s = 0; s < kv.sequence(); ++s) {
+                for (int d = 0; d < kv.dimension(); ++d) {
+                    float v = kv.dataAt<float>(b, h / n_rep, s, d);
+                    if (dtype == MLLM_TYPE_F16) {
+                        t->setDataAt<mllm_fp16_t>(b, h, s, d, MLLM_FP32_TO_FP16(v));
+                    } else {
+                        t->setDataAt<float>(b, h, s, d, v);
+                    }
+                }
+            }
+        }
+    }
+    return t;
+}
+
+// GQA with un-replicated KV heads (n_rep = 2), as Tensor::mm hands them to mat_mul: query head h
+// reads KV head h / 2, and the result is the one of the KV heads expanded to every query head,
+// for QK^T and PV with F32 and F16 KV
+TEST_F(CPUTest, CPUMatmulSharedKVHeads) {
+    const int n_rep = 2;
+    const int q_heads = 4;
+    const int M = 3;
+    const int N = 5;
+    const int K = 32;
+    auto compare = [](Tensor &out, Tensor &expect, const std::string &what) {
+        for (int h = 0; h < out.head(); ++h) {
+            for (int s = 0; s < out.sequence(); ++s) {
+                for (int d = 0; d < out.dimension(); ++d) {
+                    ASSERT_NEAR(out.dataAt<float>(0, h, s, d), expect.dataAt<float>(0, h, s, d), 1e-4)
+                        << what << " head " << h << " row " << s << " column " << d;
+                }
+            }
+        }
+    };
+    auto q = randomTensor(bn_, "q", 1, q_heads, M, K, 1.0f, 3);
+    auto k = randomTensor(bn_, "k", 1, q_heads / n_rep, N, K, 1.0f, 4);
+    auto p = randomTensor(bn_, "p", 1, q_heads, M, N, 1.0f, 5);
+    auto v = randomTensor(bn_, "v", 1, q_heads / n_rep, N, K, 1.0f, 6);
+    for (auto dtype : {MLLM_TYPE_F32, MLLM_TYPE_F16}) {
+        std::string name = dtype == MLLM_TYPE_F16 ? " f16" : " f32";
+        auto k_shared = repeatHeads(bn_, *k, 1, dtype);
+        auto k_rep = repeatHeads(bn_, *k, n_rep, dtype);
+        Tensor qk(1, q_heads, M, N, bn_, true);
+        Tensor qk_expect(1, q_heads, M, N, bn_, true);
+        mat_mul(q.get(), k_shared.get(), &qk, false, nullptr, false, true, 4);
+        mat_mul(q.get(), k_rep.get(), &qk_expect, false, nullptr, false, true, 4);
+        compare(qk, qk_expect, "qk" + name);
+
+        // V is read along the sequence, as CPUmmFunction lays it out (BHDS)
+        auto v_shared = repeatHeads(bn_, *v, 1, dtype, BHDS);
+        auto v_rep = repeatHeads(bn_, *v, n_rep, dtype, BHDS);
+        Tensor pv(1, q_heads, M, K, bn_, true);
+        Tensor pv_expect(1, q_heads, M, K, bn_, true);
+        mat_mul(p.get(), v_shared.get(), &pv, false, nullptr, false, false, 4);
+        mat_mul(p.get(), v_rep.get(), &pv_expect, false, nullptr, false, false, 4);
+        compare(pv, pv_expect, "pv" + name);
+    }
+}
@@ -0,0 +1,183 @@
+#include "CPUToyLM.hpp"
+#include "OpTracer.hpp"
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+// just enough JSON to read a trace back: objects, arrays, strings, numbers, literals
+struct JsonValue {
+    enum Kind { Null,
+                Bool,
+                Number,
+                String,
+                Array,
+                Object } kind = Null;
+    double number = 0;
+    std::string string;
+    std::vector<JsonValue> array;
+    std::vector<std::pair<std::string, JsonValue>> object;
+
+    const JsonValue *get(const std::string &key) const {
+        for (const auto &member : object) {
+            if (member.first == key) return &member.second;
+        }
+        return nullptr;
+    }
+};
+
+class JsonReader {
+public:
+    explicit JsonReader(const std::string &text) :
+        text_(text) {
+    }
+    JsonValue document() {
+        auto value = parse();
+        skipSpace();
+        if (pos_ != text_.size()) fail("trailing characters");
+        return value;
+    }
+
+private:
+    void fail(const std::string &what) {
+        throw std::runtime_error(what + " at offset " + std::to_string(pos_));
+    }
+    void skipSpace() {
+        while (pos_ < text_.size() && isspace((unsigned char)text_[pos_])) ++pos_;
+    }
+    void expect(char c) {
+        skipSpace();
+        if (pos_ >= text_.size() || text_[pos_] != c) fail(std::string("expected '") + c + "'");
+        ++pos_;
+    }
+    std::string parseString() {
+        expect('"');
+        std::string out;
+        while (pos_ < text_.size() && text_[pos_] != '"') {
+            char c = text_[pos_++];
+            if (c == '\\') {
+                if (pos_ >= text_.size()) fail("bad escape");
+                char e = text_[pos_++];
+                if (e == 'u') {
+                    if (pos_ + 4 > text_.size()) fail("bad \\u escape");
+                    out += (char)std::stoi(text_.substr(pos_, 4), nullptr, 16);
+                    pos_ += 4;
+                } else {
+                    out += e == 'n' ? '\n' : e == 't' ? '\t' : e;
+                }
+            } else {
+                out += c;
+            }
+        }
+        expect('"');
+        return out;
+    }
+    JsonValue parse() {
+        skipSpace();
+        if (pos_ >= text_.size()) fail("unexpected end");
+        JsonValue value;
+        char c = text_[pos_];
+        if (c == '{') {
+            value.kind = JsonValue::Object;
+            ++pos_;
+            skipSpace();
+            if (text_[pos_] == '}') {
+                ++pos_;
+                return value;
+            }
+            do {
+                auto key = parseString();
+                expect(':');
+                value.object.emplace_back(key, parse());
+                skipSpace();
+            } while (pos_ < text_.size() && text_[pos_] == ',' && ++pos_);
+            expect('}');
+        } else if (c == '[') {
+            value.kind = JsonValue::Array;
+            ++pos_;
+            skipSpace();
+            if (text_[pos_] == ']') {
+                ++pos_;
+                return value;
+            }
+            do {
+                value.array.push_back(parse());
+                skipSpace();
+            } while (pos_ < text_.size() && text_[pos_] == ',' && ++pos_);
+            expect(']');
+        } else if (c == '"') {
+            value.kind = JsonValue::String;
+            value.string = parseString();
+        } else if (text_.compare(pos_, 4, "true") == 0 || text_.compare(pos_, 5, "false") == 0) {
+            value.kind = JsonValue::Bool;
+            value.number = c == 't';
+            pos_ += c == 't' ? 4 : 5;
+        } else if (text_.compare(pos_, 4, "null") == 0) {
+            pos_ += 4;
+        } else {
+            size_t used = 0;
+            value.kind = JsonValue::Number;
+            try {
+                value.number = std::stod(text_.substr(pos_, 32), &used);
+            } catch (const std::exception &) {
+                fail("bad value");
+            }
+            pos_ += used;
+        }
+        return value;
+    }
+
+    const std::string &text_;
+    size_t pos_ = 0;
+};
+
+// a traced prefill exports a well-formed Chrome trace with one event per op and one for the step
+TEST_F(CPUTest, OpTracerExportParses) {
+    ToyLM model("trace");
+    model.load(ToyLM::writeWeights("trace", 5));
+    OpTracer::instance().start();
+    model.step({1, 2, 3});
+    OpTracer::instance().stop();
+    auto recorded = OpTracer::instance().events();
+    auto path = testing::TempDir() + "trace.json";
+    ASSERT_TRUE(OpTracer::instance().exportChromeTrace(path));
+    OpTracer::instance().clear();
+
+    std::ifstream file(path);
+    std::stringstream text;
+    text << file.rdbuf();
+    JsonValue trace;
+    ASSERT_NO_THROW(trace = JsonReader(text.str()).document());
+    const JsonValue *events = trace.get("traceEvents");
+    ASSERT_NE(events, nullptr);
+    ASSERT_EQ(events->kind, JsonValue::Array);
+    ASSERT_EQ(events->array.size(), recorded.size());
+
+    int steps = 0;
+    bool embedding = false;
+    for (const auto &event : events->array) {
+        ASSERT_EQ(event.kind, JsonValue::Object);
+        EXPECT_EQ(event.get("ph")->string, "X");
+        EXPECT_GE(event.get("dur")->number, 0);
+        const auto &cat = event.get("cat")->string;
+        if (cat == "forward") {
+            ++steps;
+            EXPECT_EQ(event.get("name")->string, "prefill");
+            EXPECT_EQ(event.get("args"), nullptr);
+            continue;
+        }
+        const JsonValue *args = event.get("args");
+        ASSERT_NE(args, nullptr);
+        EXPECT_EQ(args->get("type")->string, cat);
+        EXPECT_NE(cat, "UNKNOWN");
+        EXPECT_GT(args->get("activation_bytes")->number, 0);
+        if (cat == "EMBEDDING") {
+            embedding = true;
+            EXPECT_EQ(event.get("name")->string, "trace.embed");
+            EXPECT_EQ(args->get("inputs")->string, "[1,1,3,1]:F32");
+            EXPECT_EQ(args->get("outputs")->string, "[1,1,3,16]:F32");
+        }
+    }
+    EXPECT_EQ(steps, 1);
+    EXPECT_TRUE(embedding);
+    Module::llm_model_ptr = nullptr;
+}
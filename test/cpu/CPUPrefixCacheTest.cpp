@@ -0,0 +1,72 @@
+#include "CPUToyLM.hpp"
+#include "backends/cpu/CPUPrefixCache.hpp"
+#include "backends/cpu/op/CPUKVCacheXp.hpp"
+
+// greedy decoding after prefilling feed, the logits of every step
+static std::vector<std::vector<float>> decode(ToyLM &model, std::vector<unsigned> feed, int n) {
+    std::vector<std::vector<float>> steps;
+    while ((int)steps.size() < n) {
+        auto logits = model.step(feed);
+        const float *row = logits.ptrAt<float>(0, 0, logits.sequence() - 1, 0);
+        steps.emplace_back(row, row + ToyLM::vocab);
+        feed = {ToyLM::argmax(logits)};
+    }
+    return steps;
+}
+
+static void expectSame(const std::vector<std::vector<float>> &a, const std::vector<std::vector<float>> &b, const char *what) {
+    ASSERT_EQ(a.size(), b.size());
+    for (size_t s = 0; s < a.size(); ++s) {
+        for (int v = 0; v < ToyLM::vocab; ++v) {
+            ASSERT_FLOAT_EQ(a[s][v], b[s][v]) << what << " step " << s << " token " << v;
+        }
+    }
+}
+
+// a restored prefix then the rest of the prompt decodes as the whole prompt prefilled, in the
+// model that took the snapshot and, through save / load, in a fresh one whose paged caches have
+// not grown yet; a model with an XP cache is refused
+TEST_F(CPUTest, PrefixCacheSnapshotRestoreDecode) {
+    int saved = KVCache_page_size;
+    KVCache_page_size = 4;
+    const std::vector<unsigned> prompt = {3, 1, 4, 1, 5, 9, 2, 6, 5, 3, 5};
+    const std::vector<unsigned> prefix(prompt.begin(), prompt.begin() + 7);
+    const std::vector<unsigned> rest(prompt.begin() + 7, prompt.end());
+
+    ToyLM model("prefix");
+    model.load(ToyLM::writeWeights("prefix", 11));
+    model.clear_kvcache();
+    auto expect = decode(model, prompt, 12);
+
+    CPUPrefixCache cache(model);
+    model.clear_kvcache();
+    model.step(prefix);
+    ASSERT_TRUE(cache.insert(prefix));
+    model.clear_kvcache();
+    decode(model, {8, 8, 2, 7, 13, 0, 1, 4, 10}, 6); // other K/V over the snapshot rows
+    model.clear_kvcache();
+    ASSERT_EQ(cache.restore(prompt), (int)prefix.size());
+    expectSame(decode(model, rest, 12), expect, "restored");
+
+    auto path = testing::TempDir() + "prefix.mllm.prefix";
+    ASSERT_TRUE(cache.save(path));
+    ToyLM fresh("prefix");
+    fresh.load(ToyLM::writeWeights("prefix", 11));
+    fresh.clear_kvcache();
+    CPUPrefixCache loaded(fresh);
+    ASSERT_TRUE(loaded.load(path));
+    ASSERT_EQ(loaded.size(), 1);
+    ASSERT_EQ(loaded.restore(prompt), (int)prefix.size());
+    expectSame(decode(fresh, rest, 12), expect, "loaded");
+
+    {
+        Module::llm_model_ptr = &fresh;
+        CPUKVCacheXp xp(Backend::global_backends[MLLM_CPU].get(), "xp", 1);
+        fresh.clear_kvcache();
+        EXPECT_FALSE(loaded.insert(prefix));
+        EXPECT_EQ(loaded.restore(prompt), 0);
+        EXPECT_FALSE(loaded.load(path));
+    }
+    EXPECT_EQ(loaded.restore(prompt), (int)prefix.size());
+    KVCache_page_size = saved;
+}
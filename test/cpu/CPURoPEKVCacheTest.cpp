@@ -0,0 +1,186 @@
+#include "CPUTest.hpp"
+#include "Module.hpp"
+#include "ParamWriter.hpp"
+#include "backends/cpu/op/CPUKVCache.hpp"
+#include "backends/cpu/op/CPURoPE.hpp"
+#include "backends/cpu/op/CPURoPEKVCache.hpp"
+#include "models/transformer/modeling_transformer.hpp"
+#include <cmath>
+#include <random>
+
+// q/k/v inputs are written after setUp: the cache ops turn k/v into views of their cache slots
+static void fillStep(Tensor &t, int step, float phase) {
+    for (int h = 0; h < t.head(); ++h) {
+        for (int s = 0; s < t.sequence(); ++s) {
+            for (int d = 0; d < t.dimension(); ++d) {
+                t.setDataAt<float>(0, h, s, d, std::sin(phase + 0.37f * d + 1.3f * h + 0.71f * s + 2.1f * step));
+            }
+        }
+    }
+}
+
+// CPURoPEKVCache against q_rope / k_rope -> k_cache / v_cache, over a prefill and a few decode steps
+TEST_F(CPUTest, CPURoPEKVCache) {
+    const int H = 2;
+    const int D = 64;
+    const int cache_max = 32;
+    const int pose_type = 2;
+    int saved_type = KVCache_TYPE;
+    KVCache_TYPE = 32;
+    CPURoPEKVCache fused(bn_, "fused.rope_kv_cache", H, D, 1, cache_max, pose_type, 10000.0f, 1.0f, 16384, 4);
+    CPURoPE q_rope(bn_, "ref.q_rope", pose_type, 10000.0f, 1.0f, 16384, 4);
+    CPURoPE k_rope(bn_, "ref.k_rope", pose_type, 10000.0f, 1.0f, 16384, 4);
+    CPUKVCache k_cache(bn_, "ref.k_cache", D, H, 1, true, false, cache_max, 4);
+    CPUKVCache v_cache(bn_, "ref.v_cache", D, H, 1, true, false, cache_max, 4);
+    KVCache_TYPE = saved_type;
+    SETUP_LOADER;
+
+    int step = 0;
+    for (int seq : {5, 1, 1, 3}) {
+        auto input = [&](const char *name) {
+            auto t = std::make_shared<Tensor>(bn_);
+            t->setName(name);
+            t->reshape(1, H, seq, D);
+            return t;
+        };
+        auto q = input("q"), k = input("k"), v = input("v");
+        auto rq = input("rq"), rk = input("rk"), rv = input("rv");
+        TENSOR(q_out);
+        TENSOR(k_out);
+        TENSOR(v_out);
+        TENSOR(rq_out);
+        TENSOR(rk_out);
+        TENSOR(rk_all);
+        TENSOR(rv_all);
+        for (auto &t : {q, k, v, rq, rk, rv}) {
+            t->alloc();
+        }
+
+        ASSERT_FALSE(fused.reshape({q, k, v}, {q_out, k_out, v_out}));
+        ASSERT_FALSE(fused.setUp({q, k, v}, {q_out, k_out, v_out}));
+        ASSERT_FALSE(q_rope.reshape({rq}, {rq_out}));
+        ASSERT_FALSE(q_rope.setUp({rq}, {rq_out}));
+        ASSERT_FALSE(k_rope.reshape({rk}, {rk_out}));
+        ASSERT_FALSE(k_rope.setUp({rk}, {rk_out}));
+        ASSERT_FALSE(k_cache.reshape({rk_out}, {rk_all}));
+        ASSERT_FALSE(k_cache.setUp({rk_out}, {rk_all}));
+        ASSERT_FALSE(v_cache.reshape({rv}, {rv_all}));
+        ASSERT_FALSE(v_cache.setUp({rv}, {rv_all}));
+        if (step == 0) {
+            for (Op *op : std::initializer_list<Op *>{&fused, &q_rope, &k_rope, &k_cache, &v_cache}) {
+                ASSERT_FALSE(op->load(loader));
+            }
+        }
+
+        for (auto &[a, b, phase] : {std::tuple{q, rq, 0.0f}, std::tuple{k, rk, 0.5f}, std::tuple{v, rv, 1.0f}}) {
+            fillStep(*a, step, phase);
+            fillStep(*b, step, phase);
+        }
+        ASSERT_FALSE(fused.execute({q, k, v}, {q_out, k_out, v_out}));
+        ASSERT_FALSE(q_rope.execute({rq}, {rq_out}));
+        ASSERT_FALSE(k_rope.execute({rk}, {rk_out}));
+        ASSERT_FALSE(k_cache.execute({rk_out}, {rk_all}));
+        ASSERT_FALSE(v_cache.execute({rv}, {rv_all}));
+
+        EXPECT_EQ(fused.getCacheSeqLen(), k_cache.getCacheSeqLen());
+        COMPARE_TENSOR(q_out.get(), rq_out.get(), true);
+        COMPARE_TENSOR(k_out.get(), rk_all.get(), true);
+        COMPARE_TENSOR(v_out.get(), rv_all.get(), true);
+        step++;
+    }
+}
+
+// an embedding into one GQA flash_attention_2 layer, with or without the fused rope + kv cache op
+class RoPEKVCacheLM final : public Module {
+public:
+    static const int vocab = 16;
+    static const int hidden = 32;
+
+    RoPEKVCacheLM(const std::string &name, bool fused) {
+        bool saved = KVCache_fused_rope;
+        KVCache_fused_rope = fused;
+        TransformerNameConfig names;
+        names._q_proj_name = "q_proj";
+        names._k_proj_name = "k_proj";
+        names._v_proj_name = "v_proj";
+        names._o_proj_name = "o_proj";
+        embedding = Embedding(vocab, hidden, name + ".embed");
+        attention = MultiHeadAttention(hidden, 2, 1, hidden / 2, SPLIT_NONE, PostQkv_NONE, false,
+                                       RoPEType::HFHUBROPE, 10000.0f, 1024, 64, true, false, false,
+                                       "flash_attention_2", names, name + ".attn.");
+        KVCache_fused_rope = saved;
+    }
+    vector<Tensor> Forward(vector<Tensor> inputs, vector<std::any> args) override {
+        auto x = embedding(inputs[0]);
+        return attention({x, x, x});
+    }
+
+    // the same random weights for every name prefix, returns the model file
+    static std::string writeWeights(const std::string &name) {
+        auto path = testing::TempDir() + name + ".mllm";
+        std::vector<std::pair<std::string, int>> params = {
+            {name + ".embed.weight", vocab * hidden},
+            {name + ".attn.q_proj.weight", hidden * hidden},
+            {name + ".attn.k_proj.weight", hidden / 2 * hidden},
+            {name + ".attn.v_proj.weight", hidden / 2 * hidden},
+            {name + ".attn.o_proj.weight", hidden * hidden},
+        };
+        std::vector<std::string> names;
+        for (auto &param : params) {
+            names.push_back(param.first);
+        }
+        std::mt19937 rng(11);
+        std::uniform_real_distribution<float> dist(-0.5f, 0.5f);
+        ParamWriter writer(path);
+        writer.paddingIndex(names);
+        for (auto &[param, size] : params) {
+            std::vector<float> weight(size);
+            for (auto &w : weight) {
+                w = dist(rng);
+            }
+            writer.beginWriteParam(param, MLLM_TYPE_F32);
+            writer.writeChunk(weight.data(), weight.size() * sizeof(float));
+            writer.endWriteParam();
+        }
+        writer.writeIndex();
+        return path;
+    }
+
+    Tensor step(const std::vector<unsigned> &tokens) {
+        Module::llm_model_ptr = this;
+        Tensor input(1, 1, tokens.size(), 1, Backend::global_backends[MLLM_CPU].get(), true);
+        input.setName("input");
+        Tensor::tensor_status = TENSOR_STATIC_INIT;
+        input.setTtype(INPUT_TENSOR);
+        for (int s = 0; s < (int)tokens.size(); ++s) {
+            input.setDataAt<float>(0, 0, s, 0, tokens[s]);
+        }
+        return (*this)({input})[0];
+    }
+
+private:
+    Layer embedding;
+    MultiHeadAttention attention;
+};
+
+// whole forwards through Module: the op is set up once by the trace pass, later steps only
+// reshape and execute, and must match the separate q_rope / k_rope / k_cache / v_cache ops
+TEST_F(CPUTest, CPURoPEKVCacheMatchesSeparateOps) {
+    RoPEKVCacheLM fused("fused_attn", true);
+    fused.load(RoPEKVCacheLM::writeWeights("fused_attn"));
+    RoPEKVCacheLM separate("separate_attn", false);
+    separate.load(RoPEKVCacheLM::writeWeights("separate_attn"));
+    for (const auto &tokens : std::vector<std::vector<unsigned>>{{3, 1, 4, 1, 5}, {9}, {2}, {6, 5, 3}, {5}}) {
+        auto a = fused.step(tokens);
+        auto b = separate.step(tokens);
+        ASSERT_EQ(a.sequence(), (int)tokens.size());
+        ASSERT_EQ(b.sequence(), (int)tokens.size());
+        for (int s = 0; s < a.sequence(); ++s) {
+            for (int d = 0; d < a.dimension(); ++d) {
+                EXPECT_NEAR(a.dataAt<float>(0, 0, s, d), b.dataAt<float>(0, 0, s, d), 1e-4)
+                    << "token " << s << " column " << d;
+            }
+        }
+    }
+    Module::llm_model_ptr = nullptr;
+}
@@ -4,6 +4,8 @@
 
 #include "CPUTest.hpp"
 #include "backends/cpu/op/CPURoPE.hpp"
+#include "Module.hpp"
+#include <random>
 TEST_F(CPUTest, CPURoPE1) {
     //    GTEST_SKIP();
     SETUP_OP(CPURoPE, 2, 4);
@@ -17,4 +19,98 @@ TEST_F(CPUTest, CPURoPE1) {
     TEST_EXCUTE({input0}, {c_output});
     PRINT_TENSOR_SHAPES(input0, c_output, output);
     COMPARE_TENSOR(output, c_output, true);
-}
\ No newline at end of file
+}
+namespace {
+// only stands for the model a rope was created under
+class RoPEOwner final : public Module {
+public:
+    vector<Tensor> Forward(vector<Tensor> inputs, vector<std::any> args) override {
+        return {};
+    }
+};
+
+OpParam llama3Config(float factor) {
+    return {{"pose_type", LLAMAROPE}, {"rope_type", LLAMA3}, {"rope_theta", 500000}, {"max_position_embeddings", 16384}, {"factor", factor}, {"low_freq_factor", 1}, {"high_freq_factor", 4}, {"original_max_position_embeddings", 8192}};
+}
+} // namespace
+
+// the windows give the rows of the full max_position_embeddings tables the op used to precompute,
+// at large positions too; ropes that differ only in scaling params, or in the model they belong to,
+// run in turn and keep their own rows
+TEST_F(CPUTest, CPURoPEWindowsMatchFullTables) {
+    const int dim = 64;
+    const int pos_max = 16384;
+    RoPEOwner model_a, model_b;
+    struct Case {
+        OpParam config;
+        Module *owner;
+        int position = 0;
+        shared_ptr<CPURoPE> op;
+        vector<vector<float>> sin, cos;
+    };
+    std::vector<Case> cases(4);
+    cases[0].config = llama3Config(8);
+    cases[1].config = llama3Config(4);
+    cases[2].config = {{"pose_type", HFHUBROPE}, {"rope_type", DEFAULT}, {"rope_theta", 10000}, {"max_position_embeddings", pos_max}};
+    cases[3].config = cases[2].config;
+    cases[0].owner = cases[1].owner = cases[2].owner = &model_a;
+    cases[3].owner = &model_b;
+    for (auto &c : cases) {
+        Module::llm_model_ptr = c.owner;
+        c.op = std::make_shared<CPURoPE>(bn_, "rope", c.config, 1);
+        auto config = c.config;
+        config["base"] = config["rope_theta"];
+        config["dim"] = dim;
+        vector<float> theta;
+        float scaling = rope_init_func_map.at((RoPEThetaType)config["rope_type"])(config, theta);
+        if (config["pose_type"] == LLAMAROPE) {
+            sinusoidal_position_embedding_llama(pos_max, dim, theta, c.sin, c.cos, scaling);
+        } else {
+            sinusoidal_position_embedding_huggingface(pos_max, dim, theta, c.sin, c.cos, scaling);
+        }
+    }
+    Module::llm_model_ptr = nullptr;
+
+    std::mt19937 rng(13);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    auto step = [&](Case &c, int seq) {
+        TENSOR(input);
+        TENSOR(output);
+        input->reshape(1, 1, seq, dim);
+        input->alloc();
+        for (int s = 0; s < seq; ++s) {
+            for (int d = 0; d < dim; ++d) {
+                input->setDataAt<float>(0, 0, s, d, dist(rng));
+            }
+        }
+        ASSERT_FALSE(c.op->reshape({input}, {output}));
+        ASSERT_FALSE(c.op->setUp({input}, {output}));
+        ASSERT_FALSE(c.op->execute({input}, {output}));
+        bool llama = c.config["pose_type"] == LLAMAROPE;
+        for (int s = 0; s < seq; ++s) {
+            const auto &sin = c.sin[c.position + s];
+            const auto &cos = c.cos[c.position + s];
+            for (int d = 0; d < dim / 2; ++d) {
+                int d1 = llama ? 2 * d : d;
+                int d2 = llama ? 2 * d + 1 : d + dim / 2;
+                float x1 = input->dataAt<float>(0, 0, s, d1);
+                float x2 = input->dataAt<float>(0, 0, s, d2);
+                ASSERT_NEAR(output->dataAt<float>(0, 0, s, d1), x1 * cos[d1] - x2 * sin[d1], 1e-5)
+                    << "case " << &c - cases.data() << " position " << c.position + s << " column " << d1;
+                ASSERT_NEAR(output->dataAt<float>(0, 0, s, d2), x1 * sin[d1] + x2 * cos[d1], 1e-5)
+                    << "case " << &c - cases.data() << " position " << c.position + s << " column " << d2;
+            }
+        }
+        c.position += seq;
+    };
+    // a long prefill for model a, a short one for model b, then decode steps in turn across refills
+    for (int i = 0; i < 3; ++i) {
+        step(cases[i], 12000 + 37 * i);
+    }
+    step(cases[3], 5);
+    for (int t = 0; t < 300; ++t) {
+        for (auto &c : cases) {
+            step(c, 1);
+        }
+    }
+}
@@ -0,0 +1,102 @@
+#include "CPUTest.hpp"
+#include "Layer.hpp"
+#include "Module.hpp"
+#include "ParamWriter.hpp"
+#include <random>
+
+// an embedding and a stack of linears, all reached in the load pass, and one more linear the
+// forward skips there and that is loaded through Layer::load, as the MoE models load experts
+class StreamLM final : public Module {
+public:
+    static const int dim = 64;
+    static const int depth = 6;
+
+    explicit StreamLM(const std::string &name) {
+        embedding = Embedding(dim, dim, name + ".embed");
+        for (int i = 0; i < depth; ++i) {
+            blocks.push_back(Linear(dim, dim, false, name + ".blocks." + std::to_string(i)));
+        }
+        extra = Linear(dim, dim, false, name + ".extra");
+    }
+    vector<Tensor> Forward(vector<Tensor> inputs, vector<std::any> args) override {
+        auto x = embedding(inputs[0]);
+        for (auto &block : blocks) {
+            x = block(x);
+        }
+        if (use_extra) {
+            x = extra(x);
+        }
+        return {x};
+    }
+
+    static std::string writeWeights(const std::string &name, unsigned seed) {
+        auto path = testing::TempDir() + name + ".mllm";
+        std::vector<std::string> names = {name + ".embed.weight", name + ".extra.weight"};
+        for (int i = 0; i < depth; ++i) {
+            names.push_back(name + ".blocks." + std::to_string(i) + ".weight");
+        }
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<float> dist(-0.2f, 0.2f);
+        std::vector<float> weight(dim * dim);
+        ParamWriter writer(path);
+        writer.paddingIndex(names);
+        for (auto &n : names) {
+            for (auto &w : weight) {
+                w = dist(rng);
+            }
+            writer.beginWriteParam(n, MLLM_TYPE_F32);
+            writer.writeChunk(weight.data(), weight.size() * sizeof(float));
+            writer.endWriteParam();
+        }
+        writer.writeIndex();
+        return path;
+    }
+
+    std::vector<float> step(const std::vector<unsigned> &tokens) {
+        Module::llm_model_ptr = this;
+        Tensor input(1, 1, tokens.size(), 1, Backend::global_backends[MLLM_CPU].get(), true);
+        input.setName("input");
+        Tensor::tensor_status = TENSOR_STATIC_INIT;
+        input.setTtype(INPUT_TENSOR);
+        for (int s = 0; s < (int)tokens.size(); ++s) {
+            input.setDataAt<float>(0, 0, s, 0, tokens[s]);
+        }
+        auto out = (*this)({input})[0];
+        const float *data = out.hostPtr<float>();
+        return {data, data + out.count()};
+    }
+
+    Layer embedding;
+    vector<Layer> blocks;
+    Layer extra;
+    bool use_extra = false;
+};
+
+// a streamed model computes what the eagerly loaded one does, also for a queued op that is
+// Layer::load-ed while the thread may still read it and for an op the load pass never queued
+TEST_F(CPUTest, StreamingLoaderMatchesEagerLoad) {
+    const std::vector<unsigned> tokens = {3, 14, 15, 9, 26, 5};
+    auto path = StreamLM::writeWeights("stream", 7);
+    bool saved = Module::stream_load;
+
+    Module::stream_load = false;
+    StreamLM eager("stream");
+    eager.load(path);
+    eager.use_extra = true;
+    eager.extra.load();
+    auto expect = eager.step(tokens);
+
+    Module::stream_load = true;
+    StreamLM streamed("stream");
+    streamed.load(path);
+    Module::stream_load = saved;
+    streamed.blocks[StreamLM::depth - 1].load();
+    streamed.use_extra = true;
+    streamed.extra.load();
+    auto got = streamed.step(tokens);
+
+    ASSERT_EQ(got.size(), expect.size());
+    for (size_t i = 0; i < got.size(); ++i) {
+        ASSERT_FLOAT_EQ(got[i], expect[i]) << "value " << i;
+    }
+}
@@ -0,0 +1,72 @@
+#include "CPUTest.hpp"
+#include "backends/cpu/op/CPULinear.hpp"
+#include "backends/cpu/op/CPUMul.hpp"
+#include "backends/cpu/op/CPUSiLU.hpp"
+#include "backends/cpu/op/CPUSwiGLU.hpp"
+
+// CPUSwiGLU against gate_proj -> silu -> * up_proj with the same weights
+static void checkSwiGLU(Backend *bn_, DataType dtype, int seq, bool interleave_on_load, bool interleaved_file) {
+    const int K = 64;
+    const int N = 96;
+    auto gate_w = randomTensor(bn_, "gate", 1, 1, N, K, 0.5f, 1);
+    auto up_w = randomTensor(bn_, "up", 1, 1, N, K, 0.5f, 2);
+    auto x = randomTensor(bn_, "x", 1, 1, seq, K, 1.0f, 3);
+    MemoryLoader loader;
+    loader.add("mlp.gate_proj.weight", *gate_w, dtype);
+    loader.add("mlp.up_proj.weight", *up_w, dtype);
+    if (interleaved_file) {
+        auto both = std::make_shared<Tensor>(bn_);
+        both->reshape(1, 1, 2 * N, K);
+        both->setDtype(MLLM_TYPE_F32);
+        both->alloc();
+        for (int j = 0; j < N; ++j) {
+            memcpy(both->ptrAt<float>(0, 0, 2 * j, 0), gate_w->ptrAt<float>(0, 0, j, 0), K * sizeof(float));
+            memcpy(both->ptrAt<float>(0, 0, 2 * j + 1, 0), up_w->ptrAt<float>(0, 0, j, 0), K * sizeof(float));
+        }
+        loader.add("mlp.gate_up_proj.interleaved.weight", *both, dtype);
+    }
+
+    TENSOR(gate);
+    TENSOR(act);
+    TENSOR(up);
+    TENSOR(expect);
+    CPULinear gate_proj(bn_, "mlp.gate_proj", K, N, false, 4);
+    CPULinear up_proj(bn_, "mlp.up_proj", K, N, false, 4);
+    CPUSiLU silu(bn_, "mlp.act", 4);
+    CPUMul mul(bn_, "mlp.mul", 4);
+    auto run = [&](Op &op, vector<shared_ptr<Tensor>> in, vector<shared_ptr<Tensor>> out) {
+        ASSERT_FALSE(op.reshape(in, out));
+        ASSERT_FALSE(op.setUp(in, out));
+        ASSERT_FALSE(op.load(loader));
+        ASSERT_FALSE(op.execute(in, out));
+    };
+    run(gate_proj, {x}, {gate});
+    run(up_proj, {x}, {up});
+    run(silu, {gate}, {act});
+    run(mul, {act, up}, {expect});
+
+    bool saved = SwiGLU_interleave_on_load;
+    SwiGLU_interleave_on_load = interleave_on_load;
+    TENSOR(output);
+    CPUSwiGLU op(bn_, "mlp.gate_up_proj", K, N, 4);
+    run(op, {x}, {output});
+    SwiGLU_interleave_on_load = saved;
+    COMPARE_TENSOR(output.get(), expect.get(), true);
+}
+
+TEST_F(CPUTest, CPUSwiGLUSeparateF32) {
+    checkSwiGLU(bn_, MLLM_TYPE_F32, 1, false, false);
+    checkSwiGLU(bn_, MLLM_TYPE_F32, 9, false, false);
+}
+TEST_F(CPUTest, CPUSwiGLUSeparateQ4_0) {
+    checkSwiGLU(bn_, MLLM_TYPE_Q4_0, 1, false, false);
+    checkSwiGLU(bn_, MLLM_TYPE_Q4_0, 9, false, false);
+}
+TEST_F(CPUTest, CPUSwiGLUInterleaveOnLoad) {
+    checkSwiGLU(bn_, MLLM_TYPE_Q8_0, 1, true, false);
+    checkSwiGLU(bn_, MLLM_TYPE_Q8_0, 9, true, false);
+}
+TEST_F(CPUTest, CPUSwiGLUInterleavedFile) {
+    checkSwiGLU(bn_, MLLM_TYPE_Q4_0, 1, false, true);
+    checkSwiGLU(bn_, MLLM_TYPE_Q4_0, 9, false, true);
+}
@@ -8,6 +8,10 @@
 #include "backends/cpu/CPUBackend.hpp"
 #include "TestLoader.hpp"
 #include "memory/SystemMemoryManager.hpp"
+#include "backends/cpu/third_party/ggml/VecDotType.hpp"
+#include <cstring>
+#include <map>
+#include <random>
 using namespace mllm;
 #define COMPARE_TENSOR(...) ASSERT_TRUE(isSame(__VA_ARGS__))
 #define TEST_LOAD(...) ASSERT_TRUE(loader.load(__VA_ARGS__)) << "TestLoader load failed"
@@ -133,4 +137,56 @@ static bool isSame(Tensor *a, Tensor *b, bool unstrict = false) {
 static bool isSame(shared_ptr<Tensor> a, shared_ptr<Tensor> b, bool unstrict = false) {
     return isSame(a.get(), b.get(), unstrict);
 }
+// F32 tensor [b, h, s, d] with values uniform in [-scale, scale)
+static shared_ptr<Tensor> randomTensor(Backend *bn, const string &name, int b, int h, int s, int d, float scale = 1.0f, unsigned seed = 0) {
+    auto t = std::make_shared<Tensor>(bn);
+    t->setName(name);
+    t->reshape(b, h, s, d);
+    t->setDtype(MLLM_TYPE_F32);
+    t->alloc();
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> dist(-scale, scale);
+    for (int i = 0; i < t->count(); ++i) {
+        t->hostPtr<float>()[i] = dist(gen);
+    }
+    return t;
+}
+// Weights of the ops under test, kept in memory: F32 rows, quantized to the requested dtype on add.
+class MemoryLoader : public AbstructLoader {
+public:
+    void add(const string &name, Tensor &rows, DataType dtype = MLLM_TYPE_F32) {
+        auto &entry = tensors_[name];
+        entry.first = dtype;
+        const int k = rows.dimension();
+        const int n = rows.count() / k;
+        const size_t row = row_size(dtype, k);
+        entry.second.resize(row * n);
+        for (int r = 0; r < n; ++r) {
+            const float *src = rows.hostPtr<float>() + (size_t)r * k;
+            if (dtype == MLLM_TYPE_F32) {
+                memcpy(entry.second.data() + r * row, src, row);
+            } else {
+                type_traits[dtype].from_float(src, entry.second.data() + r * row, k);
+            }
+        }
+    }
+    bool load(Tensor *tensor) override {
+        auto it = tensors_.find(tensor->name());
+        if (it == tensors_.end() || tensor->cntSize() != it->second.second.size()) {
+            return false;
+        }
+        memcpy(tensor->rawHostPtr(), it->second.second.data(), it->second.second.size());
+        return true;
+    }
+    bool load(shared_ptr<Tensor> tensor) override {
+        return load(tensor.get());
+    }
+    DataType getDataType(string name) override {
+        auto it = tensors_.find(name);
+        return it == tensors_.end() ? MLLM_TYPE_COUNT : it->second.first;
+    }
+
+private:
+    std::map<string, std::pair<DataType, std::vector<char>>> tensors_;
+};
 #endif // MLLM_CPUTEST_HPP
@@ -0,0 +1,60 @@
+#include "gtest/gtest.h"
+#include "backends/cpu/CPUBackend.hpp"
+#include "backends/cpu/CPUThreadPool.hpp"
+#include <atomic>
+#include <vector>
+using namespace mllm;
+
+// every index of [0, n) is visited exactly once and all writes are visible when parallelFor returns
+static void checkCoverage(int64_t n, int threads, int64_t grain) {
+    std::vector<int> hits(n, 0);
+    CPUThreadPool::instance().parallelFor(n, threads, [&](int64_t begin, int64_t end) {
+        for (int64_t i = begin; i < end; ++i) {
+            hits[i]++;
+        }
+    }, grain);
+    for (int64_t i = 0; i < n; ++i) {
+        ASSERT_EQ(hits[i], 1) << "n=" << n << " threads=" << threads << " grain=" << grain << " i=" << i;
+    }
+}
+
+TEST(CPUThreadPoolTest, Coverage) {
+    CPUThreadPool::instance().configure(4);
+    for (int64_t n : {1, 7, 64, 1000, 4097}) {
+        for (int threads : {1, 2, 3, 4}) {
+            for (int64_t grain : {1, 16, 5000}) {
+                checkCoverage(n, threads, grain);
+            }
+        }
+    }
+}
+
+TEST(CPUThreadPoolTest, BackToBackJobsOfDifferentWidth) {
+    // a worker left out of one job must not join the next one with a stale participant count
+    CPUThreadPool::instance().configure(4);
+    for (int round = 0; round < 2000; ++round) {
+        checkCoverage(64 + round % 37, 1 + round % 4, 1 + round % 3);
+    }
+}
+
+TEST(CPUThreadPoolTest, NestedRunsInline) {
+    CPUThreadPool::instance().configure(3);
+    std::atomic<int64_t> sum{0};
+    CPUThreadPool::instance().parallelFor(6, 3, [&](int64_t begin, int64_t end) {
+        for (int64_t i = begin; i < end; ++i) {
+            CPUThreadPool::instance().parallelFor(10, 3, [&](int64_t b, int64_t e) { sum += e - b; });
+        }
+    });
+    EXPECT_EQ(sum.load(), 60);
+}
+
+TEST(CPUThreadPoolTest, ConfigureThreadsFromBackend) {
+    int threads = CPUBackend::cpu_threads;
+    int core_set = CPUBackend::cpu_core_set;
+    CPUBackend::configureThreads(2, CPUThreadPool::PERFORMANCE_CORES);
+    EXPECT_EQ(CPUThreadPool::instance().threads(), 2);
+    EXPECT_EQ(CPUBackend::cpu_threads, 2);
+    checkCoverage(1000, 2, 8);
+    EXPECT_FALSE(CPUThreadPool::coresOf(CPUThreadPool::EFFICIENCY_CORES).empty());
+    CPUBackend::configureThreads(threads, core_set);
+}
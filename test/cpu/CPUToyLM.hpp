@@ -0,0 +1,95 @@
+#ifndef MLLM_CPUTOYLM_HPP
+#define MLLM_CPUTOYLM_HPP
+#include "CPUTest.hpp"
+#include "Layer.hpp"
+#include "Module.hpp"
+#include "ParamWriter.hpp"
+#include <random>
+
+// a one-head, one-layer causal LM over a 16 token vocabulary whose logits are its attention
+// input plus output, for tests that drive whole decode steps through Module / CPUBackend;
+// K and V are roped copies of the embedding, each in its own cache as in an attention layer
+class ToyLM final : public Module {
+public:
+    static const int vocab = 16;
+
+    explicit ToyLM(const std::string &name) {
+        embedding = Embedding(vocab, vocab, name + ".embed");
+        q_rope = RoPE(RoPEType::HFHUBROPE, 10000.0f, 1024, name + ".q_rope");
+        k_rope = RoPE(RoPEType::HFHUBROPE, 10000.0f, 1024, name + ".k_rope");
+        v_rope = RoPE(RoPEType::HFHUBROPE, 10000.0f, 1024, name + ".v_rope");
+        k_cache = KVCache(1, vocab, 1, 64, "eager_notrans", name + ".k_cache");
+        v_cache = KVCache(1, vocab, 1, 64, "eager_notrans", name + ".v_cache");
+        softmax = Softmax(DIMENSION, true, true, name + ".softmax");
+    }
+    vector<Tensor> Forward(vector<Tensor> inputs, vector<std::any> args) override {
+        auto x = embedding(inputs[0]);
+        auto q = q_rope(x);
+        auto k = k_cache(k_rope(x));
+        auto v = v_cache(v_rope(x));
+        auto qk = Tensor::mm(q, k.transpose(SEQUENCE, DIMENSION));
+        if (k_cache.getCacheSeqLen() != qk.sequence() && qk.sequence() > 1) {
+            qk = softmax(qk, k_cache.getCacheSeqLen());
+        } else {
+            qk = softmax(qk);
+        }
+        return {q + Tensor::mm(qk, v)};
+    }
+    void clear_kvcache() override {
+        k_cache.clearCache();
+        v_cache.clearCache();
+        q_rope.clearCache();
+        k_rope.clearCache();
+        v_rope.clearCache();
+    }
+    int cacheLength() {
+        return k_cache.getCacheSeqLen();
+    }
+
+    // random embedding rows written as <name>.embed.weight, returns the model file
+    static std::string writeWeights(const std::string &name, unsigned seed) {
+        auto path = testing::TempDir() + name + ".mllm";
+        std::vector<float> weight(vocab * vocab);
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+        for (auto &w : weight) {
+            w = dist(rng);
+        }
+        std::vector<std::string> names = {name + ".embed.weight"};
+        ParamWriter writer(path);
+        writer.paddingIndex(names);
+        writer.beginWriteParam(names[0], MLLM_TYPE_F32);
+        writer.writeChunk(weight.data(), weight.size() * sizeof(float));
+        writer.endWriteParam();
+        writer.writeIndex();
+        return path;
+    }
+
+    // one forward over tokens, the logits [1, 1, tokens.size(), vocab]
+    Tensor step(const std::vector<unsigned> &tokens) {
+        Module::llm_model_ptr = this;
+        Tensor input(1, 1, tokens.size(), 1, Backend::global_backends[MLLM_CPU].get(), true);
+        input.setName("input");
+        Tensor::tensor_status = TENSOR_STATIC_INIT;
+        input.setTtype(INPUT_TENSOR);
+        for (int s = 0; s < (int)tokens.size(); ++s) {
+            input.setDataAt<float>(0, 0, s, 0, tokens[s]);
+        }
+        return (*this)({input})[0];
+    }
+    static unsigned argmax(Tensor &logits) {
+        const float *row = logits.ptrAt<float>(0, 0, logits.sequence() - 1, 0);
+        return std::max_element(row, row + vocab) - row;
+    }
+
+private:
+    Layer embedding;
+    RoPE q_rope;
+    RoPE k_rope;
+    RoPE v_rope;
+    KVCache k_cache;
+    KVCache v_cache;
+    Softmax softmax;
+};
+
+#endif // MLLM_CPUTOYLM_HPP
@@ -0,0 +1,127 @@
+#include "TokenizorTest.hpp"
+#include "tokenizers/BPE/Bpe.hpp"
+#include <codecvt>
+#include <locale>
+#include <random>
+#include <regex>
+
+// the string-keyed rescan bpe() replaced: merge every occurrence of the lowest ranked pair, repeat
+static std::vector<std::string> referenceBpe(const std::unordered_map<std::string, unsigned> &merge_rank, const std::string &token, const std::string &end_symbol) {
+    std::wstring_convert<std::codecvt_utf8_utf16<char32_t>, char32_t> converter;
+    std::vector<std::string> word;
+    for (char32_t c : converter.from_bytes(token)) {
+        word.push_back(converter.to_bytes(c));
+    }
+    word.back() += end_symbol;
+    while (word.size() > 1) {
+        size_t best = word.size();
+        unsigned best_rank = 0;
+        for (size_t i = 0; i + 1 < word.size(); ++i) {
+            auto it = merge_rank.find(word[i] + " " + word[i + 1]);
+            if (it != merge_rank.end() && (best == word.size() || it->second < best_rank)) {
+                best = i;
+                best_rank = it->second;
+            }
+        }
+        if (best == word.size()) {
+            break;
+        }
+        std::string first = word[best], second = word[best + 1];
+        std::vector<std::string> merged;
+        for (size_t i = 0; i < word.size(); ++i) {
+            if (i + 1 < word.size() && word[i] == first && word[i + 1] == second) {
+                merged.push_back(first + second);
+                ++i;
+            } else {
+                merged.push_back(word[i]);
+            }
+        }
+        word = merged;
+    }
+    return word;
+}
+
+TEST_F(TokenizerTest, BPEMergesMatchReference) {
+    const std::vector<std::string> alphabet = {"a", "b", "c", "d", "\xc3\xa9"};
+    mllm::BPETokenizer tokenizer(writeVocab("bpe_merges", {"<unk>", "<s>", "</s>", "a", "b"}));
+    std::mt19937 rng(11);
+    for (int table = 0; table < 20; ++table) {
+        // merges learned in order: each joins two symbols that exist by then
+        std::vector<std::string> symbols = alphabet;
+        symbols.push_back("d</w>");
+        std::unordered_map<std::string, unsigned> merge_rank;
+        for (unsigned rank = 0; rank < 40; ++rank) {
+            auto left = symbols[rng() % symbols.size()];
+            auto right = symbols[rng() % symbols.size()];
+            if (left.find("</w>") != std::string::npos || merge_rank.count(left + " " + right)) {
+                continue;
+            }
+            merge_rank[left + " " + right] = rank;
+            symbols.push_back(left + right);
+        }
+        tokenizer.setMergeRank(merge_rank);
+        for (int w = 0; w < 200; ++w) {
+            std::string token;
+            for (int len = 1 + rng() % 14; len > 0; --len) {
+                token += alphabet[rng() % alphabet.size()];
+            }
+            for (std::string end_symbol : {"", "</w>"}) {
+                EXPECT_EQ(tokenizer.bpe(token, end_symbol), referenceBpe(merge_rank, token, end_symbol))
+                    << "table " << table << " token " << token << " end " << end_symbol;
+            }
+        }
+    }
+}
+
+TEST_F(TokenizerTest, BPEPreTokenizeMatchesRegex) {
+    const std::regex pattern("<\\|startoftext\\|>|<\\|endoftext\\|>|'s|'t|'re|'ve|'m|'ll|'d|\\w+|\\d+|\\S+");
+    const std::vector<std::string> pieces = {"a", "Z", "9", "_", " ", "  ", "\t", "\n", "\r", "\v", "'", "s", "t", "re", "'ll", "'d",
+                                             "<|endoftext|>", "<|startoftext|>", "<|start", "|>", "!", "-", ".", "\xc3\xa9", "\xe4\xbd\xa0"};
+    std::mt19937 rng(5);
+    for (int i = 0; i < 2000; ++i) {
+        std::string text;
+        for (int n = rng() % 24; n > 0; --n) {
+            text += pieces[rng() % pieces.size()];
+        }
+        std::vector<std::string> expect;
+        for (std::sregex_iterator it(text.begin(), text.end(), pattern), end; it != end; ++it) {
+            expect.push_back(it->str());
+        }
+        std::vector<std::string_view> words;
+        mllm::BPETokenizer::preTokenize(text, words);
+        EXPECT_EQ(std::vector<std::string>(words.begin(), words.end()), expect) << "text \"" << text << "\"";
+    }
+}
+
+// cached words are tokenized again after the vocabulary changes, and per byte_fallback setting
+TEST_F(TokenizerTest, BPEWordCacheInvalidation) {
+    auto path = writeVocab("bpe_cache", {"<unk>", "<s>", "</s>", "h", "e", "l", "o", "he", "llo", "hello"});
+    const std::unordered_map<std::string, unsigned> merge_rank = {{"h e", 0}, {"l l", 1}, {"ll o", 2}};
+    auto tokenize = [&](mllm::BPETokenizer &tokenizer, const std::string &text, bool byte_fallback) {
+        std::vector<mllm::token_id_t> ids;
+        tokenizer.tokenize(text, ids, false, byte_fallback, "");
+        return ids;
+    };
+    mllm::BPETokenizer cached(path);
+    cached.setMergeRank(merge_rank);
+    auto before = tokenize(cached, "hellos hellos", false);
+
+    const std::unordered_map<std::string, mllm::token_id_t> special = {{"hellos", 8}};
+    cached.setSpecialTokenMap(special);
+    mllm::BPETokenizer fresh(path);
+    fresh.setMergeRank(merge_rank);
+    fresh.setSpecialTokenMap(special);
+    auto after = tokenize(cached, "hellos hellos", false);
+    EXPECT_NE(after, before);
+    EXPECT_EQ(after, tokenize(fresh, "hellos hellos", false));
+
+    // "z" is not in the vocabulary: <unk> without byte fallback, its byte with it
+    auto unk = tokenize(cached, "hez", false);
+    auto bytes = tokenize(cached, "hez", true);
+    EXPECT_NE(unk, bytes);
+    mllm::BPETokenizer fresh_bytes(path);
+    fresh_bytes.setMergeRank(merge_rank);
+    EXPECT_EQ(bytes, tokenize(fresh_bytes, "hez", true));
+    EXPECT_EQ(unk, tokenize(fresh_bytes, "hez", false));
+    EXPECT_EQ(tokenize(cached, "hez", true), bytes);
+}
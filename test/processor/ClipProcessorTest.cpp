@@ -0,0 +1,44 @@
+#include "TokenizorTest.hpp"
+#include "models/clip/processing_clip.hpp"
+#include <random>
+
+// a binary PPM of random pixels, which stb_image reads as any other image
+static std::string writeImage(const std::string &name, int width, int height, unsigned seed) {
+    auto path = testing::TempDir() + name + ".ppm";
+    FILE *fp = fopen(path.c_str(), "wb");
+    fprintf(fp, "P6\n%d %d\n255\n", width, height);
+    std::mt19937 rng(seed);
+    for (int i = 0; i < width * height * 3; ++i) {
+        fputc(rng() & 0xff, fp);
+    }
+    fclose(fp);
+    return path;
+}
+
+// the planes imagesToTensor decodes in parallel are the pixels of PreProcessImages + img2Tensor,
+// for a wide, a tall and a square image; a missing file exits after the loop, not inside it
+TEST_F(TokenizerTest, ClipImagesToTensor) {
+    const int hw = 32;
+    ClipProcessor processor(writeVocab("clip_planes", {"<unk>", "<|startoftext|>", "<|endoftext|>"}), "", hw, hw);
+    const std::vector<std::string> images = {writeImage("clip_wide", 53, 29, 1), writeImage("clip_tall", 21, 40, 2),
+                                             writeImage("clip_square", hw, hw, 3)};
+    auto planes = processor.imagesToTensor(images, hw);
+    ASSERT_EQ(planes.batch(), (int)images.size());
+    for (int i = 0; i < (int)images.size(); ++i) {
+        processor.pixel_values_.clear();
+        processor.PreProcessImages({images[i]});
+        auto expect = processor.img2Tensor(processor.pixel_values_[0], "expect");
+        for (int h = 0; h < hw; ++h) {
+            for (int c = 0; c < 3; ++c) {
+                for (int w = 0; w < hw; ++w) {
+                    ASSERT_NEAR(planes.dataAt<float>(i, h, c, w), expect.dataAt<float>(0, h, c, w), 1e-5)
+                        << images[i] << " row " << h << " channel " << c << " column " << w;
+                }
+            }
+        }
+    }
+
+    testing::FLAGS_gtest_death_test_style = "threadsafe";
+    EXPECT_EXIT(processor.imagesToTensor({images[0], testing::TempDir() + "clip_missing.ppm", images[1]}, hw),
+                testing::ExitedWithCode(255), "");
+}
@@ -0,0 +1,55 @@
+#include "TokenizorTest.hpp"
+#include "tokenizers/BPE/Bpe.hpp"
+#include "tokenizers/StreamDetokenizer.hpp"
+#include "tokenizers/Unigram/Unigram.hpp"
+
+// s is whole code points: every lead byte followed by all of its continuation bytes
+static bool wholeCodePoints(const std::string &s) {
+    for (size_t i = 0; i < s.size();) {
+        unsigned char c = s[i];
+        size_t len = c < 0x80 ? 1 : (c & 0xE0) == 0xC0 ? 2 : (c & 0xF0) == 0xE0 ? 3 : (c & 0xF8) == 0xF0 ? 4 : 0;
+        if (len == 0 || i + len > s.size()) {
+            return false;
+        }
+        for (size_t k = 1; k < len; ++k) {
+            if (((unsigned char)s[i + k] & 0xC0) != 0x80) {
+                return false;
+            }
+        }
+        i += len;
+    }
+    return true;
+}
+
+// the pushes give whole code points only, and with the flush they add up to detokenize(tokens)
+static void expectStreamed(mllm::Tokenizer &tokenizer, const std::vector<mllm::token_id_t> &tokens, bool unfinished) {
+    mllm::StreamDetokenizer stream(tokenizer);
+    std::string text;
+    for (auto token : tokens) {
+        const auto &piece = stream.push(token);
+        EXPECT_TRUE(wholeCodePoints(piece)) << "after token " << token;
+        text += piece;
+    }
+    const auto &rest = stream.flush();
+    EXPECT_EQ(rest.empty(), !unfinished);
+    text += rest;
+    EXPECT_EQ(text, tokenizer.detokenize(tokens));
+    EXPECT_TRUE(stream.flush().empty());
+}
+
+// CJK and emoji code points cut across tokens at every byte, ending inside an emoji
+TEST_F(TokenizerTest, StreamDetokenizerSplitCodePoints) {
+    // 中 E4 B8 AD, 文 E6 96 87, 😀 F0 9F 98 80
+    mllm::BPETokenizer tokenizer(writeVocab("stream_bytes", {"<unk>", "<s>", "</s>", "Hi ", "\xE4\xB8", "\xAD\xE6", "\x96\x87!",
+                                                             "\xF0\x9F", "\x98", "\x80 ok", "\xE4\xB8\xAD"}));
+    expectStreamed(tokenizer, {3, 4, 5, 6, 7, 8, 9, 10, 3}, false);
+    expectStreamed(tokenizer, {3, 4, 5, 6, 7, 8, 9, 7, 8}, true);
+}
+
+// SentencePiece byte fallback: <0xNN> tokens carry one byte each of 中 and 😀
+TEST_F(TokenizerTest, StreamDetokenizerByteFallback) {
+    mllm::UnigramTokenizer tokenizer(writeVocab("stream_fallback", {"<unk>", "<s>", "</s>", "<0xE4>", "<0xB8>", "<0xAD>", "\xE2\x96\x81\xE4\xB8\x96",
+                                                                    "<0xF0>", "<0x9F>", "<0x98>", "<0x80>", "a"}));
+    expectStreamed(tokenizer, {11, 3, 4, 5, 6, 7, 8, 9, 10, 11}, false);
+    expectStreamed(tokenizer, {6, 3, 4, 5, 7, 8, 9}, true);
+}
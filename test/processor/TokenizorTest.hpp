@@ -6,6 +6,9 @@
 #define MLLM_TOKENIZORTEST_HPP
 #include "gtest/gtest.h"
 #include "tokenizers/Tokenizer.hpp"
+#include <cstdio>
+#include <string>
+#include <vector>
 
 class TokenizerTest : public ::testing::Test {
 public:
@@ -19,4 +22,23 @@ protected:
 
     };
 }; // namespace mllm
+
+// a vocabulary file with the given tokens as ids 0..n-1
+static std::string writeVocab(const std::string &name, const std::vector<std::string> &tokens) {
+    auto path = testing::TempDir() + name + ".vocab.mllm";
+    FILE *fp = fopen(path.c_str(), "wb");
+    auto write_int = [fp](int v) { fwrite(&v, sizeof(v), 1, fp); };
+    write_int(mllm::VocabMagicNumber);
+    write_int(tokens.size());
+    for (int id = 0; id < (int)tokens.size(); ++id) {
+        write_int(id);
+        write_int(tokens[id].size());
+        fwrite(tokens[id].data(), 1, tokens[id].size(), fp);
+        float score = -(float)id;
+        fwrite(&score, sizeof(score), 1, fp);
+    }
+    fclose(fp);
+    return path;
+}
+
 #endif // MLLM_TOKENIZORTEST_HPP
@@ -2,6 +2,8 @@
 // Created by Xiang Li on 23-11-2.
 //
 #include "gtest/gtest.h"
+#include <map>
+#include <memory>
 #include <unordered_map>
 #include <vector> //
 #include "ParamLoader.hpp"
@@ -9,6 +11,8 @@
 #include "QuantWriter.hpp"
 #include "QuantTest.hpp"
 #include "Types.hpp"
+#include "backends/cpu/CPUBackend.hpp"
+#include "memory/SystemMemoryManager.hpp"
 #include "backends/cpu/third_party/ggml/QuantizeQ4.hpp" // For manual quantization
 
 namespace mllm {
@@ -113,4 +117,75 @@ TEST_F(QuantTest, QuantTest) {
     delete[] actual_quant_data_ptr;
     delete original_loader;
 }
+
+// two F32 tensors of odd sizes written with ParamWriter, returns their contents by name
+static std::map<std::string, std::vector<float>> writeTwoTensors(ParamWriter &writer) {
+    std::map<std::string, std::vector<float>> tensors = {{"a.weight", std::vector<float>(33)}, {"b.weight", std::vector<float>(1000)}};
+    std::vector<std::string> names;
+    float v = 0.5f;
+    for (auto &[name, data] : tensors) {
+        names.push_back(name);
+        for (auto &x : data) {
+            x = v;
+            v += 0.25f;
+        }
+    }
+    writer.paddingIndex(names);
+    for (auto &[name, data] : tensors) {
+        writer.beginWriteParam(name, DataType::MLLM_TYPE_F32);
+        writer.writeChunk(data.data(), data.size() * sizeof(float));
+        writer.endWriteParam();
+    }
+    writer.writeIndex();
+    return tensors;
+}
+
+// the default writer keeps the packed v1 format, version 2 is opt-in; both read back unchanged
+TEST_F(QuantTest, WriterRoundTripV1V2) {
+    for (int version : {0, 1, 2}) { // 0: the constructor default
+        auto path = testing::TempDir() + "round_trip_v" + std::to_string(version) + ".mllm";
+        std::map<std::string, std::vector<float>> tensors;
+        {
+            auto writer = version == 0 ? std::make_unique<ParamWriter>(path) : std::make_unique<ParamWriter>(path, version);
+            tensors = writeTwoTensors(*writer);
+        }
+        ParamLoader loader(path);
+        ASSERT_EQ(loader.getVersion(), version == 2 ? 2 : 1) << "version " << version;
+        ASSERT_EQ(loader.getParamNames().size(), tensors.size());
+        for (auto &[name, data] : tensors) {
+            ASSERT_EQ(loader.getDataType(name), DataType::MLLM_TYPE_F32);
+            auto meta = loader.getParamMetadata(name);
+            if (version == 2) {
+                EXPECT_EQ(meta.offset % _MLLM_V2_ALIGNMENT, 0) << name;
+            }
+            auto [bytes, size] = loader.load(name);
+            ASSERT_EQ(size, data.size() * sizeof(float)) << name << " version " << version;
+            EXPECT_EQ(memcmp(bytes, data.data(), size), 0) << name << " version " << version;
+            delete[] bytes;
+        }
+    }
+}
+
+// an mmap-ed v2 file hands out pointers into the mapping: no bytes are read and every tensor
+// starts on a page; the data is the one written
+TEST_F(QuantTest, WriterV2ZeroCopyLoad) {
+    auto path = testing::TempDir() + "zero_copy_v2.mllm";
+    std::map<std::string, std::vector<float>> tensors;
+    {
+        ParamWriter writer(path, 2);
+        tensors = writeTwoTensors(writer);
+    }
+    shared_ptr<MemoryManager> mm(new SystemMemoryManager());
+    CPUBackend backend(mm);
+    ParamLoader loader(path, true);
+    for (auto &[name, data] : tensors) {
+        Tensor tensor(1, 1, 1, data.size(), &backend, false);
+        tensor.setName(name);
+        tensor.setDtype(DataType::MLLM_TYPE_F32);
+        ASSERT_TRUE(loader.load(&tensor)) << name;
+        EXPECT_EQ((uintptr_t)tensor.rawHostPtr() % _MLLM_V2_ALIGNMENT, 0) << name;
+        EXPECT_EQ(memcmp(tensor.rawHostPtr(), data.data(), data.size() * sizeof(float)), 0) << name;
+    }
+    EXPECT_EQ(loader.loadedBytes(), 0);
+}
 } // namespace mllm
\ No newline at end of file
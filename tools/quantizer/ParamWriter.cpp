@@ -7,14 +7,22 @@
 #include <vector>
 #include <string>
 
-ParamWriter::ParamWriter(std::string filename) :
-    path_(std::move(filename)) {
+ParamWriter::ParamWriter(std::string filename, int version, uint32_t alignment) :
+    path_(std::move(filename)), version_(version), alignment_(alignment) {
+    if (version_ >= 2 && (alignment_ == 0 || (alignment_ & (alignment_ - 1)) != 0)) {
+        throw std::runtime_error("Alignment must be a power of two: " + std::to_string(alignment_));
+    }
     fp_ = fopen(path_.c_str(), "wb");
     if (fp_ == nullptr) {
         throw std::runtime_error("Failed to open file for writing: " + path_);
     }
-    // _MAGIC_NUMBER is defined in ParamLoader.hpp
-    writeInt(fp_, _MAGIC_NUMBER);
+    // _MAGIC_NUMBER and _MAGIC_NUMBER_V2 are defined in ParamLoader.hpp
+    if (version_ >= 2) {
+        writeInt(fp_, _MAGIC_NUMBER_V2);
+        writeInt(fp_, static_cast<int32_t>(alignment_));
+    } else {
+        writeInt(fp_, _MAGIC_NUMBER);
+    }
 }
 
 ParamWriter::~ParamWriter() {
@@ -32,7 +40,7 @@ int ParamWriter::calcIndexSize(const std::vector<std::string> &names) {
 }
 
 void ParamWriter::writeIndex() {
-    fseek(fp_, sizeof(int32_t) + sizeof(uint64_t), SEEK_SET);
+    fseek(fp_, version_ >= 2 ? _MLLM_V2_HEADER_SIZE : sizeof(int32_t) + sizeof(uint64_t), SEEK_SET);
     for (const auto &param : param_info_) {
         writeString(fp_, param.name);
         write_u64(fp_, param.size);
@@ -49,6 +57,13 @@ void ParamWriter::beginWriteParam(const std::string &name, DataType type) {
     auto &param = param_info_[index_];
     param.name = name;
     param.type = type;
+    if (version_ >= 2) {
+        // zero padding up to the next aligned offset
+        uint64_t pos = ftell(fp_);
+        uint64_t padding = (alignment_ - pos % alignment_) % alignment_;
+        std::vector<char> zeros(padding, 0);
+        fwrite(zeros.data(), sizeof(char), padding, fp_);
+    }
     param.offset = ftell(fp_);
 
     current_param_start_offset_ = param.offset;
@@ -35,7 +35,8 @@ struct ParmInfo {
 class ParamWriter {
 public:
     virtual ~ParamWriter();
-    explicit ParamWriter(std::string filename);
+    // version 1 packs the tensors; version 2 (opt-in) pads every tensor to `alignment` bytes, see _MAGIC_NUMBER_V2
+    explicit ParamWriter(std::string filename, int version = 1, uint32_t alignment = _MLLM_V2_ALIGNMENT);
     int calcIndexSize(const std::vector<std::string> &names);
     void writeIndex();
 
@@ -50,6 +51,8 @@ protected:
     FILE *fp_;
     std::string path_;
     std::vector<ParmInfo> param_info_;
+    int version_;
+    uint32_t alignment_;
 
 private:
     uint64_t current_param_start_offset_ = 0;
@@ -59,6 +59,8 @@ const std::vector<std::string> q4_0_kai_to_q4_0_4x4_layers = {
     // "dense",
 };
 
+static const std::string kSwiGLUSuffix = "gate_up_proj.interleaved.weight";
+
 bool find_in_layers(const std::string &name, const std::vector<std::string> &layer_names) {
     if ("vision_embed_tokens" == name) return true;
     for (const auto &layer : layer_names) {
@@ -69,8 +71,8 @@ bool find_in_layers(const std::string &name, const std::vector<std::string> &lay
     return false;
 }
 
-QuantWriter::QuantWriter(std::string output_path, std::string input_path) :
-    ParamWriter(std::move(output_path)), output_path_(this->path_) {
+QuantWriter::QuantWriter(std::string output_path, std::string input_path, int version) :
+    ParamWriter(std::move(output_path), version), output_path_(this->path_) {
     param_loader_ = new mllm::ParamLoader(std::move(input_path));
     if (!param_loader_->isAvailible()) {
         __exit(-1);
@@ -81,7 +83,7 @@ QuantWriter::~QuantWriter() {
     delete param_loader_;
 };
 
-int QuantWriter::readParams() {
+int QuantWriter::readParams(const std::string &other_flag) {
     original_param_names_ = param_loader_->getParamNames(); // 保存原始参数名
     param_names_ = original_param_names_;                   // 复制一份用于可能的操作
 
@@ -102,6 +104,32 @@ int QuantWriter::readParams() {
         param_names_.push_back("lm_head.weight");
     }
 
+    if (other_flag == "swiglu") {
+        // read by CPUSwiGLU: row 2i is gate row i, row 2i+1 is up row i
+        std::vector<std::string> names;
+        for (const auto &name : param_names_) {
+            if (name.find(".experts.") != std::string::npos) { // MoE experts keep their own Linear layers
+                names.push_back(name);
+                continue;
+            }
+            auto pos = name.rfind("gate_proj.weight");
+            if (pos != std::string::npos && pos + 16 == name.size()) {
+                auto prefix = name.substr(0, pos);
+                if (std::find(param_names_.begin(), param_names_.end(), prefix + "up_proj.weight") != param_names_.end()) {
+                    names.push_back(prefix + kSwiGLUSuffix);
+                    continue;
+                }
+            }
+            pos = name.rfind("up_proj.weight");
+            if (pos != std::string::npos && pos + 14 == name.size()
+                && std::find(param_names_.begin(), param_names_.end(), name.substr(0, pos) + "gate_proj.weight") != param_names_.end()) {
+                continue;
+            }
+            names.push_back(name);
+        }
+        param_names_ = names;
+    }
+
     paddingIndex(param_names_);
     return param_names_.size();
 }
@@ -191,6 +219,11 @@ void QuantWriter::quantize(DataType target_quant_type, const std::string &other_
     for (const auto &name : param_names_) {
         bool is_copied_lm_head = (name == "lm_head.weight" && std::find(original_param_names_.begin(), original_param_names_.end(), name) == original_param_names_.end());
         DataType final_quant_type = getQuantizationTypeFor(name, target_quant_type, other_flag);
+        auto swiglu_pos = name.rfind(kSwiGLUSuffix);
+        bool is_swiglu = swiglu_pos != std::string::npos && swiglu_pos + kSwiGLUSuffix.size() == name.size();
+        if (is_swiglu && (final_quant_type == MLLM_TYPE_KLEIDIAI_Q4_0 || final_quant_type == MLLM_TYPE_Q4_0_4_4)) {
+            final_quant_type = MLLM_TYPE_Q4_0; // packed layouts mix rows, they cannot be interleaved
+        }
 
         std::cout << "Processing param " << name << " -> " << DataTypeName(final_quant_type) << " ... ";
         if (is_copied_lm_head) {
@@ -210,6 +243,21 @@ void QuantWriter::quantize(DataType target_quant_type, const std::string &other_
                 __exit(-1);
             }
             num_floats = full_param_data.size();
+        } else if (is_swiglu) {
+            auto prefix = name.substr(0, swiglu_pos);
+            auto gate = load_full_fp32_param(prefix + "gate_proj.weight");
+            auto up = load_full_fp32_param(prefix + "up_proj.weight");
+            int K = find_in_layers(name, {"visual"}) ? vit_tmp_hidden_dim : tmp_hidden_dim;
+            if (gate.empty() || gate.size() != up.size() || K <= 0 || gate.size() % K != 0) {
+                std::cerr << "FAIL! Cannot interleave " << prefix << "gate_proj/up_proj" << std::endl;
+                __exit(-1);
+            }
+            num_floats = gate.size() * 2;
+            full_param_data.resize(num_floats);
+            for (uint64_t i = 0; i < gate.size() / K; ++i) {
+                memcpy(full_param_data.data() + (2 * i) * K, gate.data() + i * K, K * sizeof(float));
+                memcpy(full_param_data.data() + (2 * i + 1) * K, up.data() + i * K, K * sizeof(float));
+            }
         } else {
             ParamMetadata meta = param_loader_->getParamMetadata(name);
             num_floats = meta.size / sizeof(float);
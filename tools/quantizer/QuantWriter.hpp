@@ -63,8 +63,10 @@ extern const std::vector<std::string> q4_0_kai_to_q4_0_4x4_layers;
 class QuantWriter : public ParamWriter {
 public:
     ~QuantWriter();
-    explicit QuantWriter(std::string output_path, std::string input_path);
-    int readParams();
+    explicit QuantWriter(std::string output_path, std::string input_path, int version = 1);
+    // other_flag "swiglu": write <p>gate_proj/<p>up_proj as one row-interleaved <p>gate_up_proj.interleaved.weight,
+    // for models whose MLP is the SwiGLU layer (QWenMLP, LLaMAMLP)
+    int readParams(const std::string &other_flag = "");
 
     void quantize(DataType target_quant_type, const std::string &other_flag = "");
 
@@ -4,6 +4,7 @@
 #include "ParamWriter.hpp"
 #include "ParamLoader.hpp"
 #include <string>
+#include <vector>
 #include <iostream>
 #include "QuantWriter.hpp"
 #include "Types.hpp"
@@ -11,10 +12,23 @@
 const std::vector<std::string> vl_q4x4_2_q4_k_layers;
 
 int main(int argc, char **argv) {
+    // --v2 anywhere writes the page-aligned v2 file, v1 otherwise
+    int version = 1;
+    std::vector<char *> args;
+    for (int i = 0; i < argc; ++i) {
+        if (std::string(argv[i]) == "--v2") {
+            version = 2;
+        } else {
+            args.push_back(argv[i]);
+        }
+    }
+    argc = args.size();
+    argv = args.data();
     if (argc < 4) {
-        std::cout << "Usage: ./quantize <input_path> <output_path> <quant_type> [other_flag]\n";
+        std::cout << "Usage: ./quantize <input_path> <output_path> <quant_type> [other_flag] [--v2]\n";
         std::cout << "  quant_type: Q4_0, Q8_0, Q4_K, Q6_K, Q8_K, Q4_0_4_4, KAI_Q4_0, etc.\n";
-        std::cout << "  other_flag (optional): 'vl' or 'eager'\n";
+        std::cout << "  other_flag (optional): 'vl', 'eager', 'qw3' or 'swiglu' (fused gate/up weights for the SwiGLU op)\n";
+        std::cout << "  --v2 (optional): write the page-aligned v2 format for zero-copy mmap loading\n";
         return -1;
     }
     auto input_path = std::string(argv[1]);
@@ -23,8 +37,8 @@ int main(int argc, char **argv) {
     std::string other_flag = "";
     if (argc == 5) {
         other_flag = std::string(argv[4]);
-        if (other_flag != "vl" && other_flag != "eager" && other_flag != "qw3") {
-            std::cout << "Invalid other_flag. Use 'vl' or 'eager' or 'qw3'.\n";
+        if (other_flag != "vl" && other_flag != "eager" && other_flag != "qw3" && other_flag != "swiglu") {
+            std::cout << "Invalid other_flag. Use 'vl' or 'eager' or 'qw3' or 'swiglu'.\n";
             return -1;
         }
     }
@@ -53,8 +67,8 @@ int main(int argc, char **argv) {
         return -1;
     }
 
-    mllm::QuantWriter quant_writer(output_path, input_path);
-    int param_count = quant_writer.readParams();
+    mllm::QuantWriter quant_writer(output_path, input_path, version);
+    int param_count = quant_writer.readParams(other_flag);
     if (param_count <= 0) {
         std::cout << "No params to quantize\n";
         return -1;